@@ -70,3 +70,21 @@ def average_periods(peaks):
         return 0
     else:
         return sum(periods) / len(periods)
+
+
+def nlms(array, reference, taps=4, mu=0.05, epsilon=0.3):
+    """NLMS motion canceller, as NLMS_process of the firmware.
+
+    reference holds one band-passed array per accelerometer axis.
+    """
+    axes = len(reference)
+    weights = np.zeros((axes, taps))
+    history = np.zeros((axes, taps))
+    result = np.zeros(len(array))
+    for i in range(len(array)):
+        history = np.roll(history, -1, axis=1)
+        history[:, -1] = [axis[i] for axis in reference]
+        error = array[i] - np.sum(weights * history)
+        weights += mu * error / (epsilon + np.sum(history * history)) * history
+        result[i] = error
+    return result
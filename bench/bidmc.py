@@ -1,13 +1,30 @@
 import pandas as pd
 
+# The PLETH channel is enough for the respiration rate, which the firmware derives
+# from the amplitude, the baseline and the interval of the beats. Its benchmark
+# against the breath annotations is the host program
+# stm32/stm32pribor/tools/respiration.c; here the reference rate of the
+# annotations is compared with the RESP numeric of the bedside monitor.
+WINDOW = 32  # seconds, REFERENCE_WINDOW of tools/respiration.c
+FREQ = 125
+
+
+def reference_rate(breaths, time):
+    window = breaths[(breaths > time - WINDOW) & (breaths <= time)]
+    if len(window) < 3:
+        return float('nan')
+    return 60.0 * (len(window) - 1) / (window.iloc[-1] - window.iloc[0])
+
+
 if __name__ == '__main__':
     # Manual breath annotations
     breaths = pd.read_csv('BIDMC/bidmc_01_Breaths.csv')
-    # Fixed variables
-    fix = pd.read_csv('BIDMC/bidmc_01_Fix.txt')
     # Parameters
-    numerics = pd.read_csv('BIDMC/bidmc_01_Numerics.csv')
-    # Signals
-    signals = pd.read_csv('BIDMC/bidmc_01_Signals.csv')
+    numerics = pd.read_csv('BIDMC/bidmc_01_Numerics.csv', skipinitialspace=True)
+    numerics.columns = numerics.columns.str.strip()
 
-    # Не подходит, нет красного и ИК светодиодов
+    times = breaths.mean(axis=1) / FREQ
+    reference = pd.Series([reference_rate(times, t) for t in numerics['Time [s]']])
+    error = (numerics['RESP'] - reference).abs()
+    print('RESP against the breath annotations: MAE %.2f breaths/min over %d s'
+          % (error.mean(), error.count()))
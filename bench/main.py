@@ -1,9 +1,16 @@
+import argparse
+
 import matplotlib.pyplot as plt
 from algo import bandpass, ssf, find_peaks, average_periods, ma
 
 from utils import extract_mat_gap, normalize
 
 if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Heart rate of a gyro_acc_ppg subject against the ECG')
+    # c: the firmware heartmonitor.c through pribor.py, see the build steps there
+    parser.add_argument('--engine', choices=['python', 'c'], default='python')
+    args = parser.parse_args()
+
     data = extract_mat_gap('./gyro_acc_ppg/Subject_3.mat')
     freq = 50.0
     size = 200
@@ -16,27 +23,39 @@ if __name__ == '__main__':
     pgg3 = normalize(pgg[2], 0.5, 1.0)
 
     time = data['Time']
-    filtered = bandpass(pgg1, freq, 1.0, 8.5, 8)
-    s = ssf(filtered, 8)
-    p = []
-    calc = []
-    calc_time = []
-
-    for i in range(0, len(s), batch):
-        start_index = i
-        end_index = i + size
-        arr = s[start_index:end_index]
-        peaks = find_peaks(arr, 0.3)
-        avg = average_periods(peaks)
-        if avg == 0:
-            hr = 0
-        else:
-            hr = 60.0 / (avg / freq)
-        calc.append(hr)
-        calc_time.append(time[i])
-        p[i:i + batch] = (arr * peaks)[0:batch]
-
-    calc = ma(calc, 20)
+
+    if args.engine == 'c':
+        from pribor import HeartMonitor
+
+        with HeartMonitor(freq, size) as monitor:
+            result = monitor.process(pgg1, block=batch)
+        # The rate of a block is that of the window ending with it
+        calc_time = time[batch - 1::batch]
+        calc = result.tracked[:len(calc_time)]
+        signals = {'Preprocessed': result.filtered}
+    else:
+        filtered = bandpass(pgg1, freq, 1.0, 8.5, 8)
+        s = ssf(filtered, 8)
+        p = []
+        calc = []
+        calc_time = []
+
+        for i in range(0, len(s), batch):
+            start_index = i
+            end_index = i + size
+            arr = s[start_index:end_index]
+            peaks = find_peaks(arr, 0.3)
+            avg = average_periods(peaks)
+            if avg == 0:
+                hr = 0
+            else:
+                hr = 60.0 / (avg / freq)
+            calc.append(hr)
+            calc_time.append(time[i])
+            p[i:i + batch] = (arr * peaks)[0:batch]
+
+        calc = ma(calc, 20)
+        signals = {'BP': filtered, 'SSF': s, 'Peaks': p}
 
     plt.title("HR algorithm")
     plt.xlabel("t, sec")
@@ -52,9 +71,8 @@ if __name__ == '__main__':
     plt.ylabel("Values")
 
     plt.plot(time, pgg1, label='Original signal')
-    plt.plot(time, filtered, label='BP')
-    plt.plot(time, s, label='SSF')
-    plt.plot(time, p, label='Peaks')
+    for label, values in signals.items():
+        plt.plot(time, values, label=label)
 
     plt.legend()
     plt.show()
@@ -0,0 +1,63 @@
+import glob
+
+import numpy as np
+from algo import bandpass, ssf, find_peaks, average_periods, nlms
+
+from utils import extract_mat_gap, normalize
+
+# Gate of main.c: windows are dropped while the mean |x| + |y| + |z| of the
+# accelerometer is above the threshold, and for ROUNDS batches after it
+ACC_SCALE = 1.0  # accelerometer units of the dataset per g
+THRESHOLD_GATE = 3.0  # g, ACC_THRESHOLD without the motion canceller
+THRESHOLD_NLMS = 5.0  # g, ACC_THRESHOLD with the motion canceller
+ROUNDS = 4
+
+
+def heart_rates(s, acc_sum, threshold, freq, size, batch):
+    calc = []
+    discarded = 0
+    count = 0
+    for i in range(0, len(s) - size, batch):
+        count += 1
+        if np.mean(acc_sum[i:i + batch]) > threshold:
+            count = 0
+        if count <= ROUNDS:
+            calc.append(np.nan)
+            discarded += 1
+            continue
+        peaks = find_peaks(s[i:i + size], 0.3)
+        avg = average_periods(peaks)
+        calc.append(0 if avg == 0 else 60.0 / (avg / freq))
+    return np.array(calc), discarded
+
+
+def evaluate(filename, freq=50.0, size=200, batch=50):
+    data = extract_mat_gap(filename)
+    if 'ACC' not in data:
+        return None
+    acc = [axis / ACC_SCALE for axis in data['ACC']]
+    acc_sum = np.abs(acc[0]) + np.abs(acc[1]) + np.abs(acc[2])
+    bpm = data['BPM'][size:len(data['BPM']):batch]
+
+    filtered = bandpass(normalize(data['PGG'][0], 0.5, 1.0), freq, 1.0, 8.5, 8)
+    reference = [bandpass(axis, freq, 1.0, 8.5, 8) for axis in acc]
+    cleaned = nlms(filtered, reference)
+
+    result = {}
+    for name, signal, threshold in (('gate', filtered, THRESHOLD_GATE),
+                                    ('nlms', cleaned, THRESHOLD_NLMS)):
+        calc, discarded = heart_rates(np.array(ssf(signal, 8)), acc_sum, threshold, freq, size, batch)
+        valid = ~np.isnan(calc)
+        error = np.mean(np.abs(calc[valid] - bpm[:len(calc)][valid])) if valid.any() else np.nan
+        result[name] = (error, 100.0 * discarded / len(calc))
+    return result
+
+
+if __name__ == '__main__':
+    for filename in sorted(glob.glob('./gyro_acc_ppg/Subject_*.mat')):
+        result = evaluate(filename)
+        if result is None:
+            print(filename, 'no accelerometer channels')
+            continue
+        print(filename, ' '.join('%s: MAE %.2f bpm, %.1f%% discarded' % (name, *values)
+                                 for name, values in result.items()))
@@ -0,0 +1,111 @@
+"""ctypes binding of the heart monitor of the firmware (stm32/stm32pribor/Core/Src/heartmonitor.c).
+
+The DSP code that runs on the device processes whole recordings at native
+speed instead of the Python re-implementation of algo.py. Build the library
+with the host build of the firmware first:
+
+    cmake -S stm32/stm32pribor -B stm32/stm32pribor/build
+    cmake --build stm32/stm32pribor/build --target pribor_py
+
+The library is looked up in stm32/stm32pribor/build, or at the path of the
+PRIBOR_LIB environment variable. The NumPy arrays go to the C code by pointer;
+arrays which are not contiguous float32 are converted once.
+"""
+import ctypes
+import os
+from collections import namedtuple
+
+import numpy as np
+
+ENGINE_PEAKS = 0
+ENGINE_SPECTRUM = 1
+ENGINE_AUTOCORRELATION = 2
+
+LIBRARY = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'stm32', 'stm32pribor', 'build',
+                       'libpribor_py.so')
+
+Result = namedtuple('Result', ['filtered', 'rate', 'ratio', 'quality', 'tracked'])
+
+_floats = ctypes.POINTER(ctypes.c_float)
+_library = None
+
+
+def library():
+    """The loaded libpribor_py.so with the argument types of its functions."""
+    global _library
+    if _library is None:
+        lib = ctypes.CDLL(os.environ.get('PRIBOR_LIB', LIBRARY))
+        lib.HRPY_new.restype = ctypes.c_void_p
+        lib.HRPY_new.argtypes = [ctypes.c_float, ctypes.c_int, ctypes.c_float, ctypes.c_int, ctypes.c_float,
+                                 ctypes.c_float, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_float, ctypes.c_float,
+                                 ctypes.c_int, ctypes.c_int]
+        lib.HRPY_free.restype = None
+        lib.HRPY_free.argtypes = [ctypes.c_void_p]
+        lib.HRPY_process.restype = ctypes.c_int
+        lib.HRPY_process.argtypes = [ctypes.c_void_p, _floats, _floats, _floats, ctypes.c_int, ctypes.c_int,
+                                     _floats, _floats, _floats, _floats, _floats]
+        _library = lib
+    return _library
+
+
+def _array(array):
+    return np.ascontiguousarray(array, dtype=np.float32)
+
+
+def _pointer(array):
+    return None if array is None else array.ctypes.data_as(_floats)
+
+
+class HeartMonitor:
+    """HR_HeartMonitor with the parameters of HR_heartMonitor_new, the defaults are those of main.c."""
+
+    def __init__(self, freq, size, threshold=0.35, bpf_order=4, bpf_low=0.8, bpf_high=8.5, ssf_size=2,
+                 ma_green_size=5, ma_redir_size=7, rate_low=50, rate_high=150, engine=ENGINE_PEAKS, fusion=False):
+        self.freq = freq
+        self._monitor = None
+        self._lib = library()
+        self._monitor = self._lib.HRPY_new(freq, size, threshold, bpf_order, bpf_low, bpf_high, ssf_size,
+                                           ma_green_size, ma_redir_size, rate_low, rate_high, engine,
+                                           int(fusion))
+        if not self._monitor:
+            raise ValueError('no heart monitor for these parameters')
+
+    def close(self):
+        if self._monitor:
+            self._lib.HRPY_free(self._monitor)
+            self._monitor = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def process(self, green, red=None, ir=None, block=None):
+        """Runs the channels block by block as the main loop does, one second per block by default.
+
+        Returns the green channel after the preprocessing (BPF, SSF, MA) and the heart rate,
+        red/infrared ratio, signal quality index and tracked heart rate of every block. The
+        state of the monitor carries over to the next call.
+        """
+        if (red is None) != (ir is None):
+            raise ValueError('red and ir go together')
+        block = block or int(self.freq)
+        green = _array(green)
+        if red is not None:
+            red = _array(red)
+            ir = _array(ir)
+            if len(red) != len(green) or len(ir) != len(green):
+                raise ValueError('the channels differ in length')
+        blocks = (len(green) + block - 1) // block
+        filtered = np.empty_like(green)
+        rate, ratio, quality, tracked = (np.empty(blocks, dtype=np.float32) for _ in range(4))
+        done = self._lib.HRPY_process(self._monitor, _pointer(green), _pointer(red), _pointer(ir), len(green), block,
+                                      _pointer(filtered), _pointer(rate), _pointer(ratio), _pointer(quality),
+                                      _pointer(tracked))
+        if done != blocks:
+            raise ValueError('HRPY_process failed')
+        return Result(filtered, rate, ratio, quality, tracked)
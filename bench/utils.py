@@ -20,4 +20,7 @@ def extract_mat_gap(filename, freq=50):
     bpm_interp = np.interp(time, timeECG, bpmECG)
 
     result = {'PGG': [pgg0, pgg1, pgg2], 'Ticks': ticks, 'Time': time, 'BPM': bpm_interp}
+    if 'sigAcc' in data:
+        acc = data['sigAcc']
+        result['ACC'] = [acc[0].astype(float), acc[1].astype(float), acc[2].astype(float)]
     return result
@@ -31,7 +31,7 @@ def decode_data(message):
         position = "{:06.2f}:{:06.2f}:{:06.2f}".format(
             float("inf"), float("inf"), float("inf")
         )
-        user = "{:}:{:}:{:}".format(0, 0, 0)
+        user = "{:}:{:}:{:}:{:}:{:}:{:}:{:}".format(0, 0, 0, 0, 0, 0, 0)
         if msg.HasField("position"):
             position = "{:08.2f}:{:08.2f}:{:08.2f}".format(
                 msg.position.x_position,
@@ -40,10 +40,14 @@ def decode_data(message):
             )
         if msg.HasField("payload"):
             payload = SimplePayload(list(msg.payload))
-            user = "{:}:{:}:{:}".format(
+            user = "{:}:{:}:{:}:{:}:{:}:{:}:{:}".format(
                 payload.getHeartRate(),
                 payload.getSaturation(),
                 payload.getTemperature(),
+                payload.getRmssd(),
+                payload.getSdnn(),
+                payload.getPnn50(),
+                payload.getRespiration(),
             )
         served = set()
         for anchor in msg.rssi_entry:
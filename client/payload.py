@@ -21,3 +21,15 @@ class SimplePayload(Payload):
 
     def getSaturation(self):
         return self.user_data[2]
+
+    def getRmssd(self):
+        return self.user_data[3] if len(self.user_data) > 3 else 0
+
+    def getSdnn(self):
+        return self.user_data[4] if len(self.user_data) > 4 else 0
+
+    def getPnn50(self):
+        return self.user_data[5] if len(self.user_data) > 5 else 0
+
+    def getRespiration(self):
+        return self.user_data[6] if len(self.user_data) > 6 else 0
@@ -9,69 +9,235 @@
 #ifndef INC_HEARTMONITOR_H_
 #define INC_HEARTMONITOR_H_
 
-#define HR_DEBUG
+#include <stddef.h>
+#include <stdint.h>
 
 /**
- * @brief HeartMonitor debug mode
+ * @brief HeartMonitor fixed-point mode
  *
- * Store intermediate values of processing of signals.
+ * Run the green channel preprocessing and the red/infrared ratio of
+ * HR_HeartMonitor in fixed point (see heartmonitor_fixed.h) instead of float.
+ * The interface of HR_HeartMonitor stays the same.
  */
-#ifdef HR_DEBUG
+//#define HR_FIXED_POINT
 
 /**
- * @brief Size of the debug arrays.
+ * @brief HeartMonitor runtime filter design
  *
- * This constant defines the size of the debug arrays used for HR debugging.
- * It specifies the maximum number of elements that each debug array can hold.
+ * BPF_filter and HRQ_BPF_filter are bound to the tables generated at build
+ * time by tools/bpf_tables.py (see BPF_tables), HR_Spectrum and ATD_detector
+ * to those of tools/monitor_tables.py (see HR_spectrumTables and ATD_tables).
+ * With this switch they are
+ * designed when created for settings that have no table; without it such
+ * settings give NULL and the firmware links no cosf, sinf, tanf or expf.
  */
-#define HR_SIZE 25
+//#define HR_BPF_RUNTIME_DESIGN
+
+
+/**
+ * @brief Alignment of every block handed out by HR_Arena.
+ */
+#define HR_ARENA_ALIGNMENT 8
 
 /**
- * @brief Debug arrays for HR module.
+ * @brief Size of a block rounded up to HR_ARENA_ALIGNMENT.
+ */
+#define HR_ARENA_ALIGN(size) \
+	(((size_t) (size) + HR_ARENA_ALIGNMENT - 1) & ~(size_t) (HR_ARENA_ALIGNMENT - 1))
+
+/**
+ * @brief Structure representing a bump allocator over caller-provided memory.
  *
- * These arrays are used for debugging purposes in the HR module.
- * Each array has a size of HR_SIZE.
+ * Every object of this module is built from an arena: the structure itself
+ * first, then its arrays. The *_arenaNew functions take the arena from the
+ * caller (e.g. a static array sized with the *_FOOTPRINT macros), the *_new
+ * functions make one malloc of the exact footprint and build the object in it,
+ * so the matching *_free is a single free. Nothing is allocated after construction.
  */
-extern float d1[HR_SIZE], d2[HR_SIZE], d3[HR_SIZE], d4[HR_SIZE],
-             d5[HR_SIZE], d6[HR_SIZE], d7[HR_SIZE], d8[HR_SIZE];
+typedef struct {
+	uint8_t *base; /**< Pointer to the memory of the arena */
+	size_t size; /**< Size of the memory in bytes */
+	size_t used; /**< Number of bytes handed out so far */
+} HR_Arena;
+
+void HR_arena_init(HR_Arena *arena, void *memory, size_t size);
+void* HR_arena_alloc(HR_Arena *arena, size_t size);
+int HR_arena_fits(HR_Arena *arena, size_t footprint);
+
+/**
+ * @brief Coefficients of one second-order section of a BPF_filter.
+ */
+typedef struct {
+	float b0, b1, b2; /**< Numerator coefficients */
+	float a1, a2; /**< Denominator coefficients, a0 = 1 */
+} BPF_coefficients;
+
+/**
+ * @brief Band-pass filter designed at build time by tools/bpf_tables.py.
+ *
+ * Holds the sections of both BPF_filter and HRQ_BPF_filter for one order,
+ * sampling frequency and band. The tables stay in flash.
+ */
+typedef struct {
+	int order; /**< Order of the band-pass filter */
+	float freq; /**< Sampling frequency */
+	float low; /**< Lower cutoff frequency */
+	float high; /**< Upper cutoff frequency */
+	const BPF_coefficients *sections; /**< Pointer to the order second-order sections */
+	const int32_t *A, *d1, *d2, *d3, *d4; /**< Pointers to the order / 2 fixed-point 4th order sections, Q3.28 */
+} BPF_table;
+
+extern const BPF_table BPF_tables[];
+extern const int BPF_tables_size;
+
+const BPF_table* BPF_findTable(int order, float freq, float low, float high);
+
+/**
+ * @brief Structure representing one second-order section of a BPF_filter.
+ *
+ * Coefficients and state of a section are kept next to each other, so the
+ * whole cascade is one contiguous array. Transposed Direct Form II:
+ * y = b0 x + s1, s1 = b1 x - a1 y + s2, s2 = b2 x - a2 y.
+ */
+typedef struct {
+	float b0, b1, b2; /**< Numerator coefficients */
+	float a1, a2; /**< Denominator coefficients, a0 = 1 */
+	float s1, s2; /**< State */
+} BPF_biquad;
 
-#endif
 /**
  * @brief Structure representing a Band-Pass Filter (BPF) filter.
+ *
+ * Butterworth band-pass built as a cascade of @c n second-order sections.
  */
 typedef struct {
-	int n; /**< Number of elements */
+	int n; /**< Number of sections */
 	float freq; /**< Center frequency */
 	float freq_low; /**< Lower cutoff frequency */
 	float freq_high; /**< Upper cutoff frequency */
-	float *A, *d1, *d2, *d3, *d4, *w0, *w1, *w2, *w3, *w4; /**< Pointers to coefficients */
+	BPF_biquad *sections; /**< Pointer to the array of sections */
 } BPF_filter;
 
+/**
+ * @brief Arena bytes used by a BPF_filter of the given order.
+ */
+#define BPF_FOOTPRINT(order) \
+	(HR_ARENA_ALIGN(sizeof(BPF_filter)) \
+			+ HR_ARENA_ALIGN((order) * sizeof(BPF_biquad)))
+
 void BPF_process(BPF_filter *filter, float *array, int array_size);
 void BPF_free(BPF_filter *bpf_filter);
 BPF_filter* BPF_new(int order, float freq, float low, float high);
+BPF_filter* BPF_arenaNew(HR_Arena *arena, int order, float freq, float low,
+		float high);
+BPF_filter* BPF_tableArenaNew(HR_Arena *arena, const BPF_table *table);
+
+/**
+ * @brief Number of accelerometer axes used as the motion reference.
+ */
+#define HR_MOTION_AXES 3
+
+/**
+ * @brief Structure representing a Normalized Least Mean Squares (NLMS) motion canceller.
+ *
+ * Adaptive FIR filter from the band-passed accelerometer axes to the band-passed
+ * green channel. Its output is the motion-correlated part of the green channel,
+ * which is subtracted from every sample. The history of each axis is mirrored
+ * as in HR_Ring, so the last @c taps samples are contiguous.
+ */
+typedef struct {
+	int taps; /**< Number of taps per axis */
+	float mu; /**< Step size, 0 < mu < 2 */
+	float epsilon; /**< Regularization of the reference power */
+	float *weights; /**< Pointer to the HR_MOTION_AXES * taps weights */
+	float *history; /**< Pointer to the mirrored history, 2 * taps elements per axis */
+	int head; /**< Index of the oldest reference sample, next one is written here */
+	float power; /**< Running sum of squares of the reference history */
+} NLMS_filter;
+
+/**
+ * @brief Arena bytes used by a NLMS_filter with the given number of taps.
+ */
+#define NLMS_FOOTPRINT(taps) \
+	(HR_ARENA_ALIGN(sizeof(NLMS_filter)) \
+			+ HR_ARENA_ALIGN(HR_MOTION_AXES * (taps) * sizeof(float)) \
+			+ HR_ARENA_ALIGN(HR_MOTION_AXES * 2 * (taps) * sizeof(float)))
+
+NLMS_filter* NLMS_new(int taps, float mu, float epsilon);
+NLMS_filter* NLMS_arenaNew(HR_Arena *arena, int taps, float mu, float epsilon);
+void NLMS_free(NLMS_filter *filter);
+void NLMS_process(NLMS_filter *filter, float *array, float **reference,
+		int array_size);
+
+/**
+ * @brief Number of taps per axis of the motion canceller of the green channel.
+ */
+#define HR_NLMS_TAPS 4
+
+/**
+ * @brief Step size of the motion canceller of the green channel.
+ */
+#define HR_NLMS_MU 0.05
+
+/**
+ * @brief Regularization of the motion canceller, in g^2.
+ *
+ * Keeps the step small while the wearer is still and the reference is noise.
+ */
+#define HR_NLMS_EPSILON 0.3
+
+#include "heartmonitor_fixed.h"
 
 /**
  * @brief Structure representing a Moving Average (MA) filter.
+ *
+ * The window is a circular buffer with a running sum, so a sample costs O(1)
+ * regardless of the window size. The sum is recomputed from the window every
+ * time the buffer wraps, which bounds the rounding drift of the running sum.
  */
 typedef struct {
 	int window_size; /**< Size of the moving average window */
-	float *data; /**< Pointer to the previous data array */
+	float *data; /**< Pointer to the circular buffer of the window */
+	int head; /**< Index of the oldest sample, next one is written here */
+	float sum; /**< Running sum of the window */
 } MA_filter;
 
+/**
+ * @brief Arena bytes used by a MA_filter with the given window.
+ */
+#define MA_FOOTPRINT(window_size) \
+	(HR_ARENA_ALIGN(sizeof(MA_filter)) \
+			+ HR_ARENA_ALIGN((window_size) * sizeof(float)))
+
 MA_filter* MA_new(int window_size);
+MA_filter* MA_arenaNew(HR_Arena *arena, int window_size);
 void MA_process(MA_filter *filter, float *array, int array_size);
 void MA_free(MA_filter *filter);
 
 /**
  * @brief Structure representing a Slope Sum Function (SSF).
+ *
+ * Keeps the positive differences of the window_size - 1 adjacent pairs of the
+ * window in a circular buffer with a running sum, so a sample costs O(1)
+ * regardless of the window size. The sum is recomputed every time the buffer
+ * wraps, as in MA_filter.
  */
 typedef struct {
 	int window_size; /**< Window size */
-	float *data; /**< Pointer to the data array */
+	float *data; /**< Pointer to the circular buffer of positive differences */
+	int head; /**< Index of the oldest difference, next one is written here */
+	float previous; /**< Previous sample */
+	float sum; /**< Running sum of the positive differences */
 } SSF;
 
+/**
+ * @brief Arena bytes used by a SSF with the given window.
+ */
+#define SSF_FOOTPRINT(window_size) \
+	(HR_ARENA_ALIGN(sizeof(SSF)) + HR_ARENA_ALIGN((window_size) * sizeof(float)))
+
 SSF* SSF_new(int window_size);
+SSF* SSF_arenaNew(HR_Arena *arena, int window_size);
 void SSF_free(SSF *ssf);
 void SSF_process(SSF *ssf, float *array, int array_size);
 
@@ -80,15 +246,806 @@ void SSF_process(SSF *ssf, float *array, int array_size);
  */
 typedef struct {
 	BPF_filter *bpf_green; /**< Pointer to a Band-Pass Filter (BPF) for green channel data */
+	BPF_filter *bpf_motion[HR_MOTION_AXES]; /**< Pointers to the same BPF for every accelerometer axis */
+	NLMS_filter *nlms_green; /**< Pointer to a NLMS motion canceller for green channel data */
 	SSF *ssf_green; /**< Pointer to a Simple Smoothing Filter (SSF) for green channel data */
-	MA_filter *ma_green;
+	MA_filter *ma_green; /**< Pointer to a Moving Average (MA) filter for green channel data */
 } HR_GreenPreprocess;
 
+/**
+ * @brief Window of the moving average applied after the SSF of green channel.
+ */
+#define HR_GREEN_MA_SIZE 7
+
+/**
+ * @brief Arena bytes used by a HR_GreenPreprocess.
+ */
+#define HR_GREENPREPROCESS_FOOTPRINT(bpf_order, ssf_size) \
+	(HR_ARENA_ALIGN(sizeof(HR_GreenPreprocess)) \
+			+ (1 + HR_MOTION_AXES) * BPF_FOOTPRINT(bpf_order) \
+			+ NLMS_FOOTPRINT(HR_NLMS_TAPS) + SSF_FOOTPRINT(ssf_size) \
+			+ MA_FOOTPRINT(HR_GREEN_MA_SIZE))
+
 HR_GreenPreprocess* HR_greenPreprocess_new(float freq, int bpf_order,
 		float bpf_low, float bpf_high, int ssf_size);
+HR_GreenPreprocess* HR_greenPreprocess_arenaNew(HR_Arena *arena, float freq,
+		int bpf_order, float bpf_low, float bpf_high, int ssf_size);
 void HR_greenPreprocess_free(HR_GreenPreprocess *greenPrepocess);
 void HR_greenPreprocess_process(HR_GreenPreprocess *greenPrepocess,
 		float *array, int array_size);
+void HR_greenPreprocess_processMotion(HR_GreenPreprocess *greenPrepocess,
+		float *array, float **motion, int array_size);
+
+/**
+ * @brief Structure representing a circular buffer of samples.
+ *
+ * Storage is mirrored: every sample is written both at @c head and at
+ * @c head + size, so the last @c size samples are always available as one
+ * contiguous array starting at @c data[head]. Appending costs O(1) per sample
+ * regardless of the window size.
+ */
+typedef struct {
+	int size; /**< Number of samples in the window */
+	int head; /**< Index of the oldest sample, next one is written here */
+	float *data; /**< Pointer to the mirrored storage of 2 * size elements */
+} HR_Ring;
+
+/**
+ * @brief Arena bytes used by a HR_Ring of the given size.
+ */
+#define HR_RING_FOOTPRINT(size) \
+	(HR_ARENA_ALIGN(sizeof(HR_Ring)) + HR_ARENA_ALIGN(2 * (size) * sizeof(float)))
+
+HR_Ring* HR_ring_new(int size);
+HR_Ring* HR_ring_arenaNew(HR_Arena *arena, int size);
+void HR_ring_free(HR_Ring *ring);
+void HR_ring_push(HR_Ring *ring, float value);
+void HR_ring_pushArray(HR_Ring *ring, float *array, int array_size);
+float* HR_ring_window(HR_Ring *ring);
+
+/**
+ * @brief Structure representing a local maximum seen by the streaming peak detector.
+ */
+typedef struct {
+	float value; /**< Value of the local maximum */
+	unsigned int first; /**< Sample number of the first sample of the plateau */
+	unsigned int last; /**< Sample number of the last sample of the plateau */
+	float valley; /**< Minimum between the previous local maximum and this one */
+	unsigned int valley_index; /**< Sample number of the minimum */
+} PD_candidate;
+
+/**
+ * @brief Structure representing a streaming peak detector.
+ *
+ * Streaming equivalent of peaks_detect + peaks_normalize. Every sample updates
+ * a monotonic deque holding the window maximum and, once a local maximum is
+ * confirmed, emits it as a peak candidate together with the valley before it.
+ * Both cost amortised O(1) per sample. The peaks of the window are resolved
+ * from the candidates only, so old samples are never rescanned.
+ */
+typedef struct {
+	int size; /**< Size of the window in samples */
+	float threshold; /**< Relative threshold for peak detection */
+	unsigned int count; /**< Number of processed samples */
+	float previous; /**< Value of the previous sample */
+	unsigned int *max_index; /**< Sample numbers of the deque entries */
+	float *max_value; /**< Values of the deque entries */
+	int max_head; /**< Index of the deque front (window maximum) */
+	int max_size; /**< Number of entries in the deque */
+	int rising; /**< Non-zero while the signal is not decreasing */
+	PD_candidate pending; /**< Local maximum that is not confirmed yet */
+	int tail_rising; /**< Value of 'rising' before the last sample */
+	float tail_value; /**< Pending maximum value before the last sample */
+	unsigned int tail_first; /**< Pending maximum start before the last sample */
+	PD_candidate *candidates; /**< Ring of confirmed local maxima */
+	int candidates_capacity; /**< Capacity of the candidates ring */
+	int candidates_head; /**< Index of the oldest candidate */
+	int candidates_size; /**< Number of stored candidates */
+} PD_detector;
+
+/**
+ * @brief Capacity of the candidates ring of a PD_detector.
+ */
+#define PD_CAPACITY(size) ((size) / 2 + 2)
+
+/**
+ * @brief Arena bytes used by a PD_detector of the given size.
+ */
+#define PD_FOOTPRINT(size) \
+	(HR_ARENA_ALIGN(sizeof(PD_detector)) \
+			+ HR_ARENA_ALIGN((size) * sizeof(unsigned int)) \
+			+ HR_ARENA_ALIGN((size) * sizeof(float)) \
+			+ HR_ARENA_ALIGN(PD_CAPACITY(size) * sizeof(PD_candidate)))
+
+PD_detector* PD_new(int size, float threshold);
+PD_detector* PD_arenaNew(HR_Arena *arena, int size, float threshold);
+void PD_free(PD_detector *detector);
+void PD_push(PD_detector *detector, float value);
+void PD_process(PD_detector *detector, float *array, int array_size);
+void PD_peaks(PD_detector *detector, float *array, int *signals);
+
+/**
+ * @brief Structure representing a streaming beat detector with an adaptive threshold.
+ *
+ * Every local maximum above the threshold and at least @c refractory samples
+ * after the previous beat is a beat. A higher maximum within the refractory
+ * period moves the previous beat instead. The threshold restarts at @c ratio of
+ * every beat, at most HR_ATD_SPIKE times the average beat, and decays
+ * exponentially, so an artefact only hides the beats shortly after it. When
+ * no beat comes for HR_ATD_SEARCHBACK average intervals, the highest maximum
+ * missed since the last beat is taken as a beat (searchback). The position of
+ * every beat is refined between samples by a parabola through the maximum and
+ * its neighbours, and a beat is final once its refractory period has passed.
+ */
+typedef struct {
+	int size; /**< Size of the window in samples */
+	float ratio; /**< Threshold after a beat as a fraction of the beat */
+	int refractory; /**< Shortest beat interval in samples */
+	float decay; /**< Factor of the threshold per sample */
+	unsigned int count; /**< Number of processed samples */
+	float previous; /**< Value of the previous sample */
+	int rising; /**< Non-zero while the signal is rising */
+	float pending_value; /**< Value of the local maximum that is not confirmed yet */
+	unsigned int pending_index; /**< Sample number of the local maximum that is not confirmed yet */
+	float pending_before; /**< Value of the sample before the local maximum */
+	float threshold; /**< Current threshold */
+	float amplitude; /**< Running average of the beat values, 0 before the first beat */
+	float interval; /**< Running average of the beat intervals in samples */
+	float last_value; /**< Value of the last beat */
+	unsigned int last_index; /**< Sample number of the last beat */
+	int seen; /**< Number of beats so far, up to HR_ATD_WARMUP */
+	float missed_value; /**< Value of the highest maximum below the threshold since the last beat */
+	unsigned int missed_index; /**< Sample number of that maximum */
+	float missed_offset; /**< Position of that maximum between samples, -0.5 to 0.5 */
+	unsigned int *beats; /**< Pointer to the ring of sample numbers of the beats */
+	float *offsets; /**< Pointer to the ring of positions of the beats between samples */
+	int beats_capacity; /**< Capacity of the beats ring */
+	int beats_head; /**< Index of the oldest beat */
+	int beats_size; /**< Number of stored beats */
+	unsigned int next; /**< Sample number from which ATD_next looks for final beats */
+} ATD_detector;
+
+/**
+ * @brief Time constant of the threshold decay in seconds.
+ */
+#define HR_ATD_DECAY 0.8
+
+/**
+ * @brief Threshold decay of an ATD_detector generated at build time by tools/monitor_tables.py.
+ */
+typedef struct {
+	float freq; /**< Sampling frequency */
+	float decay; /**< Factor of the threshold per sample, exp(-1 / (HR_ATD_DECAY freq)) */
+} ATD_table;
+
+extern const ATD_table ATD_tables[];
+extern const int ATD_tables_size;
+
+const ATD_table* ATD_findTable(float freq);
+
+/**
+ * @brief Largest beat as a multiple of the average beat, bigger ones are clipped.
+ */
+#define HR_ATD_SPIKE 2.0
+
+/**
+ * @brief Beat interval without a beat, in average intervals, that starts a searchback.
+ */
+#define HR_ATD_SEARCHBACK 1.66
+
+/**
+ * @brief Smallest maximum taken by a searchback as a fraction of the average beat.
+ */
+#define HR_ATD_MISSED 0.3
+
+/**
+ * @brief Number of first beats averaged without clipping.
+ */
+#define HR_ATD_WARMUP 4
+
+/**
+ * @brief Capacity of the beats ring of an ATD_detector.
+ */
+#define ATD_CAPACITY(size) ((size) / 2 + 2)
+
+/**
+ * @brief Arena bytes used by an ATD_detector of the given size.
+ */
+#define ATD_FOOTPRINT(size) \
+	(HR_ARENA_ALIGN(sizeof(ATD_detector)) \
+			+ HR_ARENA_ALIGN(ATD_CAPACITY(size) * sizeof(unsigned int)) \
+			+ HR_ARENA_ALIGN(ATD_CAPACITY(size) * sizeof(float)))
+
+ATD_detector* ATD_new(int size, float freq, float threshold, float rate_high);
+ATD_detector* ATD_arenaNew(HR_Arena *arena, int size, float freq,
+		float threshold, float rate_high);
+void ATD_free(ATD_detector *detector);
+void ATD_push(ATD_detector *detector, float value);
+void ATD_process(ATD_detector *detector, float *array, int array_size);
+void ATD_peaks(ATD_detector *detector, int *signals);
+int ATD_next(ATD_detector *detector, unsigned int *index, float *offset);
+
+/**
+ * @brief Structure representing a spectral heart rate estimator (Goertzel bank).
+ *
+ * The power of the window is evaluated at @c bins frequencies spaced by @c step,
+ * starting at @c low, with a Hann window. The strongest bin is refined by
+ * parabolic interpolation with its neighbours. All bins run in the same pass
+ * over the samples, so the window is read once per estimate.
+ */
+typedef struct {
+	int size; /**< Number of samples in the window */
+	int bins; /**< Number of frequency bins */
+	float low; /**< Frequency of the first bin in Hz */
+	float step; /**< Spacing of the bins in Hz */
+	const float *window; /**< Pointer to the Hann window of size samples */
+	const float *coefficients; /**< Pointer to the Goertzel coefficients 2 cos(2 pi f / freq) of the bins */
+	float *state; /**< Pointer to the two Goertzel states of every bin, then the power */
+} HR_Spectrum;
+
+/**
+ * @brief Lowest frequency in Hz searched by the spectral heart rate engine, 48 bpm.
+ */
+#define HR_SPECTRUM_LOW 0.8
+
+/**
+ * @brief Spacing in Hz of the bins of the spectral heart rate engine, 7.5 bpm.
+ */
+#define HR_SPECTRUM_STEP 0.125
+
+/**
+ * @brief Number of bins of the spectral heart rate engine, up to 3.55 Hz (213 bpm).
+ */
+#define HR_SPECTRUM_BINS 23
+
+/**
+ * @brief Hann window and Goertzel coefficients of a HR_Spectrum generated at build time by tools/monitor_tables.py.
+ *
+ * The tables stay in flash.
+ */
+typedef struct {
+	int size; /**< Number of samples in the window */
+	float freq; /**< Sampling frequency */
+	float low; /**< Frequency of the first bin in Hz */
+	float step; /**< Spacing of the bins in Hz */
+	int bins; /**< Number of frequency bins */
+	const float *window; /**< Pointer to the Hann window of size samples */
+	const float *coefficients; /**< Pointer to the Goertzel coefficients of the bins */
+} HR_SpectrumTable;
+
+extern const HR_SpectrumTable HR_spectrumTables[];
+extern const int HR_spectrumTables_size;
+
+const HR_SpectrumTable* HR_spectrum_findTable(int size, float freq, float low,
+		float step, int bins);
+
+/**
+ * @brief Arena bytes used by a HR_Spectrum with the given window and bins.
+ *
+ * With HR_BPF_RUNTIME_DESIGN the window and the coefficients of settings without a
+ * HR_SpectrumTable are computed into the arena.
+ */
+#ifdef HR_BPF_RUNTIME_DESIGN
+#define HR_SPECTRUM_FOOTPRINT(size, bins) \
+	(HR_ARENA_ALIGN(sizeof(HR_Spectrum)) \
+			+ HR_ARENA_ALIGN((size) * sizeof(float)) \
+			+ HR_ARENA_ALIGN((bins) * sizeof(float)) \
+			+ HR_ARENA_ALIGN(2 * (bins) * sizeof(float)))
+#else
+#define HR_SPECTRUM_FOOTPRINT(size, bins) \
+	(HR_ARENA_ALIGN(sizeof(HR_Spectrum)) \
+			+ HR_ARENA_ALIGN(2 * (bins) * sizeof(float)))
+#endif
+
+HR_Spectrum* HR_spectrum_new(int size, float freq, float low, float step,
+		int bins);
+HR_Spectrum* HR_spectrum_arenaNew(HR_Arena *arena, int size, float freq,
+		float low, float step, int bins);
+void HR_spectrum_free(HR_Spectrum *spectrum);
+float HR_spectrum_heartRate(HR_Spectrum *spectrum, float *array);
+
+/**
+ * @brief Structure representing an incremental autocorrelation heart rate estimator.
+ *
+ * Keeps the running sums x[n] x[n - lag] over the last @c size samples for the
+ * lags of the heart rate band, and the running sums of the samples, so every new
+ * sample updates them in O(lags) and the estimate is available after any sample.
+ * The sums are recomputed from the history once per @c size samples to drop the
+ * rounding, as in MA_process.
+ */
+typedef struct {
+	int size; /**< Number of products summed per lag */
+	float freq; /**< Sampling frequency */
+	int lag_min; /**< Shortest lag of the band, highest heart rate */
+	int lag_max; /**< Longest lag of the band, lowest heart rate */
+	int length; /**< Number of samples in the history, size + lag_max + 2 */
+	float *history; /**< Pointer to the circular buffer of the last samples */
+	int head; /**< Index of the newest sample in the history */
+	float *products; /**< Pointer to the running sums of x[n] x[n - lag], lag 0 to lag_max + 1 */
+	float *sums; /**< Pointer to the circular buffer of the window sums of the last lag_max + 2 samples */
+	int sum_head; /**< Index of the newest window sum */
+	int count; /**< Samples since the last recomputation */
+} HR_Autocorrelation;
+
+/**
+ * @brief Arena bytes used by a HR_Autocorrelation with the given window.
+ *
+ * Lags are limited to half of the window, so at least two beats are compared.
+ */
+#define HR_AUTOCORRELATION_FOOTPRINT(size) \
+	(HR_ARENA_ALIGN(sizeof(HR_Autocorrelation)) \
+			+ HR_ARENA_ALIGN(((size) + (size) / 2 + 3) * sizeof(float)) \
+			+ 2 * HR_ARENA_ALIGN(((size) / 2 + 3) * sizeof(float)))
+
+HR_Autocorrelation* HR_autocorrelation_new(int size, float freq,
+		float rate_low, float rate_high);
+HR_Autocorrelation* HR_autocorrelation_arenaNew(HR_Arena *arena, int size,
+		float freq, float rate_low, float rate_high);
+void HR_autocorrelation_free(HR_Autocorrelation *autocorrelation);
+void HR_autocorrelation_push(HR_Autocorrelation *autocorrelation, float value);
+void HR_autocorrelation_process(HR_Autocorrelation *autocorrelation,
+		float *array, int array_size);
+float HR_autocorrelation_heartRate(HR_Autocorrelation *autocorrelation,
+		float *confidence);
+
+/**
+ * @brief Structure representing a heart rate tracker.
+ *
+ * Scalar Kalman filter of the heart rate in bpm with a random walk model. Every
+ * window gives one measurement with its own variance: from the peaks, the
+ * implausible beat intervals and those far from the median interval (missed or
+ * double-detected beats) are dropped and the spread of the rest sets the
+ * variance. Consecutive windows overlap, so only the intervals that end in the
+ * part of the window added since the last measurement are measured, and every
+ * interval reaches the filter once. A measurement far outside the predicted
+ * range is ignored, unless HR_TRACKER_OUTLIERS come in a row, which restarts
+ * the track at it.
+ */
+typedef struct {
+	float freq; /**< Sampling frequency */
+	float rate_low; /**< Lowest heart rate in bpm of a kept beat interval */
+	float rate_high; /**< Highest heart rate in bpm of a kept beat interval */
+	int capacity; /**< Maximum number of beat intervals of a window */
+	float *intervals; /**< Pointer to the beat intervals of the last window in samples */
+	int count; /**< Number of beat intervals kept from the last window */
+	float rate; /**< Tracked heart rate in bpm, NaN before the first measurement */
+	float variance; /**< Variance of the tracked heart rate in bpm^2 */
+	int outliers; /**< Number of measurements ignored in a row */
+} HR_Tracker;
+
+/**
+ * @brief Largest relative distance of a beat interval from the median interval of its window.
+ */
+#define HR_TRACKER_GATE 0.3
+
+/**
+ * @brief Growth of the variance of the tracked heart rate per update in bpm^2.
+ */
+#define HR_TRACKER_PROCESS 4.0
+
+/**
+ * @brief Variance of a measurement in bpm^2 when the estimator gives no spread.
+ */
+#define HR_TRACKER_NOISE 4.0
+
+/**
+ * @brief Number of ignored measurements in a row after which the track restarts.
+ */
+#define HR_TRACKER_OUTLIERS 3
+
+/**
+ * @brief Arena bytes used by a HR_Tracker for up to the given number of beat intervals.
+ */
+#define HR_TRACKER_FOOTPRINT(capacity) \
+	(HR_ARENA_ALIGN(sizeof(HR_Tracker)) \
+			+ HR_ARENA_ALIGN((capacity) * sizeof(float)))
+
+HR_Tracker* HR_tracker_new(int capacity, float freq, float rate_low,
+		float rate_high);
+HR_Tracker* HR_tracker_arenaNew(HR_Arena *arena, int capacity, float freq,
+		float rate_low, float rate_high);
+void HR_tracker_free(HR_Tracker *tracker);
+void HR_tracker_reset(HR_Tracker *tracker);
+float HR_tracker_update(HR_Tracker *tracker, float rate, float variance);
+float HR_tracker_updatePeaks(HR_Tracker *tracker, int *peaks, int peaks_size,
+		int start);
+float HR_tracker_measurePeaks(HR_Tracker *tracker, int *peaks, int peaks_size,
+		int start, float *variance);
+
+/**
+ * @brief Structure representing the beat-to-beat interval (heart rate variability) stage.
+ *
+ * Takes the final beats of the ATD_detector one by one and keeps the last @c size
+ * beat intervals in a ring together with the difference of every interval from the
+ * one before it. Running sums over the ring give RMSSD, SDNN and pNN50 without a pass
+ * over the ring, they are recomputed when the head wraps to drop the rounding, as in
+ * MA_process. Implausible intervals and those far from the mean interval (missed or
+ * double-detected beats) are dropped, and the interval after a dropped one has no
+ * difference because the two beats are not successive.
+ */
+typedef struct {
+	float freq; /**< Sampling frequency */
+	float rate_low; /**< Lowest heart rate in bpm of a kept beat interval */
+	float rate_high; /**< Highest heart rate in bpm of a kept beat interval */
+	int size; /**< Capacity of the rings */
+	float *intervals; /**< Pointer to the ring of beat intervals in ms */
+	float *differences; /**< Pointer to the ring of differences from the interval before in ms, NaN if not successive */
+	int head; /**< Index of the next interval in the rings */
+	int count; /**< Number of intervals in the ring */
+	float reference; /**< Interval subtracted before the sums to keep the squares small, in ms */
+	float sum; /**< Sum of the intervals minus the reference */
+	float square; /**< Sum of the squared intervals minus the reference */
+	float difference_square; /**< Sum of the squared differences */
+	int differences_count; /**< Number of differences in the ring */
+	int nn50; /**< Number of differences larger than 50 ms in the ring */
+	int started; /**< 1 once a beat was given after HR_variability_reset */
+	unsigned int last_index; /**< Sample number of the last beat */
+	float last_offset; /**< Position of the last beat between samples */
+	float interval; /**< Last accepted interval in ms, NaN if the last interval was dropped */
+	float time; /**< Time of the beat ending the last accepted interval in ms */
+	int outliers; /**< Number of intervals dropped in a row */
+	float candidate; /**< Last interval in ms while the ring is empty, NaN if none */
+} HR_Variability;
+
+/**
+ * @brief Number of beat intervals in the window of the HRV measures, about a minute at rest.
+ */
+#define HR_HRV_SIZE 64
+
+/**
+ * @brief Largest relative distance of a beat interval from the mean interval of the ring.
+ */
+#define HR_HRV_GATE 0.2
+
+/**
+ * @brief Number of dropped intervals in a row after which the ring restarts.
+ */
+#define HR_HRV_OUTLIERS 8
+
+/**
+ * @brief Difference of successive intervals in ms counted by pNN50.
+ */
+#define HR_HRV_NN50 50.0
+
+/**
+ * @brief Arena bytes used by a HR_Variability with the given number of intervals.
+ */
+#define HR_VARIABILITY_FOOTPRINT(size) \
+	(HR_ARENA_ALIGN(sizeof(HR_Variability)) \
+			+ 2 * HR_ARENA_ALIGN((size) * sizeof(float)))
+
+HR_Variability* HR_variability_new(int size, float freq, float rate_low,
+		float rate_high);
+HR_Variability* HR_variability_arenaNew(HR_Arena *arena, int size, float freq,
+		float rate_low, float rate_high);
+void HR_variability_free(HR_Variability *variability);
+void HR_variability_reset(HR_Variability *variability);
+float HR_variability_beat(HR_Variability *variability, unsigned int index,
+		float offset);
+float HR_variability_rmssd(HR_Variability *variability);
+float HR_variability_sdnn(HR_Variability *variability);
+float HR_variability_pnn50(HR_Variability *variability);
+
+/**
+ * @brief Per-beat features of the respiration stage, indices of HR_Respiration.
+ *
+ * Breathing modulates the pulse amplitude (RIAV), the baseline of the pulse (RIIV) and
+ * the beat interval (RIFV, respiratory sinus arrhythmia).
+ */
+#define HR_RESP_FEATURES 3
+#define HR_RESP_AMPLITUDE 0
+#define HR_RESP_BASELINE 1
+#define HR_RESP_INTERVAL 2
+
+/**
+ * @brief Structure representing the respiration rate estimator.
+ *
+ * Every feature of the beats is resampled by linear interpolation to a series of
+ * @c freq samples per second and band-passed to the breathing band less its mean, so
+ * the filter does not ring on the step from zero to the first beat. A breath is a
+ * rising crossing of the filtered series through HR_RESP_HYSTERESIS times its mean
+ * level after it fell below the negative of it. The rate of a feature comes from the
+ * median of its last breath intervals, and only the rates of the features that agree
+ * within HR_RESP_AGREE are fused, so a feature distorted by motion or barely modulated
+ * by breathing does not give a wrong reading. A feature whose modulation depth, the mean
+ * level of the filtered series over the mean pulse amplitude (beat interval for the beat
+ * interval), is below HR_RESP_DEPTH gives no rate, so steady beats give no reading at all.
+ */
+typedef struct {
+	float freq; /**< Sampling frequency of the resampled series */
+	int capacity; /**< Number of breath intervals kept per feature */
+	BPF_filter *bpf[HR_RESP_FEATURES]; /**< Pointers to the breathing band-pass filters of the features */
+	float previous[HR_RESP_FEATURES]; /**< Features of the previous beat */
+	float previous_time; /**< Time of the previous beat in s, NaN before the first beat */
+	float next; /**< Time of the next sample of the resampled series in s */
+	float mean[HR_RESP_FEATURES]; /**< Running mean of the features, NaN before the first sample */
+	float level[HR_RESP_FEATURES]; /**< Mean absolute value of the filtered features */
+	int below[HR_RESP_FEATURES]; /**< 1 if the filtered feature fell below the negative threshold since the last breath */
+	float breath[HR_RESP_FEATURES]; /**< Time of the last breath of the features in s, NaN before the first one */
+	float *intervals; /**< Pointer to the rings of breath intervals in s, capacity per feature */
+	int head[HR_RESP_FEATURES]; /**< Index of the next breath interval in the ring of each feature */
+	int count[HR_RESP_FEATURES]; /**< Number of breath intervals in the ring of each feature */
+	float *sorted; /**< Scratch array for the median of the breath intervals */
+} HR_Respiration;
+
+/**
+ * @brief Sampling frequency of the resampled features in Hz, there must be a BPF_tables entry for it.
+ */
+#define HR_RESP_FREQ 2.0
+
+/**
+ * @brief Order and band in Hz of the breathing band-pass filter, 6 to 42 breaths/min.
+ */
+#define HR_RESP_BPF_ORDER 2
+#define HR_RESP_BPF_LOW 0.1
+#define HR_RESP_BPF_HIGH 0.7
+
+/**
+ * @brief Number of breath intervals per feature, about 25 s of breathing at rest.
+ */
+#define HR_RESP_BREATHS 8
+
+/**
+ * @brief Least number of breath intervals of a feature that gives a rate.
+ */
+#define HR_RESP_MIN_BREATHS 3
+
+/**
+ * @brief Threshold of the breath detector as a fraction of the mean level of the filtered feature.
+ */
+#define HR_RESP_HYSTERESIS 0.2
+
+/**
+ * @brief Time constant of the mean level of the filtered features and of the mean features in s.
+ */
+#define HR_RESP_LEVEL 10.0
+
+/**
+ * @brief Least modulation depth of a feature that gives a rate.
+ *
+ * Breathing modulates the features of the BIDMC recordings by 4 % to 10 %, beats that it
+ * does not modulate vary by well under 1 % when they are clean.
+ */
+#define HR_RESP_DEPTH 0.012
+
+/**
+ * @brief Largest spread in breaths/min of the feature rates that are fused.
+ */
+#define HR_RESP_AGREE 4.0
+
+/**
+ * @brief Arena bytes used by a HR_Respiration with the given number of breath intervals.
+ */
+#define HR_RESPIRATION_FOOTPRINT(capacity) \
+	(HR_ARENA_ALIGN(sizeof(HR_Respiration)) \
+			+ HR_RESP_FEATURES * BPF_FOOTPRINT(HR_RESP_BPF_ORDER) \
+			+ HR_ARENA_ALIGN(HR_RESP_FEATURES * (capacity) * sizeof(float)) \
+			+ HR_ARENA_ALIGN((capacity) * sizeof(float)))
+
+HR_Respiration* HR_respiration_new(int capacity, float freq);
+HR_Respiration* HR_respiration_arenaNew(HR_Arena *arena, int capacity,
+		float freq);
+void HR_respiration_free(HR_Respiration *respiration);
+void HR_respiration_reset(HR_Respiration *respiration);
+void HR_respiration_beat(HR_Respiration *respiration, float time,
+		float *features);
+float HR_respiration_featureRate(HR_Respiration *respiration, int feature);
+float HR_respiration_rate(HR_Respiration *respiration);
+
+/**
+ * @brief Heart rate estimators of a HR_HeartMonitor.
+ */
+typedef enum {
+	HR_ENGINE_PEAKS, /**< Mean spacing of the detected peaks */
+	HR_ENGINE_SPECTRUM, /**< Strongest frequency of the window, see HR_Spectrum */
+	HR_ENGINE_AUTOCORRELATION /**< Strongest period of the window, updated every sample, see HR_Autocorrelation */
+} HR_Engine;
+
+/**
+ * @brief Layout of one sample of the interleaved AFE FIFO.
+ *
+ * Every sample holds HR_AFE_STRIDE values: red, infrared, green and ambient.
+ */
+#define HR_AFE_STRIDE 4
+#define HR_AFE_RED 0
+#define HR_AFE_IR 1
+#define HR_AFE_GREEN 2
+
+/**
+ * @brief Maximum number of green samples preprocessed at once by HR_heartMonitor_addInterleaved.
+ */
+#define HR_BLOCK_SIZE 32
+
+/**
+ * @brief Low-pass filter of a HR_Decimator designed at build time by tools/decimator_tables.py.
+ *
+ * The taps h are stored phase by phase: row p holds h[p], h[p + factor], h[p + 2 factor] and
+ * so on, padded with zeros to length coefficients. The table stays in flash.
+ */
+typedef struct {
+	int factor; /**< Decimation factor */
+	float freq; /**< Output sampling frequency */
+	float pass; /**< Upper edge of the pass band */
+	int length; /**< Number of coefficients per phase */
+	int delay; /**< Delay of the filter in input samples */
+	const float *coefficients; /**< Pointer to the factor rows of coefficients */
+} HR_DecimatorTable;
+
+extern const HR_DecimatorTable HR_decimatorTables[];
+extern const int HR_decimatorTables_size;
+
+const HR_DecimatorTable* HR_decimator_findTable(int factor, float freq,
+		float pass);
+
+/**
+ * @brief Number of channels of the AFE FIFO filtered by a HR_Decimator: red, infrared and green.
+ *
+ * The ambient value of an output sample is the one of the last input sample.
+ */
+#define HR_DECIMATOR_CHANNELS 3
+
+/**
+ * @brief Maximum number of coefficients per phase of a HR_DecimatorTable.
+ */
+#define HR_DECIMATOR_LENGTH 16
+
+/**
+ * @brief Weight of a new rise in the average distance of the rises from their beats.
+ */
+#define HR_DECIMATOR_LAG_GAIN 0.1
+
+/**
+ * @brief Structure representing a polyphase decimator of the interleaved AFE FIFO.
+ *
+ * The AFE runs factor times faster than the heart monitor and every output sample is the
+ * low-passed input at one sample of factor. Transposed polyphase form: every input sample
+ * is multiplied by the row of its phase and added to the partial sums of the length outputs
+ * it belongs to, so only length values per channel are kept and the cost is length
+ * multiply-adds per channel and input sample, a factor less than filtering at the high rate.
+ *
+ * With a history the raw green samples at the high rate are kept for HR_decimator_refine.
+ */
+typedef struct {
+	int factor; /**< Decimation factor */
+	int length; /**< Number of coefficients per phase */
+	int delay; /**< Delay of the filter in input samples */
+	const float *coefficients; /**< Pointer to the coefficients of the HR_DecimatorTable */
+	int phase; /**< Row of the next input sample, an output is complete after row 0 */
+	float *sums; /**< Pointer to the HR_DECIMATOR_CHANNELS rows of partial sums, the next output first */
+	unsigned int count; /**< Number of input samples */
+	float lag; /**< Average distance of the rises before their beats in output samples or NaN */
+	HR_Ring *green; /**< Pointer to the ring of the high-rate green samples or NULL */
+} HR_Decimator;
+
+/**
+ * @brief Arena bytes used by a HR_Decimator keeping the given number of high-rate green samples.
+ */
+#define HR_DECIMATOR_FOOTPRINT(history) \
+	(HR_ARENA_ALIGN(sizeof(HR_Decimator)) \
+			+ HR_ARENA_ALIGN(HR_DECIMATOR_CHANNELS * HR_DECIMATOR_LENGTH \
+					* sizeof(float)) \
+			+ ((history) > 0 ? HR_RING_FOOTPRINT(history) : 0))
+
+HR_Decimator* HR_decimator_new(int factor, float freq, float pass,
+		int history);
+HR_Decimator* HR_decimator_arenaNew(HR_Arena *arena, int factor, float freq,
+		float pass, int history);
+void HR_decimator_free(HR_Decimator *decimator);
+void HR_decimator_reset(HR_Decimator *decimator);
+int HR_decimator_process(HR_Decimator *decimator, const float *fifo,
+		int samples, float *output);
+float HR_decimator_refine(HR_Decimator *decimator, float ago, float span);
+
+/**
+ * @brief Structure representing the Moving Average (MA) filters of the red and infrared channels.
+ *
+ * Structure of arrays: both windows share the head and are updated by the same step,
+ * as two MA_filter objects would be. With HR_FIXED_POINT the samples are Q8.23.
+ */
+typedef struct {
+	int window_size; /**< Size of the moving average windows */
+	int head; /**< Index of the oldest samples, next ones are written here */
+#ifdef HR_FIXED_POINT
+	int32_t *red; /**< Pointer to the circular buffer of the red window */
+	int32_t *ir; /**< Pointer to the circular buffer of the infrared window */
+	int32_t sum_red; /**< Running sum of the red window */
+	int32_t sum_ir; /**< Running sum of the infrared window */
+#else
+	float *red; /**< Pointer to the circular buffer of the red window */
+	float *ir; /**< Pointer to the circular buffer of the infrared window */
+	float sum_red; /**< Running sum of the red window */
+	float sum_ir; /**< Running sum of the infrared window */
+#endif
+} HR_RedIrMA;
+
+/**
+ * @brief Arena bytes used by a HR_RedIrMA with the given window.
+ *
+ * Float and Q8.23 samples take the same 4 bytes.
+ */
+#define HR_REDIRMA_FOOTPRINT(window_size) \
+	(HR_ARENA_ALIGN(sizeof(HR_RedIrMA)) \
+			+ 2 * HR_ARENA_ALIGN((window_size) * sizeof(int32_t)))
+
+HR_RedIrMA* HR_redIrMA_arenaNew(HR_Arena *arena, int window_size);
+
+/**
+ * @brief Channels of the peak detection scored by HR_Fusion.
+ */
+#define HR_FUSION_CHANNELS 2
+#define HR_FUSION_GREEN 0
+#define HR_FUSION_IR 1
+
+/**
+ * @brief Lowest score of both channels from which their heart rates are blended.
+ */
+#define HR_FUSION_BLEND 0.5
+
+/**
+ * @brief Largest difference in bpm of the heart rates of both channels that are blended.
+ */
+#define HR_FUSION_AGREE 5.0
+
+/**
+ * @brief Structure representing the second peak detection channel of a HR_HeartMonitor.
+ *
+ * The raw infrared samples go through the same chain as the green ones (BPF, NLMS motion
+ * canceller, SSF and MA, in fixed point with HR_FIXED_POINT) into their own window and beat
+ * detector. Every window both channels are scored by the regularity of their beat intervals
+ * and the correlation of their beats with the average beat, as in HR_heartMonitor_quality,
+ * and the peaks of the better one are used by the monitor. When both are good and agree, the
+ * heart rate blends them.
+ */
+typedef struct {
+#ifdef HR_FIXED_POINT
+	HRQ_BPF_filter *bpf; /**< Pointer to the fixed-point Band-Pass Filter (BPF) of the infrared channel */
+	HRQ_SSF *ssf; /**< Pointer to the fixed-point Slope Sum Function (SSF) of the infrared channel */
+	HRQ_MA_filter *ma; /**< Pointer to the fixed-point Moving Average (MA) filter of the infrared channel */
+#else
+	BPF_filter *bpf; /**< Pointer to the Band-Pass Filter (BPF) of the infrared channel */
+	SSF *ssf; /**< Pointer to the Slope Sum Function (SSF) of the infrared channel */
+	MA_filter *ma; /**< Pointer to the Moving Average (MA) filter of the infrared channel */
+#endif
+	NLMS_filter *nlms; /**< Pointer to the NLMS motion canceller of the infrared channel */
+	HR_Ring *pulse; /**< Pointer to the window of the preprocessed infrared channel */
+	ATD_detector *detector; /**< Pointer to the beat detector of the infrared channel */
+	int *indexed[HR_FUSION_CHANNELS]; /**< Pointers to the indexed peaks of every channel in the last window */
+	int indexed_size[HR_FUSION_CHANNELS]; /**< Number of indexed peaks of every channel */
+	float rate[HR_FUSION_CHANNELS]; /**< Heart rate of every channel in the last window in bpm or NaN */
+	float score[HR_FUSION_CHANNELS]; /**< Score of every channel in the last window, 0 (unusable) to 1 */
+	int channel; /**< Channel whose peaks the monitor uses, HR_FUSION_GREEN or HR_FUSION_IR */
+	int blend; /**< Non-zero if the heart rate blends both channels */
+} HR_Fusion;
+
+/**
+ * @brief Arena bytes used by a HR_Fusion with the given window and preprocessing.
+ */
+#ifdef HR_FIXED_POINT
+#define HR_FUSION_FOOTPRINT(size, bpf_order, ssf_size) \
+	(HR_ARENA_ALIGN(sizeof(HR_Fusion)) + HRQ_BPF_FOOTPRINT(bpf_order) \
+			+ HRQ_SSF_FOOTPRINT(ssf_size) + HRQ_MA_FOOTPRINT(HR_GREEN_MA_SIZE) \
+			+ NLMS_FOOTPRINT(HR_NLMS_TAPS) + HR_RING_FOOTPRINT(size) \
+			+ ATD_FOOTPRINT(size) \
+			+ HR_FUSION_CHANNELS \
+					* HR_ARENA_ALIGN(HR_PEAKS_CAPACITY(size) * sizeof(int)))
+#else
+#define HR_FUSION_FOOTPRINT(size, bpf_order, ssf_size) \
+	(HR_ARENA_ALIGN(sizeof(HR_Fusion)) + BPF_FOOTPRINT(bpf_order) \
+			+ SSF_FOOTPRINT(ssf_size) + MA_FOOTPRINT(HR_GREEN_MA_SIZE) \
+			+ NLMS_FOOTPRINT(HR_NLMS_TAPS) + HR_RING_FOOTPRINT(size) \
+			+ ATD_FOOTPRINT(size) \
+			+ HR_FUSION_CHANNELS \
+					* HR_ARENA_ALIGN(HR_PEAKS_CAPACITY(size) * sizeof(int)))
+#endif
+
+HR_Fusion* HR_fusion_new(float freq, int size, float threshold, int bpf_order,
+		float bpf_low, float bpf_high, int ssf_size, float rate_high);
+HR_Fusion* HR_fusion_arenaNew(HR_Arena *arena, float freq, int size,
+		float threshold, int bpf_order, float bpf_low, float bpf_high,
+		int ssf_size, float rate_high);
+void HR_fusion_free(HR_Fusion *fusion);
+void HR_fusion_process(HR_Fusion *fusion, float *array, float **motion,
+		int array_size);
 
 /**
  * @brief Structure representing a Heart Monitor for heart rate estimation.
@@ -96,31 +1053,158 @@ void HR_greenPreprocess_process(HR_GreenPreprocess *greenPrepocess,
 typedef struct {
     int size;                          /**< Size of the data arrays */
     float freq;                        /**< Frequency of the heart monitor */
-    float *green;                      /**< Pointer to the green channel data array */
-    float *red;                        /**< Pointer to the red channel data array */
-    float *ir;                         /**< Pointer to the infrared channel data array */
+    HR_Ring *green;                    /**< Pointer to the green channel ring buffer */
+#ifdef HR_FIXED_POINT
+    HRQ_Ring *red;                     /**< Pointer to the fixed-point red channel ring buffer */
+    HRQ_Ring *ir;                      /**< Pointer to the fixed-point infrared channel ring buffer */
+#else
+    HR_Ring *red;                      /**< Pointer to the red channel ring buffer */
+    HR_Ring *ir;                       /**< Pointer to the infrared channel ring buffer */
+#endif
+    HR_RedIrMA *ma_redIr;              /**< Pointer to the Moving Average filters of the red and infrared channels */
     int *peaks;                        /**< Pointer to the peaks array */
-    float threshold;                   /**< Threshold value for peak detection */
+    int *indexed;                      /**< Scratch array for indexed peaks */
+    int indexed_size;                  /**< Number of indexed peaks, kept by HR_heartMonitor_indexPeaks */
+    float *beat;                       /**< Scratch array for the average beat of HR_heartMonitor_quality */
+    float motion;                      /**< Mean square of the band-passed acceleration of the last block in g^2 */
+    float threshold;                   /**< Threshold of the beat detector after a beat, as a fraction of the beat */
+    ATD_detector *detector;            /**< Pointer to the adaptive threshold beat detector for green channel */
+    HR_Engine engine;                  /**< Heart rate estimator */
+    HR_Spectrum *spectrum;             /**< Pointer to the spectral estimator, only with HR_ENGINE_SPECTRUM */
+    HR_Autocorrelation *autocorrelation; /**< Pointer to the autocorrelation estimator, only with HR_ENGINE_AUTOCORRELATION */
+    HR_Tracker *tracker;               /**< Pointer to the heart rate tracker of HR_heartMonitor_track */
+    unsigned int tracked;              /**< Samples of the green beat detector at the last HR_heartMonitor_track */
+    HR_Variability *variability;       /**< Pointer to the beat-to-beat interval stage fed by the beat detector */
+    HR_Respiration *respiration;       /**< Pointer to the respiration rate estimator fed by the beat-to-beat interval stage */
+    HR_Decimator *decimator;           /**< Pointer to the decimator of the AFE samples, whose high-rate green times the beats, or NULL, set by the caller */
+    HR_Fusion *fusion;                 /**< Pointer to the infrared peak detection scored against the green one, or NULL, set by the caller */
+#ifdef HR_FIXED_POINT
+    HRQ_GreenPreprocess *greenPreprocess; /**< Pointer to the fixed-point green channel preprocessing stage */
+#else
     HR_GreenPreprocess *greenPreprocess; /**< Pointer to the green channel preprocessing stage */
+#endif
 } HR_HeartMonitor;
 
+/**
+ * @brief Structure representing the measurements of one window of a HR_HeartMonitor.
+ */
+typedef struct {
+	float rate; /**< Heart rate in beats per minute or NaN */
+	float ratio; /**< Red/infrared ratio (AC_red / DC_red) / (AC_ir / DC_ir) or NaN */
+	float perfusion; /**< Perfusion index of the infrared channel in percent or NaN */
+	float confidence; /**< Height of the autocorrelation peak (0 to 1) with HR_ENGINE_AUTOCORRELATION, NaN otherwise */
+	int valid; /**< 1 if all the measurements above are numbers, 0 otherwise */
+} HR_Result;
+
+/**
+ * @brief Structure representing the signal quality of one window of a HR_HeartMonitor.
+ *
+ * Every measure is mapped to a score from 0 to 1 and the index is the lowest score,
+ * so a single bad measure makes the window unusable.
+ */
+typedef struct {
+	float interval_cv; /**< Coefficient of variation of the beat intervals or NaN */
+	float correlation; /**< Mean correlation of the beats with their average beat, -1 to 1 */
+	float perfusion; /**< Perfusion index of the infrared channel in percent or NaN */
+	float motion; /**< Mean square of the band-passed acceleration of the last block in g^2 */
+	float index; /**< Signal quality index, 0 (unusable) to 1 */
+} HR_Quality;
+
+/**
+ * @brief Coefficient of variation of the beat intervals at which the interval score reaches 0.
+ */
+#define HR_SQI_INTERVAL_CV 0.2
+
+/**
+ * @brief Perfusion index in percent from which the perfusion score is 1.
+ */
+#define HR_SQI_PERFUSION 0.5
+
+/**
+ * @brief Mean square of the band-passed acceleration in g^2 at which the motion score reaches 0.
+ */
+#define HR_SQI_MOTION 0.02
+
+/**
+ * @brief Lowest signal quality index of a window whose reading can be accepted at once.
+ */
+#define HR_SQI_ACCEPT 0.6
+
+/**
+ * @brief Maximum number of peaks in a window of the given size.
+ *
+ * Every peak belongs to its own run of samples above the threshold and runs are
+ * separated by at least one sample, plus the last sample may be flagged.
+ */
+#define HR_PEAKS_CAPACITY(size) ((size) / 2 + 2)
+
+/**
+ * @brief Arena bytes used by the preprocessing stage and the red/infrared rings of a HR_HeartMonitor.
+ */
+#ifdef HR_FIXED_POINT
+#define HR_CHANNELS_FOOTPRINT(size, bpf_order, ssf_size) \
+	(HRQ_GREENPREPROCESS_FOOTPRINT(bpf_order, ssf_size) \
+			+ 2 * HRQ_RING_FOOTPRINT(size))
+#else
+#define HR_CHANNELS_FOOTPRINT(size, bpf_order, ssf_size) \
+	(HR_GREENPREPROCESS_FOOTPRINT(bpf_order, ssf_size) \
+			+ 2 * HR_RING_FOOTPRINT(size))
+#endif
+
+/**
+ * @brief Arena bytes used by a HR_HeartMonitor, all its stages and scratch arrays.
+ *
+ * Suitable for sizing a static array passed to HR_heartMonitor_arenaNew.
+ */
+#define HR_HEARTMONITOR_FOOTPRINT(size, bpf_order, ssf_size, ma_redIr_size, \
+		engine) \
+	(HR_ARENA_ALIGN(sizeof(HR_HeartMonitor)) \
+			+ HR_CHANNELS_FOOTPRINT(size, bpf_order, ssf_size) \
+			+ HR_REDIRMA_FOOTPRINT(ma_redIr_size) \
+			+ HR_RING_FOOTPRINT(size) + ATD_FOOTPRINT(size) \
+			+ HR_ARENA_ALIGN((size) * sizeof(int)) \
+			+ HR_ARENA_ALIGN(HR_PEAKS_CAPACITY(size) * sizeof(int)) \
+			+ HR_ARENA_ALIGN((size) * sizeof(float)) \
+			+ HR_TRACKER_FOOTPRINT(HR_PEAKS_CAPACITY(size)) \
+			+ HR_VARIABILITY_FOOTPRINT(HR_HRV_SIZE) \
+			+ HR_RESPIRATION_FOOTPRINT(HR_RESP_BREATHS) \
+			+ ((engine) == HR_ENGINE_SPECTRUM ? \
+					HR_SPECTRUM_FOOTPRINT(size, HR_SPECTRUM_BINS) : 0) \
+			+ ((engine) == HR_ENGINE_AUTOCORRELATION ? \
+					HR_AUTOCORRELATION_FOOTPRINT(size) : 0))
+
 HR_HeartMonitor* HR_heartMonitor_new(float freq, int size, float threshold,
 		int bpf_order, float bpf_low, float bpf_high, int ssf_size,
-		int ma_green_size, int ma_redIr_size);
+		int ma_green_size, int ma_redIr_size, float rate_low, float rate_high,
+		HR_Engine engine);
+HR_HeartMonitor* HR_heartMonitor_arenaNew(HR_Arena *arena, float freq,
+		int size, float threshold, int bpf_order, float bpf_low,
+		float bpf_high, int ssf_size, int ma_green_size, int ma_redIr_size,
+		float rate_low, float rate_high, HR_Engine engine);
 void HR_heartMonitor_free(HR_HeartMonitor *heartMonitor);
 
 void HR_heartMonitor_addGreen(HR_HeartMonitor *heartMonitor, float *array,
 		int array_size);
 void HR_heartMonitor_addRedIr(HR_HeartMonitor *heartMonitor, float *array_red,
 		float *array_ir, int array_size);
+float HR_heartMonitor_addInterleaved(HR_HeartMonitor *heartMonitor,
+		float *fifo, int16_t (*acceleration)[HR_MOTION_AXES], int samples);
 
 void HR_heartMonitor_peaksFromGreen(HR_HeartMonitor *heartMonitor);
+void HR_heartMonitor_peaksFromChannels(HR_HeartMonitor *heartMonitor);
 float HR_heartMonitor_heartRateFromPeaks(HR_HeartMonitor *heartMonitor);
 float HR_heartMonitor_ratioFromPeaks(HR_HeartMonitor *heartMonitor);
 float HR_heartMonitor_ratioFromIndexedPeaks(HR_HeartMonitor *heartMonitor,
 		int *peaks, int peaks_size);
 float HR_heartMonitor_heartRateFromIndexedPeaks(HR_HeartMonitor *heartMonitor,
 		int *peaks, int peaks_size);
+int HR_heartMonitor_indexPeaks(HR_HeartMonitor *heartMonitor);
+float HR_heartMonitor_heartRate(HR_HeartMonitor *heartMonitor);
+void HR_heartMonitor_heartRateAndRatio(HR_HeartMonitor *heartMonitor,
+		HR_Result *result);
+void HR_heartMonitor_quality(HR_HeartMonitor *heartMonitor,
+		HR_Result *result, HR_Quality *quality);
+float HR_heartMonitor_track(HR_HeartMonitor *heartMonitor, HR_Result *result);
 
 void peaks_detect(float *array, int *signals, int array_size,
 		float initial_threshold);
@@ -0,0 +1,198 @@
+/**
+ * @file heartmonitor_fixed.h
+ * @brief Header file for fixed-point Heart Monitoring functions
+ *
+ * Fixed-point counterparts of the green channel preprocessing (BPF, SSF, MA)
+ * and of the red/infrared AC/DC ratio. Samples are Q8.23 in 32-bit words, the
+ * BPF multiply-adds go to 64-bit accumulators and every conversion from float
+ * saturates. The STM32F103 has no FPU, so this path avoids the soft-float
+ * calls of the float implementation.
+ */
+
+// HR_Arena comes from heartmonitor.h, which includes this file in turn,
+// so it is included before the guard
+#include "heartmonitor.h"
+
+#ifndef INC_HEARTMONITOR_FIXED_H_
+#define INC_HEARTMONITOR_FIXED_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Number of fractional bits of the samples.
+ *
+ * Samples cover [-256, 256) with a resolution of 2^-23, which keeps the full
+ * precision of the AFE values (|x| < 2) and leaves headroom for the gain of
+ * the BPF sections. 16-bit samples are not enough: the pulsatile part of the
+ * PPG is below 1% of its DC level.
+ */
+#define HRQ_FRAC 23
+
+/**
+ * @brief Number of fractional bits of the BPF coefficients (range ±8).
+ */
+#define HRQ_COEF_FRAC 28
+
+/**
+ * @brief Largest value of the SSF output.
+ *
+ * Keeps the sum of a moving average of up to 8 samples within 32 bits.
+ */
+#define HRQ_SSF_MAX (INT32_MAX / 8)
+
+/**
+ * @brief Maximum number of samples converted at once by the heart monitor.
+ */
+#define HRQ_BLOCK_SIZE 32
+
+int32_t HRQ_fromFloat(float value);
+float HRQ_toFloat(int32_t value);
+void HRQ_fromFloatArray(float *array, int32_t *result, int array_size);
+void HRQ_toFloatArray(int32_t *array, float *result, int array_size);
+
+/**
+ * @brief Structure representing a fixed-point Band-Pass Filter (BPF) filter.
+ *
+ * Same Butterworth band-pass as BPF_filter, kept as a cascade of 4th order
+ * sections (direct form), coefficients in Q3.28, states in Q8.23.
+ */
+typedef struct {
+	int n; /**< Number of sections */
+	const int32_t *A, *d1, *d2, *d3, *d4; /**< Pointers to coefficients */
+	int32_t *w1, *w2, *w3, *w4; /**< Pointers to states */
+} HRQ_BPF_filter;
+
+/**
+ * @brief Arena bytes used by a HRQ_BPF_filter of the given order.
+ *
+ * The four state arrays, plus the five coefficient arrays of a filter designed
+ * at run time; a generated table keeps its coefficients in flash.
+ */
+#ifdef HR_BPF_RUNTIME_DESIGN
+#define HRQ_BPF_FOOTPRINT(order) \
+	(HR_ARENA_ALIGN(sizeof(HRQ_BPF_filter)) \
+			+ 9 * HR_ARENA_ALIGN((order) / 2 * sizeof(int32_t)))
+#else
+#define HRQ_BPF_FOOTPRINT(order) \
+	(HR_ARENA_ALIGN(sizeof(HRQ_BPF_filter)) \
+			+ 4 * HR_ARENA_ALIGN((order) / 2 * sizeof(int32_t)))
+#endif
+
+HRQ_BPF_filter* HRQ_BPF_new(int order, float freq, float low, float high);
+HRQ_BPF_filter* HRQ_BPF_arenaNew(HR_Arena *arena, int order, float freq,
+		float low, float high);
+HRQ_BPF_filter* HRQ_BPF_tableArenaNew(HR_Arena *arena, const BPF_table *table);
+void HRQ_BPF_free(HRQ_BPF_filter *bpf_filter);
+void HRQ_BPF_process(HRQ_BPF_filter *filter, int32_t *array, int array_size);
+
+/**
+ * @brief Structure representing a fixed-point Moving Average (MA) filter.
+ *
+ * Circular buffer with a running sum as in MA_filter. Integer sums are exact,
+ * so the running sum never drifts.
+ */
+typedef struct {
+	int window_size; /**< Size of the moving average window */
+	int32_t *data; /**< Pointer to the circular buffer of the window */
+	int head; /**< Index of the oldest sample, next one is written here */
+	int32_t sum; /**< Running sum of the window */
+} HRQ_MA_filter;
+
+/**
+ * @brief Arena bytes used by a HRQ_MA_filter with the given window.
+ */
+#define HRQ_MA_FOOTPRINT(window_size) \
+	(HR_ARENA_ALIGN(sizeof(HRQ_MA_filter)) \
+			+ HR_ARENA_ALIGN((window_size) * sizeof(int32_t)))
+
+HRQ_MA_filter* HRQ_MA_new(int window_size);
+HRQ_MA_filter* HRQ_MA_arenaNew(HR_Arena *arena, int window_size);
+void HRQ_MA_free(HRQ_MA_filter *filter);
+void HRQ_MA_process(HRQ_MA_filter *filter, int32_t *array, int array_size);
+
+/**
+ * @brief Structure representing a fixed-point Slope Sum Function (SSF).
+ *
+ * Circular buffer of positive differences with a running sum as in SSF.
+ */
+typedef struct {
+	int window_size; /**< Window size */
+	uint32_t *data; /**< Pointer to the circular buffer of positive differences */
+	int head; /**< Index of the oldest difference, next one is written here */
+	int32_t previous; /**< Previous sample */
+	int64_t sum; /**< Running sum of the positive differences */
+} HRQ_SSF;
+
+/**
+ * @brief Arena bytes used by a HRQ_SSF with the given window.
+ */
+#define HRQ_SSF_FOOTPRINT(window_size) \
+	(HR_ARENA_ALIGN(sizeof(HRQ_SSF)) \
+			+ HR_ARENA_ALIGN((window_size) * sizeof(uint32_t)))
+
+HRQ_SSF* HRQ_SSF_new(int window_size);
+HRQ_SSF* HRQ_SSF_arenaNew(HR_Arena *arena, int window_size);
+void HRQ_SSF_free(HRQ_SSF *ssf);
+void HRQ_SSF_process(HRQ_SSF *ssf, int32_t *array, int array_size);
+
+/**
+ * @brief Structure representing the fixed-point preprocessing stage of green channel data.
+ */
+typedef struct {
+	HRQ_BPF_filter *bpf_green; /**< Pointer to a Band-Pass Filter (BPF) for green channel data */
+	BPF_filter *bpf_motion[HR_MOTION_AXES]; /**< Pointers to the float BPF for every accelerometer axis */
+	NLMS_filter *nlms_green; /**< Pointer to a NLMS motion canceller for green channel data */
+	HRQ_SSF *ssf_green; /**< Pointer to a Slope Sum Function (SSF) for green channel data */
+	HRQ_MA_filter *ma_green; /**< Pointer to a Moving Average (MA) filter for green channel data */
+} HRQ_GreenPreprocess;
+
+/**
+ * @brief Arena bytes used by a HRQ_GreenPreprocess.
+ */
+#define HRQ_GREENPREPROCESS_FOOTPRINT(bpf_order, ssf_size) \
+	(HR_ARENA_ALIGN(sizeof(HRQ_GreenPreprocess)) \
+			+ HRQ_BPF_FOOTPRINT(bpf_order) \
+			+ HR_MOTION_AXES * BPF_FOOTPRINT(bpf_order) \
+			+ NLMS_FOOTPRINT(HR_NLMS_TAPS) + HRQ_SSF_FOOTPRINT(ssf_size) \
+			+ HRQ_MA_FOOTPRINT(HR_GREEN_MA_SIZE))
+
+HRQ_GreenPreprocess* HRQ_greenPreprocess_new(float freq, int bpf_order,
+		float bpf_low, float bpf_high, int ssf_size);
+HRQ_GreenPreprocess* HRQ_greenPreprocess_arenaNew(HR_Arena *arena, float freq,
+		int bpf_order, float bpf_low, float bpf_high, int ssf_size);
+void HRQ_greenPreprocess_free(HRQ_GreenPreprocess *greenPreprocess);
+void HRQ_greenPreprocess_process(HRQ_GreenPreprocess *greenPreprocess,
+		int32_t *array, int array_size);
+void HRQ_greenPreprocess_processMotion(HRQ_GreenPreprocess *greenPreprocess,
+		int32_t *array, float **motion, int array_size);
+
+/**
+ * @brief Structure representing a circular buffer of fixed-point samples.
+ *
+ * Same mirrored layout as HR_Ring: the last @c size samples are always
+ * available as one contiguous array starting at @c data[head].
+ */
+typedef struct {
+	int size; /**< Number of samples in the window */
+	int head; /**< Index of the oldest sample, next one is written here */
+	int32_t *data; /**< Pointer to the mirrored storage of 2 * size elements */
+} HRQ_Ring;
+
+/**
+ * @brief Arena bytes used by a HRQ_Ring of the given size.
+ */
+#define HRQ_RING_FOOTPRINT(size) \
+	(HR_ARENA_ALIGN(sizeof(HRQ_Ring)) \
+			+ HR_ARENA_ALIGN(2 * (size) * sizeof(int32_t)))
+
+HRQ_Ring* HRQ_ring_new(int size);
+HRQ_Ring* HRQ_ring_arenaNew(HR_Arena *arena, int size);
+void HRQ_ring_free(HRQ_Ring *ring);
+void HRQ_ring_push(HRQ_Ring *ring, int32_t value);
+void HRQ_ring_pushFloatArray(HRQ_Ring *ring, float *array, int array_size);
+int32_t* HRQ_ring_window(HRQ_Ring *ring);
+
+float HRQ_ratioFromIndexedPeaks(int32_t *red, int32_t *ir, int *peaks,
+		int peaks_size, float *perfusion);
+
+#endif /* INC_HEARTMONITOR_FIXED_H_ */
@@ -0,0 +1,227 @@
+/**
+ * @file heartmonitor_pipeline.hpp
+ * @brief Header-only C++17 pipeline of the green channel preprocessing
+ *
+ * The chain of HR_greenPreprocess_process written as a type, e.g.
+ *
+ * @code
+ * static hr::Pipeline<hr::Bandpass<4>, hr::SlopeSum<2>, hr::MovingAvg<7>> green(
+ * 		hr::Bandpass<4>(BPF_findTable(4, 25, 0.8, 8.5)), hr::SlopeSum<2>(),
+ * 		hr::MovingAvg<7>());
+ * green.process(AFE_GREEN, LED_DEPTH);
+ * @endcode
+ *
+ * Every stage keeps its state in fixed-size members, so a pipeline lives in
+ * static storage and never touches the heap. Stages have no virtual functions:
+ * the per-sample step of the whole chain is inlined and unrolled for the
+ * window sizes and filter order given as template arguments. The results are
+ * the same as those of BPF_process, SSF_process and MA_process.
+ */
+
+#ifndef INC_HEARTMONITOR_PIPELINE_HPP_
+#define INC_HEARTMONITOR_PIPELINE_HPP_
+
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+extern "C" {
+#include "heartmonitor.h"
+}
+
+namespace hr {
+
+/**
+ * @brief Butterworth band-pass of the given order, as BPF_filter.
+ *
+ * Cascade of Order second-order sections in transposed Direct Form II. The
+ * coefficients are copied from a table generated by tools/bpf_tables.py.
+ */
+template<int Order>
+class Bandpass {
+	static_assert(Order >= 2 && Order % 2 == 0, "order must be even");
+
+public:
+	Bandpass() :
+			sections_(), valid_(false) {
+	}
+
+	/**
+	 * @brief Creates the band-pass from a generated table.
+	 *
+	 * @param table Pointer to the table, e.g. from BPF_findTable. A missing
+	 * table or one of another order leaves all coefficients zero, see valid().
+	 */
+	explicit Bandpass(const BPF_table *table) :
+			sections_(), valid_(false) {
+		if (table == nullptr || table->order != Order) {
+			return;
+		}
+		valid_ = true;
+		for (int i = 0; i < Order; i++) {
+			sections_[i].b0 = table->sections[i].b0;
+			sections_[i].b1 = table->sections[i].b1;
+			sections_[i].b2 = table->sections[i].b2;
+			sections_[i].a1 = table->sections[i].a1;
+			sections_[i].a2 = table->sections[i].a2;
+		}
+	}
+
+	/**
+	 * @brief Returns true if the band-pass was created from a matching table.
+	 */
+	bool valid() const {
+		return valid_;
+	}
+
+	float process(float x) {
+		for (int i = 0; i < Order; i++) {
+			BPF_biquad &section = sections_[i];
+			float y = section.b0 * x + section.s1;
+			section.s1 = section.b1 * x - section.a1 * y + section.s2;
+			section.s2 = section.b2 * x - section.a2 * y;
+			x = y;
+		}
+		return x;
+	}
+
+private:
+	BPF_biquad sections_[Order];
+	bool valid_;
+};
+
+/**
+ * @brief Slope Sum Function over a window of the given size, as SSF.
+ *
+ * Sum of the positive differences of the last Window samples.
+ */
+template<int Window>
+class SlopeSum {
+	static_assert(Window >= 1, "window must not be empty");
+	static constexpr int pairs = Window - 1;
+
+public:
+	SlopeSum() :
+			data_(), head_(0), previous_(0.0f), sum_(0.0f) {
+	}
+
+	float process(float x) {
+		if constexpr (pairs < 1) {
+			return 0.0f;
+		} else {
+			float delta = x - previous_;
+			if (delta < 0) {
+				delta = 0.0f;
+			}
+			previous_ = x;
+			sum_ += delta - data_[head_];
+			data_[head_] = delta;
+			head_++;
+			if (head_ == pairs) {
+				// recompute once per window to drop the rounding of the running sum
+				head_ = 0;
+				sum_ = 0.0f;
+				for (int j = 0; j < pairs; j++) {
+					sum_ += data_[j];
+				}
+			}
+			return sum_;
+		}
+	}
+
+private:
+	float data_[pairs < 1 ? 1 : pairs];
+	int head_;
+	float previous_;
+	float sum_;
+};
+
+/**
+ * @brief Moving average over a window of the given size, as MA_filter.
+ */
+template<int Window>
+class MovingAvg {
+	static_assert(Window >= 1, "window must not be empty");
+
+public:
+	MovingAvg() :
+			data_(), head_(0), sum_(0.0f) {
+	}
+
+	float process(float x) {
+		sum_ += x - data_[head_];
+		data_[head_] = x;
+		head_++;
+		if (head_ == Window) {
+			// recompute once per window to drop the rounding of the running sum
+			head_ = 0;
+			sum_ = 0.0f;
+			for (int j = 0; j < Window; j++) {
+				sum_ += data_[j];
+			}
+		}
+		return sum_ / Window;
+	}
+
+private:
+	float data_[Window];
+	int head_;
+	float sum_;
+};
+
+/**
+ * @brief Chain of stages applied to every sample in order.
+ *
+ * A stage is any class with a float process(float) member.
+ */
+template<typename ... Stages>
+class Pipeline {
+	static_assert(sizeof...(Stages) > 0, "pipeline must have a stage");
+
+public:
+	Pipeline() = default;
+
+	explicit Pipeline(Stages ... stages) :
+			stages_(std::move(stages)...) {
+	}
+
+	/**
+	 * @brief Returns the stage with the given index.
+	 */
+	template<std::size_t Index>
+	auto& stage() {
+		return std::get<Index>(stages_);
+	}
+
+	/**
+	 * @brief Runs one sample through all the stages.
+	 */
+	float process(float x) {
+		return process(x, std::index_sequence_for<Stages...>());
+	}
+
+	/**
+	 * @brief Runs an array through all the stages in place.
+	 *
+	 * @param array Pointer to the samples.
+	 * @param array_size Number of samples.
+	 */
+	void process(float *array, int array_size) {
+		for (int i = 0; i < array_size; i++) {
+			array[i] = process(array[i]);
+		}
+	}
+
+private:
+	template<std::size_t ... Index>
+	float process(float x, std::index_sequence<Index...>) {
+		((x = std::get<Index>(stages_).process(x)), ...);
+		return x;
+	}
+
+	std::tuple<Stages...> stages_;
+};
+
+} // namespace hr
+
+#endif /* INC_HEARTMONITOR_PIPELINE_HPP_ */
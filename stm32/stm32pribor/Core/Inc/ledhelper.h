@@ -12,7 +12,7 @@
 
 
 void LED_init();
-void LED_update(uint8_t t, uint8_t h, uint8_t o);
+void LED_update(uint8_t t, uint8_t h, uint8_t o, uint8_t v, uint8_t r);
 void LED_pribor();
 
 void inc_led_status();
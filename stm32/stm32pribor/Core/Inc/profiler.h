@@ -0,0 +1,158 @@
+/**
+ * @file profiler.h
+ * @brief Cycle counts of the main loop stages with the DWT cycle counter
+ *
+ * Every stage of the main loop is wrapped in PROF_SCOPE, or in PROF_BEGIN and
+ * PROF_END for the whole iteration, which read DWT CYCCNT before and after the
+ * stage and add the difference to the accumulator of the stage: count, min,
+ * max, sum and a histogram with log2 bins. PROF_report sends the accumulators
+ * every PROF_PERIOD calls as a binary frame on ITM stimulus port
+ * PROF_ITM_PORT, next to the printf output of _write on port 0, and starts
+ * them again. tools/profiler.py decodes the frames of the SWO capture into a
+ * table per stage.
+ *
+ * Without PROF_ENABLE the markers compile to nothing and the block of
+ * PROF_SCOPE is a plain block.
+ */
+
+#ifndef INC_PROFILER_H_
+#define INC_PROFILER_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Profiler mode
+ *
+ * Count the cycles of the stages marked with PROF_SCOPE and report them
+ * over ITM. Needs a debugger with SWO enabled to see the reports.
+ */
+//#define PROF_ENABLE
+
+/**
+ * @brief Stages of the main loop, in the order of the report.
+ *
+ * tools/profiler.py names the stages in the same order.
+ */
+typedef enum {
+	PROF_LOOP = 0, /**< Whole iteration, from the AFE ready pin to the next wait */
+	PROF_AFE_READ, /**< AFE_FIFO_READ, with the decimator if any */
+	PROF_ACC_READ, /**< FIFO level and the ACC_DEPTH reads of the LIS2DTW12 */
+	PROF_PREPROCESS, /**< HR_heartMonitor_addInterleaved, the green preprocessing */
+	PROF_PEAKS, /**< HR_heartMonitor_peaksFromChannels */
+	PROF_RATIO, /**< HR_heartMonitor_heartRateAndRatio */
+	PROF_QUALITY, /**< HR_heartMonitor_quality */
+	PROF_TRACK, /**< HR_heartMonitor_track and HRV_update */
+	PROF_LED, /**< LED_update */
+	PROF_BEE, /**< BEE_b_fnin */
+	PROF_STAGES
+} PROF_Stage;
+
+/**
+ * @brief Number of histogram bins per stage.
+ */
+#define PROF_BINS 16
+
+/**
+ * @brief Log2 of the upper edge of the first histogram bin.
+ *
+ * Bin 0 counts below 2^PROF_BIN_FIRST cycles (16 us at 64 MHz), bin k counts
+ * from 2^(PROF_BIN_FIRST + k - 1) to 2^(PROF_BIN_FIRST + k) cycles and the
+ * last bin everything above.
+ */
+#define PROF_BIN_FIRST 10
+
+/**
+ * @brief Calls of PROF_report between two reports.
+ *
+ * The main loop runs once per second, so a report covers PROF_PERIOD seconds.
+ */
+#define PROF_PERIOD 10
+
+/**
+ * @brief ITM stimulus port of the reports, port 0 is printf.
+ */
+#define PROF_ITM_PORT 1
+
+/**
+ * @brief First word of a report, "PROF" in little endian.
+ */
+#define PROF_MAGIC 0x464F5250
+
+/**
+ * @brief Version of the report layout, see PROF_report.
+ */
+#define PROF_VERSION 1
+
+/**
+ * @brief Accumulator of one stage.
+ */
+typedef struct {
+	uint32_t count; /**< Number of runs */
+	uint32_t min; /**< Fewest cycles of a run */
+	uint32_t max; /**< Most cycles of a run */
+	uint64_t sum; /**< Cycles of all runs */
+	uint16_t bins[PROF_BINS]; /**< Runs per log2 bin of cycles */
+} PROF_Accumulator;
+
+#ifdef PROF_ENABLE
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * @brief Runs the next statement or block as a stage.
+ *
+ *     PROF_SCOPE(PROF_PEAKS) {
+ *         HR_heartMonitor_peaksFromChannels(HR_heartMonitor);
+ *     }
+ *
+ * The cycles are added when the block ends normally; a break, continue,
+ * return or goto out of it drops the run.
+ *
+ * @param stage PROF_Stage of the block.
+ */
+#define PROF_SCOPE(stage) \
+	for (uint32_t PROF_start = DWT->CYCCNT, PROF_once = 1; PROF_once; \
+			PROF_once = 0, PROF_add((stage), DWT->CYCCNT - PROF_start))
+
+/**
+ * @brief Starts a stage that is not one block, ended by PROF_END in the same block.
+ *
+ * @param stage PROF_Stage name, once per block.
+ */
+#define PROF_BEGIN(stage) uint32_t PROF_start_##stage = DWT->CYCCNT
+
+/**
+ * @brief Ends the stage started by PROF_BEGIN.
+ *
+ * @param stage PROF_Stage name given to PROF_BEGIN.
+ */
+#define PROF_END(stage) PROF_add((stage), DWT->CYCCNT - PROF_start_##stage)
+
+/**
+ * @brief Starts the cycle counter and clears the accumulators.
+ */
+#define PROF_INIT() PROF_init()
+
+/**
+ * @brief Counts a call and sends a report every PROF_PERIOD calls.
+ */
+#define PROF_REPORT() PROF_report()
+
+void PROF_init();
+void PROF_add(PROF_Stage stage, uint32_t cycles);
+void PROF_reset();
+void PROF_report();
+
+extern PROF_Accumulator PROF_accumulators[PROF_STAGES];
+
+#else
+
+#define PROF_SCOPE(stage)
+#define PROF_BEGIN(stage)
+#define PROF_END(stage)
+#define PROF_INIT()
+#define PROF_REPORT()
+
+#endif
+
+#endif /* INC_PROFILER_H_ */
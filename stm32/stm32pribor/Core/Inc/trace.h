@@ -0,0 +1,129 @@
+/**
+ * @file trace.h
+ * @brief Probes of the intermediate signals of the heart monitor
+ *
+ * A probe point copies a block of samples of one stage into a single producer,
+ * single consumer ring of 32-bit words. The main loop drains the ring to ITM
+ * stimulus port TRACE_ITM_PORT (see TRACE_drain in main.c) and tools/trace.py
+ * turns the SWO capture into one signal per probe.
+ *
+ * Probes write only while TRACE_active is set, which the drain does while the
+ * debugger has enabled the port, so a unit without a debugger only tests one
+ * word per probe. Probes left out of TRACE_PROBES, or all of them without
+ * TRACE_ENABLE, compile to nothing.
+ */
+
+#ifndef INC_TRACE_H_
+#define INC_TRACE_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Trace mode
+ *
+ * Compile the probe points of TRACE_PROBES and the ring they write to.
+ */
+#define TRACE_ENABLE
+
+/**
+ * @brief Probe points, in the order of their bit in TRACE_PROBES.
+ *
+ * tools/trace.py names the probes in the same order.
+ */
+typedef enum {
+	TRACE_GREEN_RAW = 0, /**< Green samples from the AFE */
+	TRACE_GREEN_BPF, /**< Green channel after the BPF */
+	TRACE_GREEN_NLMS, /**< Green channel after the motion canceller */
+	TRACE_GREEN_PULSE, /**< Green channel after the SSF and MA, into the beat detector */
+	TRACE_MOTION_X, /**< Band-passed accelerometer X axis in g */
+	TRACE_MOTION_Y, /**< Band-passed accelerometer Y axis in g */
+	TRACE_MOTION_Z, /**< Band-passed accelerometer Z axis in g */
+	TRACE_IR_RAW, /**< Infrared samples from the AFE */
+	TRACE_IR_PULSE, /**< Infrared channel of HR_Fusion, into its beat detector */
+	TRACE_PROBE_COUNT
+} TRACE_Probe;
+
+/**
+ * @brief Sample formats of a record.
+ */
+typedef enum {
+	TRACE_FLOAT = 0, /**< IEEE 754 single precision */
+	TRACE_Q23 = 1 /**< Q8.23, see HRQ_FRAC */
+} TRACE_Format;
+
+/**
+ * @brief Probes compiled in, one bit per TRACE_Probe.
+ *
+ * The green channel stages, as the former HR_DEBUG arrays, about 110 words
+ * per second at 25 Hz.
+ */
+#define TRACE_PROBES (1UL << TRACE_GREEN_RAW | 1UL << TRACE_GREEN_BPF \
+		| 1UL << TRACE_GREEN_NLMS | 1UL << TRACE_GREEN_PULSE)
+
+/**
+ * @brief Words of the ring, a power of 2.
+ *
+ * Holds more than the records of one main loop iteration, which the main loop
+ * drains at its end. Records that do not fit are dropped whole.
+ */
+#define TRACE_RING_WORDS 256
+
+/**
+ * @brief Most samples of a record, longer blocks are split.
+ *
+ * Two records of this size with their headers fit the ring, and the count
+ * fits the byte of the header.
+ */
+#define TRACE_RECORD_SAMPLES (TRACE_RING_WORDS / 2 - 2 < 255 ? \
+		TRACE_RING_WORDS / 2 - 2 : 255)
+
+/**
+ * @brief Low byte of the first word of a record.
+ */
+#define TRACE_SYNC 0xA5
+
+/**
+ * @brief ITM stimulus port of the records, port 0 is printf and 1 the profiler.
+ */
+#define TRACE_ITM_PORT 2
+
+#ifdef TRACE_ENABLE
+
+/**
+ * @brief Writes float samples of a probe point to the ring.
+ *
+ * @param probe   TRACE_Probe, a constant so that probes out of TRACE_PROBES
+ *                compile to nothing.
+ * @param samples Pointer to the samples.
+ * @param size    Number of samples.
+ */
+#define TRACE_PROBE(probe, samples, size) do { \
+		if ((TRACE_PROBES & 1UL << (probe)) && TRACE_active) { \
+			TRACE_write((probe), TRACE_FLOAT, (samples), (size)); \
+		} \
+	} while (0)
+
+/**
+ * @brief Writes Q8.23 samples of a probe point to the ring, as TRACE_PROBE.
+ */
+#define TRACE_PROBE_Q(probe, samples, size) do { \
+		if ((TRACE_PROBES & 1UL << (probe)) && TRACE_active) { \
+			TRACE_write((probe), TRACE_Q23, (samples), (size)); \
+		} \
+	} while (0)
+
+extern volatile uint32_t TRACE_active;
+
+void TRACE_write(TRACE_Probe probe, TRACE_Format format, const void *samples,
+		int size);
+int TRACE_read(uint32_t *words, int capacity);
+uint32_t TRACE_dropped();
+
+#else
+
+#define TRACE_PROBE(probe, samples, size) do { } while (0)
+#define TRACE_PROBE_Q(probe, samples, size) do { } while (0)
+
+#endif
+
+#endif /* INC_TRACE_H_ */
@@ -6,34 +6,68 @@
  */
 
 #include <heartmonitor.h>
+#include <trace.h>
 #include <math.h>
 #include <malloc.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-#ifdef HR_DEBUG
+int findMaxIndex(float *array, int start, int end);
+int findMinIndex(float *array, int start, int end);
 
-float d1[HR_SIZE];
-float d2[HR_SIZE];
-float d3[HR_SIZE];
-float d4[HR_SIZE];
-float d5[HR_SIZE];
-float d6[HR_SIZE];
-float d7[HR_SIZE];
-float d8[HR_SIZE];
+/**
+ * @brief Initializes an arena over caller-provided memory.
+ *
+ * @param arena  Pointer to the HR_Arena structure.
+ * @param memory Pointer to the memory, aligned to HR_ARENA_ALIGNMENT. May be NULL,
+ *               then every allocation fails.
+ * @param size   Size of the memory in bytes.
+ * @return None.
+ */
+void HR_arena_init(HR_Arena *arena, void *memory, size_t size) {
+	arena->base = (uint8_t*) memory;
+	arena->size = memory != NULL ? size : 0;
+	arena->used = 0;
+}
 
-#endif
+/**
+ * @brief Hands out a zeroed block of the arena.
+ *
+ * @param arena Pointer to the HR_Arena structure.
+ * @param size  Size of the block in bytes, rounded up to HR_ARENA_ALIGNMENT.
+ *
+ * @return Pointer to the block or NULL if the arena is exhausted.
+ */
+void* HR_arena_alloc(HR_Arena *arena, size_t size) {
+	size = HR_ARENA_ALIGN(size);
+	if (size > arena->size - arena->used) {
+		return NULL;
+	}
+	void *block = &arena->base[arena->used];
+	arena->used += size;
+	memset(block, 0, size);
+	return block;
+}
 
-int findMaxIndex(float *array, int start, int end);
-int findMinIndex(float *array, int start, int end);
+/**
+ * @brief Checks that an object of the given footprint fits into the arena.
+ *
+ * @param arena     Pointer to the HR_Arena structure.
+ * @param footprint Size of the object in bytes, as given by its *_FOOTPRINT macro.
+ *
+ * @return Non-zero if the object fits.
+ */
+int HR_arena_fits(HR_Arena *arena, size_t footprint) {
+	return footprint <= arena->size - arena->used;
+}
 
 /**
  * @brief Creates a new HR_GreenPreprocess structure.
  *
  * This function creates and initializes a new HR_GreenPreprocess structure for preprocessing the
- * green channel data in the heart rate estimation process. It allocates memory for the structure
- * and initializes the Band-Pass Filter (BPF) and Slope Sum Function (SSF) within it.
+ * green channel data in the heart rate estimation process. The structure, the Band-Pass Filter (BPF),
+ * Slope Sum Function (SSF) and Moving Average (MA) are placed in a single heap block.
  *
  * @param freq       Frequency of the heart monitor.
  * @param bpf_order  Order of the Band-Pass Filter (BPF).
@@ -41,34 +75,73 @@ int findMinIndex(float *array, int start, int end);
  * @param bpf_high   Upper cutoff frequency of the BPF.
  * @param ssf_size   Size of the Slope Sum Function (SSF).
  *
- * @return Pointer to the newly created HR_GreenPreprocess structure.
+ * @return Pointer to the newly created HR_GreenPreprocess structure or NULL.
  */
 HR_GreenPreprocess* HR_greenPreprocess_new(float freq, int bpf_order,
 		float bpf_low, float bpf_high, int ssf_size) {
-	SSF *ssf = SSF_new(ssf_size);
-	BPF_filter *bpf = BPF_new(bpf_order, freq, bpf_low, bpf_high);
-	MA_filter *ma = MA_new(7);
-	HR_GreenPreprocess *greenPreprocess = (HR_GreenPreprocess*) malloc(
-			sizeof(HR_GreenPreprocess));
-	greenPreprocess->bpf_green = bpf;
-	greenPreprocess->ssf_green = ssf;
-	greenPreprocess->ma_green = ma;
+	size_t footprint = HR_GREENPREPROCESS_FOOTPRINT(bpf_order, ssf_size);
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(footprint), footprint);
+	HR_GreenPreprocess *greenPreprocess = HR_greenPreprocess_arenaNew(&arena,
+			freq, bpf_order, bpf_low, bpf_high, ssf_size);
+	if (greenPreprocess == NULL) {
+		free(arena.base);
+	}
+	return greenPreprocess;
+}
+
+/**
+ * @brief Creates a new HR_GreenPreprocess structure in an arena.
+ *
+ * Same as HR_greenPreprocess_new, but all memory is taken from the arena.
+ *
+ * @param arena      Pointer to the arena with at least HR_GREENPREPROCESS_FOOTPRINT bytes left.
+ * @param freq       Frequency of the heart monitor.
+ * @param bpf_order  Order of the Band-Pass Filter (BPF).
+ * @param bpf_low    Lower cutoff frequency of the BPF.
+ * @param bpf_high   Upper cutoff frequency of the BPF.
+ * @param ssf_size   Size of the Slope Sum Function (SSF).
+ *
+ * @return Pointer to the newly created HR_GreenPreprocess structure or NULL if the arena is too small
+ * or there is no BPF_tables entry for the band-pass filter.
+ */
+HR_GreenPreprocess* HR_greenPreprocess_arenaNew(HR_Arena *arena, float freq,
+		int bpf_order, float bpf_low, float bpf_high, int ssf_size) {
+	if (!HR_arena_fits(arena,
+			HR_GREENPREPROCESS_FOOTPRINT(bpf_order, ssf_size))) {
+		return NULL;
+	}
+	HR_GreenPreprocess *greenPreprocess = (HR_GreenPreprocess*) HR_arena_alloc(
+			arena, sizeof(HR_GreenPreprocess));
+	greenPreprocess->bpf_green = BPF_arenaNew(arena, bpf_order, freq, bpf_low,
+			bpf_high);
+	if (greenPreprocess->bpf_green == NULL) {
+		return NULL;
+	}
+	for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+		greenPreprocess->bpf_motion[axis] = BPF_arenaNew(arena, bpf_order, freq,
+				bpf_low, bpf_high);
+		if (greenPreprocess->bpf_motion[axis] == NULL) {
+			return NULL;
+		}
+	}
+	greenPreprocess->nlms_green = NLMS_arenaNew(arena, HR_NLMS_TAPS,
+			HR_NLMS_MU, HR_NLMS_EPSILON);
+	greenPreprocess->ssf_green = SSF_arenaNew(arena, ssf_size);
+	greenPreprocess->ma_green = MA_arenaNew(arena, HR_GREEN_MA_SIZE);
 	return greenPreprocess;
 }
 
 /**
  * @brief Frees the memory associated with HR_GreenPreprocess structure.
  *
- * This function frees the memory allocated for the HR_GreenPreprocess structure and its associated
- * Band-Pass Filter (BPF) and Slope Sum Function (SSF).
+ * This function frees the heap block holding the HR_GreenPreprocess structure and its associated
+ * Band-Pass Filter (BPF), Slope Sum Function (SSF) and Moving Average (MA).
  *
- * @param greenPreprocess Pointer to the HR_GreenPreprocess structure to be freed.
+ * @param greenPreprocess Pointer to the HR_GreenPreprocess structure created by HR_greenPreprocess_new.
  * @return None.
  */
 void HR_greenPreprocess_free(HR_GreenPreprocess *greenPrepocess) {
-	BPF_free(greenPrepocess->bpf_green);
-	SSF_free(greenPrepocess->ssf_green);
-	MA_free(greenPrepocess->ma_green);
 	free(greenPrepocess);
 }
 
@@ -85,460 +158,3584 @@ void HR_greenPreprocess_free(HR_GreenPreprocess *greenPrepocess) {
  */
 void HR_greenPreprocess_process(HR_GreenPreprocess *greenPrepocess,
 		float *array, int array_size) {
+	HR_greenPreprocess_processMotion(greenPrepocess, array, NULL, array_size);
+}
+
+/**
+ * @brief Processes the green channel data with an accelerometer reference.
+ *
+ * Same as HR_greenPreprocess_process, with the NLMS motion canceller between the BPF and the
+ * SSF. The accelerometer axes go through the same BPF as the green channel, so the canceller
+ * only models the motion within the pass band of the heart rate.
+ *
+ * @param greenPreprocess Pointer to the HR_GreenPreprocess structure.
+ * @param array           Pointer to the green channel data array.
+ * @param motion          HR_MOTION_AXES pointers to the accelerometer samples in g, band-passed
+ *                        in place, or NULL to skip the motion canceller.
+ * @param array_size      Size of the green channel data array and of every motion array.
+ * @return None.
+ */
+void HR_greenPreprocess_processMotion(HR_GreenPreprocess *greenPrepocess,
+		float *array, float **motion, int array_size) {
 	BPF_process(greenPrepocess->bpf_green, array, array_size);
-#ifdef HR_DEBUG
-	memcpy(d1, array, HR_SIZE * sizeof(float));
-#endif
+	TRACE_PROBE(TRACE_GREEN_BPF, array, array_size);
+	if (motion != NULL) {
+		for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+			BPF_process(greenPrepocess->bpf_motion[axis], motion[axis],
+					array_size);
+		}
+		TRACE_PROBE(TRACE_MOTION_X, motion[0], array_size);
+		TRACE_PROBE(TRACE_MOTION_Y, motion[1], array_size);
+		TRACE_PROBE(TRACE_MOTION_Z, motion[2], array_size);
+		NLMS_process(greenPrepocess->nlms_green, array, motion, array_size);
+		TRACE_PROBE(TRACE_GREEN_NLMS, array, array_size);
+	}
 	SSF_process(greenPrepocess->ssf_green, array, array_size);
 	MA_process(greenPrepocess->ma_green, array, array_size);
-#ifdef HR_DEBUG
-	memcpy(d2, array, HR_SIZE * sizeof(float));
-#endif
+	TRACE_PROBE(TRACE_GREEN_PULSE, array, array_size);
 }
 
 /**
- * @brief Creates a new HR_HeartMonitor structure.
+ * @brief Creates a new HR_Ring circular buffer.
  *
- * This function creates and initializes a new HR_HeartMonitor structure for heart rate monitoring.
- * It allocates memory for the structure and its associated data arrays, initializes the parameters,
- * and creates an HR_GreenPreprocess structure for preprocessing the green channel data.
+ * This function allocates a ring buffer holding a window of 'size' samples.
+ * The storage is mirrored (2 * size elements) so the window can always be read
+ * as a contiguous array. The window is initially filled with zeros.
  *
- * @param freq           Frequency of the heart monitor.
- * @param size           Size of the data arrays.
- * @param threshold      Threshold value for peak detection.
- * @param bpf_order      Order of the Band-Pass Filter (BPF).
- * @param bpf_low        Lower cutoff frequency of the BPF.
- * @param bpf_high       Upper cutoff frequency of the BPF.
- * @param ssf_size       Size of the Slope Sum Function (SSF).
- * @param ma_green_size  Size of the Moving Average filter for the green channel.
- * @param ma_redIr_size  Size of the Moving Average filter for the red and infrared channels.
+ * @param size Number of samples in the window.
  *
- * @return Pointer to the newly created HR_HeartMonitor structure.
+ * @return Pointer to the newly created HR_Ring structure.
  */
-HR_HeartMonitor* HR_heartMonitor_new(float freq, int size, float threshold,
-		int bpf_order, float bpf_low, float bpf_high, int ssf_size,
-		int ma_green_size, int ma_redIr_size) {
+HR_Ring* HR_ring_new(int size) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(HR_RING_FOOTPRINT(size)),
+			HR_RING_FOOTPRINT(size));
+	return HR_ring_arenaNew(&arena, size);
+}
 
-	HR_GreenPreprocess *greenPreprocess = HR_greenPreprocess_new(freq,
-			bpf_order, bpf_low, bpf_high, ssf_size);
+/**
+ * @brief Creates a new HR_Ring circular buffer in an arena.
+ *
+ * @param arena Pointer to the arena with at least HR_RING_FOOTPRINT bytes left.
+ * @param size  Number of samples in the window.
+ *
+ * @return Pointer to the newly created HR_Ring structure or NULL if the arena is too small.
+ */
+HR_Ring* HR_ring_arenaNew(HR_Arena *arena, int size) {
+	if (!HR_arena_fits(arena, HR_RING_FOOTPRINT(size))) {
+		return NULL;
+	}
+	HR_Ring *ring = (HR_Ring*) HR_arena_alloc(arena, sizeof(HR_Ring));
+	ring->size = size;
+	ring->head = 0;
+	ring->data = (float*) HR_arena_alloc(arena, 2 * size * sizeof(float));
+	return ring;
+}
 
-	HR_HeartMonitor *heartMonitor = (HR_HeartMonitor*) malloc(
-			sizeof(HR_HeartMonitor));
-	heartMonitor->size = size;
-	heartMonitor->freq = freq;
-	heartMonitor->green = (float*) calloc(size, sizeof(float));
-	heartMonitor->red = (float*) calloc(size, sizeof(float));
-	heartMonitor->ir = (float*) calloc(size, sizeof(float));
-	heartMonitor->peaks = (int*) calloc(size, sizeof(int));
-	heartMonitor->threshold = threshold;
-	heartMonitor->greenPreprocess = greenPreprocess;
-	return heartMonitor;
+/**
+ * @brief Frees the memory associated with HR_Ring structure.
+ *
+ * @param ring Pointer to the HR_Ring structure created by HR_ring_new.
+ * @return None.
+ */
+void HR_ring_free(HR_Ring *ring) {
+	free(ring);
 }
 
 /**
- * @brief Frees the memory associated with HR_HeartMonitor structure.
+ * @brief Appends one sample to the ring buffer.
  *
- * This function frees the memory allocated for the HR_HeartMonitor structure and its associated
- * data arrays, as well as the HR_GreenPreprocess structure used for preprocessing.
+ * The oldest sample of the window is dropped. The value is written to both
+ * halves of the mirrored storage, so the cost does not depend on the window size.
  *
- * @param heartMonitor Pointer to the HR_HeartMonitor structure to be freed.
+ * @param ring  Pointer to the HR_Ring structure.
+ * @param value Sample to append.
  * @return None.
  */
-void HR_heartMonitor_free(HR_HeartMonitor *heartMonitor) {
-	HR_greenPreprocess_free(heartMonitor->greenPreprocess);
-	free(heartMonitor->green);
-	free(heartMonitor->red);
-	free(heartMonitor->ir);
-	free(heartMonitor);
+void HR_ring_push(HR_Ring *ring, float value) {
+	ring->data[ring->head] = value;
+	ring->data[ring->head + ring->size] = value;
+	ring->head++;
+	if (ring->head == ring->size) {
+		ring->head = 0;
+	}
 }
 
 /**
- * @brief Adds green channel data to the HR_HeartMonitor structure.
+ * @brief Appends an array of samples to the ring buffer.
  *
- * This function adds the green channel data to the HR_HeartMonitor structure. It processes the
- * data using the HR_GreenPreprocess structure, updates the internal green channel data array.
+ * If the array is longer than the window only its last 'size' samples are kept.
  *
- * @param heartMonitor Pointer to the HR_HeartMonitor structure.
- * @param array        Pointer to the green channel data array.
- * @param array_size   Size of the green channel data array.
+ * @param ring       Pointer to the HR_Ring structure.
+ * @param array      Pointer to the array of samples.
+ * @param array_size Size of the array.
  * @return None.
  */
-void HR_heartMonitor_addGreen(HR_HeartMonitor *heartMonitor, float *array,
-		int array_size) {
-	HR_greenPreprocess_process(heartMonitor->greenPreprocess, array,
-			array_size);
-	if (array_size >= heartMonitor->size) {
-		memcpy(heartMonitor->green, &array[array_size - heartMonitor->size],
-				heartMonitor->size * sizeof(float));
-	} else {
-		memmove(heartMonitor->green, &heartMonitor->green[array_size],
-				(heartMonitor->size - array_size) * sizeof(float));
-		memmove(&heartMonitor->green[heartMonitor->size - array_size], array,
-				array_size * sizeof(float));
+void HR_ring_pushArray(HR_Ring *ring, float *array, int array_size) {
+	int start = 0;
+	if (array_size > ring->size) {
+		start = array_size - ring->size;
 	}
+	for (int i = start; i < array_size; i++) {
+		HR_ring_push(ring, array[i]);
+	}
+}
 
+/**
+ * @brief Returns the current window of the ring buffer.
+ *
+ * @param ring Pointer to the HR_Ring structure.
+ * @return Pointer to 'size' contiguous samples, oldest first. The pointer is
+ *         valid until the next push.
+ */
+float* HR_ring_window(HR_Ring *ring) {
+	return &ring->data[ring->head];
 }
 
 /**
- * @brief Adds red and infrared channel data to the HR_HeartMonitor structure.
+ * @brief Creates the Moving Average (MA) filters of the red and infrared channels in an arena.
  *
- * This function adds the red and infrared channel data to the HR_HeartMonitor structure. It handles cases
- * where the array size is smaller than the size of the HR_HeartMonitor data array, and updates the internal
- * red and infrared channel data arrays accordingly.
+ * @param arena       Pointer to the arena with at least HR_REDIRMA_FOOTPRINT bytes left.
+ * @param window_size Size of the moving average windows.
  *
- * @param heartMonitor Pointer to the HR_HeartMonitor structure.
- * @param array_red    Pointer to the red channel data array.
- * @param array_ir     Pointer to the infrared channel data array.
- * @param array_size   Size of the red and infrared channel data arrays.
- * @return None.
+ * @return Pointer to the newly created HR_RedIrMA structure or NULL if the arena is too small.
  */
-void HR_heartMonitor_addRedIr(HR_HeartMonitor *heartMonitor, float *array_red,
-		float *array_ir, int array_size) {
-	if (array_size >= heartMonitor->size) {
-		memcpy(heartMonitor->red, &array_red[array_size - heartMonitor->size],
-				heartMonitor->size * sizeof(float));
-		memcpy(heartMonitor->ir, &array_ir[array_size - heartMonitor->size],
-				heartMonitor->size * sizeof(float));
-	} else {
-		memmove(heartMonitor->red, &heartMonitor->red[array_size],
-				(heartMonitor->size - array_size) * sizeof(float));
-		memcpy(&heartMonitor->red[heartMonitor->size - array_size], array_red,
-				array_size * sizeof(float));
+HR_RedIrMA* HR_redIrMA_arenaNew(HR_Arena *arena, int window_size) {
+	if (!HR_arena_fits(arena, HR_REDIRMA_FOOTPRINT(window_size))) {
+		return NULL;
+	}
+	HR_RedIrMA *filter = (HR_RedIrMA*) HR_arena_alloc(arena,
+			sizeof(HR_RedIrMA));
+	filter->window_size = window_size;
+	filter->red = HR_arena_alloc(arena, window_size * sizeof(*filter->red));
+	filter->ir = HR_arena_alloc(arena, window_size * sizeof(*filter->ir));
+	return filter;
+}
 
-		memmove(heartMonitor->ir, &heartMonitor->ir[array_size],
-				(heartMonitor->size - array_size) * sizeof(float));
-		memcpy(&heartMonitor->ir[heartMonitor->size - array_size], array_ir,
-				array_size * sizeof(float));
+/**
+ * @brief Pushes a red and an infrared sample through the Moving Average (MA) filters.
+ *
+ * Same step as MA_process on both channels. The averages are written back to red and ir.
+ *
+ * @param filter Pointer to the HR_RedIrMA structure.
+ * @param red    Pointer to the red sample.
+ * @param ir     Pointer to the infrared sample.
+ */
+#ifdef HR_FIXED_POINT
+static inline void HR_redIrMA_step(HR_RedIrMA *filter, int32_t *red,
+		int32_t *ir) {
+	// integer sums are exact, no recalculation is needed
+	filter->sum_red += *red - filter->red[filter->head];
+	filter->sum_ir += *ir - filter->ir[filter->head];
+	filter->red[filter->head] = *red;
+	filter->ir[filter->head] = *ir;
+	filter->head++;
+	if (filter->head == filter->window_size) {
+		filter->head = 0;
+	}
+	*red = filter->sum_red / filter->window_size;
+	*ir = filter->sum_ir / filter->window_size;
+}
+#else
+static inline void HR_redIrMA_step(HR_RedIrMA *filter, float *red, float *ir) {
+	filter->sum_red += *red - filter->red[filter->head];
+	filter->sum_ir += *ir - filter->ir[filter->head];
+	filter->red[filter->head] = *red;
+	filter->ir[filter->head] = *ir;
+	filter->head++;
+	if (filter->head == filter->window_size) {
+		filter->head = 0;
+		filter->sum_red = 0.0;
+		filter->sum_ir = 0.0;
+		for (int j = 0; j < filter->window_size; j++) {
+			filter->sum_red += filter->red[j];
+			filter->sum_ir += filter->ir[j];
+		}
 	}
+	*red = filter->sum_red / filter->window_size;
+	*ir = filter->sum_ir / filter->window_size;
 }
+#endif
 
 /**
- * @brief Detects peaks from the green channel data in the HR_HeartMonitor structure.
+ * @brief Finds the generated table of a decimation filter.
  *
- * This function detects peaks from the green channel data in the HR_HeartMonitor structure. It
- * applies peak detection and normalization algorithms to the green channel data array.
+ * @param factor Decimation factor.
+ * @param freq   Output sampling frequency.
+ * @param pass   Upper edge of the pass band.
  *
- * @param heartMonitor Pointer to the HR_HeartMonitor structure.
- * @return None.
+ * @return Pointer to the entry of HR_decimatorTables or NULL if there is none for these settings.
  */
-void HR_heartMonitor_peaksFromGreen(HR_HeartMonitor *heartMonitor) {
-	peaks_detect(heartMonitor->green, heartMonitor->peaks, heartMonitor->size,
-			heartMonitor->threshold);
-	peaks_normalize(heartMonitor->green, heartMonitor->peaks,
-			heartMonitor->size);
+const HR_DecimatorTable* HR_decimator_findTable(int factor, float freq,
+		float pass) {
+	for (int i = 0; i < HR_decimatorTables_size; i++) {
+		const HR_DecimatorTable *table = &HR_decimatorTables[i];
+		if (table->factor == factor && table->freq == freq
+				&& table->pass == pass) {
+			return table;
+		}
+	}
+	return NULL;
 }
 
 /**
- * @brief Calculates the heart rate from the detected peaks in the HR_HeartMonitor structure.
+ * @brief Creates a new HR_Decimator polyphase decimator.
  *
- * This function calculates the heart rate from the detected peaks in the HR_HeartMonitor structure.
- * It indexes the peaks, calculates the heart rate using the indexed peaks, and returns the result.
+ * @param factor  Decimation factor, the AFE runs at factor * freq.
+ * @param freq    Output sampling frequency.
+ * @param pass    Upper edge of the pass band, e.g. the upper cutoff of the BPF.
+ * @param history Number of high-rate green samples kept for HR_decimator_refine, 0 for none.
  *
- * @param heartMonitor Pointer to the HR_HeartMonitor structure.
- * @return Heart rate calculated from the detected peaks.
+ * @return Pointer to the newly created HR_Decimator structure or NULL if there is no table.
+ *
+ * @note The returned HR_Decimator structure should be freed using the 'HR_decimator_free' function after use.
  */
-float HR_heartMonitor_heartRateFromPeaks(HR_HeartMonitor *heartMonitor) {
-	int indexed_size = 0;
-	int *signals_indexed = peaks_indexingSize(heartMonitor->peaks,
-			heartMonitor->size, &indexed_size);
+HR_Decimator* HR_decimator_new(int factor, float freq, float pass,
+		int history) {
+	HR_Arena arena;
+	void *memory = malloc(HR_DECIMATOR_FOOTPRINT(history));
+	HR_arena_init(&arena, memory, HR_DECIMATOR_FOOTPRINT(history));
+	HR_Decimator *decimator = HR_decimator_arenaNew(&arena, factor, freq, pass,
+			history);
+	if (decimator == NULL) {
+		free(memory);
+	}
+	return decimator;
+}
 
-	float result = HR_heartMonitor_heartRateFromIndexedPeaks(heartMonitor,
-			signals_indexed, indexed_size);
+/**
+ * @brief Creates a new HR_Decimator polyphase decimator in an arena.
+ *
+ * The decimator is bound to its entry of HR_decimatorTables, run tools/decimator_tables.py
+ * for new settings.
+ *
+ * @param arena   Pointer to the arena with at least HR_DECIMATOR_FOOTPRINT bytes left.
+ * @param factor  Decimation factor, the AFE runs at factor * freq.
+ * @param freq    Output sampling frequency.
+ * @param pass    Upper edge of the pass band, e.g. the upper cutoff of the BPF.
+ * @param history Number of high-rate green samples kept for HR_decimator_refine, 0 for none.
+ *
+ * @return Pointer to the newly created HR_Decimator structure or NULL if the arena is too small
+ * or there is no table.
+ */
+HR_Decimator* HR_decimator_arenaNew(HR_Arena *arena, int factor, float freq,
+		float pass, int history) {
+	const HR_DecimatorTable *table = HR_decimator_findTable(factor, freq, pass);
+	if (table == NULL || table->length > HR_DECIMATOR_LENGTH
+			|| !HR_arena_fits(arena, HR_DECIMATOR_FOOTPRINT(history))) {
+		return NULL;
+	}
+	HR_Decimator *decimator = (HR_Decimator*) HR_arena_alloc(arena,
+			sizeof(HR_Decimator));
+	decimator->factor = factor;
+	decimator->length = table->length;
+	decimator->delay = table->delay;
+	decimator->coefficients = table->coefficients;
+	decimator->sums = (float*) HR_arena_alloc(arena,
+			HR_DECIMATOR_CHANNELS * HR_DECIMATOR_LENGTH * sizeof(float));
+	decimator->green =
+			history > 0 ? HR_ring_arenaNew(arena, history) : NULL;
+	HR_decimator_reset(decimator);
+	return decimator;
+}
 
-	free(signals_indexed);
-	return result;
+/**
+ * @brief Frees the memory allocated for a HR_Decimator structure.
+ *
+ * @param decimator Pointer to the HR_Decimator structure created by HR_decimator_new.
+ */
+void HR_decimator_free(HR_Decimator *decimator) {
+	free(decimator);
 }
 
 /**
- * @brief Calculates the heart rate from the indexed peaks in the HR_HeartMonitor structure.
+ * @brief Clears the partial sums, the next input sample gives the next output sample.
  *
- * This function calculates the heart rate from the indexed peaks in the HR_HeartMonitor structure.
- * It iterates through the indexed peaks, calculates the average peak-to-peak distance, and returns
- * the heart rate based on the average distance and the sampling frequency.
+ * @param decimator Pointer to the HR_Decimator structure.
+ */
+void HR_decimator_reset(HR_Decimator *decimator) {
+	memset(decimator->sums, 0,
+			HR_DECIMATOR_CHANNELS * decimator->length * sizeof(float));
+	decimator->phase = 0;
+	decimator->count = 0;
+	decimator->lag = nanf("");
+}
+
+/**
+ * @brief Decimates interleaved AFE samples.
  *
- * @param heartMonitor Pointer to the HR_HeartMonitor structure.
- * @param peaks        Pointer to the array of indexed peaks.
- * @param peaks_size   Size of the array of indexed peaks.
- * @return Heart rate calculated from the indexed peaks.
+ * One output sample comes out for every factor input samples, so a block of a multiple of
+ * factor samples always gives samples / factor of them.
+ *
+ * @param decimator Pointer to the HR_Decimator structure.
+ * @param fifo      Pointer to the interleaved input samples, each HR_AFE_STRIDE values.
+ * @param samples   Number of input samples.
+ * @param output    Pointer to the interleaved output samples, may be fifo.
+ *
+ * @return Number of output samples written.
  */
-float HR_heartMonitor_heartRateFromIndexedPeaks(HR_HeartMonitor *heartMonitor,
-		int *peaks, int peaks_size) {
-	int pointer = 0;
-	int count = 0;
-	int sum = 0.0;
-	while (pointer < peaks_size - 1) {
-		sum += (peaks[pointer + 1] - peaks[pointer]);
-		count++;
-		pointer++;
+int HR_decimator_process(HR_Decimator *decimator, const float *fifo,
+		int samples, float *output) {
+	int length = decimator->length;
+	int written = 0;
+	for (int i = 0; i < samples; i++, fifo += HR_AFE_STRIDE) {
+		const float *row = decimator->coefficients + decimator->phase * length;
+		float *sums = decimator->sums;
+		for (int channel = 0; channel < HR_DECIMATOR_CHANNELS; channel++, sums +=
+				length) {
+			float value = fifo[channel];
+			for (int j = 0; j < length; j++) {
+				sums[j] += row[j] * value;
+			}
+		}
+		if (decimator->green != NULL) {
+			HR_ring_push(decimator->green, fifo[HR_AFE_GREEN]);
+		}
+		decimator->count++;
+		if (decimator->phase > 0) {
+			decimator->phase--;
+			continue;
+		}
+		float *sample = output + written * HR_AFE_STRIDE;
+		sums = decimator->sums;
+		for (int channel = 0; channel < HR_DECIMATOR_CHANNELS; channel++, sums +=
+				length) {
+			sample[channel] = sums[0];
+			memmove(sums, sums + 1, (length - 1) * sizeof(float));
+			sums[length - 1] = 0.0;
+		}
+		for (int k = HR_DECIMATOR_CHANNELS; k < HR_AFE_STRIDE; k++) {
+			sample[k] = fifo[k];
+		}
+		written++;
+		decimator->phase = decimator->factor - 1;
+	}
+	return written;
+}
+
+/**
+ * @brief Times a beat on the high-rate green samples.
+ *
+ * Finds the steepest rise of the raw green channel within span output samples of the beat,
+ * with a parabola through the slopes around it, and returns its time with the delay of the
+ * decimation filter added, so it lines up with the output samples. The slope is taken over
+ * one output sample. The rise is the point of the pulse the slope sum function of the green
+ * preprocessing stands on, timed factor times finer than the beat detector.
+ *
+ * Without a rise in the history the beat is moved by the average distance of the last rises
+ * from their beats, so refined and unrefined beats stay in line.
+ *
+ * @param decimator Pointer to the HR_Decimator structure.
+ * @param ago       Time of the beat in output samples before the newest output sample.
+ * @param span      Output samples searched on either side of the beat, e.g. half a beat interval.
+ *
+ * @return Time of the rise in output samples before the newest output sample, or NaN
+ * without a history or before the first rise.
+ */
+float HR_decimator_refine(HR_Decimator *decimator, float ago, float span) {
+	HR_Ring *ring = decimator->green;
+	if (ring == NULL || decimator->count == 0) {
+		return nanf("");
+	}
+	int factor = decimator->factor;
+	int half = factor / 2;
+	// Distance of the newest output from the newest input sample
+	int last = (int) ((decimator->count - 1) % factor);
+	// Window indexes of the input samples lined up with the beat and the span
+	float end = ring->size - 1 - last - decimator->delay - ago * factor;
+	float low = end - span * factor;
+	float high = end + span * factor;
+	// the casts truncate towards zero, first is rounded up and stop down without ceilf and floorf
+	int first = (int) low;
+	int stop = (int) high;
+	first += (float) first < low;
+	stop -= (float) stop > high;
+	int oldest = decimator->count < (unsigned int) ring->size ?
+			ring->size - (int) decimator->count : 0;
+	int steepest = first;
+	float slope = 0.0;
+	if (first - half - 1 >= oldest && stop + half + 1 < ring->size) {
+		float *green = HR_ring_window(ring);
+		for (int i = first; i <= stop; i++) {
+			float rise = green[i + half] - green[i - half];
+			if (rise > slope) {
+				slope = rise;
+				steepest = i;
+			}
+		}
+		if (steepest > first && steepest < stop) {
+			float before = green[steepest - 1 + half] - green[steepest - 1 - half];
+			float after = green[steepest + 1 + half] - green[steepest + 1 - half];
+			float curvature = before - 2.0 * slope + after;
+			float position = steepest;
+			if (curvature < 0.0) {
+				position += 0.5 * (before - after) / curvature;
+			}
+			float rise = (ring->size - 1 - last - decimator->delay - position)
+					/ factor;
+			decimator->lag =
+					isnan(decimator->lag) ?
+							rise - ago :
+							decimator->lag
+									+ HR_DECIMATOR_LAG_GAIN
+											* (rise - ago - decimator->lag);
+			return rise;
+		}
+	}
+	return ago + decimator->lag;
+}
+
+/**
+ * @brief Creates a new HR_Fusion infrared peak detection channel.
+ *
+ * @param freq       Frequency of the heart monitor.
+ * @param size       Size of the window, that of the heart monitor.
+ * @param threshold  Threshold of the beat detector after a beat, as a fraction of the beat.
+ * @param bpf_order  Order of the Band-Pass Filter (BPF).
+ * @param bpf_low    Lower cutoff frequency of the BPF.
+ * @param bpf_high   Upper cutoff frequency of the BPF.
+ * @param ssf_size   Size of the Slope Sum Function (SSF).
+ * @param rate_high  Highest heart rate in bpm, which sets the refractory period of the detector.
+ *
+ * @return Pointer to the newly created HR_Fusion structure or NULL.
+ *
+ * @note The returned HR_Fusion structure should be freed using the 'HR_fusion_free' function after use.
+ */
+HR_Fusion* HR_fusion_new(float freq, int size, float threshold, int bpf_order,
+		float bpf_low, float bpf_high, int ssf_size, float rate_high) {
+	size_t footprint = HR_FUSION_FOOTPRINT(size, bpf_order, ssf_size);
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(footprint), footprint);
+	HR_Fusion *fusion = HR_fusion_arenaNew(&arena, freq, size, threshold,
+			bpf_order, bpf_low, bpf_high, ssf_size, rate_high);
+	if (fusion == NULL) {
+		free(arena.base);
+	}
+	return fusion;
+}
+
+/**
+ * @brief Creates a new HR_Fusion infrared peak detection channel in an arena.
+ *
+ * Takes the settings of the green channel of the heart monitor it is set on.
+ *
+ * @param arena      Pointer to the arena with at least HR_FUSION_FOOTPRINT bytes left.
+ * @param freq       Frequency of the heart monitor.
+ * @param size       Size of the window, that of the heart monitor.
+ * @param threshold  Threshold of the beat detector after a beat, as a fraction of the beat.
+ * @param bpf_order  Order of the Band-Pass Filter (BPF).
+ * @param bpf_low    Lower cutoff frequency of the BPF.
+ * @param bpf_high   Upper cutoff frequency of the BPF.
+ * @param ssf_size   Size of the Slope Sum Function (SSF).
+ * @param rate_high  Highest heart rate in bpm, which sets the refractory period of the detector.
+ *
+ * @return Pointer to the newly created HR_Fusion structure or NULL if the arena is too small
+ * or there is no BPF_tables entry for the band-pass filter.
+ */
+HR_Fusion* HR_fusion_arenaNew(HR_Arena *arena, float freq, int size,
+		float threshold, int bpf_order, float bpf_low, float bpf_high,
+		int ssf_size, float rate_high) {
+	if (!HR_arena_fits(arena, HR_FUSION_FOOTPRINT(size, bpf_order, ssf_size))) {
+		return NULL;
+	}
+	HR_Fusion *fusion = (HR_Fusion*) HR_arena_alloc(arena, sizeof(HR_Fusion));
+#ifdef HR_FIXED_POINT
+	fusion->bpf = HRQ_BPF_arenaNew(arena, bpf_order, freq, bpf_low, bpf_high);
+	fusion->ssf = HRQ_SSF_arenaNew(arena, ssf_size);
+	fusion->ma = HRQ_MA_arenaNew(arena, HR_GREEN_MA_SIZE);
+#else
+	fusion->bpf = BPF_arenaNew(arena, bpf_order, freq, bpf_low, bpf_high);
+	fusion->ssf = SSF_arenaNew(arena, ssf_size);
+	fusion->ma = MA_arenaNew(arena, HR_GREEN_MA_SIZE);
+#endif
+	if (fusion->bpf == NULL) {
+		return NULL;
+	}
+	fusion->nlms = NLMS_arenaNew(arena, HR_NLMS_TAPS, HR_NLMS_MU,
+			HR_NLMS_EPSILON);
+	fusion->pulse = HR_ring_arenaNew(arena, size);
+	fusion->detector = ATD_arenaNew(arena, size, freq, threshold, rate_high);
+	if (fusion->detector == NULL) {
+		return NULL;
+	}
+	for (int channel = 0; channel < HR_FUSION_CHANNELS; channel++) {
+		fusion->indexed[channel] = (int*) HR_arena_alloc(arena,
+				HR_PEAKS_CAPACITY(size) * sizeof(int));
+		fusion->rate[channel] = nanf("");
+	}
+	fusion->channel = HR_FUSION_GREEN;
+	return fusion;
+}
+
+/**
+ * @brief Frees the memory allocated for a HR_Fusion structure.
+ *
+ * @param fusion Pointer to the HR_Fusion structure created by HR_fusion_new.
+ */
+void HR_fusion_free(HR_Fusion *fusion) {
+	free(fusion);
+}
+
+/**
+ * @brief Adds raw infrared samples to the HR_Fusion structure.
+ *
+ * The samples are preprocessed in place as the green ones by HR_greenPreprocess_processMotion,
+ * appended to the infrared window and fed to its beat detector. The motion canceller takes the
+ * accelerometer samples the green channel has already band-passed. With HR_FIXED_POINT the
+ * filters run on blocks of HRQ_BLOCK_SIZE samples converted to Q8.23.
+ *
+ * @param fusion     Pointer to the HR_Fusion structure.
+ * @param array      Pointer to the raw infrared samples, preprocessed in place.
+ * @param motion     HR_MOTION_AXES pointers to the band-passed accelerometer samples in g,
+ *                   or NULL to skip the motion canceller.
+ * @param array_size Size of the infrared array and of every motion array.
+ */
+void HR_fusion_process(HR_Fusion *fusion, float *array, float **motion,
+		int array_size) {
+#ifdef HR_FIXED_POINT
+	int32_t block[HRQ_BLOCK_SIZE];
+	float *reference[HR_MOTION_AXES];
+	for (int start = 0; start < array_size; start += HRQ_BLOCK_SIZE) {
+		int block_size = array_size - start;
+		if (block_size > HRQ_BLOCK_SIZE) {
+			block_size = HRQ_BLOCK_SIZE;
+		}
+		HRQ_fromFloatArray(array + start, block, block_size);
+		HRQ_BPF_process(fusion->bpf, block, block_size);
+		if (motion != NULL) {
+			for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+				reference[axis] = motion[axis] + start;
+			}
+			HRQ_toFloatArray(block, array + start, block_size);
+			NLMS_process(fusion->nlms, array + start, reference, block_size);
+			HRQ_fromFloatArray(array + start, block, block_size);
+		}
+		HRQ_SSF_process(fusion->ssf, block, block_size);
+		HRQ_MA_process(fusion->ma, block, block_size);
+		HRQ_toFloatArray(block, array + start, block_size);
+	}
+#else
+	BPF_process(fusion->bpf, array, array_size);
+	if (motion != NULL) {
+		NLMS_process(fusion->nlms, array, motion, array_size);
+	}
+	SSF_process(fusion->ssf, array, array_size);
+	MA_process(fusion->ma, array, array_size);
+#endif
+	TRACE_PROBE(TRACE_IR_PULSE, array, array_size);
+	HR_ring_pushArray(fusion->pulse, array, array_size);
+	ATD_process(fusion->detector, array, array_size);
+}
+
+/**
+ * @brief Creates a new HR_HeartMonitor structure.
+ *
+ * This function creates and initializes a new HR_HeartMonitor structure for heart rate monitoring.
+ * The structure, its data and scratch arrays and the HR_GreenPreprocess stage are placed in a
+ * single heap block of HR_HEARTMONITOR_FOOTPRINT bytes, so no further allocation happens while
+ * the monitor is used.
+ *
+ * @param freq           Frequency of the heart monitor.
+ * @param size           Size of the data arrays.
+ * @param threshold      Threshold of the beat detector after a beat, as a fraction of the beat.
+ * @param bpf_order      Order of the Band-Pass Filter (BPF).
+ * @param bpf_low        Lower cutoff frequency of the BPF.
+ * @param bpf_high       Upper cutoff frequency of the BPF.
+ * @param ssf_size       Size of the Slope Sum Function (SSF).
+ * @param ma_green_size  Size of the Moving Average filter for the green channel.
+ * @param ma_redIr_size  Size of the Moving Average filter for the red and infrared channels.
+ * @param rate_low       Lowest heart rate in bpm, HR_limit_low of main.c.
+ * @param rate_high      Highest heart rate in bpm, HR_limit_high of main.c.
+ * @param engine         Heart rate estimator, HR_ENGINE_PEAKS, HR_ENGINE_SPECTRUM or HR_ENGINE_AUTOCORRELATION.
+ *
+ * @return Pointer to the newly created HR_HeartMonitor structure or NULL.
+ */
+HR_HeartMonitor* HR_heartMonitor_new(float freq, int size, float threshold,
+		int bpf_order, float bpf_low, float bpf_high, int ssf_size,
+		int ma_green_size, int ma_redIr_size, float rate_low, float rate_high,
+		HR_Engine engine) {
+	size_t footprint = HR_HEARTMONITOR_FOOTPRINT(size, bpf_order, ssf_size,
+			ma_redIr_size, engine);
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(footprint), footprint);
+	HR_HeartMonitor *heartMonitor = HR_heartMonitor_arenaNew(&arena, freq,
+			size, threshold, bpf_order, bpf_low, bpf_high, ssf_size,
+			ma_green_size, ma_redIr_size, rate_low, rate_high, engine);
+	if (heartMonitor == NULL) {
+		free(arena.base);
+	}
+	return heartMonitor;
+}
+
+/**
+ * @brief Creates a new HR_HeartMonitor structure in an arena.
+ *
+ * Same as HR_heartMonitor_new, but all memory is taken from the arena, e.g. a static array of
+ * HR_HEARTMONITOR_FOOTPRINT(size, bpf_order, ssf_size, ma_redIr_size, engine) bytes. The heap is never used.
+ *
+ * @param arena          Pointer to the arena with at least HR_HEARTMONITOR_FOOTPRINT bytes left.
+ * @param freq           Frequency of the heart monitor.
+ * @param size           Size of the data arrays.
+ * @param threshold      Threshold of the beat detector after a beat, as a fraction of the beat.
+ * @param bpf_order      Order of the Band-Pass Filter (BPF).
+ * @param bpf_low        Lower cutoff frequency of the BPF.
+ * @param bpf_high       Upper cutoff frequency of the BPF.
+ * @param ssf_size       Size of the Slope Sum Function (SSF).
+ * @param ma_green_size  Size of the Moving Average filter for the green channel.
+ * @param ma_redIr_size  Size of the Moving Average filter for the red and infrared channels.
+ * @param rate_low       Lowest heart rate in bpm, HR_limit_low of main.c.
+ * @param rate_high      Highest heart rate in bpm, HR_limit_high of main.c.
+ * @param engine         Heart rate estimator, HR_ENGINE_PEAKS, HR_ENGINE_SPECTRUM or HR_ENGINE_AUTOCORRELATION.
+ *
+ * @return Pointer to the newly created HR_HeartMonitor structure or NULL if the arena is too small
+ * or there is no BPF_tables entry for the band-pass filter.
+ */
+HR_HeartMonitor* HR_heartMonitor_arenaNew(HR_Arena *arena, float freq,
+		int size, float threshold, int bpf_order, float bpf_low,
+		float bpf_high, int ssf_size, int ma_green_size, int ma_redIr_size,
+		float rate_low, float rate_high, HR_Engine engine) {
+	if (!HR_arena_fits(arena,
+			HR_HEARTMONITOR_FOOTPRINT(size, bpf_order, ssf_size,
+					ma_redIr_size, engine))) {
+		return NULL;
+	}
+	HR_HeartMonitor *heartMonitor = (HR_HeartMonitor*) HR_arena_alloc(arena,
+			sizeof(HR_HeartMonitor));
+	heartMonitor->size = size;
+	heartMonitor->freq = freq;
+	heartMonitor->green = HR_ring_arenaNew(arena, size);
+#ifdef HR_FIXED_POINT
+	heartMonitor->red = HRQ_ring_arenaNew(arena, size);
+	heartMonitor->ir = HRQ_ring_arenaNew(arena, size);
+#else
+	heartMonitor->red = HR_ring_arenaNew(arena, size);
+	heartMonitor->ir = HR_ring_arenaNew(arena, size);
+#endif
+	heartMonitor->ma_redIr = HR_redIrMA_arenaNew(arena, ma_redIr_size);
+	heartMonitor->peaks = (int*) HR_arena_alloc(arena, size * sizeof(int));
+	heartMonitor->indexed = (int*) HR_arena_alloc(arena,
+			HR_PEAKS_CAPACITY(size) * sizeof(int));
+	heartMonitor->indexed_size = 0;
+	heartMonitor->beat = (float*) HR_arena_alloc(arena, size * sizeof(float));
+	heartMonitor->threshold = threshold;
+	heartMonitor->detector = ATD_arenaNew(arena, size, freq, threshold,
+			rate_high);
+	if (heartMonitor->detector == NULL) {
+		return NULL;
+	}
+	heartMonitor->engine = engine;
+	if (engine == HR_ENGINE_SPECTRUM) {
+		heartMonitor->spectrum = HR_spectrum_arenaNew(arena, size, freq,
+				HR_SPECTRUM_LOW, HR_SPECTRUM_STEP, HR_SPECTRUM_BINS);
+		if (heartMonitor->spectrum == NULL) {
+			return NULL;
+		}
+	} else if (engine == HR_ENGINE_AUTOCORRELATION) {
+		heartMonitor->autocorrelation = HR_autocorrelation_arenaNew(arena, size,
+				freq, rate_low, rate_high);
+	}
+	heartMonitor->tracker = HR_tracker_arenaNew(arena, HR_PEAKS_CAPACITY(size),
+			freq, rate_low, rate_high);
+	heartMonitor->tracked = 0;
+	heartMonitor->variability = HR_variability_arenaNew(arena, HR_HRV_SIZE,
+			freq, rate_low, rate_high);
+	heartMonitor->respiration = HR_respiration_arenaNew(arena,
+			HR_RESP_BREATHS, HR_RESP_FREQ);
+	if (heartMonitor->respiration == NULL) {
+		return NULL;
+	}
+	heartMonitor->decimator = NULL;
+	heartMonitor->fusion = NULL;
+#ifdef HR_FIXED_POINT
+	heartMonitor->greenPreprocess = HRQ_greenPreprocess_arenaNew(arena, freq,
+			bpf_order, bpf_low, bpf_high, ssf_size);
+#else
+	heartMonitor->greenPreprocess = HR_greenPreprocess_arenaNew(arena, freq,
+			bpf_order, bpf_low, bpf_high, ssf_size);
+#endif
+	if (heartMonitor->greenPreprocess == NULL) {
+		return NULL;
+	}
+	return heartMonitor;
+}
+
+/**
+ * @brief Frees the memory associated with HR_HeartMonitor structure.
+ *
+ * This function frees the heap block holding the HR_HeartMonitor structure, its data arrays
+ * and the HR_GreenPreprocess structure used for preprocessing.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure created by HR_heartMonitor_new.
+ * @return None.
+ */
+void HR_heartMonitor_free(HR_HeartMonitor *heartMonitor) {
+	free(heartMonitor);
+}
+
+/**
+ * @brief Infrared sample of the monitor window as a float.
+ */
+static float HR_heartMonitor_ir(HR_HeartMonitor *heartMonitor, int i) {
+#ifdef HR_FIXED_POINT
+	return HRQ_toFloat(HRQ_ring_window(heartMonitor->ir)[i]);
+#else
+	return HR_ring_window(heartMonitor->ir)[i];
+#endif
+}
+
+/**
+ * @brief Value at the vertex of the parabola through an extreme sample and its neighbours.
+ */
+static float HR_heartMonitor_vertex(HR_HeartMonitor *heartMonitor, int i) {
+	float before = HR_heartMonitor_ir(heartMonitor, i - 1);
+	float value = HR_heartMonitor_ir(heartMonitor, i);
+	float after = HR_heartMonitor_ir(heartMonitor, i + 1);
+	float curvature = before - 2.0 * value + after;
+	if (curvature == 0.0) {
+		return value;
+	}
+	return value - 0.125 * (before - after) * (before - after) / curvature;
+}
+
+/**
+ * @brief Hands a beat with its amplitude and baseline in the infrared channel to the
+ * respiration stage.
+ *
+ * The amplitude is the range and the baseline the mean of the infrared channel over the
+ * interval ending at the beat, which holds one whole pulse whatever the delay of the green
+ * channel and however far the beat is off its pulse. Both are taken on the channel
+ * interpolated between the samples, over the interval timed to a fraction of a sample and
+ * with the extrema at their parabola vertices: with whole samples a constant rate that is
+ * not a divisor of the sampling frequency beats against it and modulates them by 5 % to
+ * 8 % at 25 Hz, as much as the breathing does. A dropped interval is replaced by the one
+ * of the previous beat, not by the average, which would modulate the interval feature
+ * whenever the interval stage drops every other beat.
+ *
+ * @param interval Interval ending at the beat in ms or NaN, then the previous one is taken.
+ */
+static void HR_heartMonitor_breathe(HR_HeartMonitor *heartMonitor,
+		unsigned int index, float offset, float interval) {
+	int size = heartMonitor->size;
+	ATD_detector *detector = heartMonitor->detector;
+	HR_Respiration *respiration = heartMonitor->respiration;
+	if (isnan(interval)) {
+		interval = isnan(respiration->previous_time) ?
+				detector->interval * 1000.0 / heartMonitor->freq :
+				respiration->previous[HR_RESP_INTERVAL];
+	}
+	float span = interval * heartMonitor->freq / 1000.0;
+	float end = (float) size - (float) (detector->count - index) + offset;
+	float start = end - span;
+	if (span < 1.0 || start < 1.0 || end > size - 2) {
+		return;
+	}
+	int first = (int) start + 1;
+	int last = (int) end;
+	float value_start = HR_heartMonitor_ir(heartMonitor, first - 1);
+	value_start += (start - (first - 1))
+			* (HR_heartMonitor_ir(heartMonitor, first) - value_start);
+	float value_end = HR_heartMonitor_ir(heartMonitor, last);
+	value_end += (end - last)
+			* (HR_heartMonitor_ir(heartMonitor, last + 1) - value_end);
+	float previous = HR_heartMonitor_ir(heartMonitor, first);
+	float sum = 0.5 * (first - start) * (value_start + previous);
+	int lowest = first;
+	int highest = first;
+	float min = previous;
+	float max = previous;
+	for (int i = first + 1; i <= last; i++) {
+		float value = HR_heartMonitor_ir(heartMonitor, i);
+		sum += 0.5 * (previous + value);
+		if (value < min) {
+			min = value;
+			lowest = i;
+		}
+		if (value > max) {
+			max = value;
+			highest = i;
+		}
+		previous = value;
+	}
+	sum += 0.5 * (end - last) * (previous + value_end);
+	if (value_start < min || value_end < min) {
+		min = value_start < value_end ? value_start : value_end;
+	} else if (lowest > first && lowest < last) {
+		min = HR_heartMonitor_vertex(heartMonitor, lowest);
+	}
+	if (value_start > max || value_end > max) {
+		max = value_start > value_end ? value_start : value_end;
+	} else if (highest > first && highest < last) {
+		max = HR_heartMonitor_vertex(heartMonitor, highest);
+	}
+	float features[HR_RESP_FEATURES];
+	features[HR_RESP_AMPLITUDE] = max - min;
+	features[HR_RESP_BASELINE] = sum / span;
+	features[HR_RESP_INTERVAL] = interval;
+	HR_respiration_beat(respiration,
+			((float) index + offset) / heartMonitor->freq, features);
+}
+
+/**
+ * @brief Hands the beats that became final to the beat-to-beat interval stage and the
+ * respiration stage.
+ *
+ * With a decimator the beats are first timed on its high-rate green samples, within half an
+ * average beat interval, see HR_decimator_refine. A beat that the interval stage skips as
+ * an extra beat, mostly the second hump of a slow pulse, is not handed to the respiration
+ * stage: its features alternating with those of the pulses read as a breathing rate.
+ *
+ * @param pending Number of samples of the decimator not yet added to the monitor.
+ */
+static void HR_heartMonitor_beats(HR_HeartMonitor *heartMonitor, int pending) {
+	ATD_detector *detector = heartMonitor->detector;
+	unsigned int index;
+	float offset;
+	while (ATD_next(detector, &index, &offset)) {
+		if (heartMonitor->decimator != NULL) {
+			float ago = (float) (detector->count - 1 - index) + pending - offset;
+			float rise = HR_decimator_refine(heartMonitor->decimator, ago,
+					0.5 * detector->interval);
+			if (!isnan(rise)) {
+				offset += ago - rise;
+			}
+		}
+		float interval = HR_variability_beat(heartMonitor->variability, index,
+				offset);
+		if (heartMonitor->variability->last_index == index) {
+			HR_heartMonitor_breathe(heartMonitor, index, offset, interval);
+		}
+	}
+}
+
+/**
+ * @brief Adds green channel data to the HR_HeartMonitor structure.
+ *
+ * This function adds the green channel data to the HR_HeartMonitor structure. It processes the
+ * data using the HR_GreenPreprocess structure, appends it to the green channel ring buffer and
+ * feeds it to the beat detector, whose final beats go to the beat-to-beat interval stage,
+ * and, with HR_ENGINE_AUTOCORRELATION, to the autocorrelation estimator. With HR_FIXED_POINT
+ * the preprocessing runs in fixed point on blocks of HRQ_BLOCK_SIZE samples and the result is
+ * converted back to float.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @param array        Pointer to the green channel data array.
+ * @param array_size   Size of the green channel data array.
+ * @return None.
+ */
+void HR_heartMonitor_addGreen(HR_HeartMonitor *heartMonitor, float *array,
+		int array_size) {
+#ifdef HR_FIXED_POINT
+	int32_t block[HRQ_BLOCK_SIZE];
+	for (int start = 0; start < array_size; start += HRQ_BLOCK_SIZE) {
+		int block_size = array_size - start;
+		if (block_size > HRQ_BLOCK_SIZE) {
+			block_size = HRQ_BLOCK_SIZE;
+		}
+		HRQ_fromFloatArray(array + start, block, block_size);
+		HRQ_greenPreprocess_process(heartMonitor->greenPreprocess, block,
+				block_size);
+		HRQ_toFloatArray(block, array + start, block_size);
+	}
+#else
+	HR_greenPreprocess_process(heartMonitor->greenPreprocess, array,
+			array_size);
+#endif
+	HR_ring_pushArray(heartMonitor->green, array, array_size);
+	ATD_process(heartMonitor->detector, array, array_size);
+	HR_heartMonitor_beats(heartMonitor, 0);
+	if (heartMonitor->engine == HR_ENGINE_AUTOCORRELATION) {
+		HR_autocorrelation_process(heartMonitor->autocorrelation, array,
+				array_size);
+	}
+}
+
+/**
+ * @brief Adds red and infrared channel data to the HR_HeartMonitor structure.
+ *
+ * This function adds the red and infrared channel data to the HR_HeartMonitor structure. The samples
+ * go through the Moving Average filters of both channels and are appended to the red and infrared
+ * ring buffers, so the cost depends only on the array size. With HR_FIXED_POINT the samples are
+ * filtered and stored in fixed point (Q8.23). With a HR_Fusion the raw infrared samples also go
+ * to its peak detection, without motion cancellation.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @param array_red    Pointer to the red channel data array.
+ * @param array_ir     Pointer to the infrared channel data array.
+ * @param array_size   Size of the red and infrared channel data arrays.
+ * @return None.
+ */
+void HR_heartMonitor_addRedIr(HR_HeartMonitor *heartMonitor, float *array_red,
+		float *array_ir, int array_size) {
+	for (int i = 0; i < array_size; i++) {
+#ifdef HR_FIXED_POINT
+		int32_t red = HRQ_fromFloat(array_red[i]);
+		int32_t ir = HRQ_fromFloat(array_ir[i]);
+		HR_redIrMA_step(heartMonitor->ma_redIr, &red, &ir);
+		HRQ_ring_push(heartMonitor->red, red);
+		HRQ_ring_push(heartMonitor->ir, ir);
+#else
+		float red = array_red[i];
+		float ir = array_ir[i];
+		HR_redIrMA_step(heartMonitor->ma_redIr, &red, &ir);
+		HR_ring_push(heartMonitor->red, red);
+		HR_ring_push(heartMonitor->ir, ir);
+#endif
+	}
+	if (heartMonitor->fusion != NULL) {
+		float block[HR_BLOCK_SIZE];
+		for (int start = 0; start < array_size; start += HR_BLOCK_SIZE) {
+			int block_size = array_size - start;
+			if (block_size > HR_BLOCK_SIZE) {
+				block_size = HR_BLOCK_SIZE;
+			}
+			memcpy(block, array_ir + start, block_size * sizeof(float));
+			HR_fusion_process(heartMonitor->fusion, block, NULL, block_size);
+		}
+	}
+}
+
+/**
+ * @brief Adds a block of the interleaved AFE FIFO to the HR_HeartMonitor structure.
+ *
+ * This function takes the red, infrared and green channels straight from the AFE FIFO buffer
+ * (see HR_AFE_STRIDE) in a single pass. Red and infrared go through their Moving Average filters
+ * into the ring buffers. Green is gathered into blocks of HR_BLOCK_SIZE samples on the stack,
+ * preprocessed, appended to the green ring buffer and fed to the beat detector. The
+ * results are the same as those of HR_heartMonitor_addGreen and HR_heartMonitor_addRedIr on
+ * deinterleaved arrays. With accelerometer samples taken at the same rate, the motion-correlated
+ * part of the green channel is removed before the SSF (see HR_greenPreprocess_processMotion)
+ * and the band-passed accelerometer energy is kept for HR_heartMonitor_quality. With a
+ * HR_Fusion the raw infrared samples go through the same chain to its peak detection.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @param fifo         Pointer to the interleaved samples.
+ * @param acceleration Pointer to one accelerometer sample in mg per AFE sample, oldest first,
+ *                     or NULL without motion cancellation.
+ * @param samples      Number of samples, each HR_AFE_STRIDE values.
+ * @return Mean of the raw green samples, e.g. for the LED current control.
+ */
+float HR_heartMonitor_addInterleaved(HR_HeartMonitor *heartMonitor,
+		float *fifo, int16_t (*acceleration)[HR_MOTION_AXES], int samples) {
+	float green_sum = 0.0;
+	float motion_sum = 0.0;
+	float green[HR_BLOCK_SIZE];
+	float ir_raw[HR_BLOCK_SIZE];
+	float motion_data[HR_MOTION_AXES][HR_BLOCK_SIZE];
+	float *motion[HR_MOTION_AXES];
+	for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+		motion[axis] = motion_data[axis];
+	}
+#ifdef HR_FIXED_POINT
+	int32_t block[HR_BLOCK_SIZE];
+#endif
+	for (int start = 0; start < samples; start += HR_BLOCK_SIZE) {
+		int block_size = samples - start;
+		if (block_size > HR_BLOCK_SIZE) {
+			block_size = HR_BLOCK_SIZE;
+		}
+		float *sample = fifo + start * HR_AFE_STRIDE;
+		for (int i = 0; i < block_size; i++, sample += HR_AFE_STRIDE) {
+			green_sum += sample[HR_AFE_GREEN];
+			ir_raw[i] = sample[HR_AFE_IR];
+#ifdef HR_FIXED_POINT
+			block[i] = HRQ_fromFloat(sample[HR_AFE_GREEN]);
+			int32_t red = HRQ_fromFloat(sample[HR_AFE_RED]);
+			int32_t ir = HRQ_fromFloat(sample[HR_AFE_IR]);
+			HR_redIrMA_step(heartMonitor->ma_redIr, &red, &ir);
+			HRQ_ring_push(heartMonitor->red, red);
+			HRQ_ring_push(heartMonitor->ir, ir);
+#else
+			green[i] = sample[HR_AFE_GREEN];
+			float red = sample[HR_AFE_RED];
+			float ir = sample[HR_AFE_IR];
+			HR_redIrMA_step(heartMonitor->ma_redIr, &red, &ir);
+			HR_ring_push(heartMonitor->red, red);
+			HR_ring_push(heartMonitor->ir, ir);
+#endif
+		}
+		if (acceleration != NULL) {
+			for (int i = 0; i < block_size; i++) {
+				for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+					motion[axis][i] = acceleration[start + i][axis] * 0.001f;
+				}
+			}
+		}
+		TRACE_PROBE(TRACE_IR_RAW, ir_raw, block_size);
+#ifdef HR_FIXED_POINT
+		TRACE_PROBE_Q(TRACE_GREEN_RAW, block, block_size);
+		HRQ_greenPreprocess_processMotion(heartMonitor->greenPreprocess, block,
+				acceleration != NULL ? motion : NULL, block_size);
+		HRQ_toFloatArray(block, green, block_size);
+#else
+		TRACE_PROBE(TRACE_GREEN_RAW, green, block_size);
+		HR_greenPreprocess_processMotion(heartMonitor->greenPreprocess, green,
+				acceleration != NULL ? motion : NULL, block_size);
+#endif
+		if (acceleration != NULL) {
+			for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+				for (int i = 0; i < block_size; i++) {
+					motion_sum += motion[axis][i] * motion[axis][i];
+				}
+			}
+		}
+		if (heartMonitor->fusion != NULL) {
+			HR_fusion_process(heartMonitor->fusion, ir_raw,
+					acceleration != NULL ? motion : NULL, block_size);
+		}
+		HR_ring_pushArray(heartMonitor->green, green, block_size);
+		ATD_process(heartMonitor->detector, green, block_size);
+		HR_heartMonitor_beats(heartMonitor, samples - start - block_size);
+		if (heartMonitor->engine == HR_ENGINE_AUTOCORRELATION) {
+			HR_autocorrelation_process(heartMonitor->autocorrelation, green,
+					block_size);
+		}
+	}
+	heartMonitor->motion = samples > 0 ? motion_sum / samples : 0.0;
+	return samples > 0 ? green_sum / samples : 0.0;
+}
+
+/**
+ * @brief Detects peaks from the green channel data in the HR_HeartMonitor structure.
+ *
+ * This function fills the peaks array of the HR_HeartMonitor structure for the current green
+ * channel window. The peaks are the beats of the adaptive threshold detector, which already
+ * processed every sample in HR_heartMonitor_addGreen, so the green samples are not rescanned.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @return None.
+ */
+void HR_heartMonitor_peaksFromGreen(HR_HeartMonitor *heartMonitor) {
+	ATD_peaks(heartMonitor->detector, heartMonitor->peaks);
+}
+
+/**
+ * @brief Indexes the detected peaks into the scratch array of the HR_HeartMonitor structure.
+ *
+ * This function writes the positions of the peaks from the peaks array to the 'indexed' scratch
+ * array, which holds up to HR_PEAKS_CAPACITY(size) elements, without allocating. The number of
+ * indexed peaks is kept in indexed_size too, so the stages after
+ * HR_heartMonitor_heartRateAndRatio reuse the peaks it indexed.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @return Number of indexed peaks.
+ */
+int HR_heartMonitor_indexPeaks(HR_HeartMonitor *heartMonitor) {
+	int count = 0;
+	for (int i = 0; i < heartMonitor->size; i++) {
+		if (heartMonitor->peaks[i] == 1
+				&& count < HR_PEAKS_CAPACITY(heartMonitor->size)) {
+			heartMonitor->indexed[count] = i;
+			count++;
+		}
+	}
+	heartMonitor->indexed_size = count;
+	return count;
+}
+
+/**
+ * @brief Calculates the heart rate from the detected peaks in the HR_HeartMonitor structure.
+ *
+ * This function calculates the heart rate from the detected peaks in the HR_HeartMonitor structure.
+ * It indexes the peaks, calculates the heart rate using the indexed peaks, and returns the result.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @return Heart rate calculated from the detected peaks.
+ */
+float HR_heartMonitor_heartRateFromPeaks(HR_HeartMonitor *heartMonitor) {
+	int indexed_size = HR_heartMonitor_indexPeaks(heartMonitor);
+	return HR_heartMonitor_heartRateFromIndexedPeaks(heartMonitor,
+			heartMonitor->indexed, indexed_size);
+}
+
+/**
+ * @brief Calculates the heart rate with the engine selected in HR_heartMonitor_new.
+ *
+ * With HR_ENGINE_PEAKS the peaks must be detected by HR_heartMonitor_peaksFromGreen first,
+ * HR_ENGINE_SPECTRUM works on the green channel ring buffer directly and
+ * HR_ENGINE_AUTOCORRELATION on its running sums, which are up to date after every sample.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @return Heart rate in beats per minute or NaN.
+ */
+float HR_heartMonitor_heartRate(HR_HeartMonitor *heartMonitor) {
+	if (heartMonitor->engine == HR_ENGINE_SPECTRUM) {
+		return HR_spectrum_heartRate(heartMonitor->spectrum,
+				HR_ring_window(heartMonitor->green));
+	}
+	if (heartMonitor->engine == HR_ENGINE_AUTOCORRELATION) {
+		return HR_autocorrelation_heartRate(heartMonitor->autocorrelation,
+				NULL);
+	}
+	return HR_heartMonitor_heartRateFromPeaks(heartMonitor);
+}
+
+/**
+ * @brief Creates a new HR_Spectrum spectral heart rate estimator.
+ *
+ * @param size Number of samples in the window.
+ * @param freq Sampling frequency.
+ * @param low  Frequency of the first bin in Hz.
+ * @param step Spacing of the bins in Hz.
+ * @param bins Number of bins, at least 3.
+ *
+ * @return Pointer to the newly created HR_Spectrum structure or NULL if there is no table for
+ *         these settings, see HR_spectrum_arenaNew.
+ *
+ * @note The returned HR_Spectrum structure should be freed using the 'HR_spectrum_free' function after use.
+ */
+HR_Spectrum* HR_spectrum_new(int size, float freq, float low, float step,
+		int bins) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(HR_SPECTRUM_FOOTPRINT(size, bins)),
+			HR_SPECTRUM_FOOTPRINT(size, bins));
+	HR_Spectrum *spectrum = HR_spectrum_arenaNew(&arena, size, freq, low, step,
+			bins);
+	if (spectrum == NULL) {
+		free(arena.base);
+	}
+	return spectrum;
+}
+
+/**
+ * @brief Finds the generated table of a spectral heart rate estimator.
+ *
+ * @param size Number of samples in the window.
+ * @param freq Sampling frequency.
+ * @param low  Frequency of the first bin in Hz.
+ * @param step Spacing of the bins in Hz.
+ * @param bins Number of bins.
+ *
+ * @return Pointer to the entry of HR_spectrumTables or NULL if there is none for these settings.
+ */
+const HR_SpectrumTable* HR_spectrum_findTable(int size, float freq, float low,
+		float step, int bins) {
+	for (int i = 0; i < HR_spectrumTables_size; i++) {
+		const HR_SpectrumTable *table = &HR_spectrumTables[i];
+		if (table->size == size && table->freq == freq && table->low == low
+				&& table->step == step && table->bins == bins) {
+			return table;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Creates a new HR_Spectrum spectral heart rate estimator in an arena.
+ *
+ * The Hann window and the Goertzel coefficients of the bins come from HR_spectrumTables or,
+ * with HR_BPF_RUNTIME_DESIGN, are computed here once.
+ *
+ * @param arena Pointer to the arena with at least HR_SPECTRUM_FOOTPRINT bytes left.
+ * @param size  Number of samples in the window.
+ * @param freq  Sampling frequency.
+ * @param low   Frequency of the first bin in Hz.
+ * @param step  Spacing of the bins in Hz.
+ * @param bins  Number of bins, at least 3.
+ *
+ * @return Pointer to the newly created HR_Spectrum structure or NULL if the arena is too small
+ * or there is no table for these settings.
+ */
+HR_Spectrum* HR_spectrum_arenaNew(HR_Arena *arena, int size, float freq,
+		float low, float step, int bins) {
+	const HR_SpectrumTable *table = HR_spectrum_findTable(size, freq, low, step,
+			bins);
+#ifndef HR_BPF_RUNTIME_DESIGN
+	if (table == NULL) {
+		return NULL;
+	}
+#endif
+	if (!HR_arena_fits(arena, HR_SPECTRUM_FOOTPRINT(size, bins))) {
+		return NULL;
+	}
+	HR_Spectrum *spectrum = (HR_Spectrum*) HR_arena_alloc(arena,
+			sizeof(HR_Spectrum));
+	spectrum->size = size;
+	spectrum->bins = bins;
+	spectrum->low = low;
+	spectrum->step = step;
+	spectrum->state = (float*) HR_arena_alloc(arena,
+			2 * bins * sizeof(float));
+	if (table != NULL) {
+		spectrum->window = table->window;
+		spectrum->coefficients = table->coefficients;
+		return spectrum;
+	}
+#ifdef HR_BPF_RUNTIME_DESIGN
+	float *window = (float*) HR_arena_alloc(arena, size * sizeof(float));
+	float *coefficients = (float*) HR_arena_alloc(arena, bins * sizeof(float));
+	for (int i = 0; i < size; i++) {
+		window[i] = 0.5 - 0.5 * cosf(2.0 * M_PI * i / size);
+	}
+	for (int k = 0; k < bins; k++) {
+		coefficients[k] = 2.0 * cosf(2.0 * M_PI * (low + k * step) / freq);
+	}
+	spectrum->window = window;
+	spectrum->coefficients = coefficients;
+#endif
+	return spectrum;
+}
+
+/**
+ * @brief Frees the memory allocated for a HR_Spectrum structure.
+ *
+ * @param spectrum Pointer to the HR_Spectrum structure created by HR_spectrum_new.
+ */
+void HR_spectrum_free(HR_Spectrum *spectrum) {
+	free(spectrum);
+}
+
+/**
+ * @brief Calculates the heart rate from the strongest frequency of a window.
+ *
+ * The mean is removed and the window is weighted by the Hann window. Every sample then
+ * advances the Goertzel recursion s = x + 2 cos(w) s1 - s2 of all bins, which takes one
+ * multiplication per bin instead of the complex product of a DFT. The strongest bin and its
+ * neighbours are fitted by a parabola, so the estimate is finer than the bin spacing.
+ *
+ * @param spectrum Pointer to the HR_Spectrum structure.
+ * @param array    Pointer to the window of spectrum->size samples, e.g. the green ring buffer.
+ * @return Heart rate in beats per minute, or NaN if the window is flat or the strongest
+ *         frequency lies on the first or the last bin, i.e. out of the band.
+ */
+float HR_spectrum_heartRate(HR_Spectrum *spectrum, float *array) {
+	int bins = spectrum->bins;
+	const float *coefficients = spectrum->coefficients;
+	float *s1 = spectrum->state;
+	float *s2 = spectrum->state + bins;
+
+	float mean = 0.0;
+	for (int i = 0; i < spectrum->size; i++) {
+		mean += array[i];
+	}
+	mean /= spectrum->size;
+
+	memset(spectrum->state, 0, 2 * bins * sizeof(float));
+	for (int i = 0; i < spectrum->size; i++) {
+		float x = spectrum->window[i] * (array[i] - mean);
+		for (int k = 0; k < bins; k++) {
+			float s0 = x + coefficients[k] * s1[k] - s2[k];
+			s2[k] = s1[k];
+			s1[k] = s0;
+		}
+	}
+
+	// the power of every bin replaces its first state
+	int best = 0;
+	for (int k = 0; k < bins; k++) {
+		s1[k] = s1[k] * s1[k] + s2[k] * s2[k]
+				- coefficients[k] * s1[k] * s2[k];
+		if (s1[k] > s1[best]) {
+			best = k;
+		}
+	}
+	if (best == 0 || best == bins - 1 || !(s1[best] > 0)) {
+		return nanf("");
+	}
+
+	float before = s1[best - 1];
+	float after = s1[best + 1];
+	float delta = 0.5 * (before - after) / (before - 2.0 * s1[best] + after);
+	return 60.0 * (spectrum->low + (best + delta) * spectrum->step);
+}
+
+/**
+ * @brief Creates a new HR_Autocorrelation heart rate estimator.
+ *
+ * @param size      Number of samples in the window.
+ * @param freq      Sampling frequency.
+ * @param rate_low  Lowest heart rate in bpm, its lag is limited to half of the window.
+ * @param rate_high Highest heart rate in bpm.
+ *
+ * @return Pointer to the newly created HR_Autocorrelation structure.
+ *
+ * @note The returned HR_Autocorrelation structure should be freed using the 'HR_autocorrelation_free' function after use.
+ */
+HR_Autocorrelation* HR_autocorrelation_new(int size, float freq,
+		float rate_low, float rate_high) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(HR_AUTOCORRELATION_FOOTPRINT(size)),
+			HR_AUTOCORRELATION_FOOTPRINT(size));
+	return HR_autocorrelation_arenaNew(&arena, size, freq, rate_low,
+			rate_high);
+}
+
+/**
+ * @brief Creates a new HR_Autocorrelation heart rate estimator in an arena.
+ *
+ * The history starts zeroed, so the first estimates treat the missing samples as zeros.
+ *
+ * @param arena     Pointer to the arena with at least HR_AUTOCORRELATION_FOOTPRINT bytes left.
+ * @param size      Number of samples in the window.
+ * @param freq      Sampling frequency.
+ * @param rate_low  Lowest heart rate in bpm, its lag is limited to half of the window.
+ * @param rate_high Highest heart rate in bpm.
+ *
+ * @return Pointer to the newly created HR_Autocorrelation structure or NULL if the arena is too small.
+ */
+HR_Autocorrelation* HR_autocorrelation_arenaNew(HR_Arena *arena, int size,
+		float freq, float rate_low, float rate_high) {
+	if (!HR_arena_fits(arena, HR_AUTOCORRELATION_FOOTPRINT(size))) {
+		return NULL;
+	}
+	HR_Autocorrelation *autocorrelation = (HR_Autocorrelation*) HR_arena_alloc(
+			arena, sizeof(HR_Autocorrelation));
+	int lag_min = (int) (60.0 * freq / rate_high);
+	float period = 60.0 * freq / rate_low;
+	// rounded up without ceilf, the period is positive
+	int lag_max = (int) period + ((float) (int) period < period);
+	if (lag_min < 2) {
+		lag_min = 2;
+	}
+	if (lag_max > size / 2) {
+		lag_max = size / 2;
+	}
+	autocorrelation->size = size;
+	autocorrelation->freq = freq;
+	autocorrelation->lag_min = lag_min;
+	autocorrelation->lag_max = lag_max;
+	autocorrelation->length = size + lag_max + 2;
+	autocorrelation->history = (float*) HR_arena_alloc(arena,
+			autocorrelation->length * sizeof(float));
+	autocorrelation->products = (float*) HR_arena_alloc(arena,
+			(lag_max + 2) * sizeof(float));
+	autocorrelation->sums = (float*) HR_arena_alloc(arena,
+			(lag_max + 2) * sizeof(float));
+	return autocorrelation;
+}
+
+/**
+ * @brief Frees the memory allocated for a HR_Autocorrelation structure.
+ *
+ * @param autocorrelation Pointer to the HR_Autocorrelation structure created by HR_autocorrelation_new.
+ */
+void HR_autocorrelation_free(HR_Autocorrelation *autocorrelation) {
+	free(autocorrelation);
+}
+
+/**
+ * @brief Returns the sample pushed the given number of samples before the newest one.
+ */
+static inline float HR_autocorrelation_sample(
+		HR_Autocorrelation *autocorrelation, int age) {
+	int index = autocorrelation->head - age;
+	if (index < 0) {
+		index += autocorrelation->length;
+	}
+	return autocorrelation->history[index];
+}
+
+/**
+ * @brief Returns the sum of the window ending the given number of samples before the newest one.
+ */
+static inline float HR_autocorrelation_sum(HR_Autocorrelation *autocorrelation,
+		int age) {
+	int index = autocorrelation->sum_head - age;
+	if (index < 0) {
+		index += autocorrelation->lag_max + 2;
+	}
+	return autocorrelation->sums[index];
+}
+
+/**
+ * @brief Recomputes the running sums of a HR_Autocorrelation from its history.
+ */
+static void HR_autocorrelation_recompute(HR_Autocorrelation *autocorrelation) {
+	int size = autocorrelation->size;
+	int lag_last = autocorrelation->lag_max + 1;
+	float sum = 0.0;
+	for (int k = 0; k < size; k++) {
+		sum += HR_autocorrelation_sample(autocorrelation, k);
+	}
+	for (int age = 0; age <= lag_last; age++) {
+		int index = autocorrelation->sum_head - age;
+		if (index < 0) {
+			index += lag_last + 1;
+		}
+		autocorrelation->sums[index] = sum;
+		sum += HR_autocorrelation_sample(autocorrelation, age + size)
+				- HR_autocorrelation_sample(autocorrelation, age);
+	}
+	for (int lag = 0; lag <= lag_last; lag++) {
+		if (lag > 0 && lag < autocorrelation->lag_min - 1) {
+			continue;
+		}
+		float product = 0.0;
+		for (int k = 0; k < size; k++) {
+			product += HR_autocorrelation_sample(autocorrelation, k)
+					* HR_autocorrelation_sample(autocorrelation, k + lag);
+		}
+		autocorrelation->products[lag] = product;
+	}
+}
+
+/**
+ * @brief Adds one sample to a HR_Autocorrelation.
+ *
+ * The product of the new sample with the sample one lag before is added to every lag and
+ * the product of the two samples leaving the window is taken off, so the cost is O(lags).
+ *
+ * @param autocorrelation Pointer to the HR_Autocorrelation structure.
+ * @param value           New sample.
+ */
+void HR_autocorrelation_push(HR_Autocorrelation *autocorrelation, float value) {
+	int size = autocorrelation->size;
+	autocorrelation->head++;
+	if (autocorrelation->head == autocorrelation->length) {
+		autocorrelation->head = 0;
+	}
+	autocorrelation->history[autocorrelation->head] = value;
+	float leaving = HR_autocorrelation_sample(autocorrelation, size);
+
+	float sum = autocorrelation->sums[autocorrelation->sum_head] + value
+			- leaving;
+	autocorrelation->sum_head++;
+	if (autocorrelation->sum_head == autocorrelation->lag_max + 2) {
+		autocorrelation->sum_head = 0;
+	}
+	autocorrelation->sums[autocorrelation->sum_head] = sum;
+
+	autocorrelation->count++;
+	if (autocorrelation->count == size) {
+		autocorrelation->count = 0;
+		HR_autocorrelation_recompute(autocorrelation);
+		return;
+	}
+	autocorrelation->products[0] += value * value - leaving * leaving;
+	for (int lag = autocorrelation->lag_min - 1;
+			lag <= autocorrelation->lag_max + 1; lag++) {
+		autocorrelation->products[lag] += value
+				* HR_autocorrelation_sample(autocorrelation, lag)
+				- leaving
+						* HR_autocorrelation_sample(autocorrelation,
+								size + lag);
+	}
+}
+
+/**
+ * @brief Adds an array of samples to a HR_Autocorrelation.
+ *
+ * @param autocorrelation Pointer to the HR_Autocorrelation structure.
+ * @param array           Pointer to the samples.
+ * @param array_size      Number of samples.
+ */
+void HR_autocorrelation_process(HR_Autocorrelation *autocorrelation,
+		float *array, int array_size) {
+	for (int i = 0; i < array_size; i++) {
+		HR_autocorrelation_push(autocorrelation, array[i]);
+	}
+}
+
+/**
+ * @brief Calculates the heart rate from the strongest period of the current window.
+ *
+ * The autocorrelation of the window with its mean removed is normalized by the variance, the
+ * highest local maximum within the lags of the heart rate band is taken as the beat period and
+ * refined by parabolic interpolation with its neighbours. The cost is O(lags), so it can be
+ * called after every sample.
+ *
+ * @param autocorrelation Pointer to the HR_Autocorrelation structure.
+ * @param confidence      Pointer to store the height of the autocorrelation peak, 1 for a
+ *                        perfectly periodic window, 0 if there is no peak. May be NULL.
+ * @return Heart rate in beats per minute, or NaN if the window is flat or has no peak in the band.
+ */
+float HR_autocorrelation_heartRate(HR_Autocorrelation *autocorrelation,
+		float *confidence) {
+	float size = autocorrelation->size;
+	float sum = HR_autocorrelation_sum(autocorrelation, 0);
+	float variance = autocorrelation->products[0] - sum * sum / size;
+	if (confidence != NULL) {
+		*confidence = 0.0;
+	}
+	if (!(variance > 0)) {
+		return nanf("");
+	}
+
+	int lag = autocorrelation->lag_min - 1;
+	float previous = (autocorrelation->products[lag]
+			- sum * HR_autocorrelation_sum(autocorrelation, lag) / size)
+			/ variance;
+	lag++;
+	float current = (autocorrelation->products[lag]
+			- sum * HR_autocorrelation_sum(autocorrelation, lag) / size)
+			/ variance;
+	int best = 0;
+	float before = 0.0, peak = 0.0, after = 0.0;
+	for (; lag <= autocorrelation->lag_max; lag++) {
+		float next = (autocorrelation->products[lag + 1]
+				- sum * HR_autocorrelation_sum(autocorrelation, lag + 1) / size)
+				/ variance;
+		if (current > previous && current >= next && current > peak) {
+			best = lag;
+			before = previous;
+			peak = current;
+			after = next;
+		}
+		previous = current;
+		current = next;
+	}
+	if (best == 0) {
+		return nanf("");
+	}
+
+	if (confidence != NULL) {
+		*confidence = peak < 1.0 ? peak : 1.0;
+	}
+	float delta = 0.5 * (before - after) / (before - 2.0 * peak + after);
+	return 60.0 * autocorrelation->freq / (best + delta);
+}
+
+/**
+ * @brief Creates a new HR_Tracker heart rate tracker.
+ *
+ * @param capacity  Maximum number of beat intervals of a window, e.g. HR_PEAKS_CAPACITY(size).
+ * @param freq      Sampling frequency.
+ * @param rate_low  Lowest heart rate in bpm of a kept beat interval.
+ * @param rate_high Highest heart rate in bpm of a kept beat interval.
+ *
+ * @return Pointer to the newly created HR_Tracker structure.
+ *
+ * @note The returned HR_Tracker structure should be freed using the 'HR_tracker_free' function after use.
+ */
+HR_Tracker* HR_tracker_new(int capacity, float freq, float rate_low,
+		float rate_high) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(HR_TRACKER_FOOTPRINT(capacity)),
+			HR_TRACKER_FOOTPRINT(capacity));
+	return HR_tracker_arenaNew(&arena, capacity, freq, rate_low, rate_high);
+}
+
+/**
+ * @brief Creates a new HR_Tracker heart rate tracker in an arena.
+ *
+ * @param arena     Pointer to the arena with at least HR_TRACKER_FOOTPRINT bytes left.
+ * @param capacity  Maximum number of beat intervals of a window, e.g. HR_PEAKS_CAPACITY(size).
+ * @param freq      Sampling frequency.
+ * @param rate_low  Lowest heart rate in bpm of a kept beat interval.
+ * @param rate_high Highest heart rate in bpm of a kept beat interval.
+ *
+ * @return Pointer to the newly created HR_Tracker structure or NULL if the arena is too small.
+ */
+HR_Tracker* HR_tracker_arenaNew(HR_Arena *arena, int capacity, float freq,
+		float rate_low, float rate_high) {
+	if (!HR_arena_fits(arena, HR_TRACKER_FOOTPRINT(capacity))) {
+		return NULL;
+	}
+	HR_Tracker *tracker = (HR_Tracker*) HR_arena_alloc(arena,
+			sizeof(HR_Tracker));
+	tracker->freq = freq;
+	tracker->rate_low = rate_low;
+	tracker->rate_high = rate_high;
+	tracker->capacity = capacity;
+	tracker->intervals = (float*) HR_arena_alloc(arena,
+			capacity * sizeof(float));
+	HR_tracker_reset(tracker);
+	return tracker;
+}
+
+/**
+ * @brief Frees the memory allocated for a HR_Tracker structure.
+ *
+ * @param tracker Pointer to the HR_Tracker structure created by HR_tracker_new.
+ */
+void HR_tracker_free(HR_Tracker *tracker) {
+	free(tracker);
+}
+
+/**
+ * @brief Forgets the tracked heart rate, the next measurement starts a new track.
+ *
+ * @param tracker Pointer to the HR_Tracker structure.
+ */
+void HR_tracker_reset(HR_Tracker *tracker) {
+	tracker->count = 0;
+	tracker->rate = nanf("");
+	tracker->variance = 0.0;
+	tracker->outliers = 0;
+}
+
+/**
+ * @brief Updates the tracked heart rate with one measurement.
+ *
+ * The first measurement after HR_tracker_reset is taken as it is. Then the variance grows by
+ * HR_TRACKER_PROCESS per call and a measurement within three standard deviations of the
+ * prediction is weighted against it by the Kalman gain. A NaN measurement only grows the variance.
+ *
+ * @param tracker  Pointer to the HR_Tracker structure.
+ * @param rate     Measured heart rate in bpm or NaN.
+ * @param variance Variance of the measurement in bpm^2.
+ * @return Tracked heart rate in bpm, NaN until the first measurement.
+ */
+float HR_tracker_update(HR_Tracker *tracker, float rate, float variance) {
+	if (isnan(tracker->rate)) {
+		if (!isnan(rate)) {
+			tracker->rate = rate;
+			tracker->variance = variance;
+		}
+		return tracker->rate;
+	}
+	tracker->variance += HR_TRACKER_PROCESS;
+	if (isnan(rate)) {
+		return tracker->rate;
+	}
+
+	float innovation = rate - tracker->rate;
+	float total = tracker->variance + variance;
+	if (innovation * innovation > 9.0 * total) {
+		tracker->outliers++;
+		if (tracker->outliers >= HR_TRACKER_OUTLIERS) {
+			tracker->rate = rate;
+			tracker->variance = variance;
+			tracker->outliers = 0;
+		}
+		return tracker->rate;
+	}
+	tracker->outliers = 0;
+	float gain = tracker->variance / total;
+	tracker->rate += gain * innovation;
+	tracker->variance *= 1.0 - gain;
+	return tracker->rate;
+}
+
+/**
+ * @brief Updates the tracked heart rate with the beat intervals of a window.
+ *
+ * Intervals outside the rate_low to rate_high of the tracker are dropped, as are those more
+ * than HR_TRACKER_GATE away from the median of the rest, which removes missed and double-detected
+ * beats. The mean of the kept intervals that end at or after start is the measurement, so the
+ * intervals of overlapping windows are measured once. Its variance is that of the mean of these
+ * intervals, from the spread of all the kept intervals and at least one sample over their number,
+ * scaled up by the share of dropped ones. The first measurement of a track takes every kept
+ * interval.
+ *
+ * @param tracker    Pointer to the HR_Tracker structure.
+ * @param peaks      Pointer to the array of indexed peaks.
+ * @param peaks_size Size of the array of indexed peaks.
+ * @param start      Index of the window from which the samples are new since the last update.
+ * @return Tracked heart rate in bpm, NaN until the first measurement.
+ */
+float HR_tracker_updatePeaks(HR_Tracker *tracker, int *peaks, int peaks_size,
+		int start) {
+	float variance = 0.0;
+	float rate = HR_tracker_measurePeaks(tracker, peaks, peaks_size, start,
+			&variance);
+	return HR_tracker_update(tracker, rate, variance);
+}
+
+/**
+ * @brief Measures the heart rate and its variance from the beat intervals of a window.
+ *
+ * The measurement of HR_tracker_updatePeaks, without updating the tracked heart rate.
+ *
+ * @param tracker    Pointer to the HR_Tracker structure.
+ * @param peaks      Pointer to the array of indexed peaks.
+ * @param peaks_size Size of the array of indexed peaks.
+ * @param start      Index of the window from which the samples are new since the last update.
+ * @param variance   Pointer to store the variance of the measurement in bpm^2.
+ * @return Measured heart rate in bpm or NaN if no new interval is kept.
+ */
+float HR_tracker_measurePeaks(HR_Tracker *tracker, int *peaks, int peaks_size,
+		int start, float *variance) {
+	float *intervals = tracker->intervals;
+	float interval_min = 60.0 * tracker->freq / tracker->rate_high;
+	float interval_max = 60.0 * tracker->freq / tracker->rate_low;
+	int count = 0;
+	for (int i = 1; i < peaks_size && count < tracker->capacity; i++) {
+		float interval = peaks[i] - peaks[i - 1];
+		if (interval < interval_min || interval > interval_max) {
+			continue;
+		}
+		// insertion sort, a window holds a handful of beats
+		int j = count;
+		while (j > 0 && intervals[j - 1] > interval) {
+			intervals[j] = intervals[j - 1];
+			j--;
+		}
+		intervals[j] = interval;
+		count++;
+	}
+	tracker->count = 0;
+	if (count == 0) {
+		return nanf("");
+	}
+
+	float median = count % 2 ?
+			intervals[count / 2] :
+			0.5 * (intervals[count / 2 - 1] + intervals[count / 2]);
+	float sum = 0.0;
+	float square = 0.0;
+	int kept = 0;
+	for (int i = 0; i < count; i++) {
+		if (fabsf(intervals[i] - median) <= HR_TRACKER_GATE * median) {
+			intervals[kept] = intervals[i];
+			sum += intervals[i];
+			square += intervals[i] * intervals[i];
+			kept++;
+		}
+	}
+	tracker->count = kept;
+	if (kept == 0) {
+		return nanf("");
+	}
+	float mean = sum / kept;
+	float spread = square / kept - mean * mean;
+
+	if (isnan(tracker->rate)) {
+		start = 0;
+	}
+	float fresh_sum = 0.0;
+	int fresh = 0;
+	for (int i = 1; i < peaks_size; i++) {
+		float interval = peaks[i] - peaks[i - 1];
+		if (peaks[i] >= start && interval >= interval_min
+				&& interval <= interval_max
+				&& fabsf(interval - median) <= HR_TRACKER_GATE * median) {
+			fresh_sum += interval;
+			fresh++;
+		}
+	}
+	if (fresh == 0) {
+		return nanf("");
+	}
+
+	mean = fresh_sum / fresh;
+	float rate = 60.0 * tracker->freq / mean;
+	spread /= fresh;
+	float resolution = 1.0 / fresh;
+	if (spread < resolution * resolution) {
+		spread = resolution * resolution;
+	}
+	spread *= (rate / mean) * (rate / mean) * (peaks_size - 1) / kept;
+	*variance = spread;
+	return rate;
+}
+
+/**
+ * @brief Creates a new HR_Variability beat-to-beat interval stage.
+ *
+ * @param size      Number of beat intervals of the HRV measures, e.g. HR_HRV_SIZE.
+ * @param freq      Sampling frequency.
+ * @param rate_low  Lowest heart rate in bpm of a kept beat interval.
+ * @param rate_high Highest heart rate in bpm of a kept beat interval.
+ *
+ * @return Pointer to the newly created HR_Variability structure.
+ *
+ * @note The returned HR_Variability structure should be freed using the 'HR_variability_free' function after use.
+ */
+HR_Variability* HR_variability_new(int size, float freq, float rate_low,
+		float rate_high) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(HR_VARIABILITY_FOOTPRINT(size)),
+			HR_VARIABILITY_FOOTPRINT(size));
+	return HR_variability_arenaNew(&arena, size, freq, rate_low, rate_high);
+}
+
+/**
+ * @brief Creates a new HR_Variability beat-to-beat interval stage in an arena.
+ *
+ * @param arena     Pointer to the arena with at least HR_VARIABILITY_FOOTPRINT bytes left.
+ * @param size      Number of beat intervals of the HRV measures, e.g. HR_HRV_SIZE.
+ * @param freq      Sampling frequency.
+ * @param rate_low  Lowest heart rate in bpm of a kept beat interval.
+ * @param rate_high Highest heart rate in bpm of a kept beat interval.
+ *
+ * @return Pointer to the newly created HR_Variability structure or NULL if the arena is too small.
+ */
+HR_Variability* HR_variability_arenaNew(HR_Arena *arena, int size, float freq,
+		float rate_low, float rate_high) {
+	if (!HR_arena_fits(arena, HR_VARIABILITY_FOOTPRINT(size))) {
+		return NULL;
+	}
+	HR_Variability *variability = (HR_Variability*) HR_arena_alloc(arena,
+			sizeof(HR_Variability));
+	variability->freq = freq;
+	variability->rate_low = rate_low;
+	variability->rate_high = rate_high;
+	variability->size = size;
+	variability->intervals = (float*) HR_arena_alloc(arena,
+			size * sizeof(float));
+	variability->differences = (float*) HR_arena_alloc(arena,
+			size * sizeof(float));
+	HR_variability_reset(variability);
+	return variability;
+}
+
+/**
+ * @brief Frees the memory allocated for a HR_Variability structure.
+ *
+ * @param variability Pointer to the HR_Variability structure created by HR_variability_new.
+ */
+void HR_variability_free(HR_Variability *variability) {
+	free(variability);
+}
+
+/**
+ * @brief Empties the rings and the running sums of a HR_Variability structure.
+ */
+static void HR_variability_clear(HR_Variability *variability) {
+	variability->head = 0;
+	variability->count = 0;
+	variability->sum = 0.0;
+	variability->square = 0.0;
+	variability->difference_square = 0.0;
+	variability->differences_count = 0;
+	variability->nn50 = 0;
+	variability->outliers = 0;
+	variability->candidate = nanf("");
+}
+
+/**
+ * @brief Forgets all beats, the next beat starts a new series of intervals.
+ *
+ * @param variability Pointer to the HR_Variability structure.
+ */
+void HR_variability_reset(HR_Variability *variability) {
+	HR_variability_clear(variability);
+	variability->started = 0;
+	variability->interval = nanf("");
+	variability->time = nanf("");
+}
+
+/**
+ * @brief Adds the interval and the difference in the given slot of the rings to the running sums.
+ *
+ * @param sign 1 to add the slot, -1 to remove it.
+ */
+static void HR_variability_account(HR_Variability *variability, int slot,
+		int sign) {
+	float deviation = variability->intervals[slot] - variability->reference;
+	variability->sum += sign * deviation;
+	variability->square += sign * deviation * deviation;
+	float difference = variability->differences[slot];
+	if (!isnan(difference)) {
+		variability->difference_square += sign * difference * difference;
+		variability->differences_count += sign;
+		variability->nn50 += sign * (fabsf(difference) > HR_HRV_NN50);
+	}
+}
+
+/**
+ * @brief Recomputes the running sums from the full rings around their mean interval.
+ */
+static void HR_variability_recompute(HR_Variability *variability) {
+	float mean = variability->reference
+			+ variability->sum / variability->count;
+	variability->reference = mean;
+	variability->sum = 0.0;
+	variability->square = 0.0;
+	variability->difference_square = 0.0;
+	variability->differences_count = 0;
+	variability->nn50 = 0;
+	for (int i = 0; i < variability->count; i++) {
+		HR_variability_account(variability, i, 1);
+	}
+}
+
+/**
+ * @brief Takes the next beat and adds the interval from the beat before it to the rings.
+ *
+ * The beats must come in order, as given by ATD_next. The interval is counted in whole
+ * samples first, so it keeps the position between samples however long the session runs.
+ * An interval outside the rate_low to rate_high of the stage or further than
+ * HR_HRV_GATE from the mean interval of the ring is dropped: a short one ends at an extra
+ * beat, which is skipped, and a long one misses a beat. After HR_HRV_OUTLIERS dropped
+ * intervals in a row the rings restart, so the stage follows a real change of the rate. An
+ * empty ring starts with two successive intervals within HR_HRV_GATE of each other.
+ *
+ * @param variability Pointer to the HR_Variability structure.
+ * @param index       Sample number of the beat.
+ * @param offset      Position of the beat between samples, -0.5 to 0.5.
+ * @return Interval ending at the beat in ms, or NaN for the first beat and dropped intervals.
+ */
+float HR_variability_beat(HR_Variability *variability, unsigned int index,
+		float offset) {
+	float period = 1000.0 / variability->freq;
+	float interval = ((float) (index - variability->last_index) + offset
+			- variability->last_offset) * period;
+	if (!variability->started) {
+		variability->started = 1;
+		variability->last_index = index;
+		variability->last_offset = offset;
+		return nanf("");
+	}
+
+	float low = 60000.0 / variability->rate_high;
+	float high = 60000.0 / variability->rate_low;
+	if (variability->count == 0 && interval >= low && interval <= high) {
+		// the first interval of the ring must agree with the one before it
+		float candidate = variability->candidate;
+		variability->candidate = interval;
+		if (isnan(candidate)
+				|| fabsf(interval - candidate) > HR_HRV_GATE * candidate) {
+			variability->last_index = index;
+			variability->last_offset = offset;
+			variability->interval = nanf("");
+			return nanf("");
+		}
+	} else if (variability->count > 0) {
+		float mean = variability->reference
+				+ variability->sum / variability->count;
+		if (low < (1.0 - HR_HRV_GATE) * mean) {
+			low = (1.0 - HR_HRV_GATE) * mean;
+		}
+		if (high > (1.0 + HR_HRV_GATE) * mean) {
+			high = (1.0 + HR_HRV_GATE) * mean;
+		}
+	}
+	if (interval < low || interval > high) {
+		// a short interval ends at an extra beat, which is skipped, a long one misses a beat
+		if (interval > high) {
+			variability->last_index = index;
+			variability->last_offset = offset;
+		}
+		variability->interval = nanf("");
+		variability->outliers++;
+		if (variability->outliers >= HR_HRV_OUTLIERS) {
+			HR_variability_clear(variability);
+		}
+		return nanf("");
+	}
+	variability->last_index = index;
+	variability->last_offset = offset;
+	variability->outliers = 0;
+
+	int slot = variability->head;
+	if (variability->count == variability->size) {
+		HR_variability_account(variability, slot, -1);
+	} else {
+		if (variability->count == 0) {
+			variability->reference = interval;
+		}
+		variability->count++;
+	}
+	variability->intervals[slot] = interval;
+	variability->differences[slot] = interval - variability->interval;
+	HR_variability_account(variability, slot, 1);
+	variability->head++;
+	if (variability->head == variability->size) {
+		variability->head = 0;
+		HR_variability_recompute(variability);
+	}
+	variability->interval = interval;
+	variability->time = ((float) index + offset) * period;
+	return interval;
+}
+
+/**
+ * @brief Square root by Newton's method, so that the firmware links no sqrtf.
+ *
+ * The first guess halves the exponent of the IEEE 754 representation, which is within 6 %,
+ * and each of the three Newton steps squares the relative error.
+ *
+ * @param value Value, 0 is returned for values that are not positive.
+ * @return Square root of the value.
+ */
+static float HR_sqrt(float value) {
+	if (!(value > 0)) {
+		return 0.0;
+	}
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	bits = (bits >> 1) + 0x1FC00000;
+	float root;
+	memcpy(&root, &bits, sizeof(root));
+	for (int i = 0; i < 3; i++) {
+		root = 0.5 * (root + value / root);
+	}
+	return root;
+}
+
+/**
+ * @brief Returns the root mean square of the successive interval differences of the ring.
+ *
+ * @param variability Pointer to the HR_Variability structure.
+ * @return RMSSD in ms or NaN without successive intervals.
+ */
+float HR_variability_rmssd(HR_Variability *variability) {
+	if (variability->differences_count == 0) {
+		return nanf("");
+	}
+	return HR_sqrt(
+			variability->difference_square / variability->differences_count);
+}
+
+/**
+ * @brief Returns the standard deviation of the intervals of the ring.
+ *
+ * @param variability Pointer to the HR_Variability structure.
+ * @return SDNN in ms or NaN with less than two intervals.
+ */
+float HR_variability_sdnn(HR_Variability *variability) {
+	if (variability->count < 2) {
+		return nanf("");
+	}
+	float variance = (variability->square
+			- variability->sum * variability->sum / variability->count)
+			/ (variability->count - 1);
+	return HR_sqrt(variance);
+}
+
+/**
+ * @brief Returns the share of successive interval differences larger than HR_HRV_NN50.
+ *
+ * @param variability Pointer to the HR_Variability structure.
+ * @return pNN50 in percent or NaN without successive intervals.
+ */
+float HR_variability_pnn50(HR_Variability *variability) {
+	if (variability->differences_count == 0) {
+		return nanf("");
+	}
+	return 100.0 * variability->nn50 / variability->differences_count;
+}
+
+/**
+ * @brief Creates a new HR_Respiration respiration rate estimator.
+ *
+ * @param capacity Number of breath intervals kept per feature, e.g. HR_RESP_BREATHS.
+ * @param freq     Sampling frequency of the resampled features, e.g. HR_RESP_FREQ.
+ *
+ * @return Pointer to the newly created HR_Respiration structure or NULL if there is no
+ * BPF_tables entry for the breathing band-pass filter.
+ *
+ * @note The returned HR_Respiration structure should be freed using the 'HR_respiration_free' function after use.
+ */
+HR_Respiration* HR_respiration_new(int capacity, float freq) {
+	HR_Arena arena;
+	void *memory = malloc(HR_RESPIRATION_FOOTPRINT(capacity));
+	HR_arena_init(&arena, memory, HR_RESPIRATION_FOOTPRINT(capacity));
+	HR_Respiration *respiration = HR_respiration_arenaNew(&arena, capacity,
+			freq);
+	if (respiration == NULL) {
+		free(memory);
+	}
+	return respiration;
+}
+
+/**
+ * @brief Creates a new HR_Respiration respiration rate estimator in an arena.
+ *
+ * @param arena    Pointer to the arena with at least HR_RESPIRATION_FOOTPRINT bytes left.
+ * @param capacity Number of breath intervals kept per feature, e.g. HR_RESP_BREATHS.
+ * @param freq     Sampling frequency of the resampled features, e.g. HR_RESP_FREQ.
+ *
+ * @return Pointer to the newly created HR_Respiration structure or NULL if the arena is too
+ * small or there is no BPF_tables entry for the breathing band-pass filter.
+ */
+HR_Respiration* HR_respiration_arenaNew(HR_Arena *arena, int capacity,
+		float freq) {
+	if (!HR_arena_fits(arena, HR_RESPIRATION_FOOTPRINT(capacity))) {
+		return NULL;
+	}
+	HR_Respiration *respiration = (HR_Respiration*) HR_arena_alloc(arena,
+			sizeof(HR_Respiration));
+	respiration->freq = freq;
+	respiration->capacity = capacity;
+	for (int feature = 0; feature < HR_RESP_FEATURES; feature++) {
+		respiration->bpf[feature] = BPF_arenaNew(arena, HR_RESP_BPF_ORDER, freq,
+				HR_RESP_BPF_LOW, HR_RESP_BPF_HIGH);
+		if (respiration->bpf[feature] == NULL) {
+			return NULL;
+		}
+	}
+	respiration->intervals = (float*) HR_arena_alloc(arena,
+			HR_RESP_FEATURES * capacity * sizeof(float));
+	respiration->sorted = (float*) HR_arena_alloc(arena,
+			capacity * sizeof(float));
+	HR_respiration_reset(respiration);
+	return respiration;
+}
+
+/**
+ * @brief Frees the memory allocated for a HR_Respiration structure.
+ *
+ * @param respiration Pointer to the HR_Respiration structure created by HR_respiration_new.
+ */
+void HR_respiration_free(HR_Respiration *respiration) {
+	free(respiration);
+}
+
+/**
+ * @brief Forgets all beats and breaths, the next beat starts new series.
+ *
+ * @param respiration Pointer to the HR_Respiration structure.
+ */
+void HR_respiration_reset(HR_Respiration *respiration) {
+	respiration->previous_time = nanf("");
+	for (int feature = 0; feature < HR_RESP_FEATURES; feature++) {
+		BPF_filter *bpf = respiration->bpf[feature];
+		for (int i = 0; i < bpf->n; i++) {
+			bpf->sections[i].s1 = 0.0;
+			bpf->sections[i].s2 = 0.0;
+		}
+		respiration->mean[feature] = nanf("");
+		respiration->level[feature] = 0.0;
+		respiration->below[feature] = 0;
+		respiration->breath[feature] = nanf("");
+		respiration->head[feature] = 0;
+		respiration->count[feature] = 0;
+	}
+}
+
+/**
+ * @brief Filters the next sample of the resampled series of a feature and detects breaths in it.
+ */
+static void HR_respiration_sample(HR_Respiration *respiration, int feature,
+		float value, float time) {
+	float *mean = &respiration->mean[feature];
+	*mean = isnan(*mean) ?
+			value : *mean + (value - *mean) / (HR_RESP_LEVEL * respiration->freq);
+	// without the mean the filter starts from the feature, not from a step up to it
+	value -= *mean;
+	BPF_process(respiration->bpf[feature], &value, 1);
+	float *level = &respiration->level[feature];
+	*level += (fabsf(value) - *level) / (HR_RESP_LEVEL * respiration->freq);
+	float threshold = HR_RESP_HYSTERESIS * *level;
+	if (value < -threshold) {
+		respiration->below[feature] = 1;
+		return;
+	}
+	if (value <= threshold || !respiration->below[feature]) {
+		return;
+	}
+	respiration->below[feature] = 0;
+	float interval = time - respiration->breath[feature];
+	respiration->breath[feature] = time;
+	if (interval >= 1.0 / HR_RESP_BPF_HIGH && interval <= 1.0 / HR_RESP_BPF_LOW) {
+		int capacity = respiration->capacity;
+		respiration->intervals[feature * capacity + respiration->head[feature]] =
+				interval;
+		respiration->head[feature] = (respiration->head[feature] + 1) % capacity;
+		if (respiration->count[feature] < capacity) {
+			respiration->count[feature]++;
+		}
+	}
+}
+
+/**
+ * @brief Takes the features of the next beat.
+ *
+ * The series of every feature is interpolated linearly from the previous beat to this one
+ * at the sampling frequency of the estimator, so the filters run at a fixed rate whatever
+ * the heart rate. The beats must come in order.
+ *
+ * @param respiration Pointer to the HR_Respiration structure.
+ * @param time        Time of the beat in s.
+ * @param features    Pointer to the HR_RESP_FEATURES features of the beat.
+ */
+void HR_respiration_beat(HR_Respiration *respiration, float time,
+		float *features) {
+	float previous_time = respiration->previous_time;
+	if (isnan(previous_time)) {
+		respiration->next = time;
+		previous_time = time;
+	}
+	float period = 1.0 / respiration->freq;
+	for (; respiration->next <= time; respiration->next += period) {
+		float weight =
+				time > previous_time ?
+						(respiration->next - previous_time)
+								/ (time - previous_time) :
+						1.0;
+		for (int feature = 0; feature < HR_RESP_FEATURES; feature++) {
+			float value = respiration->previous[feature]
+					+ weight
+							* (features[feature]
+									- respiration->previous[feature]);
+			HR_respiration_sample(respiration, feature, value,
+					respiration->next);
+		}
+	}
+	respiration->previous_time = time;
+	for (int feature = 0; feature < HR_RESP_FEATURES; feature++) {
+		respiration->previous[feature] = features[feature];
+	}
+}
+
+/**
+ * @brief Returns the respiration rate of one feature.
+ *
+ * @param respiration Pointer to the HR_Respiration structure.
+ * @param feature     Feature, HR_RESP_AMPLITUDE, HR_RESP_BASELINE or HR_RESP_INTERVAL.
+ * @return Median rate of the last breath intervals in breaths/min, or NaN with less than
+ *         HR_RESP_MIN_BREATHS intervals, no breath for the longest interval of the band or
+ *         a modulation depth below HR_RESP_DEPTH.
+ */
+float HR_respiration_featureRate(HR_Respiration *respiration, int feature) {
+	int count = respiration->count[feature];
+	if (count < HR_RESP_MIN_BREATHS
+			|| respiration->previous_time - respiration->breath[feature]
+					> 1.0 / HR_RESP_BPF_LOW) {
+		return nanf("");
+	}
+	// the baseline moves by a part of the pulse, not of the light level
+	float scale = respiration->mean[
+			feature == HR_RESP_INTERVAL ? HR_RESP_INTERVAL : HR_RESP_AMPLITUDE];
+	if (!(respiration->level[feature] >= HR_RESP_DEPTH * fabsf(scale))) {
+		return nanf("");
+	}
+	// insertion sort into the scratch array, the ring holds a few intervals
+	float *sorted = respiration->sorted;
+	float *intervals = respiration->intervals + feature * respiration->capacity;
+	for (int i = 0; i < count; i++) {
+		int j = i;
+		for (; j > 0 && sorted[j - 1] > intervals[i]; j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = intervals[i];
+	}
+	float median =
+			count % 2 ?
+					sorted[count / 2] :
+					0.5 * (sorted[count / 2 - 1] + sorted[count / 2]);
+	return 60.0 / median;
+}
+
+/**
+ * @brief Returns the respiration rate fused from the features.
+ *
+ * The rates of the features are sorted and the largest group of them that spreads at most
+ * HR_RESP_AGREE is averaged, the closest pair when no group of three agrees. A feature that
+ * breathing barely modulates, often the beat interval of elderly people, is outvoted or, below
+ * HR_RESP_DEPTH, left out, so without breathing modulation there is no rate.
+ *
+ * @param respiration Pointer to the HR_Respiration structure.
+ * @return Rate in breaths/min, or NaN if no two modulated features agree.
+ */
+float HR_respiration_rate(HR_Respiration *respiration) {
+	float rates[HR_RESP_FEATURES];
+	int count = 0;
+	for (int feature = 0; feature < HR_RESP_FEATURES; feature++) {
+		float rate = HR_respiration_featureRate(respiration, feature);
+		if (isnan(rate)) {
+			continue;
+		}
+		int i = count++;
+		for (; i > 0 && rates[i - 1] > rate; i--) {
+			rates[i] = rates[i - 1];
+		}
+		rates[i] = rate;
+	}
+	if (count < 2) {
+		return nanf("");
+	}
+	if (rates[count - 1] - rates[0] <= HR_RESP_AGREE) {
+		float sum = 0.0;
+		for (int i = 0; i < count; i++) {
+			sum += rates[i];
+		}
+		return sum / count;
+	}
+	// closest pair of neighbours
+	int best = 0;
+	for (int i = 1; i < count - 1; i++) {
+		if (rates[i + 1] - rates[i] < rates[best + 1] - rates[best]) {
+			best = i;
+		}
+	}
+	if (rates[best + 1] - rates[best] > HR_RESP_AGREE) {
+		return nanf("");
+	}
+	return 0.5 * (rates[best] + rates[best + 1]);
+}
+
+/**
+ * @brief Calculates the heart rate from the indexed peaks in the HR_HeartMonitor structure.
+ *
+ * This function calculates the heart rate from the indexed peaks in the HR_HeartMonitor structure.
+ * It iterates through the indexed peaks, calculates the average peak-to-peak distance, and returns
+ * the heart rate based on the average distance and the sampling frequency.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @param peaks        Pointer to the array of indexed peaks.
+ * @param peaks_size   Size of the array of indexed peaks.
+ * @return Heart rate calculated from the indexed peaks.
+ */
+float HR_heartMonitor_heartRateFromIndexedPeaks(HR_HeartMonitor *heartMonitor,
+		int *peaks, int peaks_size) {
+	int pointer = 0;
+	int count = 0;
+	float sum = 0.0f;
+	while (pointer < peaks_size - 1) {
+		sum += (peaks[pointer + 1] - peaks[pointer]);
+		count++;
+		pointer++;
+	}
+
+	if (count == 0) {
+		return nanf("");
+	} else {
+		return 60.0f / ((sum / count) / heartMonitor->freq);
+	}
+}
+
+#ifndef HR_FIXED_POINT
+// With HR_FIXED_POINT HRQ_ratioFromIndexedPeaks scans the Q8.23 windows instead
+
+/**
+ * @brief Extrema of one channel found while scanning the beats of a window.
+ *
+ * Within the current beat, @c min is the first minimum so far, @c before the
+ * first maximum in front of it and @c after the first maximum from it on. The
+ * maximum between the minima of two consecutive beats is then the greater of
+ * @c after of the previous beat and @c before of the next one, so minima and
+ * maxima come out of a single pass.
+ */
+typedef struct {
+	int min; /**< Index of the minimum of the current beat */
+	int before; /**< Index of the maximum before the minimum or -1 */
+	int after; /**< Index of the maximum from the minimum on */
+	int previous_min; /**< Index of the minimum of the previous beat */
+	int previous_after; /**< Index of the maximum after the minimum of the previous beat */
+	float AC; /**< Sum of the AC components */
+	float DC; /**< Sum of the DC components */
+} HR_BeatScan;
+
+static inline void HR_beatScan_start(HR_BeatScan *scan, int start) {
+	scan->min = start;
+	scan->before = -1;
+	scan->after = start;
+}
+
+static inline void HR_beatScan_step(HR_BeatScan *scan, float *array, int i) {
+	if (array[i] < array[scan->min]) {
+		if (scan->before < 0 || array[scan->after] > array[scan->before]) {
+			scan->before = scan->after;
+		}
+		scan->min = i;
+		scan->after = i;
+	} else if (array[i] > array[scan->after]) {
+		scan->after = i;
+	}
+}
+
+static inline void HR_beatScan_end(HR_BeatScan *scan, float *array, int beat) {
+	if (beat > 0) {
+		int max = scan->previous_after;
+		if (scan->before >= 0 && array[scan->before] > array[max]) {
+			max = scan->before;
+		}
+		float DC_now = (array[scan->previous_min] + array[scan->min]) / 2;
+		scan->AC += array[max] - DC_now;
+		scan->DC += DC_now;
+	}
+	scan->previous_min = scan->min;
+	scan->previous_after = scan->after;
+}
+
+/**
+ * @brief Calculates the ratio and the perfusion index from windows and indexed peaks.
+ *
+ * The minimum of each beat and the maximum between two consecutive minima are
+ * searched in both channels during the same single pass over the samples from
+ * the first to the last peak.
+ *
+ * @param red        Pointer to the red channel window.
+ * @param ir         Pointer to the infrared channel window.
+ * @param peaks      Pointer to the array of indexed peaks.
+ * @param peaks_size Size of the array of indexed peaks.
+ * @param perfusion  Pointer to store the perfusion index in percent or NULL.
+ * @return Ratio calculated from the indexed peaks or NaN.
+ */
+static float HR_ratioFromIndexedPeaks(float *red, float *ir, int *peaks,
+		int peaks_size, float *perfusion) {
+	if (perfusion != NULL) {
+		*perfusion = nanf("");
+	}
+	if (peaks_size < 3) {
+		return nanf("");
+	}
+	HR_BeatScan scan_red = { .AC = 0.0, .DC = 0.0 };
+	HR_BeatScan scan_ir = { .AC = 0.0, .DC = 0.0 };
+	for (int beat = 0; beat < peaks_size - 1; beat++) {
+		HR_beatScan_start(&scan_red, peaks[beat]);
+		HR_beatScan_start(&scan_ir, peaks[beat]);
+		for (int i = peaks[beat] + 1; i < peaks[beat + 1]; i++) {
+			HR_beatScan_step(&scan_red, red, i);
+			HR_beatScan_step(&scan_ir, ir, i);
+		}
+		HR_beatScan_end(&scan_red, red, beat);
+		HR_beatScan_end(&scan_ir, ir, beat);
+	}
+
+	int count = peaks_size - 2;
+	float AC_red = scan_red.AC / count;
+	float DC_red = scan_red.DC / count;
+	float AC_ir = scan_ir.AC / count;
+	float DC_ir = scan_ir.DC / count;
+
+	if (perfusion != NULL) {
+		*perfusion = 100.0 * AC_ir / DC_ir;
+	}
+	return (AC_red / DC_red) / (AC_ir / DC_ir);
+}
+#endif
+
+/**
+ * @brief Calculates the ratio from the indexed peaks in the HR_HeartMonitor structure.
+ *
+ * This function calculates the ratio from the indexed peaks in the HR_HeartMonitor structure.
+ * It calculates the AC (alternating current) and DC (direct current) components for the red and IR signals,
+ * based on the minimum and maximum values within the specified peaks. It then calculates the ratio
+ * between the AC and DC components of the red and IR signals and returns the result.
+ * With HR_FIXED_POINT the calculation is done by HRQ_ratioFromIndexedPeaks.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @param peaks        Pointer to the array of indexed peaks.
+ * @param peaks_size   Size of the array of indexed peaks.
+ * @return Ratio calculated from the indexed peaks.
+ */
+float HR_heartMonitor_ratioFromIndexedPeaks(HR_HeartMonitor *heartMonitor,
+		int *peaks, int peaks_size) {
+	if (peaks_size > HR_PEAKS_CAPACITY(heartMonitor->size)) {
+		return nanf("");
+	}
+#ifdef HR_FIXED_POINT
+	return HRQ_ratioFromIndexedPeaks(HRQ_ring_window(heartMonitor->red),
+			HRQ_ring_window(heartMonitor->ir), peaks, peaks_size, NULL);
+#else
+	return HR_ratioFromIndexedPeaks(HR_ring_window(heartMonitor->red),
+			HR_ring_window(heartMonitor->ir), peaks, peaks_size, NULL);
+#endif
+}
+
+/**
+ * @brief Calculates the ratio from the peaks in the HR_HeartMonitor structure.
+ *
+ * This function calculates the ratio from the peaks in the HR_HeartMonitor structure.
+ * It first indexes the peaks into the scratch array of the structure. Then, it calls
+ * the HR_heartMonitor_ratioFromIndexedPeaks function to calculate the ratio based on
+ * the indexed peaks and returns the calculated ratio.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @return Ratio calculated from the peaks.
+ */
+float HR_heartMonitor_ratioFromPeaks(HR_HeartMonitor *heartMonitor) {
+	int peaks_size = HR_heartMonitor_indexPeaks(heartMonitor);
+	return HR_heartMonitor_ratioFromIndexedPeaks(heartMonitor,
+			heartMonitor->indexed, peaks_size);
+}
+
+/**
+ * @brief Calculates the heart rate, ratio and perfusion index from the HR_HeartMonitor structure.
+ *
+ * This function indexes the detected peaks once and calculates all the measurements of the
+ * current window from them. The red and infrared windows are scanned together in a single pass.
+ * With HR_ENGINE_SPECTRUM or HR_ENGINE_AUTOCORRELATION the heart rate comes from the green
+ * channel spectrum or autocorrelation instead. With HR_ENGINE_PEAKS and a HR_Fusion that blends
+ * both channels, the heart rate is the mean of their rates weighted by their scores.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @param result Pointer to the HR_Result structure to fill.
+ *
+ * @see HR_heartMonitor_heartRateFromIndexedPeaks
+ * @see HR_heartMonitor_ratioFromIndexedPeaks
+ */
+void HR_heartMonitor_heartRateAndRatio(HR_HeartMonitor *heartMonitor,
+		HR_Result *result) {
+	int peaks_size = HR_heartMonitor_indexPeaks(heartMonitor);
+	result->confidence = nanf("");
+	if (heartMonitor->engine == HR_ENGINE_SPECTRUM) {
+		result->rate = HR_spectrum_heartRate(heartMonitor->spectrum,
+				HR_ring_window(heartMonitor->green));
+	} else if (heartMonitor->engine == HR_ENGINE_AUTOCORRELATION) {
+		result->rate = HR_autocorrelation_heartRate(
+				heartMonitor->autocorrelation, &result->confidence);
+	} else if (heartMonitor->fusion != NULL && heartMonitor->fusion->blend) {
+		HR_Fusion *fusion = heartMonitor->fusion;
+		float green = fusion->score[HR_FUSION_GREEN];
+		float ir = fusion->score[HR_FUSION_IR];
+		result->rate = (green * fusion->rate[HR_FUSION_GREEN]
+				+ ir * fusion->rate[HR_FUSION_IR]) / (green + ir);
+	} else {
+		result->rate = HR_heartMonitor_heartRateFromIndexedPeaks(heartMonitor,
+				heartMonitor->indexed, peaks_size);
+	}
+#ifdef HR_FIXED_POINT
+	result->ratio = HRQ_ratioFromIndexedPeaks(
+			HRQ_ring_window(heartMonitor->red),
+			HRQ_ring_window(heartMonitor->ir), heartMonitor->indexed,
+			peaks_size, &result->perfusion);
+#else
+	result->ratio = HR_ratioFromIndexedPeaks(HR_ring_window(heartMonitor->red),
+			HR_ring_window(heartMonitor->ir), heartMonitor->indexed,
+			peaks_size, &result->perfusion);
+#endif
+	result->valid = !isnan(result->rate) && isfinite(result->ratio)
+			&& isfinite(result->perfusion);
+}
+
+/**
+ * @brief Maps a measure to a quality score from 0 to 1, NaN gives 0.
+ */
+static float HR_score(float score) {
+	if (!(score > 0)) {
+		return 0.0;
+	}
+	return score < 1.0 ? score : 1.0;
+}
+
+/**
+ * @brief Measures the spread of the beat intervals and the shape of the beats of a window.
+ *
+ * The average beat is built in the scratch array from segments of the shortest interval
+ * centered on the peaks, and every beat is correlated with it. The square roots are taken with
+ * HR_sqrt.
+ *
+ * @param window      Pointer to the preprocessed window of the channel.
+ * @param size        Size of the window.
+ * @param peaks       Pointer to the array of indexed peaks, at least 3.
+ * @param peaks_size  Size of the array of indexed peaks.
+ * @param beat        Pointer to the scratch array of size floats.
+ * @param interval_cv Pointer to store the coefficient of variation of the beat intervals.
+ * @param correlation Pointer to store the mean correlation of the beats with the average beat.
+ */
+static void HR_beatShape(float *window, int size, int *peaks, int peaks_size,
+		float *beat, float *interval_cv, float *correlation) {
+	float mean = 0.0;
+	float square = 0.0;
+	int shortest = size;
+	for (int i = 1; i < peaks_size; i++) {
+		int interval = peaks[i] - peaks[i - 1];
+		mean += interval;
+		square += interval * interval;
+		if (interval < shortest) {
+			shortest = interval;
+		}
+	}
+	mean /= peaks_size - 1;
+	float variance = square / (peaks_size - 1) - mean * mean;
+	*interval_cv = variance > 0 ? HR_sqrt(variance) / mean : 0.0;
+	*correlation = 0.0;
+
+	int half = shortest / 2;
+	int length = 2 * half;
+	int beats = 0;
+	memset(beat, 0, length * sizeof(float));
+	for (int i = 0; i < peaks_size; i++) {
+		int start = peaks[i] - half;
+		if (start < 0 || start + length > size) {
+			continue;
+		}
+		for (int j = 0; j < length; j++) {
+			beat[j] += window[start + j];
+		}
+		beats++;
+	}
+	if (beats < 2) {
+		return;
+	}
+	float beat_mean = 0.0;
+	for (int j = 0; j < length; j++) {
+		beat[j] /= beats;
+		beat_mean += beat[j];
+	}
+	beat_mean /= length;
+	float beat_energy = 0.0;
+	for (int j = 0; j < length; j++) {
+		beat[j] -= beat_mean;
+		beat_energy += beat[j] * beat[j];
+	}
+	float sum = 0.0;
+	for (int i = 0; i < peaks_size; i++) {
+		int start = peaks[i] - half;
+		if (start < 0 || start + length > size) {
+			continue;
+		}
+		float segment_mean = 0.0;
+		for (int j = 0; j < length; j++) {
+			segment_mean += window[start + j];
+		}
+		segment_mean /= length;
+		float product = 0.0;
+		float energy = 0.0;
+		for (int j = 0; j < length; j++) {
+			float value = window[start + j] - segment_mean;
+			product += value * beat[j];
+			energy += value * value;
+		}
+		if (energy > 0 && beat_energy > 0) {
+			sum += product / HR_sqrt(energy * beat_energy);
+		}
+	}
+	*correlation = sum / beats;
+}
+
+/**
+ * @brief Scores the beats of a channel, the lower of the interval and the correlation score.
+ */
+static float HR_beatScore(float interval_cv, float correlation) {
+	float index = HR_score(1.0 - interval_cv / HR_SQI_INTERVAL_CV);
+	float score = HR_score(correlation);
+	return score < index ? score : index;
+}
+
+/**
+ * @brief Returns the preprocessed window of the channel whose peaks the monitor uses.
+ */
+static float* HR_heartMonitor_window(HR_HeartMonitor *heartMonitor) {
+	if (heartMonitor->fusion != NULL
+			&& heartMonitor->fusion->channel == HR_FUSION_IR) {
+		return HR_ring_window(heartMonitor->fusion->pulse);
+	}
+	return HR_ring_window(heartMonitor->green);
+}
+
+/**
+ * @brief Calculates the signal quality index of the current window.
+ *
+ * This function rates the window from data the monitor already has: the spread of the beat
+ * intervals of the detected peaks, the correlation of every beat of the green channel with the
+ * average beat, the perfusion index of the result and the accelerometer energy of the last
+ * HR_heartMonitor_addInterleaved call. The average beat is built in the scratch array of the
+ * monitor from segments of the shortest interval centered on the peaks. With a HR_Fusion the
+ * beats are those of the channel picked by HR_heartMonitor_peaksFromChannels. The peaks are
+ * those HR_heartMonitor_heartRateAndRatio indexed for the result.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @param result       Pointer to the HR_Result of the window from HR_heartMonitor_heartRateAndRatio.
+ * @param quality      Pointer to the HR_Quality structure to fill.
+ */
+void HR_heartMonitor_quality(HR_HeartMonitor *heartMonitor,
+		HR_Result *result, HR_Quality *quality) {
+	int peaks_size = heartMonitor->indexed_size;
+	quality->interval_cv = nanf("");
+	quality->correlation = 0.0;
+	quality->perfusion = result->perfusion;
+	quality->motion = heartMonitor->motion;
+	quality->index = 0.0;
+	if (peaks_size < 3) {
+		return;
+	}
+	HR_beatShape(HR_heartMonitor_window(heartMonitor), heartMonitor->size,
+			heartMonitor->indexed, peaks_size, heartMonitor->beat,
+			&quality->interval_cv, &quality->correlation);
+
+	float index = HR_beatScore(quality->interval_cv, quality->correlation);
+	float score = HR_score(quality->perfusion / HR_SQI_PERFUSION);
+	if (score < index) {
+		index = score;
+	}
+	score = HR_score(1.0 - quality->motion / HR_SQI_MOTION);
+	if (score < index) {
+		index = score;
+	}
+	quality->index = index;
+}
+
+/**
+ * @brief Detects the peaks of the current window on the better of the green and infrared channels.
+ *
+ * Without a HR_Fusion this is HR_heartMonitor_peaksFromGreen. With one, the peaks of both
+ * channels are indexed and every channel with at least 3 peaks is scored by the regularity of
+ * its beat intervals and the correlation of its beats with their average beat, the measures of
+ * HR_heartMonitor_quality that differ between the channels. The peaks array of the monitor gets
+ * the peaks of the better channel, green on a tie, so the ratio, the quality and the tracker
+ * use them. When both channels score at least HR_FUSION_BLEND and their heart rates differ by
+ * at most HR_FUSION_AGREE bpm, HR_heartMonitor_heartRateAndRatio and HR_heartMonitor_track
+ * blend the rates of both.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ */
+void HR_heartMonitor_peaksFromChannels(HR_HeartMonitor *heartMonitor) {
+	HR_Fusion *fusion = heartMonitor->fusion;
+	if (fusion == NULL) {
+		HR_heartMonitor_peaksFromGreen(heartMonitor);
+		return;
+	}
+	ATD_detector *detectors[HR_FUSION_CHANNELS];
+	float *windows[HR_FUSION_CHANNELS];
+	detectors[HR_FUSION_GREEN] = heartMonitor->detector;
+	detectors[HR_FUSION_IR] = fusion->detector;
+	windows[HR_FUSION_GREEN] = HR_ring_window(heartMonitor->green);
+	windows[HR_FUSION_IR] = HR_ring_window(fusion->pulse);
+	for (int channel = 0; channel < HR_FUSION_CHANNELS; channel++) {
+		ATD_peaks(detectors[channel], heartMonitor->peaks);
+		int peaks_size = HR_heartMonitor_indexPeaks(heartMonitor);
+		memcpy(fusion->indexed[channel], heartMonitor->indexed,
+				peaks_size * sizeof(int));
+		fusion->indexed_size[channel] = peaks_size;
+		fusion->rate[channel] = HR_heartMonitor_heartRateFromIndexedPeaks(
+				heartMonitor, heartMonitor->indexed, peaks_size);
+		fusion->score[channel] = 0.0;
+		if (peaks_size >= 3) {
+			float interval_cv;
+			float correlation;
+			HR_beatShape(windows[channel], heartMonitor->size,
+					heartMonitor->indexed, peaks_size, heartMonitor->beat,
+					&interval_cv, &correlation);
+			fusion->score[channel] = HR_beatScore(interval_cv, correlation);
+		}
+	}
+	fusion->channel =
+			fusion->score[HR_FUSION_IR] > fusion->score[HR_FUSION_GREEN] ?
+					HR_FUSION_IR : HR_FUSION_GREEN;
+	fusion->blend = fusion->score[HR_FUSION_GREEN] >= HR_FUSION_BLEND
+			&& fusion->score[HR_FUSION_IR] >= HR_FUSION_BLEND
+			&& fabsf(fusion->rate[HR_FUSION_GREEN] - fusion->rate[HR_FUSION_IR])
+					<= HR_FUSION_AGREE;
+	// the peaks array still holds the last channel
+	if (fusion->channel != HR_FUSION_CHANNELS - 1) {
+		ATD_peaks(detectors[fusion->channel], heartMonitor->peaks);
+	}
+}
+
+/**
+ * @brief Updates the heart rate tracker of the HR_HeartMonitor structure with the current window.
+ *
+ * With HR_ENGINE_PEAKS the tracker gets the beat intervals of the detected peaks, so missed and
+ * double-detected beats are dropped before they reach the estimate. Only the intervals that end
+ * in the samples added since the previous call are measured, so overlapping windows do not feed
+ * an interval twice. The other engines give one rate with the variance HR_TRACKER_NOISE, divided
+ * by the squared confidence with HR_ENGINE_AUTOCORRELATION. HR_tracker_reset(heartMonitor->tracker)
+ * starts a new track.
+ * When a HR_Fusion blends both channels, the measurements of their beat intervals are
+ * weighted by their inverse variances into one. The peaks are those
+ * HR_heartMonitor_heartRateAndRatio indexed for the result.
+ *
+ * @param heartMonitor Pointer to the HR_HeartMonitor structure.
+ * @param result       Pointer to the HR_Result of the window from HR_heartMonitor_heartRateAndRatio.
+ * @return Tracked heart rate in bpm, NaN until the first measurement.
+ */
+float HR_heartMonitor_track(HR_HeartMonitor *heartMonitor, HR_Result *result) {
+	unsigned int samples = heartMonitor->detector->count - heartMonitor->tracked;
+	heartMonitor->tracked = heartMonitor->detector->count;
+	int start = samples < (unsigned int) heartMonitor->size ?
+			heartMonitor->size - (int) samples : 0;
+	if (heartMonitor->engine == HR_ENGINE_PEAKS && heartMonitor->fusion != NULL
+			&& heartMonitor->fusion->blend) {
+		HR_Fusion *fusion = heartMonitor->fusion;
+		float weight = 0.0;
+		float sum = 0.0;
+		for (int channel = 0; channel < HR_FUSION_CHANNELS; channel++) {
+			float variance;
+			float rate = HR_tracker_measurePeaks(heartMonitor->tracker,
+					fusion->indexed[channel], fusion->indexed_size[channel],
+					start, &variance);
+			if (!isnan(rate)) {
+				weight += 1.0 / variance;
+				sum += rate / variance;
+			}
+		}
+		return HR_tracker_update(heartMonitor->tracker,
+				weight > 0 ? sum / weight : nanf(""),
+				weight > 0 ? 1.0 / weight : 0.0);
+	}
+	if (heartMonitor->engine == HR_ENGINE_PEAKS) {
+		return HR_tracker_updatePeaks(heartMonitor->tracker,
+				heartMonitor->indexed, heartMonitor->indexed_size, start);
+	}
+	float variance = HR_TRACKER_NOISE;
+	if (!isnan(result->confidence)) {
+		float confidence = result->confidence > 0.1 ? result->confidence : 0.1;
+		variance /= confidence * confidence;
+	}
+	return HR_tracker_update(heartMonitor->tracker, result->rate, variance);
+}
+
+/**
+ * @brief Normalizes the peaks in the array.
+ *
+ * This function normalizes the peaks in the given array based on the provided signals.
+ *
+ * @param array Pointer to the array of float values.
+ * @param signals Pointer to the array of signals representing the peaks.
+ * @param array_size The size of the array.
+ *
+ * @note The 'array' and 'signals' arrays should have a size of at least 'array_size'.
+ *
+ */
+void peaks_normalize(float *array, int *signals, int array_size) {
+	int start = 0;
+	for (int i = 1; i < array_size; i++) {
+		if (signals[i] == 1 && signals[i - 1] == 0) {
+			start = i;
+		}
+		if ((signals[i] == 0 && signals[i - 1] == 1) || i == array_size - 1) {
+
+			float max = array[start];
+			for (int j = start + 1; j < i; j++) {
+				if (max < array[j]) {
+					max = array[j];
+				}
+			}
+
+			int peaks = 0;
+			int count = 0;
+			for (int j = start; j < i; j++) {
+				signals[j] = 0;
+				if (array[j] >= max) {
+					peaks += j;
+					count++;
+				}
+			}
+			if (count != 0) {
+				signals[peaks / count] = 1;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Detects peaks in the array based on a threshold.
+ *
+ * This function detects peaks in the given array by comparing each element to a threshold value.
+ *
+ * @param array Pointer to the array of float values.
+ * @param signals Pointer to the array of signals representing the peaks.
+ * @param array_size The size of the array.
+ * @param initial_threshold The initial threshold value for peak detection.
+ *
+ * @note The 'array' and 'signals' arrays should have a size of at least 'array_size'.
+ *
+ */
+void peaks_detect(float *array, int *signals, int array_size,
+		float initial_threshold) {
+	float threshold = array[0];
+	for (int i = 1; i < array_size; i++) {
+		if (array[i] > threshold) {
+			threshold = array[i];
+		}
+	}
+	threshold = initial_threshold * threshold;
+
+	for (int i = 0; i < array_size; i++) {
+		if (array[i] > threshold) {
+			signals[i] = 1;
+		} else {
+			signals[i] = 0;
+		}
+	}
+}
+
+/**
+ * @brief Creates an indexed array of peak positions.
+ *
+ * This function takes an array of signals representing peaks and creates an indexed array
+ * containing the positions of the peaks.
+ *
+ * @param signals Pointer to the array of signals representing the peaks.
+ * @param ret_signals Pointer to the array where the indexed positions will be stored.
+ * @param array_size The size of the signals array.
+ *
+ * @note The 'signals' and 'ret_signals' arrays should have a size of at least 'array_size'.
+ *
+ */
+void peaks_indexing(int *signals, int *ret_signals, int array_size) {
+	int pointer = 0;
+	for (int i = 0; i < array_size; i++) {
+		if (signals[i] == 1) {
+			ret_signals[pointer] = i;
+			pointer++;
+		}
+	}
+	ret_signals[pointer] = -1;
+}
+
+/* @brief Creates an indexed array of peak positions and returns the size.
+ *
+ * This function takes an array of signals representing peaks and creates an indexed array
+ * containing the positions of the peaks. It also returns the size of the indexed array.
+ *
+ * @param signals Pointer to the array of signals representing the peaks.
+ * @param array_size The size of the signals array.
+ * @param result_size Pointer to an integer where the size of the indexed array will be stored.
+ *
+ * @return Pointer to the indexed array of peak positions.
+ *
+ * @note The returned indexed array should be freed using the 'free' function after use.
+ *
+ */
+int* peaks_indexingSize(int *signals, int array_size, int *result_size) {
+	int count = 0;
+	for (int i = 0; i < array_size; i++) {
+		if (signals[i] == 1) {
+			count++;
+		}
+	}
+	*result_size = count;
+	int *result = (int*) malloc(count * sizeof(int));
+	int pointer = 0;
+	for (int i = 0; i < array_size; i++) {
+		if (signals[i] == 1) {
+			result[pointer] = i;
+			pointer++;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief Creates a new streaming peak detector.
+ *
+ * This function allocates a PD_detector for a window of 'size' samples. The
+ * deque of window maxima needs at most 'size' entries and a window can hold at
+ * most size / 2 + 1 local maxima, which bounds the candidates ring. The detector
+ * is primed with 'size' zeros, the same initial window as HR_Ring.
+ *
+ * @param size      Size of the window in samples.
+ * @param threshold Relative threshold for peak detection.
+ *
+ * @return Pointer to the newly created PD_detector object.
+ *
+ * @note The returned object should be freed using the 'PD_free' function after use.
+ */
+PD_detector* PD_new(int size, float threshold) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(PD_FOOTPRINT(size)), PD_FOOTPRINT(size));
+	return PD_arenaNew(&arena, size, threshold);
+}
+
+/**
+ * @brief Creates a new streaming peak detector in an arena.
+ *
+ * @param arena     Pointer to the arena with at least PD_FOOTPRINT bytes left.
+ * @param size      Size of the window in samples.
+ * @param threshold Relative threshold for peak detection.
+ *
+ * @return Pointer to the newly created PD_detector object or NULL if the arena is too small.
+ */
+PD_detector* PD_arenaNew(HR_Arena *arena, int size, float threshold) {
+	if (!HR_arena_fits(arena, PD_FOOTPRINT(size))) {
+		return NULL;
+	}
+	PD_detector *detector = (PD_detector*) HR_arena_alloc(arena,
+			sizeof(PD_detector));
+	detector->size = size;
+	detector->threshold = threshold;
+	detector->max_index = (unsigned int*) HR_arena_alloc(arena,
+			size * sizeof(unsigned int));
+	detector->max_value = (float*) HR_arena_alloc(arena, size * sizeof(float));
+	detector->candidates_capacity = PD_CAPACITY(size);
+	detector->candidates = (PD_candidate*) HR_arena_alloc(arena,
+			detector->candidates_capacity * sizeof(PD_candidate));
+	for (int i = 0; i < size; i++) {
+		PD_push(detector, 0.0);
+	}
+	return detector;
+}
+
+/**
+ * @brief Frees the memory allocated for a streaming peak detector.
+ *
+ * @param detector Pointer to the PD_detector object created by PD_new.
+ */
+void PD_free(PD_detector *detector) {
+	free(detector);
+}
+
+/**
+ * @brief Stores a confirmed local maximum in the candidates ring.
+ *
+ * Candidates that left the window are dropped first, then the oldest one is
+ * overwritten if the ring is still full.
+ */
+static void PD_emit(PD_detector *detector, PD_candidate *candidate) {
+	unsigned int first = detector->count - detector->size;
+	while (detector->candidates_size > 0
+			&& (int) (detector->candidates[detector->candidates_head].last
+					- first) < 0) {
+		detector->candidates_head = (detector->candidates_head + 1)
+				% detector->candidates_capacity;
+		detector->candidates_size--;
+	}
+	if (detector->candidates_size == detector->candidates_capacity) {
+		detector->candidates_head = (detector->candidates_head + 1)
+				% detector->candidates_capacity;
+		detector->candidates_size--;
+	}
+	detector->candidates[(detector->candidates_head
+			+ detector->candidates_size) % detector->candidates_capacity] =
+			*candidate;
+	detector->candidates_size++;
+}
+
+/**
+ * @brief Processes one sample with the streaming peak detector.
+ *
+ * The sample enters the sliding-maximum deque, which always holds the maximum
+ * of the last 'size' samples at its front. The sample also advances the local
+ * maximum tracking: a plateau followed by a smaller sample is emitted as a
+ * candidate, and the minimum after it starts the next valley.
+ *
+ * @param detector Pointer to the PD_detector object.
+ * @param value    Sample to process.
+ */
+void PD_push(PD_detector *detector, float value) {
+	unsigned int index = detector->count++;
+
+	// Sliding maximum: drop the stale front, then smaller entries from the back
+	if (detector->max_size > 0
+			&& index - detector->max_index[detector->max_head]
+					>= (unsigned int) detector->size) {
+		detector->max_head = (detector->max_head + 1) % detector->size;
+		detector->max_size--;
+	}
+	while (detector->max_size > 0) {
+		int back = (detector->max_head + detector->max_size - 1)
+				% detector->size;
+		if (detector->max_value[back] > value) {
+			break;
+		}
+		detector->max_size--;
+	}
+	int back = (detector->max_head + detector->max_size) % detector->size;
+	detector->max_index[back] = index;
+	detector->max_value[back] = value;
+	detector->max_size++;
+
+	// Local maxima
+	detector->tail_rising = detector->rising;
+	detector->tail_value = detector->pending.value;
+	detector->tail_first = detector->pending.first;
+	if (index == 0 || value > detector->previous) {
+		if (index == 0) {
+			detector->pending.valley = value;
+			detector->pending.valley_index = index;
+		}
+		detector->rising = 1;
+		detector->pending.value = value;
+		detector->pending.first = index;
+		detector->pending.last = index;
+	} else if (value == detector->previous) {
+		if (detector->rising) {
+			detector->pending.last = index;
+		}
+	} else if (detector->rising) {
+		PD_emit(detector, &detector->pending);
+		detector->rising = 0;
+		detector->pending.valley = value;
+		detector->pending.valley_index = index;
+	} else if (value < detector->pending.valley) {
+		detector->pending.valley = value;
+		detector->pending.valley_index = index;
+	}
+	detector->previous = value;
+}
+
+/**
+ * @brief Processes an array of samples with the streaming peak detector.
+ *
+ * @param detector   Pointer to the PD_detector object.
+ * @param array      Pointer to the array of samples.
+ * @param array_size The size of the array.
+ */
+void PD_process(PD_detector *detector, float *array, int array_size) {
+	for (int i = 0; i < array_size; i++) {
+		PD_push(detector, array[i]);
+	}
+}
+
+/**
+ * @brief Writes the peaks of the current window as a signals array.
+ *
+ * Runs of samples above 'threshold * max' are rebuilt from the candidates: two
+ * neighbouring candidates belong to the same run when both they and the valley
+ * between them are above the threshold. Every run gets one peak at the centre
+ * of its maximum. Only the first samples of the window are read, in case the
+ * window starts on a falling edge before the first candidate.
+ *
+ * @param detector Pointer to the PD_detector object.
+ * @param array    Pointer to the window the detector processed, oldest first.
+ * @param signals  Pointer to the array of at least 'size' signals.
+ *
+ * @note The output is identical to peaks_detect + peaks_normalize, including
+ *       its handling of the window edges: the last sample is left flagged when
+ *       it is above the threshold and the run it belongs to is resolved without it.
+ */
+void PD_peaks(PD_detector *detector, float *array, int *signals) {
+	int size = detector->size;
+	unsigned int first = detector->count - size;
+	float threshold = detector->threshold
+			* detector->max_value[detector->max_head];
+
+	memset(signals, 0, size * sizeof(int));
+
+	int head = detector->candidates_head;
+	int left = detector->candidates_size;
+	while (left > 0 && (int) (detector->candidates[head].last - first) < 0) {
+		head = (head + 1) % detector->candidates_capacity;
+		left--;
+	}
+	int tail = detector->tail_rising && detector->rising;
+	unsigned int start = tail ? detector->tail_first : first + size;
+	if (left > 0) {
+		start = detector->candidates[head].first;
+	}
+
+	// Window starting before the first candidate: its first sample (and the
+	// plateau it belongs to) acts as a candidate of its own
+	int in_run = 0;
+	int runs = 0;
+	float run_max = 0.0;
+	int run_sum = 0;
+	int run_count = 0;
+	int pseudo = (int) (start - first) > 0;
+	if (pseudo && array[0] > threshold) {
+		int last = 0;
+		while (last + 1 < size - 1 && array[last + 1] == array[0]) {
+			last++;
+		}
+		in_run = 1;
+		run_max = array[0];
+		run_sum = last * (last + 1) / 2;
+		run_count = last + 1;
+	}
+
+	for (int i = 0; i <= left; i++) {
+		PD_candidate candidate;
+		if (i < left) {
+			candidate = detector->candidates[(head + i)
+					% detector->candidates_capacity];
+		} else if (tail) {
+			candidate.value = detector->tail_value;
+			candidate.first = detector->tail_first;
+			candidate.last = detector->count - 2;
+			candidate.valley = detector->pending.valley;
+			candidate.valley_index = detector->pending.valley_index;
+		} else {
+			break;
+		}
+		if ((int) (candidate.first - first) < 0) {
+			candidate.first = first;
+		}
+		if (i == 0 && pseudo
+				&& (int) (candidate.valley_index - first) < 0) {
+			candidate.valley = array[0];
+		}
+
+		if (candidate.value > threshold && in_run
+				&& candidate.valley > threshold) {
+			if (candidate.value < run_max) {
+				continue;
+			}
+			if (candidate.value > run_max) {
+				run_max = candidate.value;
+				run_sum = 0;
+				run_count = 0;
+			}
+		} else {
+			if (in_run) {
+				signals[run_sum / run_count] = 1;
+				runs++;
+			}
+			in_run = candidate.value > threshold;
+			run_max = candidate.value;
+			run_sum = 0;
+			run_count = 0;
+			if (!in_run) {
+				continue;
+			}
+		}
+		int plateau_first = candidate.first - first;
+		int plateau_last = candidate.last - first;
+		run_count += plateau_last - plateau_first + 1;
+		run_sum += (plateau_first + plateau_last)
+				* (plateau_last - plateau_first + 1) / 2;
+	}
+	if (in_run) {
+		signals[run_sum / run_count] = 1;
+		runs++;
+	}
+
+	if (array[size - 1] > threshold) {
+		signals[size - 1] = 1;
+	} else if (runs == 0) {
+		// Nothing above the threshold: only a window of zeros (or negative
+		// values), where peaks_normalize still marks the centre of its maximum
+		peaks_detect(array, signals, size, detector->threshold);
+		peaks_normalize(array, signals, size);
+	}
+}
+
+/**
+ * @brief Creates a new streaming beat detector with an adaptive threshold.
+ *
+ * @param size      Size of the window in samples, beats older than the window are dropped.
+ * @param freq      Sampling frequency.
+ * @param threshold Threshold after a beat as a fraction of the beat.
+ * @param rate_high Highest heart rate in bpm, its beat interval is the refractory period.
+ *
+ * @return Pointer to the newly created ATD_detector object or NULL if there is no table for
+ *         the sampling frequency, see ATD_arenaNew.
+ *
+ * @note The returned object should be freed using the 'ATD_free' function after use.
+ */
+ATD_detector* ATD_new(int size, float freq, float threshold, float rate_high) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(ATD_FOOTPRINT(size)), ATD_FOOTPRINT(size));
+	ATD_detector *detector = ATD_arenaNew(&arena, size, freq, threshold,
+			rate_high);
+	if (detector == NULL) {
+		free(arena.base);
 	}
+	return detector;
+}
 
-	if (count == 0) {
-		return nanf("");
-	} else {
-		return 60.0 / ((sum / count) / heartMonitor->freq);
+/**
+ * @brief Finds the generated threshold decay of a streaming beat detector.
+ *
+ * @param freq Sampling frequency.
+ *
+ * @return Pointer to the entry of ATD_tables or NULL if there is none for this frequency.
+ */
+const ATD_table* ATD_findTable(float freq) {
+	for (int i = 0; i < ATD_tables_size; i++) {
+		if (ATD_tables[i].freq == freq) {
+			return &ATD_tables[i];
+		}
 	}
+	return NULL;
 }
 
 /**
- * @brief Calculates the ratio from the indexed peaks in the HR_HeartMonitor structure.
+ * @brief Creates a new streaming beat detector with an adaptive threshold in an arena.
  *
- * This function calculates the ratio from the indexed peaks in the HR_HeartMonitor structure.
- * It calculates the AC (alternating current) and DC (direct current) components for the red and IR signals,
- * based on the minimum and maximum values within the specified peaks. It then calculates the ratio
- * between the AC and DC components of the red and IR signals and returns the result.
+ * The average interval starts at twice the refractory period and the threshold at zero, so the
+ * first local maximum above zero is a beat. The threshold decay comes from ATD_tables or, with
+ * HR_BPF_RUNTIME_DESIGN, is computed here.
  *
- * @param heartMonitor Pointer to the HR_HeartMonitor structure.
- * @param peaks        Pointer to the array of indexed peaks.
- * @param peaks_size   Size of the array of indexed peaks.
- * @return Ratio calculated from the indexed peaks.
+ * @param arena     Pointer to the arena with at least ATD_FOOTPRINT bytes left.
+ * @param size      Size of the window in samples, beats older than the window are dropped.
+ * @param freq      Sampling frequency.
+ * @param threshold Threshold after a beat as a fraction of the beat.
+ * @param rate_high Highest heart rate in bpm, its beat interval is the refractory period.
+ *
+ * @return Pointer to the newly created ATD_detector object or NULL if the arena is too small
+ * or there is no table for the sampling frequency.
  */
-float HR_heartMonitor_ratioFromIndexedPeaks(HR_HeartMonitor *heartMonitor,
-		int *peaks, int peaks_size) {
-	if (peaks_size < 2) {
-		return nanf("");
+ATD_detector* ATD_arenaNew(HR_Arena *arena, int size, float freq,
+		float threshold, float rate_high) {
+	const ATD_table *table = ATD_findTable(freq);
+#ifndef HR_BPF_RUNTIME_DESIGN
+	if (table == NULL) {
+		return NULL;
+	}
+#endif
+	if (!HR_arena_fits(arena, ATD_FOOTPRINT(size))) {
+		return NULL;
 	}
-	int *mins = (int*) malloc((peaks_size - 1) * sizeof(int));
-	int *maxs = (int*) malloc((peaks_size - 2) * sizeof(int));
+	ATD_detector *detector = (ATD_detector*) HR_arena_alloc(arena,
+			sizeof(ATD_detector));
+	detector->size = size;
+	detector->ratio = threshold;
+	detector->refractory = (int) (60.0 * freq / rate_high);
+#ifdef HR_BPF_RUNTIME_DESIGN
+	detector->decay = table != NULL ? table->decay :
+			expf(-1.0 / (HR_ATD_DECAY * freq));
+#else
+	detector->decay = table->decay;
+#endif
+	detector->interval = 2 * detector->refractory;
+	detector->beats_capacity = ATD_CAPACITY(size);
+	detector->beats = (unsigned int*) HR_arena_alloc(arena,
+			detector->beats_capacity * sizeof(unsigned int));
+	detector->offsets = (float*) HR_arena_alloc(arena,
+			detector->beats_capacity * sizeof(float));
+	return detector;
+}
 
-	// MA_process(heartMonitor->ma_red, heartMonitor->red, heartMonitor->size);
-	// MA_process(heartMonitor->ma_ir, heartMonitor->ir, heartMonitor->size);
+/**
+ * @brief Frees the memory allocated for a streaming beat detector.
+ *
+ * @param detector Pointer to the ATD_detector object created by ATD_new.
+ */
+void ATD_free(ATD_detector *detector) {
+	free(detector);
+}
 
-	// RED
-	// find mins
-	for (int i = 0; i < peaks_size - 1; i++) {
-		mins[i] = findMinIndex(heartMonitor->red, peaks[i], peaks[i + 1]);
+/**
+ * @brief Takes a local maximum as the next beat and restarts the threshold from it.
+ */
+static void ATD_beat(ATD_detector *detector, float value, unsigned int index,
+		float offset) {
+	float clipped = value;
+	if (detector->seen < HR_ATD_WARMUP) {
+		detector->seen++;
+		detector->amplitude += (value - detector->amplitude) / detector->seen;
+	} else {
+		if (clipped > HR_ATD_SPIKE * detector->amplitude) {
+			clipped = HR_ATD_SPIKE * detector->amplitude;
+		}
+		detector->amplitude += (clipped - detector->amplitude) / 8.0;
+		float interval = index - detector->last_index;
+		if (interval > 2.0 * detector->interval) {
+			interval = 2.0 * detector->interval;
+		}
+		detector->interval += (interval - detector->interval) / 8.0;
 	}
+	detector->threshold = detector->ratio * clipped;
+	detector->last_value = value;
+	detector->last_index = index;
+	detector->missed_value = 0.0;
 
-	// find maxs between mins
-	for (int i = 0; i < peaks_size - 2; i++) {
-		maxs[i] = findMaxIndex(heartMonitor->red, mins[i], mins[i + 1]);
-
+	unsigned int first = detector->count - detector->size;
+	while (detector->beats_size > 0
+			&& (int) (detector->beats[detector->beats_head] - first) < 0) {
+		detector->beats_head = (detector->beats_head + 1)
+				% detector->beats_capacity;
+		detector->beats_size--;
 	}
-	// calculate ratio
-	float AC_red = 0.0;
-	float DC_red = 0.0;
-	int count = 0;
-	for (int i = 0; i < peaks_size - 2; i++) {
-		count++;
-		float DC_now = (heartMonitor->red[mins[i]]
-				+ heartMonitor->red[mins[i + 1]]) / 2;
-		AC_red += (heartMonitor->red[maxs[i]] - DC_now);
-		DC_red += DC_now;
+	if (detector->beats_size == detector->beats_capacity) {
+		detector->beats_head = (detector->beats_head + 1)
+				% detector->beats_capacity;
+		detector->beats_size--;
 	}
+	int last = (detector->beats_head + detector->beats_size)
+			% detector->beats_capacity;
+	detector->beats[last] = index;
+	detector->offsets[last] = offset;
+	detector->beats_size++;
+}
 
-	AC_red = AC_red / count;
-	DC_red = DC_red / count;
-
-	// IR
-	for (int i = 0; i < peaks_size - 1; i++) {
-		mins[i] = findMinIndex(heartMonitor->ir, peaks[i], peaks[i + 1]);
-	}
-	// find maxs between mins
-	for (int i = 0; i < peaks_size - 2; i++) {
-		maxs[i] = findMaxIndex(heartMonitor->ir, mins[i], mins[i + 1]);
+/**
+ * @brief Checks a confirmed local maximum against the refractory period and the threshold.
+ */
+static void ATD_maximum(ATD_detector *detector, float value,
+		unsigned int index, float offset) {
+	if (detector->seen > 0
+			&& index - detector->last_index
+					< (unsigned int) detector->refractory) {
+		// the beat is the highest maximum of its refractory period
+		if (value > detector->last_value && detector->beats_size > 0) {
+			int last = (detector->beats_head + detector->beats_size - 1)
+					% detector->beats_capacity;
+			detector->beats[last] = index;
+			detector->offsets[last] = offset;
+			detector->last_value = value;
+			detector->last_index = index;
+		}
+		return;
 	}
-	// calculate ratio
-	float AC_ir = 0.0;
-	float DC_ir = 0.0;
-	count = 0;
-	for (int i = 0; i < peaks_size - 2; i++) {
-		count++;
-		float DC_now = (heartMonitor->ir[mins[i]]
-				+ heartMonitor->ir[mins[i + 1]]) / 2;
-		AC_ir += heartMonitor->ir[maxs[i]] - DC_now;
-		DC_ir += DC_now;
+	if (value > detector->threshold) {
+		ATD_beat(detector, value, index, offset);
+	} else if (value > detector->missed_value) {
+		detector->missed_value = value;
+		detector->missed_index = index;
+		detector->missed_offset = offset;
 	}
-	AC_ir = AC_ir / count;
-	DC_ir = DC_ir / count;
-
-	free(maxs);
-	free(mins);
-	return (AC_red / DC_red) / (AC_ir / DC_ir);
 }
 
 /**
- * @brief Calculates the ratio from the peaks in the HR_HeartMonitor structure.
+ * @brief Processes one sample with the streaming beat detector.
  *
- * This function calculates the ratio from the peaks in the HR_HeartMonitor structure.
- * It first indexes the peaks and determines the size of the indexed peaks array.
- * Then, it calls the HR_heartMonitor_ratioFromIndexedPeaks function to calculate
- * the ratio based on the indexed peaks. Finally, it frees the memory allocated for the
- * indexed peaks array and returns the calculated ratio.
+ * The threshold decays, a local maximum is confirmed by the first smaller sample after it (a
+ * plateau counts from its first sample) and a searchback runs once the last beat is
+ * HR_ATD_SEARCHBACK average intervals old.
  *
- * @param heartMonitor Pointer to the HR_HeartMonitor structure.
- * @return Ratio calculated from the peaks.
+ * @param detector Pointer to the ATD_detector object.
+ * @param value    Sample to process.
  */
-float HR_heartMonitor_ratioFromPeaks(HR_HeartMonitor *heartMonitor) {
+void ATD_push(ATD_detector *detector, float value) {
+	unsigned int index = detector->count++;
+	detector->threshold *= detector->decay;
 
-	int peaks_size = 0;
-	int *peaks = peaks_indexingSize(heartMonitor->peaks, heartMonitor->size,
-			&peaks_size);
-	float result = HR_heartMonitor_ratioFromIndexedPeaks(heartMonitor, peaks,
-			peaks_size);
-	free(peaks);
-	return result;
+	if (index == 0 || value > detector->previous) {
+		detector->rising = 1;
+		detector->pending_value = value;
+		detector->pending_index = index;
+		detector->pending_before = index == 0 ? value : detector->previous;
+	} else if (value < detector->previous && detector->rising) {
+		detector->rising = 0;
+		// vertex of the parabola through the maximum and its neighbours
+		float before = detector->pending_before;
+		float peak = detector->pending_value;
+		float curvature = before - 2.0 * peak + value;
+		float offset = curvature < 0 ? 0.5 * (before - value) / curvature : 0.0;
+		ATD_maximum(detector, peak, detector->pending_index, offset);
+	}
+	detector->previous = value;
+
+	if (detector->seen > 0
+			&& index - detector->last_index
+					> HR_ATD_SEARCHBACK * detector->interval
+			&& detector->missed_value
+					> HR_ATD_MISSED * detector->amplitude) {
+		ATD_beat(detector, detector->missed_value, detector->missed_index,
+				detector->missed_offset);
+	}
 }
 
 /**
- * @brief Calculates the heart rate and ratio from the HR_HeartMonitor structure.
- *
- * This function calculates the heart rate and ratio from the provided HR_HeartMonitor structure.
- *
- * @param heartMonitor Pointer to the HR_HeartMonitor structure.
- * @param rate Pointer to a float variable to store the calculated heart rate.
- * @param ratio Pointer to a float variable to store the calculated ratio.
+ * @brief Processes an array of samples with the streaming beat detector.
  *
- * @see HR_heartMonitor_heartRateFromIndexedPeaks
- * @see HR_heartMonitor_ratioFromIndexedPeaks
+ * @param detector   Pointer to the ATD_detector object.
+ * @param array      Pointer to the array of samples.
+ * @param array_size The size of the array.
  */
-void HR_heartMonitor_heartRateAndRation(HR_HeartMonitor *heartMonitor,
-		float *rate, float *ratio) {
-	int peaks_size = 0;
-	int *peaks = peaks_indexingSize(heartMonitor->peaks, heartMonitor->size,
-			&peaks_size);
-	*rate = HR_heartMonitor_heartRateFromIndexedPeaks(heartMonitor, peaks,
-			peaks_size);
-	*ratio = HR_heartMonitor_ratioFromIndexedPeaks(heartMonitor, peaks,
-			peaks_size);
+void ATD_process(ATD_detector *detector, float *array, int array_size) {
+	for (int i = 0; i < array_size; i++) {
+		ATD_push(detector, array[i]);
+	}
 }
 
 /**
- * @brief Normalizes the peaks in the array.
- *
- * This function normalizes the peaks in the given array based on the provided signals.
- *
- * @param array Pointer to the array of float values.
- * @param signals Pointer to the array of signals representing the peaks.
- * @param array_size The size of the array.
- *
- * @note The 'array' and 'signals' arrays should have a size of at least 'array_size'.
+ * @brief Writes the beats of the current window as a signals array.
  *
+ * @param detector Pointer to the ATD_detector object.
+ * @param signals  Pointer to the array of at least 'size' signals, oldest sample first.
  */
-void peaks_normalize(float *array, int *signals, int array_size) {
-	int start = 0;
-	for (int i = 1; i < array_size; i++) {
-		if (signals[i] == 1 && signals[i - 1] == 0) {
-			start = i;
-		}
-		if ((signals[i] == 0 && signals[i - 1] == 1) || i == array_size - 1) {
-
-			float max = array[start];
-			for (int j = start + 1; j < i; j++) {
-				if (max < array[j]) {
-					max = array[j];
-				}
-			}
-
-			int peaks = 0;
-			int count = 0;
-			for (int j = start; j < i; j++) {
-				signals[j] = 0;
-				if (array[j] >= max) {
-					peaks += j;
-					count++;
-				}
-			}
-			if (count != 0) {
-				signals[peaks / count] = 1;
-			}
+void ATD_peaks(ATD_detector *detector, int *signals) {
+	unsigned int first = detector->count - detector->size;
+	memset(signals, 0, detector->size * sizeof(int));
+	for (int i = 0; i < detector->beats_size; i++) {
+		unsigned int beat = detector->beats[(detector->beats_head + i)
+				% detector->beats_capacity];
+		if ((int) (beat - first) >= 0) {
+			signals[beat - first] = 1;
 		}
 	}
 }
 
 /**
- * @brief Detects peaks in the array based on a threshold.
- *
- * This function detects peaks in the given array by comparing each element to a threshold value.
+ * @brief Returns the next final beat, in the order of the beats.
  *
- * @param array Pointer to the array of float values.
- * @param signals Pointer to the array of signals representing the peaks.
- * @param array_size The size of the array.
- * @param initial_threshold The initial threshold value for peak detection.
- *
- * @note The 'array' and 'signals' arrays should have a size of at least 'array_size'.
+ * A beat is final once its refractory period has passed, so it can no longer move. Every beat
+ * is returned once, as long as this function is called at least once per window.
  *
+ * @param detector Pointer to the ATD_detector object.
+ * @param index    Pointer to the sample number of the beat to fill.
+ * @param offset   Pointer to the position of the beat between samples to fill, -0.5 to 0.5.
+ * @return 1 if a beat was returned, 0 if there is no new final beat.
  */
-void peaks_detect(float *array, int *signals, int array_size,
-		float initial_threshold) {
-	float threshold = array[0];
-	for (int i = 1; i < array_size; i++) {
-		if (array[i] > threshold) {
-			threshold = array[i];
+int ATD_next(ATD_detector *detector, unsigned int *index, float *offset) {
+	for (int i = 0; i < detector->beats_size; i++) {
+		int position = (detector->beats_head + i) % detector->beats_capacity;
+		unsigned int beat = detector->beats[position];
+		if ((int) (beat - detector->next) < 0) {
+			continue;
 		}
-	}
-	threshold = initial_threshold * threshold;
-
-	for (int i = 0; i < array_size; i++) {
-		if (array[i] > threshold) {
-			signals[i] = 1;
-		} else {
-			signals[i] = 0;
+		if (detector->count - beat <= (unsigned int) detector->refractory) {
+			return 0;
 		}
+		*index = beat;
+		*offset = detector->offsets[position];
+		detector->next = beat + 1;
+		return 1;
 	}
+	return 0;
 }
 
 /**
- * @brief Creates an indexed array of peak positions.
+ * @brief Creates a new Normalized Least Mean Squares (NLMS) motion canceller.
  *
- * This function takes an array of signals representing peaks and creates an indexed array
- * containing the positions of the peaks.
+ * This function allocates memory for a new NLMS_filter object. The weights and the
+ * history of the reference start zeroed, so the first output samples equal the input.
  *
- * @param signals Pointer to the array of signals representing the peaks.
- * @param ret_signals Pointer to the array where the indexed positions will be stored.
- * @param array_size The size of the signals array.
+ * @param taps    Number of taps per accelerometer axis.
+ * @param mu      Step size of the weight update, 0 < mu < 2.
+ * @param epsilon Regularization added to the reference power.
  *
- * @note The 'signals' and 'ret_signals' arrays should have a size of at least 'array_size'.
+ * @return Pointer to the newly created NLMS_filter object.
  *
+ * @note The returned NLMS_filter object should be freed using the 'NLMS_free' function after use.
  */
-void peaks_indexing(int *signals, int *ret_signals, int array_size) {
-	int pointer = 0;
-	for (int i = 0; i < array_size; i++) {
-		if (signals[i] == 1) {
-			ret_signals[pointer] = i;
-			pointer++;
-		}
-	}
-	ret_signals[pointer] = -1;
+NLMS_filter* NLMS_new(int taps, float mu, float epsilon) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(NLMS_FOOTPRINT(taps)), NLMS_FOOTPRINT(taps));
+	return NLMS_arenaNew(&arena, taps, mu, epsilon);
 }
 
-/* @brief Creates an indexed array of peak positions and returns the size.
+/**
+ * @brief Creates a new Normalized Least Mean Squares (NLMS) motion canceller in an arena.
  *
- * This function takes an array of signals representing peaks and creates an indexed array
- * containing the positions of the peaks. It also returns the size of the indexed array.
+ * @param arena   Pointer to the arena with at least NLMS_FOOTPRINT bytes left.
+ * @param taps    Number of taps per accelerometer axis.
+ * @param mu      Step size of the weight update, 0 < mu < 2.
+ * @param epsilon Regularization added to the reference power.
  *
- * @param signals Pointer to the array of signals representing the peaks.
- * @param array_size The size of the signals array.
- * @param result_size Pointer to an integer where the size of the indexed array will be stored.
+ * @return Pointer to the newly created NLMS_filter object or NULL if the arena is too small.
+ */
+NLMS_filter* NLMS_arenaNew(HR_Arena *arena, int taps, float mu, float epsilon) {
+	if (!HR_arena_fits(arena, NLMS_FOOTPRINT(taps))) {
+		return NULL;
+	}
+	NLMS_filter *filter = (NLMS_filter*) HR_arena_alloc(arena,
+			sizeof(NLMS_filter));
+	filter->taps = taps;
+	filter->mu = mu;
+	filter->epsilon = epsilon;
+	filter->weights = (float*) HR_arena_alloc(arena,
+			HR_MOTION_AXES * taps * sizeof(float));
+	filter->history = (float*) HR_arena_alloc(arena,
+			HR_MOTION_AXES * 2 * taps * sizeof(float));
+	return filter;
+}
+
+/**
+ * @brief Frees the memory allocated for a NLMS_filter object.
  *
- * @return Pointer to the indexed array of peak positions.
+ * @param filter Pointer to the NLMS_filter object created by NLMS_new.
+ */
+void NLMS_free(NLMS_filter *filter) {
+	free(filter);
+}
+
+/**
+ * @brief Removes the motion-correlated part of an input array.
  *
- * @note The returned indexed array should be freed using the 'free' function after use.
+ * For every sample the last filter->taps reference samples of all axes are weighted into
+ * an estimate of the motion artifact, which is subtracted from the sample. The error drives
+ * the weight update, normalized by the power of the reference history, so the adaptation
+ * speed does not depend on how hard the wearer moves. Both the input and the reference are
+ * expected to be band-passed by the same filter. The power is a running sum, recomputed
+ * once per filter->taps samples as in MA_process.
  *
+ * @param filter     Pointer to the NLMS_filter object.
+ * @param array      Pointer to the input array, replaced by the cleaned samples.
+ * @param reference  HR_MOTION_AXES pointers to the reference samples, array_size each.
+ * @param array_size Size of the input array.
  */
-int* peaks_indexingSize(int *signals, int array_size, int *result_size) {
-	int count = 0;
+void NLMS_process(NLMS_filter *filter, float *array, float **reference,
+		int array_size) {
+	int taps = filter->taps;
 	for (int i = 0; i < array_size; i++) {
-		if (signals[i] == 1) {
-			count++;
+		int head = filter->head;
+		for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+			float *history = filter->history + axis * 2 * taps;
+			float value = reference[axis][i];
+			filter->power += value * value - history[head] * history[head];
+			history[head] = value;
+			history[head + taps] = value;
 		}
-	}
-	*result_size = count;
-	int *result = (int*) malloc(count * sizeof(int));
-	int pointer = 0;
-	for (int i = 0; i < array_size; i++) {
-		if (signals[i] == 1) {
-			result[pointer] = i;
-			pointer++;
+		head++;
+		if (head == taps) {
+			head = 0;
+			filter->power = 0.0;
+			for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+				float *window = filter->history + axis * 2 * taps;
+				for (int j = 0; j < taps; j++) {
+					filter->power += window[j] * window[j];
+				}
+			}
 		}
-	}
+		filter->head = head;
 
-	return result;
+		float estimate = 0.0;
+		for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+			float *weights = filter->weights + axis * taps;
+			float *window = filter->history + axis * 2 * taps + head;
+			for (int j = 0; j < taps; j++) {
+				estimate += weights[j] * window[j];
+			}
+		}
+		float error = array[i] - estimate;
+		float step = filter->mu * error / (filter->epsilon + filter->power);
+		for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+			float *weights = filter->weights + axis * taps;
+			float *window = filter->history + axis * 2 * taps + head;
+			for (int j = 0; j < taps; j++) {
+				weights[j] += step * window[j];
+			}
+		}
+		array[i] = error;
+	}
 }
 
 /**
  * @brief Creates a new Slope Sum Function (SSF) object.
  *
  * This function allocates memory for a new SSF object and initializes its properties.
+ * The history of the window starts zeroed.
  *
  * @param window_size The size of the SSF window.
  *
@@ -548,22 +3745,39 @@ int* peaks_indexingSize(int *signals, int array_size, int *result_size) {
  *
  */
 SSF* SSF_new(int window_size) {
-	SSF *ssf = (SSF*) malloc(sizeof(SSF));
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(SSF_FOOTPRINT(window_size)),
+			SSF_FOOTPRINT(window_size));
+	return SSF_arenaNew(&arena, window_size);
+}
+
+/**
+ * @brief Creates a new Slope Sum Function (SSF) object in an arena.
+ *
+ * @param arena       Pointer to the arena with at least SSF_FOOTPRINT bytes left.
+ * @param window_size The size of the SSF window.
+ *
+ * @return Pointer to the newly created SSF object or NULL if the arena is too small.
+ */
+SSF* SSF_arenaNew(HR_Arena *arena, int window_size) {
+	if (!HR_arena_fits(arena, SSF_FOOTPRINT(window_size))) {
+		return NULL;
+	}
+	SSF *ssf = (SSF*) HR_arena_alloc(arena, sizeof(SSF));
 	ssf->window_size = window_size;
-	ssf->data = (float*) malloc(window_size * sizeof(float));
+	ssf->data = (float*) HR_arena_alloc(arena, window_size * sizeof(float));
 	return ssf;
 }
 
 /**
  * @brief Frees the memory allocated for a Slope Sum Function (SSF) object.
  *
- * This function frees the memory allocated for the SSF object, including its data array.
+ * This function frees the heap block holding the SSF object and its data array.
  *
- * @param ssf Pointer to the SSF object to be freed.
+ * @param ssf Pointer to the SSF object created by SSF_new.
  *
  */
 void SSF_free(SSF *ssf) {
-	free(ssf->data);
 	free(ssf);
 }
 
@@ -574,6 +3788,8 @@ void SSF_free(SSF *ssf) {
  * ssf->window_size over the array. For each position of the window, it calculates
  * the sum of positive differences between adjacent elements in the window.
  * The resulting SSF values replace the corresponding elements in the input array.
+ * Each sample adds the difference to its predecessor and drops the oldest one
+ * from the running sum, so the cost does not depend on the window size.
  *
  * @param ssf Pointer to the SSF object.
  * @param array Pointer to the input array.
@@ -581,19 +3797,28 @@ void SSF_free(SSF *ssf) {
  *
  */
 void SSF_process(SSF *ssf, float *array, int array_size) {
+	int pairs = ssf->window_size - 1;
+	if (pairs < 1) {
+		memset(array, 0, array_size * sizeof(float));
+		return;
+	}
 	for (int i = 0; i < array_size; i++) {
-		for (int j = 1; j < ssf->window_size; j++) {
-			ssf->data[j] = ssf->data[j - 1];
+		float delta = array[i] - ssf->previous;
+		if (delta < 0) {
+			delta = 0.0;
 		}
-		ssf->data[0] = array[i];
-		float sum = 0.0;
-		for (int j = 0; j < ssf->window_size - 1; j++) {
-			float delta = ssf->data[j] - ssf->data[j + 1];
-			if (delta >= 0) {
-				sum += delta;
+		ssf->previous = array[i];
+		ssf->sum += delta - ssf->data[ssf->head];
+		ssf->data[ssf->head] = delta;
+		ssf->head++;
+		if (ssf->head == pairs) {
+			ssf->head = 0;
+			ssf->sum = 0.0;
+			for (int j = 0; j < pairs; j++) {
+				ssf->sum += ssf->data[j];
 			}
 		}
-		array[i] = sum;
+		array[i] = ssf->sum;
 	}
 }
 
@@ -603,30 +3828,47 @@ void SSF_process(SSF *ssf, float *array, int array_size) {
  * This function creates a new MA_filter object with the specified window size.
  * The MA filter is a sliding window filter that calculates the average of the
  * windowed samples. It is commonly used for smoothing or noise reduction.
+ * The window starts zeroed.
  *
  * @param window_size The size of the moving average window.
  * @return Pointer to the newly created MA_filter object.
  *
  */
 MA_filter* MA_new(int window_size) {
-	MA_filter *filter = malloc(sizeof(MA_filter));
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(MA_FOOTPRINT(window_size)),
+			MA_FOOTPRINT(window_size));
+	return MA_arenaNew(&arena, window_size);
+}
+
+/**
+ * @brief Creates a new Moving Average (MA) filter object in an arena.
+ *
+ * @param arena       Pointer to the arena with at least MA_FOOTPRINT bytes left.
+ * @param window_size The size of the moving average window.
+ * @return Pointer to the newly created MA_filter object or NULL if the arena is too small.
+ *
+ */
+MA_filter* MA_arenaNew(HR_Arena *arena, int window_size) {
+	if (!HR_arena_fits(arena, MA_FOOTPRINT(window_size))) {
+		return NULL;
+	}
+	MA_filter *filter = (MA_filter*) HR_arena_alloc(arena, sizeof(MA_filter));
 	filter->window_size = window_size;
-	filter->data = calloc(window_size - 1, sizeof(float));
+	filter->data = (float*) HR_arena_alloc(arena, window_size * sizeof(float));
 	return filter;
-
 }
 
 /**
  * @brief Frees the memory allocated for a Moving Average (MA) filter object.
  *
- * This function frees the memory allocated for the MA_filter object, including
- * the data array and the filter object itself.
+ * This function frees the heap block holding the MA_filter object and its
+ * data array.
  *
- * @param filter Pointer to the MA_filter object to be freed.
+ * @param filter Pointer to the MA_filter object created by MA_new.
  *
  */
 void MA_free(MA_filter *filter) {
-	free(filter->data);
 	free(filter);
 }
 
@@ -636,6 +3878,8 @@ void MA_free(MA_filter *filter) {
  * This function applies the Moving Average (MA) filter to an array of values.
  * It updates the data array of the MA_filter object with the new values from
  * the input array and computes the moving average for each element in the array.
+ * The running sum is updated with the new and the dropped sample only, so the
+ * cost does not depend on the window size.
  *
  * @param filter Pointer to the MA_filter object.
  * @param array  Pointer to the array of values to be filtered.
@@ -644,15 +3888,17 @@ void MA_free(MA_filter *filter) {
  */
 void MA_process(MA_filter *filter, float *array, int array_size) {
 	for (int i = 0; i < array_size; i++) {
-		for (int j = filter->window_size - 1; j > 0; j--) {
-			filter->data[j] = filter->data[j - 1];
-		}
-		filter->data[0] = array[i];
-		float sum = 0.0;
-		for (int j = 0; j < filter->window_size; j++) {
-			sum += filter->data[j];
+		filter->sum += array[i] - filter->data[filter->head];
+		filter->data[filter->head] = array[i];
+		filter->head++;
+		if (filter->head == filter->window_size) {
+			filter->head = 0;
+			filter->sum = 0.0;
+			for (int j = 0; j < filter->window_size; j++) {
+				filter->sum += filter->data[j];
+			}
 		}
-		array[i] = sum / filter->window_size;
+		array[i] = filter->sum / filter->window_size;
 	}
 }
 
@@ -661,104 +3907,230 @@ void MA_process(MA_filter *filter, float *array, int array_size) {
  *
  * This function creates a new Bandpass Filter (BPF) object with the specified
  * parameters. The BPF object stores the filter order, frequency, and frequency
- * range for the bandpass filter. It also computes the coefficients and
- * intermediate values required for the filter.
+ * range for the bandpass filter. The coefficients come from BPF_tables or, with
+ * HR_BPF_RUNTIME_DESIGN, are computed here.
  *
  * @param order The order of the bandpass filter.
  * @param freq The sampling frequency.
  * @param low The lower cutoff frequency.
  * @param high The higher cutoff frequency.
  *
- * @return Pointer to the newly created BPF_filter object.
+ * @return Pointer to the newly created BPF_filter object or NULL.
  */
 BPF_filter* BPF_new(int order, float freq, float low, float high) {
-	BPF_filter *bpf_filter = (BPF_filter*) malloc(sizeof(BPF_filter));
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(BPF_FOOTPRINT(order)), BPF_FOOTPRINT(order));
+	BPF_filter *bpf_filter = BPF_arenaNew(&arena, order, freq, low, high);
+	if (bpf_filter == NULL) {
+		free(arena.base);
+	}
+	return bpf_filter;
+}
+
+/**
+ * @brief Finds the generated table of a band-pass filter.
+ *
+ * @param order The order of the bandpass filter.
+ * @param freq The sampling frequency.
+ * @param low The lower cutoff frequency.
+ * @param high The higher cutoff frequency.
+ *
+ * @return Pointer to the entry of BPF_tables or NULL if there is none for these settings.
+ */
+const BPF_table* BPF_findTable(int order, float freq, float low, float high) {
+	for (int i = 0; i < BPF_tables_size; i++) {
+		const BPF_table *table = &BPF_tables[i];
+		if (table->order == order && table->freq == freq && table->low == low
+				&& table->high == high) {
+			return table;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Creates a new Bandpass Filter (BPF) object in an arena from a generated table.
+ *
+ * The coefficients are copied next to the state of each section, nothing is computed.
+ *
+ * @param arena Pointer to the arena with at least BPF_FOOTPRINT bytes left.
+ * @param table Pointer to the table of the filter.
+ *
+ * @return Pointer to the newly created BPF_filter object or NULL if the arena is too small.
+ */
+BPF_filter* BPF_tableArenaNew(HR_Arena *arena, const BPF_table *table) {
+	if (!HR_arena_fits(arena, BPF_FOOTPRINT(table->order))) {
+		return NULL;
+	}
+	BPF_filter *bpf_filter = (BPF_filter*) HR_arena_alloc(arena,
+			sizeof(BPF_filter));
+
+	bpf_filter->n = table->order;
+	bpf_filter->freq = table->freq;
+	bpf_filter->freq_low = table->low;
+	bpf_filter->freq_high = table->high;
+	bpf_filter->sections = (BPF_biquad*) HR_arena_alloc(arena,
+			bpf_filter->n * sizeof(BPF_biquad));
+
+	for (int i = 0; i < bpf_filter->n; ++i) {
+		BPF_biquad *section = &bpf_filter->sections[i];
+		section->b0 = table->sections[i].b0;
+		section->b1 = table->sections[i].b1;
+		section->b2 = table->sections[i].b2;
+		section->a1 = table->sections[i].a1;
+		section->a2 = table->sections[i].a2;
+	}
+
+	return bpf_filter;
+}
+
+/**
+ * @brief Creates a new Bandpass Filter (BPF) object in an arena.
+ *
+ * Same as BPF_new, but the object, coefficients and state are taken from the arena.
+ * The filter is bound to its entry of BPF_tables if there is one, otherwise it is
+ * designed here with HR_BPF_RUNTIME_DESIGN.
+ *
+ * @param arena Pointer to the arena with at least BPF_FOOTPRINT bytes left.
+ * @param order The order of the bandpass filter.
+ * @param freq The sampling frequency.
+ * @param low The lower cutoff frequency.
+ * @param high The higher cutoff frequency.
+ *
+ * @return Pointer to the newly created BPF_filter object or NULL if the arena is too small
+ * or the filter can not be made.
+ */
+BPF_filter* BPF_arenaNew(HR_Arena *arena, int order, float freq, float low,
+		float high) {
+	const BPF_table *table = BPF_findTable(order, freq, low, high);
+	if (table != NULL) {
+		return BPF_tableArenaNew(arena, table);
+	}
+#ifdef HR_BPF_RUNTIME_DESIGN
+	if (!HR_arena_fits(arena, BPF_FOOTPRINT(order))) {
+		return NULL;
+	}
+	BPF_filter *bpf_filter = (BPF_filter*) HR_arena_alloc(arena,
+			sizeof(BPF_filter));
 
-	bpf_filter->n = order;
 	bpf_filter->freq = freq;
 	bpf_filter->freq_low = low;
 	bpf_filter->freq_high = high;
 
-	float a, b, r;
+	float a, b, r, c, g;
 	a = cosf(M_PI * (high + low) / freq) / cosf(M_PI * (high - low) / freq);
 	b = tanf(M_PI * (high - low) / freq);
 
-	bpf_filter->n = bpf_filter->n / 2;
-	bpf_filter->A = (float*) malloc(bpf_filter->n * sizeof(float));
-	bpf_filter->d1 = (float*) malloc(bpf_filter->n * sizeof(float));
-	bpf_filter->d2 = (float*) malloc(bpf_filter->n * sizeof(float));
-	bpf_filter->d3 = (float*) malloc(bpf_filter->n * sizeof(float));
-	bpf_filter->d4 = (float*) malloc(bpf_filter->n * sizeof(float));
+	// each pole s = -r + jc of the low-pass prototype gives a 4th order
+	// band-pass section with the poles z and z* of two biquads, z being the
+	// roots of z^2 - a(1 + p)z + p, p = (1 + bs) / (1 - bs)
+	int sections = order / 2;
+	bpf_filter->n = 2 * sections;
+	bpf_filter->sections = (BPF_biquad*) HR_arena_alloc(arena,
+			bpf_filter->n * sizeof(BPF_biquad));
 
-	bpf_filter->w0 = (float*) calloc(bpf_filter->n, sizeof(float));
-	bpf_filter->w1 = (float*) calloc(bpf_filter->n, sizeof(float));
-	bpf_filter->w2 = (float*) calloc(bpf_filter->n, sizeof(float));
-	bpf_filter->w3 = (float*) calloc(bpf_filter->n, sizeof(float));
-	bpf_filter->w4 = (float*) calloc(bpf_filter->n, sizeof(float));
+	for (int i = 0; i < sections; ++i) {
+		r = sinf(M_PI * (2.0 * i + 1.0) / (4.0 * sections));
+		c = cosf(M_PI * (2.0 * i + 1.0) / (4.0 * sections));
+		g = b / sqrtf(b * b + 2.0 * b * r + 1.0);
 
-	for (int i = 0; i < bpf_filter->n; ++i) {
-		r = sinf(M_PI * (2.0 * i + 1.0) / (4.0 * bpf_filter->n));
-		freq = b * b + 2.0 * b * r + 1.0;
-		bpf_filter->A[i] = b * b / freq;
-		bpf_filter->d1[i] = 4.0 * a * (1.0 + b * r) / freq;
-		bpf_filter->d2[i] = 2.0 * (b * b - 2.0 * a * a - 1.0) / freq;
-		bpf_filter->d3[i] = 4.0 * a * (1.0 - b * r) / freq;
-		bpf_filter->d4[i] = -(b * b - 2.0 * b * r + 1.0) / freq;
+		// p = (1 - br + jbc) / (1 + br - jbc)
+		float den = (1.0 + b * r) * (1.0 + b * r) + b * b * c * c;
+		float p_re = ((1.0 - b * r) * (1.0 + b * r) - b * b * c * c) / den;
+		float p_im = 2.0 * b * c / den;
+
+		// discriminant (a(1 + p))^2 - 4p and its square root
+		float q_re = a * (1.0 + p_re), q_im = a * p_im;
+		float w_re = q_re * q_re - q_im * q_im - 4.0 * p_re;
+		float w_im = 2.0 * q_re * q_im - 4.0 * p_im;
+		float w_abs = sqrtf(w_re * w_re + w_im * w_im);
+		float v_re = sqrtf(0.5 * (w_abs + w_re));
+		float v_im = copysignf(sqrtf(0.5 * (w_abs - w_re)), w_im);
+
+		for (int k = 0; k < 2; ++k) {
+			float z_re = 0.5 * (q_re + (k ? v_re : -v_re));
+			float z_im = 0.5 * (q_im + (k ? v_im : -v_im));
+			BPF_biquad *section = &bpf_filter->sections[2 * i + k];
+			section->b0 = g;
+			section->b1 = 0.0;
+			section->b2 = -g;
+			section->a1 = -2.0 * z_re;
+			section->a2 = z_re * z_re + z_im * z_im;
+		}
 	}
 
 	return bpf_filter;
+#else
+	return NULL;
+#endif
 }
 
 /**
  * @brief Frees the memory allocated for a Bandpass Filter (BPF) object.
  *
- * This function frees the memory allocated for a Bandpass Filter (BPF) object.
- * It releases the memory occupied by the filter coefficients and intermediate
- * values, as well as the BPF object itself.
+ * This function frees the heap block holding a Bandpass Filter (BPF) object,
+ * its filter coefficients and intermediate values.
  *
- * @param bpf_filter Pointer to the BPF_filter object to be freed.
+ * @param bpf_filter Pointer to the BPF_filter object created by BPF_new.
  */
 void BPF_free(BPF_filter *bpf_filter) {
-	free(bpf_filter->A);
-	free(bpf_filter->d1);
-	free(bpf_filter->d2);
-	free(bpf_filter->d3);
-	free(bpf_filter->d4);
-	free(bpf_filter->w0);
-	free(bpf_filter->w1);
-	free(bpf_filter->w2);
-	free(bpf_filter->w3);
-	free(bpf_filter->w4);
 	free(bpf_filter);
-
 }
 
 /**
  * @brief Applies Bandpass Filtering to an input array.
  *
  * This function applies Bandpass Filtering to an input array using the given
- * Bandpass Filter (BPF) object. It iterates through the input array and updates
- * each element with the filtered value based on the BPF coefficients and
- * intermediate values.
+ * Bandpass Filter (BPF) object. The whole array goes through the sections
+ * two at a time, the second one lagging one sample behind the first so that
+ * their recursions do not wait on each other. Coefficients and state of both
+ * sections stay in local variables for the block and are written back once
+ * at its end.
+ *
+ * Every section of the Butterworth band-pass has the numerator b0 (1 - z^-2),
+ * b1 = 0 and b2 = -b0 (BPF_arenaNew, tools/bpf_tables.py), so only b0 x is
+ * computed: 3 multiplications and 3 additions a section instead of 5 and 4,
+ * with the same results.
  *
  * @param filter Pointer to the BPF_filter object.
  * @param array Pointer to the input array to be filtered.
  * @param array_size The size of the input array.
  */
 void BPF_process(BPF_filter *filter, float *array, int array_size) {
-	for (int i = 0; i < array_size; i++) {
-		for (int j = 0; j < filter->n; ++j) {
-			filter->w0[j] = filter->d1[j] * filter->w1[j]
-					+ filter->d2[j] * filter->w2[j]
-					+ filter->d3[j] * filter->w3[j]
-					+ filter->d4[j] * filter->w4[j] + array[i];
-			array[i] = filter->A[j]
-					* (filter->w0[j] - 2.0 * filter->w2[j] + filter->w4[j]);
-			filter->w4[j] = filter->w3[j];
-			filter->w3[j] = filter->w2[j];
-			filter->w2[j] = filter->w1[j];
-			filter->w1[j] = filter->w0[j];
+	if (array_size <= 0) {
+		return;
+	}
+	for (int j = 0; j < filter->n; j += 2) {
+		BPF_biquad *p = &filter->sections[j], *q = &filter->sections[j + 1];
+		float pb0 = p->b0, pa1 = p->a1, pa2 = p->a2;
+		float qb0 = q->b0, qa1 = q->a1, qa2 = q->a2;
+		float ps1 = p->s1, ps2 = p->s2, qs1 = q->s1, qs2 = q->s2;
+		// u is the output of the first section for the previous sample
+		float t = pb0 * array[0];
+		float u = t + ps1;
+		ps1 = ps2 - pa1 * u;
+		ps2 = -t - pa2 * u;
+		for (int i = 1; i < array_size; i++) {
+			float x = array[i];
+			t = qb0 * u;
+			float y = t + qs1;
+			qs1 = qs2 - qa1 * y;
+			qs2 = -t - qa2 * y;
+			array[i - 1] = y;
+			t = pb0 * x;
+			u = t + ps1;
+			ps1 = ps2 - pa1 * u;
+			ps2 = -t - pa2 * u;
 		}
+		t = qb0 * u;
+		float y = t + qs1;
+		qs1 = qs2 - qa1 * y;
+		qs2 = -t - qa2 * y;
+		array[array_size - 1] = y;
+		p->s1 = ps1;
+		p->s2 = ps2;
+		q->s1 = qs1;
+		q->s2 = qs2;
 	}
 }
 
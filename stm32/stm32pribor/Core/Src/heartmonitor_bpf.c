@@ -0,0 +1,41 @@
+/**
+ * @file heartmonitor_bpf.c
+ * @brief Band-pass filter tables generated by tools/bpf_tables.py, do not edit
+ *
+ * python tools/bpf_tables.py 4 25 0.8 8.5 2 2 0.1 0.7
+ */
+
+#include <heartmonitor.h>
+
+static const BPF_coefficients BPF_table_4_25_0p8_8p5_sections[4] = {
+	{ 0.706809738f, 0.0f, -0.706809738f, 0.812633455f, 0.544647795f },
+	{ 0.706809738f, 0.0f, -0.706809738f, -1.83021917f, 0.868891506f },
+	{ 0.603323436f, 0.0f, -0.603323436f, 0.511151287f, 0.109902545f },
+	{ 0.603323436f, 0.0f, -0.603323436f, -1.62705238f, 0.668026513f },
+};
+
+static const int32_t BPF_table_4_25_0p8_8p5_A[2] = { 134104987, 97710283 };
+static const int32_t BPF_table_4_25_0p8_8p5_d1[2] = { 273156085, 299547420 };
+static const int32_t BPF_table_4_25_0p8_8p5_d2[2] = { 19799269, 14425953 };
+static const int32_t BPF_table_4_25_0p8_8p5_d3[2] = { 78043455, -43659796 };
+static const int32_t BPF_table_4_25_0p8_8p5_d4[2] = { -127034353, -19707944 };
+
+static const BPF_coefficients BPF_table_2_2_0p1_0p7_sections[2] = {
+	{ 0.62556836f, 0.0f, -0.62556836f, 0.701384721f, 0.300602126f },
+	{ 0.62556836f, 0.0f, -0.62556836f, -1.55857491f, 0.651411602f },
+};
+
+static const int32_t BPF_table_2_2_0p1_0p7_A[1] = { 105048397 };
+static const int32_t BPF_table_2_2_0p1_0p7_d1[1] = { 230100238 };
+static const int32_t BPF_table_2_2_0p1_0p7_d2[1] = { 37888832 };
+static const int32_t BPF_table_2_2_0p1_0p7_d3[1] = { 3119431 };
+static const int32_t BPF_table_2_2_0p1_0p7_d4[1] = { -52563880 };
+
+const BPF_table BPF_tables[] = {
+	{ 4, 25.0f, 0.8f, 8.5f, BPF_table_4_25_0p8_8p5_sections,
+			BPF_table_4_25_0p8_8p5_A, BPF_table_4_25_0p8_8p5_d1, BPF_table_4_25_0p8_8p5_d2, BPF_table_4_25_0p8_8p5_d3, BPF_table_4_25_0p8_8p5_d4 },
+	{ 2, 2.0f, 0.1f, 0.7f, BPF_table_2_2_0p1_0p7_sections,
+			BPF_table_2_2_0p1_0p7_A, BPF_table_2_2_0p1_0p7_d1, BPF_table_2_2_0p1_0p7_d2, BPF_table_2_2_0p1_0p7_d3, BPF_table_2_2_0p1_0p7_d4 },
+};
+
+const int BPF_tables_size = sizeof(BPF_tables) / sizeof(BPF_tables[0]);
@@ -0,0 +1,46 @@
+/**
+ * @file heartmonitor_decimator.c
+ * @brief Decimation filter tables generated by tools/decimator_tables.py, do not edit
+ *
+ * python tools/decimator_tables.py 4 25 8.5 5 25 8.5 8 25 8.5
+ */
+
+#include <heartmonitor.h>
+
+// 47 taps, delay of 23 samples at 100 Hz
+static const float HR_decimatorTable_4_25_8p5_coefficients[48] = {
+	-0.000199522762f, 0.00137203544f, -0.0044311855f, 0.0110123291f, -0.0252312982f, 0.0718153649f, 0.223996329f, -0.0398303247f, 0.0166510806f, -0.00712961747f, 0.00258626465f, -0.000620982821f,
+	-0.000532243064f, 0.00270360497f, -0.00799955642f, 0.0191766849f, -0.0444413004f, 0.156099309f, 0.156099309f, -0.0444413004f, 0.0191766849f, -0.00799955642f, 0.00270360497f, -0.000532243064f,
+	-0.000620982821f, 0.00258626465f, -0.00712961747f, 0.0166510806f, -0.0398303247f, 0.223996329f, 0.0718153649f, -0.0252312982f, 0.0110123291f, -0.0044311855f, 0.00137203544f, -0.000199522762f,
+	0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.250006058f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+};
+
+// 59 taps, delay of 29 samples at 125 Hz
+static const float HR_decimatorTable_5_25_8p5_coefficients[60] = {
+	-0.000131548558f, 0.000893760316f, -0.00287122584f, 0.0071040864f, -0.0161536946f, 0.0445436001f, 0.186545918f, -0.0279160887f, 0.011617161f, -0.00503972851f, 0.00188170681f, -0.000484207175f,
+	-0.000356999309f, 0.00188811951f, -0.00564914338f, 0.0135667279f, -0.0310331978f, 0.0981831839f, 0.149543675f, -0.0371784253f, 0.0159759561f, -0.00681145354f, 0.00241722377f, -0.00054476613f,
+	-0.00054476613f, 0.00241722377f, -0.00681145354f, 0.0159759561f, -0.0371784253f, 0.149543675f, 0.0981831839f, -0.0310331978f, 0.0135667279f, -0.00564914338f, 0.00188811951f, -0.000356999309f,
+	-0.000484207175f, 0.00188170681f, -0.00503972851f, 0.011617161f, -0.0279160887f, 0.186545918f, 0.0445436001f, -0.0161536946f, 0.0071040864f, -0.00287122584f, 0.000893760316f, -0.000131548558f,
+	0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.20001872f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+};
+
+// 93 taps, delay of 46 samples at 200 Hz
+static const float HR_decimatorTable_8_25_8p5_coefficients[96] = {
+	-9.97552791e-05f, 0.000685975759f, -0.00221545724f, 0.00550582779f, -0.0126148775f, 0.0359054862f, 0.111991314f, -0.0199139442f, 0.00832503108f, -0.00356459069f, 0.00129305323f, -0.000310472419f,
+	-0.000183098862f, 0.00106237089f, -0.00327621147f, 0.00798668593f, -0.0183644716f, 0.0570552366f, 0.0969594154f, -0.0230453597f, 0.00981739234f, -0.00415432808f, 0.00145727484f, -0.000319657168f,
+	-0.000266105255f, 0.0013517198f, -0.00399953357f, 0.00958775598f, -0.0222192911f, 0.0780448806f, 0.0780448806f, -0.0222192911f, 0.00958775598f, -0.00399953357f, 0.0013517198f, -0.000266105255f,
+	-0.000319657168f, 0.00145727484f, -0.00415432808f, 0.00981739234f, -0.0230453597f, 0.0969594154f, 0.0570552366f, -0.0183644716f, 0.00798668593f, -0.00327621147f, 0.00106237089f, -0.000183098862f,
+	-0.000310472419f, 0.00129305323f, -0.00356459069f, 0.00832503108f, -0.0199139442f, 0.111991314f, 0.0359054862f, -0.0126148775f, 0.00550582779f, -0.00221545724f, 0.000685975759f, -9.97552791e-05f,
+	-0.000209187434f, 0.000806565261f, -0.00215724833f, 0.00499219118f, -0.0122591033f, 0.121659976f, 0.0163934046f, -0.00614181504f, 0.00268026833f, -0.00105524556f, 0.000310236514f, 0.0f,
+	0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.124995383f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+	0.000310236514f, -0.00105524556f, 0.00268026833f, -0.00614181504f, 0.0163934046f, 0.121659976f, -0.0122591033f, 0.00499219118f, -0.00215724833f, 0.000806565261f, -0.000209187434f, 0.0f,
+};
+
+const HR_DecimatorTable HR_decimatorTables[] = {
+	{ 4, 25.0f, 8.5f, 12, 23, HR_decimatorTable_4_25_8p5_coefficients },
+	{ 5, 25.0f, 8.5f, 12, 29, HR_decimatorTable_5_25_8p5_coefficients },
+	{ 8, 25.0f, 8.5f, 12, 46, HR_decimatorTable_8_25_8p5_coefficients },
+};
+
+const int HR_decimatorTables_size = sizeof(HR_decimatorTables)
+		/ sizeof(HR_decimatorTables[0]);
@@ -0,0 +1,726 @@
+/**
+ * @file heartmonitor_fixed.c
+ * @brief Fixed-point Heart Monitoring functions
+ */
+
+#include <heartmonitor_fixed.h>
+#include <trace.h>
+#include <math.h>
+#include <malloc.h>
+#include <string.h>
+
+/**
+ * @brief Rounding offset for a right shift by HRQ_COEF_FRAC.
+ */
+#define HRQ_COEF_ROUND ((int64_t) 1 << (HRQ_COEF_FRAC - 1))
+
+/**
+ * @brief Converts a float sample to Q8.23.
+ *
+ * The conversion works on the IEEE 754 representation with integer operations
+ * only, so no soft-float call is made. The result is rounded to nearest (ties
+ * away from zero) and saturated; NaN is converted to 0.
+ *
+ * @param value Sample.
+ * @return Q8.23 sample.
+ */
+int32_t HRQ_fromFloat(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	int exponent = (bits >> 23) & 0xFF;
+	int negative = bits >> 31;
+	if (exponent == 0xFF && (bits & 0x7FFFFF) != 0) {
+		return 0;
+	}
+	if (exponent >= 127 + 31 - HRQ_FRAC) {
+		// |value| >= 2^(31 - HRQ_FRAC)
+		return negative ? INT32_MIN : INT32_MAX;
+	}
+	// value = mantissa * 2^(exponent - 150), result = value * 2^HRQ_FRAC
+	int shift = 150 - HRQ_FRAC - exponent;
+	if (shift > 24) {
+		// |value| < half of the least significant bit, also zeros and subnormals
+		return 0;
+	}
+	uint32_t mantissa = (bits & 0x7FFFFF) | 0x800000;
+	uint32_t magnitude;
+	if (shift > 0) {
+		magnitude = (mantissa + ((uint32_t) 1 << (shift - 1))) >> shift;
+	} else {
+		magnitude = mantissa << -shift;
+	}
+	return negative ? -(int32_t) magnitude : (int32_t) magnitude;
+}
+
+/**
+ * @brief Converts a Q8.23 sample to float.
+ *
+ * The IEEE 754 representation is built with integer operations only (CLZ).
+ * The result is exact for |value| < 2 and rounded to nearest above.
+ *
+ * @param value Q8.23 sample.
+ * @return Sample.
+ */
+float HRQ_toFloat(int32_t value) {
+	if (value == 0) {
+		return 0.0f;
+	}
+	uint32_t sign = value < 0 ? 0x80000000u : 0;
+	uint32_t magnitude = value < 0 ? -(uint32_t) value : (uint32_t) value;
+	int position = 31 - __builtin_clz(magnitude);
+	if (position > 23) {
+		int shift = position - 23;
+		magnitude = (magnitude + ((uint32_t) 1 << (shift - 1))) >> shift;
+		if (magnitude >> 24) {
+			magnitude >>= 1;
+			position++;
+		}
+	} else {
+		magnitude <<= 23 - position;
+	}
+	uint32_t bits = sign | (uint32_t) (position + 127 - HRQ_FRAC) << 23
+			| (magnitude & 0x7FFFFF);
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+/**
+ * @brief Converts an array of float samples to Q8.23.
+ *
+ * @param array      Pointer to the float samples.
+ * @param result     Pointer to the array for Q8.23 samples.
+ * @param array_size Number of samples.
+ */
+void HRQ_fromFloatArray(float *array, int32_t *result, int array_size) {
+	for (int i = 0; i < array_size; i++) {
+		result[i] = HRQ_fromFloat(array[i]);
+	}
+}
+
+/**
+ * @brief Converts an array of Q8.23 samples to float.
+ *
+ * @param array      Pointer to the Q8.23 samples.
+ * @param result     Pointer to the array for float samples.
+ * @param array_size Number of samples.
+ */
+void HRQ_toFloatArray(int32_t *array, float *result, int array_size) {
+	for (int i = 0; i < array_size; i++) {
+		result[i] = HRQ_toFloat(array[i]);
+	}
+}
+
+/**
+ * @brief Creates a new fixed-point Bandpass Filter (BPF) object.
+ *
+ * The coefficients of the 4th order sections come from BPF_tables or, with
+ * HR_BPF_RUNTIME_DESIGN, are designed in float and then quantized, so float
+ * math is used only here.
+ *
+ * @param order The order of the bandpass filter.
+ * @param freq The sampling frequency.
+ * @param low The lower cutoff frequency.
+ * @param high The higher cutoff frequency.
+ *
+ * @return Pointer to the newly created HRQ_BPF_filter object or NULL.
+ */
+HRQ_BPF_filter* HRQ_BPF_new(int order, float freq, float low, float high) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(HRQ_BPF_FOOTPRINT(order)),
+			HRQ_BPF_FOOTPRINT(order));
+	HRQ_BPF_filter *bpf_filter = HRQ_BPF_arenaNew(&arena, order, freq, low,
+			high);
+	if (bpf_filter == NULL) {
+		free(arena.base);
+	}
+	return bpf_filter;
+}
+
+/**
+ * @brief Creates a new fixed-point Bandpass Filter (BPF) object in an arena from a generated table.
+ *
+ * The coefficients stay in the table, only the state is taken from the arena.
+ *
+ * @param arena Pointer to the arena with at least HRQ_BPF_FOOTPRINT bytes left.
+ * @param table Pointer to the table of the filter.
+ *
+ * @return Pointer to the newly created HRQ_BPF_filter object or NULL if the arena is too small.
+ */
+HRQ_BPF_filter* HRQ_BPF_tableArenaNew(HR_Arena *arena, const BPF_table *table) {
+	if (!HR_arena_fits(arena, HRQ_BPF_FOOTPRINT(table->order))) {
+		return NULL;
+	}
+	HRQ_BPF_filter *bpf_filter = (HRQ_BPF_filter*) HR_arena_alloc(arena,
+			sizeof(HRQ_BPF_filter));
+
+	bpf_filter->n = table->order / 2;
+	size_t n_size = bpf_filter->n * sizeof(int32_t);
+	bpf_filter->A = table->A;
+	bpf_filter->d1 = table->d1;
+	bpf_filter->d2 = table->d2;
+	bpf_filter->d3 = table->d3;
+	bpf_filter->d4 = table->d4;
+
+	bpf_filter->w1 = (int32_t*) HR_arena_alloc(arena, n_size);
+	bpf_filter->w2 = (int32_t*) HR_arena_alloc(arena, n_size);
+	bpf_filter->w3 = (int32_t*) HR_arena_alloc(arena, n_size);
+	bpf_filter->w4 = (int32_t*) HR_arena_alloc(arena, n_size);
+
+	return bpf_filter;
+}
+
+/**
+ * @brief Creates a new fixed-point Bandpass Filter (BPF) object in an arena.
+ *
+ * @param arena Pointer to the arena with at least HRQ_BPF_FOOTPRINT bytes left.
+ * @param order The order of the bandpass filter.
+ * @param freq The sampling frequency.
+ * @param low The lower cutoff frequency.
+ * @param high The higher cutoff frequency.
+ *
+ * @return Pointer to the newly created HRQ_BPF_filter object or NULL if the arena is too small
+ * or the filter can not be made.
+ */
+HRQ_BPF_filter* HRQ_BPF_arenaNew(HR_Arena *arena, int order, float freq,
+		float low, float high) {
+	const BPF_table *table = BPF_findTable(order, freq, low, high);
+	if (table != NULL) {
+		return HRQ_BPF_tableArenaNew(arena, table);
+	}
+#ifdef HR_BPF_RUNTIME_DESIGN
+	if (!HR_arena_fits(arena, HRQ_BPF_FOOTPRINT(order))) {
+		return NULL;
+	}
+	HRQ_BPF_filter *bpf_filter = (HRQ_BPF_filter*) HR_arena_alloc(arena,
+			sizeof(HRQ_BPF_filter));
+
+	float a, b, r;
+	a = cosf(M_PI * (high + low) / freq) / cosf(M_PI * (high - low) / freq);
+	b = tanf(M_PI * (high - low) / freq);
+
+	bpf_filter->n = order / 2;
+	size_t n_size = bpf_filter->n * sizeof(int32_t);
+	int32_t *A = (int32_t*) HR_arena_alloc(arena, n_size);
+	int32_t *d1 = (int32_t*) HR_arena_alloc(arena, n_size);
+	int32_t *d2 = (int32_t*) HR_arena_alloc(arena, n_size);
+	int32_t *d3 = (int32_t*) HR_arena_alloc(arena, n_size);
+	int32_t *d4 = (int32_t*) HR_arena_alloc(arena, n_size);
+
+	bpf_filter->w1 = (int32_t*) HR_arena_alloc(arena, n_size);
+	bpf_filter->w2 = (int32_t*) HR_arena_alloc(arena, n_size);
+	bpf_filter->w3 = (int32_t*) HR_arena_alloc(arena, n_size);
+	bpf_filter->w4 = (int32_t*) HR_arena_alloc(arena, n_size);
+
+	const float scale = (float) ((int32_t) 1 << HRQ_COEF_FRAC);
+	for (int i = 0; i < bpf_filter->n; ++i) {
+		r = sinf(M_PI * (2.0 * i + 1.0) / (4.0 * bpf_filter->n));
+		freq = b * b + 2.0 * b * r + 1.0;
+		A[i] = lrintf(scale * (b * b / freq));
+		d1[i] = lrintf(scale * (4.0 * a * (1.0 + b * r) / freq));
+		d2[i] = lrintf(scale * (2.0 * (b * b - 2.0 * a * a - 1.0) / freq));
+		d3[i] = lrintf(scale * (4.0 * a * (1.0 - b * r) / freq));
+		d4[i] = lrintf(scale * (-(b * b - 2.0 * b * r + 1.0) / freq));
+	}
+	bpf_filter->A = A;
+	bpf_filter->d1 = d1;
+	bpf_filter->d2 = d2;
+	bpf_filter->d3 = d3;
+	bpf_filter->d4 = d4;
+
+	return bpf_filter;
+#else
+	return NULL;
+#endif
+}
+
+/**
+ * @brief Frees the heap block holding a fixed-point Bandpass Filter (BPF) object.
+ *
+ * @param bpf_filter Pointer to the HRQ_BPF_filter object created by HRQ_BPF_new.
+ */
+void HRQ_BPF_free(HRQ_BPF_filter *bpf_filter) {
+	free(bpf_filter);
+}
+
+/**
+ * @brief Applies fixed-point Bandpass Filtering to an input array.
+ *
+ * Same recursion as BPF_process. Every multiply-add goes to a 64-bit
+ * accumulator (SMULL/SMLAL on Cortex-M3) and is rounded back to Q8.23.
+ *
+ * @param filter Pointer to the HRQ_BPF_filter object.
+ * @param array Pointer to the Q8.23 input array to be filtered.
+ * @param array_size The size of the input array.
+ */
+void HRQ_BPF_process(HRQ_BPF_filter *filter, int32_t *array, int array_size) {
+	for (int i = 0; i < array_size; i++) {
+		int32_t x = array[i];
+		for (int j = 0; j < filter->n; ++j) {
+			int64_t acc = (int64_t) filter->d1[j] * filter->w1[j]
+					+ (int64_t) filter->d2[j] * filter->w2[j]
+					+ (int64_t) filter->d3[j] * filter->w3[j]
+					+ (int64_t) filter->d4[j] * filter->w4[j];
+			int32_t w0 = (int32_t) ((acc + HRQ_COEF_ROUND) >> HRQ_COEF_FRAC)
+					+ x;
+			acc = (int64_t) filter->A[j]
+					* (w0 - 2 * filter->w2[j] + filter->w4[j]);
+			x = (int32_t) ((acc + HRQ_COEF_ROUND) >> HRQ_COEF_FRAC);
+			filter->w4[j] = filter->w3[j];
+			filter->w3[j] = filter->w2[j];
+			filter->w2[j] = filter->w1[j];
+			filter->w1[j] = w0;
+		}
+		array[i] = x;
+	}
+}
+
+/**
+ * @brief Creates a new fixed-point Moving Average (MA) filter object.
+ *
+ * @param window_size The size of the moving average window.
+ * @return Pointer to the newly created HRQ_MA_filter object.
+ */
+HRQ_MA_filter* HRQ_MA_new(int window_size) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(HRQ_MA_FOOTPRINT(window_size)),
+			HRQ_MA_FOOTPRINT(window_size));
+	return HRQ_MA_arenaNew(&arena, window_size);
+}
+
+/**
+ * @brief Creates a new fixed-point Moving Average (MA) filter object in an arena.
+ *
+ * @param arena       Pointer to the arena with at least HRQ_MA_FOOTPRINT bytes left.
+ * @param window_size The size of the moving average window.
+ * @return Pointer to the newly created HRQ_MA_filter object or NULL if the arena is too small.
+ */
+HRQ_MA_filter* HRQ_MA_arenaNew(HR_Arena *arena, int window_size) {
+	if (!HR_arena_fits(arena, HRQ_MA_FOOTPRINT(window_size))) {
+		return NULL;
+	}
+	HRQ_MA_filter *filter = (HRQ_MA_filter*) HR_arena_alloc(arena,
+			sizeof(HRQ_MA_filter));
+	filter->window_size = window_size;
+	filter->data = (int32_t*) HR_arena_alloc(arena,
+			window_size * sizeof(int32_t));
+	return filter;
+}
+
+/**
+ * @brief Frees the heap block holding a fixed-point Moving Average (MA) filter object.
+ *
+ * @param filter Pointer to the HRQ_MA_filter object created by HRQ_MA_new.
+ */
+void HRQ_MA_free(HRQ_MA_filter *filter) {
+	free(filter);
+}
+
+/**
+ * @brief Applies the fixed-point Moving Average (MA) filter to an array of Q8.23 values.
+ *
+ * The running sum is a 32-bit accumulator: the sum of the window must stay
+ * below 256 (see HRQ_SSF_MAX). The cost does not depend on the window size.
+ *
+ * @param filter Pointer to the HRQ_MA_filter object.
+ * @param array  Pointer to the array of Q8.23 values to be filtered.
+ * @param array_size The size of the array.
+ */
+void HRQ_MA_process(HRQ_MA_filter *filter, int32_t *array, int array_size) {
+	for (int i = 0; i < array_size; i++) {
+		filter->sum += array[i] - filter->data[filter->head];
+		filter->data[filter->head] = array[i];
+		filter->head++;
+		if (filter->head == filter->window_size) {
+			filter->head = 0;
+		}
+		array[i] = filter->sum / filter->window_size;
+	}
+}
+
+/**
+ * @brief Creates a new fixed-point Slope Sum Function (SSF) object.
+ *
+ * The history of the window starts zeroed.
+ *
+ * @param window_size The size of the SSF window.
+ * @return Pointer to the newly created HRQ_SSF object.
+ */
+HRQ_SSF* HRQ_SSF_new(int window_size) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(HRQ_SSF_FOOTPRINT(window_size)),
+			HRQ_SSF_FOOTPRINT(window_size));
+	return HRQ_SSF_arenaNew(&arena, window_size);
+}
+
+/**
+ * @brief Creates a new fixed-point Slope Sum Function (SSF) object in an arena.
+ *
+ * @param arena       Pointer to the arena with at least HRQ_SSF_FOOTPRINT bytes left.
+ * @param window_size The size of the SSF window.
+ * @return Pointer to the newly created HRQ_SSF object or NULL if the arena is too small.
+ */
+HRQ_SSF* HRQ_SSF_arenaNew(HR_Arena *arena, int window_size) {
+	if (!HR_arena_fits(arena, HRQ_SSF_FOOTPRINT(window_size))) {
+		return NULL;
+	}
+	HRQ_SSF *ssf = (HRQ_SSF*) HR_arena_alloc(arena, sizeof(HRQ_SSF));
+	ssf->window_size = window_size;
+	ssf->data = (uint32_t*) HR_arena_alloc(arena,
+			window_size * sizeof(uint32_t));
+	return ssf;
+}
+
+/**
+ * @brief Frees the heap block holding a fixed-point Slope Sum Function (SSF) object.
+ *
+ * @param ssf Pointer to the HRQ_SSF object created by HRQ_SSF_new.
+ */
+void HRQ_SSF_free(HRQ_SSF *ssf) {
+	free(ssf);
+}
+
+/**
+ * @brief Calculates the fixed-point Slope Sum Function (SSF) of an input array.
+ *
+ * Same as SSF_process. The running sum is 64-bit and the output is saturated
+ * to HRQ_SSF_MAX.
+ *
+ * @param ssf Pointer to the HRQ_SSF object.
+ * @param array Pointer to the Q8.23 input array.
+ * @param array_size Size of the input array.
+ */
+void HRQ_SSF_process(HRQ_SSF *ssf, int32_t *array, int array_size) {
+	int pairs = ssf->window_size - 1;
+	if (pairs < 1) {
+		memset(array, 0, array_size * sizeof(int32_t));
+		return;
+	}
+	for (int i = 0; i < array_size; i++) {
+		uint32_t delta = 0;
+		if (array[i] > ssf->previous) {
+			delta = (uint32_t) array[i] - (uint32_t) ssf->previous;
+		}
+		ssf->previous = array[i];
+		ssf->sum += (int64_t) delta - ssf->data[ssf->head];
+		ssf->data[ssf->head] = delta;
+		ssf->head++;
+		if (ssf->head == pairs) {
+			ssf->head = 0;
+		}
+		array[i] = ssf->sum < HRQ_SSF_MAX ? (int32_t) ssf->sum : HRQ_SSF_MAX;
+	}
+}
+
+/**
+ * @brief Creates a new HRQ_GreenPreprocess structure.
+ *
+ * The structure, the BPF, SSF and MA are placed in a single heap block of
+ * HRQ_GREENPREPROCESS_FOOTPRINT bytes.
+ *
+ * @param freq       Frequency of the heart monitor.
+ * @param bpf_order  Order of the Band-Pass Filter (BPF).
+ * @param bpf_low    Lower cutoff frequency of the BPF.
+ * @param bpf_high   Upper cutoff frequency of the BPF.
+ * @param ssf_size   Size of the Slope Sum Function (SSF).
+ *
+ * @return Pointer to the newly created HRQ_GreenPreprocess structure or NULL.
+ */
+HRQ_GreenPreprocess* HRQ_greenPreprocess_new(float freq, int bpf_order,
+		float bpf_low, float bpf_high, int ssf_size) {
+	size_t footprint = HRQ_GREENPREPROCESS_FOOTPRINT(bpf_order, ssf_size);
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(footprint), footprint);
+	HRQ_GreenPreprocess *greenPreprocess = HRQ_greenPreprocess_arenaNew(&arena,
+			freq, bpf_order, bpf_low, bpf_high, ssf_size);
+	if (greenPreprocess == NULL) {
+		free(arena.base);
+	}
+	return greenPreprocess;
+}
+
+/**
+ * @brief Creates a new HRQ_GreenPreprocess structure in an arena.
+ *
+ * @param arena      Pointer to the arena with at least HRQ_GREENPREPROCESS_FOOTPRINT bytes left.
+ * @param freq       Frequency of the heart monitor.
+ * @param bpf_order  Order of the Band-Pass Filter (BPF).
+ * @param bpf_low    Lower cutoff frequency of the BPF.
+ * @param bpf_high   Upper cutoff frequency of the BPF.
+ * @param ssf_size   Size of the Slope Sum Function (SSF).
+ *
+ * @return Pointer to the newly created HRQ_GreenPreprocess structure or NULL if the arena is too small
+ * or there is no BPF_tables entry for the band-pass filter.
+ */
+HRQ_GreenPreprocess* HRQ_greenPreprocess_arenaNew(HR_Arena *arena, float freq,
+		int bpf_order, float bpf_low, float bpf_high, int ssf_size) {
+	if (!HR_arena_fits(arena,
+			HRQ_GREENPREPROCESS_FOOTPRINT(bpf_order, ssf_size))) {
+		return NULL;
+	}
+	HRQ_GreenPreprocess *greenPreprocess =
+			(HRQ_GreenPreprocess*) HR_arena_alloc(arena,
+					sizeof(HRQ_GreenPreprocess));
+	greenPreprocess->bpf_green = HRQ_BPF_arenaNew(arena, bpf_order, freq,
+			bpf_low, bpf_high);
+	if (greenPreprocess->bpf_green == NULL) {
+		return NULL;
+	}
+	for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+		greenPreprocess->bpf_motion[axis] = BPF_arenaNew(arena, bpf_order, freq,
+				bpf_low, bpf_high);
+		if (greenPreprocess->bpf_motion[axis] == NULL) {
+			return NULL;
+		}
+	}
+	greenPreprocess->nlms_green = NLMS_arenaNew(arena, HR_NLMS_TAPS,
+			HR_NLMS_MU, HR_NLMS_EPSILON);
+	greenPreprocess->ssf_green = HRQ_SSF_arenaNew(arena, ssf_size);
+	greenPreprocess->ma_green = HRQ_MA_arenaNew(arena, HR_GREEN_MA_SIZE);
+	return greenPreprocess;
+}
+
+/**
+ * @brief Frees the heap block holding the HRQ_GreenPreprocess structure.
+ *
+ * @param greenPreprocess Pointer to the HRQ_GreenPreprocess structure created by HRQ_greenPreprocess_new.
+ */
+void HRQ_greenPreprocess_free(HRQ_GreenPreprocess *greenPreprocess) {
+	free(greenPreprocess);
+}
+
+/**
+ * @brief Processes fixed-point green channel data using the HRQ_GreenPreprocess structure.
+ *
+ * Applies Band-Pass Filtering (BPF), Slope Sum Function (SSF) and Moving Average (MA).
+ *
+ * @param greenPreprocess Pointer to the HRQ_GreenPreprocess structure.
+ * @param array           Pointer to the Q8.23 green channel data array.
+ * @param array_size      Size of the green channel data array.
+ */
+void HRQ_greenPreprocess_process(HRQ_GreenPreprocess *greenPreprocess,
+		int32_t *array, int array_size) {
+	HRQ_greenPreprocess_processMotion(greenPreprocess, array, NULL,
+			array_size);
+}
+
+/**
+ * @brief Processes fixed-point green channel data with an accelerometer reference.
+ *
+ * Same as HRQ_greenPreprocess_process, with the NLMS motion canceller between the BPF and the
+ * SSF. The canceller divides by the reference power on every sample, so it runs in float on
+ * blocks of HRQ_BLOCK_SIZE samples converted from and back to Q8.23.
+ *
+ * @param greenPreprocess Pointer to the HRQ_GreenPreprocess structure.
+ * @param array           Pointer to the Q8.23 green channel data array.
+ * @param motion          HR_MOTION_AXES pointers to the accelerometer samples in g, band-passed
+ *                        in place, or NULL to skip the motion canceller.
+ * @param array_size      Size of the green channel data array and of every motion array.
+ */
+void HRQ_greenPreprocess_processMotion(HRQ_GreenPreprocess *greenPreprocess,
+		int32_t *array, float **motion, int array_size) {
+	HRQ_BPF_process(greenPreprocess->bpf_green, array, array_size);
+	TRACE_PROBE_Q(TRACE_GREEN_BPF, array, array_size);
+	if (motion != NULL) {
+		float block[HRQ_BLOCK_SIZE];
+		float *reference[HR_MOTION_AXES];
+		for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+			BPF_process(greenPreprocess->bpf_motion[axis], motion[axis],
+					array_size);
+		}
+		TRACE_PROBE(TRACE_MOTION_X, motion[0], array_size);
+		TRACE_PROBE(TRACE_MOTION_Y, motion[1], array_size);
+		TRACE_PROBE(TRACE_MOTION_Z, motion[2], array_size);
+		for (int start = 0; start < array_size; start += HRQ_BLOCK_SIZE) {
+			int block_size = array_size - start;
+			if (block_size > HRQ_BLOCK_SIZE) {
+				block_size = HRQ_BLOCK_SIZE;
+			}
+			for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+				reference[axis] = motion[axis] + start;
+			}
+			HRQ_toFloatArray(array + start, block, block_size);
+			NLMS_process(greenPreprocess->nlms_green, block, reference,
+					block_size);
+			HRQ_fromFloatArray(block, array + start, block_size);
+		}
+		TRACE_PROBE_Q(TRACE_GREEN_NLMS, array, array_size);
+	}
+	HRQ_SSF_process(greenPreprocess->ssf_green, array, array_size);
+	HRQ_MA_process(greenPreprocess->ma_green, array, array_size);
+	TRACE_PROBE_Q(TRACE_GREEN_PULSE, array, array_size);
+}
+
+/**
+ * @brief Creates a new HRQ_Ring circular buffer.
+ *
+ * The window is initially filled with zeros.
+ *
+ * @param size Number of samples in the window.
+ * @return Pointer to the newly created HRQ_Ring structure.
+ */
+HRQ_Ring* HRQ_ring_new(int size) {
+	HR_Arena arena;
+	HR_arena_init(&arena, malloc(HRQ_RING_FOOTPRINT(size)),
+			HRQ_RING_FOOTPRINT(size));
+	return HRQ_ring_arenaNew(&arena, size);
+}
+
+/**
+ * @brief Creates a new HRQ_Ring circular buffer in an arena.
+ *
+ * @param arena Pointer to the arena with at least HRQ_RING_FOOTPRINT bytes left.
+ * @param size  Number of samples in the window.
+ * @return Pointer to the newly created HRQ_Ring structure or NULL if the arena is too small.
+ */
+HRQ_Ring* HRQ_ring_arenaNew(HR_Arena *arena, int size) {
+	if (!HR_arena_fits(arena, HRQ_RING_FOOTPRINT(size))) {
+		return NULL;
+	}
+	HRQ_Ring *ring = (HRQ_Ring*) HR_arena_alloc(arena, sizeof(HRQ_Ring));
+	ring->size = size;
+	ring->head = 0;
+	ring->data = (int32_t*) HR_arena_alloc(arena, 2 * size * sizeof(int32_t));
+	return ring;
+}
+
+/**
+ * @brief Frees the heap block holding the HRQ_Ring structure and its storage.
+ *
+ * @param ring Pointer to the HRQ_Ring structure created by HRQ_ring_new.
+ */
+void HRQ_ring_free(HRQ_Ring *ring) {
+	free(ring);
+}
+
+/**
+ * @brief Appends a Q8.23 sample to the HRQ_Ring, dropping the oldest one.
+ *
+ * @param ring  Pointer to the HRQ_Ring structure.
+ * @param value Sample to append.
+ */
+void HRQ_ring_push(HRQ_Ring *ring, int32_t value) {
+	ring->data[ring->head] = value;
+	ring->data[ring->head + ring->size] = value;
+	ring->head++;
+	if (ring->head == ring->size) {
+		ring->head = 0;
+	}
+}
+
+/**
+ * @brief Converts float samples to Q8.23 and appends them to the HRQ_Ring.
+ *
+ * @param ring       Pointer to the HRQ_Ring structure.
+ * @param array      Pointer to the float samples.
+ * @param array_size Number of samples.
+ */
+void HRQ_ring_pushFloatArray(HRQ_Ring *ring, float *array, int array_size) {
+	for (int i = 0; i < array_size; i++) {
+		HRQ_ring_push(ring, HRQ_fromFloat(array[i]));
+	}
+}
+
+/**
+ * @brief Returns the current window of the HRQ_Ring as a contiguous array.
+ *
+ * @param ring Pointer to the HRQ_Ring structure.
+ * @return Pointer to 'size' samples ordered from the oldest to the newest.
+ */
+int32_t* HRQ_ring_window(HRQ_Ring *ring) {
+	return ring->data + ring->head;
+}
+
+/**
+ * @brief Extrema of one fixed-point channel found while scanning the beats of a window.
+ *
+ * Same single pass as HR_BeatScan. Both sums are doubled (the DC of a beat is
+ * the mean of two minima) and not divided by the number of beats: the factors
+ * cancel in the ratio.
+ */
+typedef struct {
+	int min; /**< Index of the minimum of the current beat */
+	int before; /**< Index of the maximum before the minimum or -1 */
+	int after; /**< Index of the maximum from the minimum on */
+	int previous_min; /**< Index of the minimum of the previous beat */
+	int previous_after; /**< Index of the maximum after the minimum of the previous beat */
+	int64_t AC; /**< Doubled sum of the AC components */
+	int64_t DC; /**< Doubled sum of the DC components */
+} HRQ_BeatScan;
+
+static inline void HRQ_beatScan_start(HRQ_BeatScan *scan, int start) {
+	scan->min = start;
+	scan->before = -1;
+	scan->after = start;
+}
+
+static inline void HRQ_beatScan_step(HRQ_BeatScan *scan, int32_t *array,
+		int i) {
+	if (array[i] < array[scan->min]) {
+		if (scan->before < 0 || array[scan->after] > array[scan->before]) {
+			scan->before = scan->after;
+		}
+		scan->min = i;
+		scan->after = i;
+	} else if (array[i] > array[scan->after]) {
+		scan->after = i;
+	}
+}
+
+static inline void HRQ_beatScan_end(HRQ_BeatScan *scan, int32_t *array,
+		int beat) {
+	if (beat > 0) {
+		int max = scan->previous_after;
+		if (scan->before >= 0 && array[scan->before] > array[max]) {
+			max = scan->before;
+		}
+		int64_t dc_now = (int64_t) array[scan->previous_min] + array[scan->min];
+		scan->AC += 2 * (int64_t) array[max] - dc_now;
+		scan->DC += dc_now;
+	}
+	scan->previous_min = scan->min;
+	scan->previous_after = scan->after;
+}
+
+/**
+ * @brief Calculates the red/infrared ratio from fixed-point windows and indexed peaks.
+ *
+ * Fixed-point counterpart of HR_heartMonitor_ratioFromIndexedPeaks: minima,
+ * maxima and the AC and DC sums of both channels are found with integer
+ * operations in a single pass, only the final ratio
+ * (AC_red / DC_red) / (AC_ir / DC_ir) and the perfusion index are formed in float.
+ *
+ * @param red        Pointer to the Q8.23 red channel window.
+ * @param ir         Pointer to the Q8.23 infrared channel window.
+ * @param peaks      Pointer to the array of indexed peaks.
+ * @param peaks_size Size of the array of indexed peaks.
+ * @param perfusion  Pointer to store the perfusion index in percent or NULL.
+ * @return Ratio calculated from the indexed peaks or NaN.
+ */
+float HRQ_ratioFromIndexedPeaks(int32_t *red, int32_t *ir, int *peaks,
+		int peaks_size, float *perfusion) {
+	if (perfusion != NULL) {
+		*perfusion = nanf("");
+	}
+	if (peaks_size < 3) {
+		return nanf("");
+	}
+	HRQ_BeatScan scan_red = { .AC = 0, .DC = 0 };
+	HRQ_BeatScan scan_ir = { .AC = 0, .DC = 0 };
+	for (int beat = 0; beat < peaks_size - 1; beat++) {
+		HRQ_beatScan_start(&scan_red, peaks[beat]);
+		HRQ_beatScan_start(&scan_ir, peaks[beat]);
+		for (int i = peaks[beat] + 1; i < peaks[beat + 1]; i++) {
+			HRQ_beatScan_step(&scan_red, red, i);
+			HRQ_beatScan_step(&scan_ir, ir, i);
+		}
+		HRQ_beatScan_end(&scan_red, red, beat);
+		HRQ_beatScan_end(&scan_ir, ir, beat);
+	}
+
+	float ratio_ir = (float) scan_ir.AC / (float) scan_ir.DC;
+	if (perfusion != NULL) {
+		*perfusion = 100.0f * ratio_ir;
+	}
+	return ((float) scan_red.AC / (float) scan_red.DC) / ratio_ir;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file heartmonitor_tables.c
+ * @brief Heart monitor tables generated by tools/monitor_tables.py, do not edit
+ *
+ * python tools/monitor_tables.py 100 25
+ */
+
+#include <heartmonitor.h>
+
+static const float HR_spectrumTable_100_25_window[100] = {
+	0.0f, 0.000986635786f, 0.00394264934f, 0.00885637464f, 0.0157084194f, 0.0244717419f, 0.0351117571f, 0.0475864738f,
+	0.06184666f, 0.0778360372f, 0.0954915028f, 0.114743379f, 0.135515686f, 0.157726447f, 0.181288005f, 0.206107374f,
+	0.232086603f, 0.259123163f, 0.287110354f, 0.315937724f, 0.345491503f, 0.375655056f, 0.406309343f, 0.437333383f,
+	0.46860474f, 0.5f, 0.53139526f, 0.562666617f, 0.593690657f, 0.624344944f, 0.654508497f, 0.684062276f,
+	0.712889646f, 0.740876837f, 0.767913397f, 0.793892626f, 0.818711995f, 0.842273553f, 0.864484314f, 0.885256621f,
+	0.904508497f, 0.922163963f, 0.93815334f, 0.952413526f, 0.964888243f, 0.975528258f, 0.984291581f, 0.991143625f,
+	0.996057351f, 0.999013364f, 1.0f, 0.999013364f, 0.996057351f, 0.991143625f, 0.984291581f, 0.975528258f,
+	0.964888243f, 0.952413526f, 0.93815334f, 0.922163963f, 0.904508497f, 0.885256621f, 0.864484314f, 0.842273553f,
+	0.818711995f, 0.793892626f, 0.767913397f, 0.740876837f, 0.712889646f, 0.684062276f, 0.654508497f, 0.624344944f,
+	0.593690657f, 0.562666617f, 0.53139526f, 0.5f, 0.46860474f, 0.437333383f, 0.406309343f, 0.375655056f,
+	0.345491503f, 0.315937724f, 0.287110354f, 0.259123163f, 0.232086603f, 0.206107374f, 0.181288005f, 0.157726447f,
+	0.135515686f, 0.114743379f, 0.0954915028f, 0.0778360372f, 0.06184666f, 0.0475864738f, 0.0351117571f, 0.0244717419f,
+	0.0157084194f, 0.00885637464f, 0.00394264934f, 0.000986635786f,
+};
+
+// 0.8 Hz to 3.55 Hz
+static const float HR_spectrumTable_100_25_coefficients[23] = {
+	1.9597101f, 1.94619702f, 1.93076328f, 1.9134241f, 1.89419661f, 1.87309977f, 1.85015441f, 1.82538317f,
+	1.7988105f, 1.77046262f, 1.74036751f, 1.70855486f, 1.67505608f, 1.63990422f, 1.60313397f, 1.56478162f,
+	1.52488502f, 1.48348355f, 1.44061805f, 1.39633084f, 1.35066562f, 1.30366745f, 1.25538272f,
+};
+
+const HR_SpectrumTable HR_spectrumTables[] = {
+	{ 100, 25.0f, 0.8f, 0.125f, 23, HR_spectrumTable_100_25_window, HR_spectrumTable_100_25_coefficients },
+};
+
+const int HR_spectrumTables_size = sizeof(HR_spectrumTables)
+		/ sizeof(HR_spectrumTables[0]);
+
+// threshold decay of 0.8 s
+const ATD_table ATD_tables[] = {
+	{ 25.0f, 0.951229425f },
+};
+
+const int ATD_tables_size = sizeof(ATD_tables) / sizeof(ATD_tables[0]);
@@ -66,7 +66,7 @@ void LED_init() {
 	led_status = LED_ALL;
 }
 
-void LED_update(uint8_t t, uint8_t h, uint8_t o) {
+void LED_update(uint8_t t, uint8_t h, uint8_t o, uint8_t v, uint8_t r) {
 
 	ssd1306_Fill(Black);
 
@@ -88,6 +88,18 @@ void LED_update(uint8_t t, uint8_t h, uint8_t o) {
 	sprintf(led_buffer, "%d", (uint8_t) o);
 	ssd1306_WriteString(led_buffer, Font_7x10, White);
 
+	ssd1306_SetCursor(64, 22);
+	ssd1306_WriteString("RMSSD", Font_6x8, White);
+	ssd1306_SetCursor(64, 32);
+	sprintf(led_buffer, "%d", (uint8_t) v);
+	ssd1306_WriteString(led_buffer, Font_7x10, White);
+
+	ssd1306_SetCursor(64, 44);
+	ssd1306_WriteString("Resp", Font_6x8, White);
+	ssd1306_SetCursor(64, 54);
+	sprintf(led_buffer, "%d", (uint8_t) r);
+	ssd1306_WriteString(led_buffer, Font_7x10, White);
+
 	ssd1306_UpdateScreen();
 }
 
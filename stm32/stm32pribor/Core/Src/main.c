@@ -36,6 +36,8 @@
 #include "stdio.h"
 #include "string.h"
 #include "ledhelper.h"
+#include "profiler.h"
+#include "trace.h"
 #include <stdlib.h>
 
 /* USER CODE END Includes */
@@ -76,7 +78,7 @@ uint16_t LED_OFF_tim = 0;
 
 uint16_t BEE_rate = 1024;
 
-#define ACC_THRESHOLD 3000 // 3 G
+#define ACC_THRESHOLD 5000 // 5 G, moderate motion is left to the motion canceller
 static int16_t data_acceleration[ACC_DEPTH][3];
 static int32_t data_acceleration_sum;
 static int16_t data_raw_acceleration[3];
@@ -86,13 +88,11 @@ static uint8_t whoamI, rst;
 static lis2dtw12_ctrl4_int1_pad_ctrl_t ctrl4_int1_pad;
 
 FlagStatus AFE_status = SET;
-float AFE_GREEN[LED_DEPTH];
-float AFE_RED[LED_DEPTH];
-float AFE_IR[LED_DEPTH];
 
 FlagStatus DATA_RDY = SET;
 
 float SP_R;
+float SP_PI;
 int SP_DISP = 0;
 
 #define TIME_TO_IDLE 20
@@ -102,10 +102,17 @@ FlagStatus IDLE = RESET;
 int HR_COUNT = 0;
 float HR_FIN = 80;
 int HR_OK = 0;
+int HR_SQ = 0;
+FlagStatus HR_NEW_SESSION = SET;
 float HR_DISP = 80;
 float HR = 80;
 
-uint8_t tx_buff[3] = { 0, 0, 0 };
+float HRV_RMSSD = 0;
+float HRV_SDNN = 0;
+float HRV_PNN50 = 0;
+float RESP_DISP = 0;
+
+uint8_t tx_buff[7] = { 0, 0, 0, 0, 0, 0, 0 };
 
 // HR CONFIG
 #define HR_MON_SIZE  100
@@ -113,26 +120,55 @@ uint8_t tx_buff[3] = { 0, 0, 0 };
 #define HR_BPF_ORDER  4
 #define HR_BPF_LOW  0.8
 #define HR_BPF_HIGH  8.5
-#define HR_SSF_SIZE  9
+// SSF over the last difference only, as the firmware has always used it
+#define HR_SSF_SIZE  2
 #define HR_MA_GREEN_SIZE  5
-#define HR_MA_REDIR_SIZE  5
+#define HR_MA_REDIR_SIZE  7
+// HR_ENGINE_SPECTRUM for the Goertzel bank, e.g. on low perfusion wearers,
+// HR_ENGINE_AUTOCORRELATION for an estimate updated with every sample
+#define HR_ENGINE  HR_ENGINE_PEAKS
+// Detect the peaks on the infrared channel too and use the better scored channel
+// every window (HR_Fusion), 0 for the green channel alone and about 2 KB less RAM
+#define HR_IR_FUSION 1
+
+#if HR_IR_FUSION
+#define HR_IR_FUSION_FOOTPRINT HR_FUSION_FOOTPRINT(HR_MON_SIZE, HR_BPF_ORDER, \
+		HR_SSF_SIZE)
+#else
+#define HR_IR_FUSION_FOOTPRINT 0
+#endif
 
 #define SAMPLING_RATE 25
-#define ROUNDS 4
-
-#ifdef HR_DEBUG
-float AFE_GREEN_COPY[LED_DEPTH];
-
-float HR_M;
-float HR_B;
-float HR_S;
-float HR_P;
-float HR_G;
-static float acceleration_mg[3];
-float SP_RED, SP_IR;
-
+// AFE samples per sample of SAMPLING_RATE. Above 1 the AFE runs at SAMPLING_RATE *
+// AFE_DECIMATION with the FIFO ready every LED_DEPTH samples (AFE_REG_INIT), the
+// samples are low-passed and decimated by HR_Decimator and the beats are timed on
+// the green channel at the AFE rate. Run tools/decimator_tables.py for new settings.
+#define AFE_DECIMATION 1
+// Green samples at the AFE rate kept for the beat timing, 2 s
+#define AFE_HISTORY (2 * SAMPLING_RATE * AFE_DECIMATION)
+
+#if AFE_DECIMATION > 1
+#define AFE_DECIMATOR_FOOTPRINT HR_DECIMATOR_FOOTPRINT(AFE_HISTORY)
+static float AFE_DECIMATED[LED_DEPTH * HR_AFE_STRIDE];
+#else
+#define AFE_DECIMATOR_FOOTPRINT 0
 #endif
 
+// Static storage for the heart monitor, its infrared channel and the decimator,
+// no heap use
+static uint8_t HR_memory[HR_HEARTMONITOR_FOOTPRINT(HR_MON_SIZE, HR_BPF_ORDER,
+		HR_SSF_SIZE, HR_MA_REDIR_SIZE, HR_ENGINE) + HR_IR_FUSION_FOOTPRINT
+		+ AFE_DECIMATOR_FOOTPRINT]
+		__attribute__((aligned(HR_ARENA_ALIGNMENT)));
+static HR_Arena HR_arena;
+static HR_Result HR_result;
+static HR_Quality HR_quality;
+#define ROUNDS 4
+// In-range readings needed to finish a session
+#define HR_OK_ROUNDS 10
+// In-range readings with HR_SQI_ACCEPT quality that finish a session at once
+#define HR_SQI_ROUNDS 2
+
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -144,6 +180,8 @@ void TPS_on();
 void TPS_off();
 
 float getAverageFloat(float *array, uint16_t size);
+void HRV_update(HR_HeartMonitor *heartMonitor);
+float* AFE_read(HR_Decimator *decimator);
 
 float findMin(float *array, uint16_t size);
 float findMax(float *array, uint16_t size);
@@ -171,8 +209,24 @@ int _write(int file, char *ptr, int len) {
 	return len;
 }
 
-// debug
-int counter = 0;
+// SWO trace of the probes, see trace.h. The probes write while the debugger
+// has enabled their ITM port, the records left from before are dropped
+static void TRACE_drain() {
+#ifdef TRACE_ENABLE
+	TRACE_active = (ITM->TCR & ITM_TCR_ITMENA_Msk) != 0
+			&& (ITM->TER & (1UL << TRACE_ITM_PORT)) != 0;
+	uint32_t words[32];
+	int count;
+	while ((count = TRACE_read(words, 32)) > 0) {
+		for (int i = 0; i < count && TRACE_active; i++) {
+			while (ITM->PORT[TRACE_ITM_PORT].u32 == 0) {
+				__NOP();
+			}
+			ITM->PORT[TRACE_ITM_PORT].u32 = words[i];
+		}
+	}
+#endif
+}
 
 /* USER CODE END 0 */
 
@@ -313,136 +367,39 @@ int main(void) {
 	HAL_Delay(100);
 	/* BEE INIT END */
 
-	HR_HeartMonitor *HR_heartMonitor = HR_heartMonitor_new(SAMPLING_RATE,
+	HR_arena_init(&HR_arena, HR_memory, sizeof(HR_memory));
+	HR_HeartMonitor *HR_heartMonitor = HR_heartMonitor_arenaNew(&HR_arena,
+	SAMPLING_RATE,
 	HR_MON_SIZE,
 	HR_THRESHOLD, HR_BPF_ORDER, HR_BPF_LOW, HR_BPF_HIGH, HR_SSF_SIZE,
 	HR_MA_GREEN_SIZE,
-	HR_MA_REDIR_SIZE);
-
-	MA_filter *ma_red = MA_new(7);
-	MA_filter *ma_ir = MA_new(7);
-
-#ifdef HR_DEBUG
-	// Debug
-	printf("Starting debug cycle!\r\n");
-	while (1) {
-		while (HAL_GPIO_ReadPin(AFE_ADC_RDY_GPIO_Port, AFE_ADC_RDY_Pin)
-				!= GPIO_PIN_SET)
-			;
-		AFE_FIFO_READ(LED_DEPTH * 4);
-		for (uint16_t i = 0; i < LED_DEPTH; i++) {
-			AFE_RED[i] = AFE_FLOAT[i * 4];
-			AFE_IR[i] = AFE_FLOAT[1 + i * 4];
-			AFE_GREEN[i] = AFE_FLOAT[2 + i * 4];
-			AFE_GREEN_COPY[i] = AFE_GREEN[i];
-		}
-
-		MA_process(ma_red, AFE_RED, 25);
-		MA_process(ma_ir, AFE_IR, 25);
-
-		// Read data from LIS2
-		uint8_t val;
-		lis2dtw12_fifo_data_level_get(&dev_ctx, &val);
-
-		if (val >= 25) {
-			lis2dtw12_fifo_data_level_get(&dev_ctx, &val);
-			for (int i = ACC_DEPTH - 1; i >= 0; i--) {
-				memset(data_raw_acceleration, 0x00, 3 * sizeof(int16_t));
-				lis2dtw12_acceleration_raw_get(&dev_ctx, data_raw_acceleration);
-				data_acceleration[i][0] = lis2dtw12_from_fs8_lp1_to_mg(
-						data_raw_acceleration[0]);
-				data_acceleration[i][1] = lis2dtw12_from_fs8_lp1_to_mg(
-						data_raw_acceleration[1]);
-				data_acceleration[i][2] = lis2dtw12_from_fs8_lp1_to_mg(
-						data_raw_acceleration[2]);
-			}
-
-		} else {
-
-		}
-
-		lis2dtw12_temperature_raw_get(&dev_ctx, &data_raw_temperature);
-		temperature = lis2dtw12_from_lsb_to_celsius(data_raw_temperature);
-
-		// Control green voltage
-		float led_green_average = getAverageFloat(AFE_GREEN, LED_DEPTH);
-
-		if (led_green_average > 0.9 && AFE_ILED_2 > 11) {
-			AFE_ILED_2 -= 10;
-			AFE_ILED_UPDATE();
-			HR_COUNT = 0;
-
-		}
-		if (led_green_average < 0.4 && AFE_ILED_2 < 91) {
-			AFE_ILED_2 += 10;
-			AFE_ILED_UPDATE();
-			HR_COUNT = 0;
-		}
-
-		// Add samples
-
-		HR_heartMonitor_addGreen(HR_heartMonitor, AFE_GREEN, LED_DEPTH);
-		HR_heartMonitor_addRedIr(HR_heartMonitor, AFE_RED, AFE_IR, LED_DEPTH);
-
-		// If okay - calculate HR
-
-		HR_heartMonitor_peaksFromGreen(HR_heartMonitor);
-		HR = HR_heartMonitor_heartRateFromPeaks(HR_heartMonitor);
-		if (!isnanf(HR)) {
-			HR_DISP = 2.0 * HR_DISP / 3.0 + HR / 3.0;
-		} else {
-			HR = 0.0;
-		}
-		SP_R = HR_heartMonitor_ratioFromPeaks(HR_heartMonitor);
-		if (isnanf(SP_R)) {
-			SP_R = 0.0;
-		}
-		SP_DISP = 110.0 - 25.0 * SP_R;
-
-		HR_COUNT++;
-
-		// Check finger on sensor
-		if (led_green_average < 0.5 && AFE_ILED_2 >= 91) {
-			HR_FIN = 0;
-		} else {
-			HR_FIN = HR_DISP;
-		}
-
-		// Monitor displaying
-		for (int i = 0; i < LED_DEPTH; i++) {
-			HR_G = AFE_GREEN_COPY[i];
-			HR_B = d1[i];
-			HR_S = d2[i];
-			HR_P = HR_heartMonitor->peaks[HR_heartMonitor->size - LED_DEPTH + i]
-					* HR_G;
-
-			acceleration_mg[0] = data_acceleration[i][0];
-			acceleration_mg[1] = data_acceleration[i][1];
-			acceleration_mg[2] = data_acceleration[i][2];
-
-			SP_RED = AFE_RED[i];
-			SP_IR = AFE_IR[i];
-			HAL_Delay(30); // for monitor alignment
-		}
-
-		counter++;
-		__HAL_TIM_SET_COUNTER(&htim2, 0);
-		LED_OFF_tim = 0;
-		LED_update(temperature, HR_DISP, SP_DISP);
-		printf_bee_response();
-
-		// fuzz
-		// uint8_t tmp[3] = { counter % 128, counter + 5, counter - 10 };
-		// BEE_b_fnin((uint8_t*) tmp, 3);
-
-		tx_buff[0] = (uint8_t) HR_DISP;
-		tx_buff[1] = (uint8_t) temperature;
-		tx_buff[2] = (uint8_t) SP_DISP;
-
-		BEE_b_fnin((uint8_t*) tx_buff, 3);
-
+	HR_MA_REDIR_SIZE, HR_limit_low, HR_limit_high, HR_ENGINE);
+	if (HR_heartMonitor == NULL) {
+		// no BPF_tables entry, run tools/bpf_tables.py for these settings, or no
+		// ATD_tables or HR_spectrumTables entry, run tools/monitor_tables.py
+		Error_Handler();
+	}
+#if HR_IR_FUSION
+	HR_heartMonitor->fusion = HR_fusion_arenaNew(&HR_arena, SAMPLING_RATE,
+	HR_MON_SIZE, HR_THRESHOLD, HR_BPF_ORDER, HR_BPF_LOW, HR_BPF_HIGH,
+	HR_SSF_SIZE, HR_limit_high);
+	if (HR_heartMonitor->fusion == NULL) {
+		Error_Handler();
 	}
 #endif
+	HR_Decimator *HR_decimator = NULL;
+#if AFE_DECIMATION > 1
+	HR_decimator = HR_decimator_arenaNew(&HR_arena, AFE_DECIMATION,
+	SAMPLING_RATE, HR_BPF_HIGH, AFE_HISTORY);
+	if (HR_decimator == NULL) {
+		// no HR_decimatorTables entry, run tools/decimator_tables.py for these settings
+		Error_Handler();
+	}
+	HR_heartMonitor->decimator = HR_decimator;
+#endif
+
+	// Cycles of the main loop stages, reported over SWO with PROF_ENABLE
+	PROF_INIT();
 
 	/* USER CODE END 2 */
 
@@ -466,6 +423,7 @@ int main(void) {
 				butt_wakeup = SET;
 			}
 		}
+		PROF_BEGIN(PROF_LOOP);
 
 		// Check wakeup flag LIS
 		lis2dtw12_all_sources_t all_source;
@@ -497,25 +455,31 @@ int main(void) {
 
 		// Afe's led on - read values
 		if (AFE_status && !IDLE) {
+			// A new session starts a new track of the heart rate, beat intervals and breaths
+			if (HR_NEW_SESSION) {
+				HR_tracker_reset(HR_heartMonitor->tracker);
+				HR_variability_reset(HR_heartMonitor->variability);
+				HR_respiration_reset(HR_heartMonitor->respiration);
+				RESP_DISP = 0;
+				HR_NEW_SESSION = RESET;
+			}
 			HR_COUNT++;
 			// Read fifo
-			AFE_FIFO_READ(LED_DEPTH * 4);
-			for (uint16_t i = 0; i < LED_DEPTH; i++) {
-				AFE_RED[i] = AFE_FLOAT[i * 4];
-				AFE_IR[i] = AFE_FLOAT[1 + i * 4];
-				AFE_GREEN[i] = AFE_FLOAT[2 + i * 4];
-			}
-			MA_process(ma_red, AFE_RED, LED_DEPTH);
-			MA_process(ma_ir, AFE_IR, LED_DEPTH);
+			PROF_BEGIN(PROF_AFE_READ);
+			float *fifo = AFE_read(HR_decimator);
+			PROF_END(PROF_AFE_READ);
 
 			// Read data from LIS2
+			PROF_BEGIN(PROF_ACC_READ);
+			int16_t (*acceleration)[3] = NULL;
 			uint8_t val;
 			lis2dtw12_fifo_data_level_get(&dev_ctx, &val);
 
 			if (val >= ACC_DEPTH) {
 				lis2dtw12_fifo_data_level_get(&dev_ctx, &val);
+				acceleration = data_acceleration;
 				data_acceleration_sum = 0;
-				for (int i = ACC_DEPTH - 1; i >= 0; i--) {
+				for (int i = 0; i < ACC_DEPTH; i++) {
 					memset(data_raw_acceleration, 0x00, 3 * sizeof(int16_t));
 					lis2dtw12_acceleration_raw_get(&dev_ctx,
 							data_raw_acceleration);
@@ -531,6 +495,14 @@ int main(void) {
 				}
 				data_acceleration_sum /= ACC_DEPTH;
 			}
+			PROF_END(PROF_ACC_READ);
+
+			// Add samples to HR module, the accelerometer is the reference
+			// of the motion canceller
+			PROF_BEGIN(PROF_PREPROCESS);
+			float led_green_average = HR_heartMonitor_addInterleaved(
+					HR_heartMonitor, fifo, acceleration, LED_DEPTH);
+			PROF_END(PROF_PREPROCESS);
 
 			// control some acc to remove to sharp moves
 			if (data_acceleration_sum > ACC_THRESHOLD) {
@@ -542,10 +514,9 @@ int main(void) {
 			temperature = lis2dtw12_from_lsb_to_celsius(data_raw_temperature);
 
 			// Control green voltage
-			float led_green_average = getAverageFloat(AFE_GREEN, LED_DEPTH);
-
 			if (led_green_average > 0.9 && AFE_ILED_2 > 11) {
 				HR_OK = 0;
+				HR_SQ = 0;
 				AFE_ILED_2 -= 10;
 				AFE_ILED_UPDATE();
 				HR_COUNT = 0;
@@ -553,34 +524,43 @@ int main(void) {
 			}
 			if (led_green_average < 0.4 && AFE_ILED_2 < 91) {
 				HR_OK = 0;
+				HR_SQ = 0;
 				AFE_ILED_2 += 10;
 				AFE_ILED_UPDATE();
 				HR_COUNT = 0;
 			}
 
-			// Add samples to HR module
-			HR_heartMonitor_addGreen(HR_heartMonitor, AFE_GREEN, LED_DEPTH);
-			HR_heartMonitor_addRedIr(HR_heartMonitor, AFE_RED, AFE_IR,
-			LED_DEPTH);
-
 			// Now filers are stable and can find HR and SPO
 			if (HR_COUNT > ROUNDS) {
 
-				HR_heartMonitor_peaksFromGreen(HR_heartMonitor);
+				PROF_SCOPE(PROF_PEAKS) {
+					HR_heartMonitor_peaksFromChannels(HR_heartMonitor);
+				}
 
 				// Data will be valid - data_rdy set
 				DATA_RDY = SET;
 
 				// Check heartrate
-				HR = HR_heartMonitor_heartRateFromPeaks(HR_heartMonitor);
+				PROF_SCOPE(PROF_RATIO) {
+					HR_heartMonitor_heartRateAndRatio(HR_heartMonitor,
+							&HR_result);
+				}
+				PROF_SCOPE(PROF_QUALITY) {
+					HR_heartMonitor_quality(HR_heartMonitor, &HR_result,
+							&HR_quality);
+				}
+				PROF_SCOPE(PROF_TRACK) {
+					HR = HR_heartMonitor_track(HR_heartMonitor, &HR_result);
+					HRV_update(HR_heartMonitor);
+				}
 				if (!isnanf(HR)) {
-					HR_DISP = 2.0 * HR_DISP / 3.0 + HR / 3.0;
+					HR_DISP = HR;
 				} else {
 					HR = 0.0;
 				}
 
 				// Check SPO
-				SP_R = HR_heartMonitor_ratioFromPeaks(HR_heartMonitor);
+				SP_R = HR_result.ratio;
 				if (isnanf(SP_R)) {
 					SP_R = 0.0;
 					SP_DISP = 0.0;
@@ -595,8 +575,15 @@ int main(void) {
 				if (HR < HR_limit_high && HR > HR_limit_low
 						&& SP_DISP > SpO_OK_low) {
 					HR_OK++;
+					// proven quality shortens the session
+					if (HR_quality.index >= HR_SQI_ACCEPT) {
+						HR_SQ++;
+					} else {
+						HR_SQ = 0;
+					}
 				} else {
 					HR_OK = 0;
+					HR_SQ = 0;
 				}
 
 			}
@@ -604,9 +591,14 @@ int main(void) {
 			// Check finger/wrist on sensor
 			if (led_green_average < 0.5 && AFE_ILED_2 >= 91) {
 				HR_OK = 0;
+				HR_SQ = 0;
 				HR_COUNT = 0;
 				HR_FIN = 0;
 				SP_DISP = 0;
+				HR_tracker_reset(HR_heartMonitor->tracker);
+				HR_variability_reset(HR_heartMonitor->variability);
+				HR_respiration_reset(HR_heartMonitor->respiration);
+				RESP_DISP = 0;
 				IDLE_timer++;
 			} else {
 				IDLE_timer = 0;
@@ -624,7 +616,7 @@ int main(void) {
 			}
 
 			// Values is good, can turn off led's and wait period before next session
-			if (HR_OK > 10) {
+			if (HR_OK > HR_OK_ROUNDS || HR_SQ >= HR_SQI_ROUNDS) {
 				AFE_status = RESET;
 				TPS_off();
 			} else {
@@ -638,13 +630,24 @@ int main(void) {
 			tx_buff[0] = (uint8_t) HR_DISP;
 			tx_buff[1] = (uint8_t) temperature;
 			tx_buff[2] = (uint8_t) SP_DISP;
-			BEE_b_fnin(tx_buff, 3);
+			tx_buff[3] = (uint8_t) HRV_RMSSD;
+			tx_buff[4] = (uint8_t) HRV_SDNN;
+			tx_buff[5] = (uint8_t) HRV_PNN50;
+			tx_buff[6] = (uint8_t) RESP_DISP;
+			PROF_SCOPE(PROF_BEE) {
+				BEE_b_fnin(tx_buff, 7);
+			}
 		}
 
 		// If oled is on
 		if (LED_ON && !IDLE && DATA_RDY) {
-			LED_update(temperature, HR_FIN, SP_DISP);
+			PROF_SCOPE(PROF_LED) {
+				LED_update(temperature, HR_FIN, SP_DISP, HRV_RMSSD, RESP_DISP);
+			}
 		}
+		PROF_END(PROF_LOOP);
+		PROF_REPORT();
+		TRACE_drain();
 	}
 	/* USER CODE END 3 */
 }
@@ -735,6 +738,8 @@ void LED_off() {
 // Switch on AFE LED supply
 void TPS_on() {
 	HR_OK = 0;
+	HR_SQ = 0;
+	HR_NEW_SESSION = SET;
 	HAL_GPIO_WritePin(TPS61099_EN_GPIO_Port, TPS61099_EN_Pin, GPIO_PIN_SET);
 }
 
@@ -743,6 +748,45 @@ void TPS_off() {
 	HAL_GPIO_WritePin(TPS61099_EN_GPIO_Port, TPS61099_EN_Pin, GPIO_PIN_RESET);
 }
 
+// Take RMSSD, SDNN and pNN50 of the beat intervals, 0 until there are enough beats,
+// and the respiration rate, which keeps the last reading while the features disagree
+void HRV_update(HR_HeartMonitor *heartMonitor) {
+	HRV_RMSSD = HR_variability_rmssd(heartMonitor->variability);
+	HRV_SDNN = HR_variability_sdnn(heartMonitor->variability);
+	HRV_PNN50 = HR_variability_pnn50(heartMonitor->variability);
+	HRV_RMSSD = isnanf(HRV_RMSSD) ? 0.0 : HRV_RMSSD > 255.0 ? 255.0 : HRV_RMSSD;
+	HRV_SDNN = isnanf(HRV_SDNN) ? 0.0 : HRV_SDNN > 255.0 ? 255.0 : HRV_SDNN;
+	HRV_PNN50 = isnanf(HRV_PNN50) ? 0.0 : HRV_PNN50;
+	float rate = HR_respiration_rate(heartMonitor->respiration);
+	if (!isnanf(rate)) {
+		RESP_DISP = rate;
+	}
+}
+
+// Read one second of samples, LED_DEPTH at SAMPLING_RATE. With AFE_DECIMATION the FIFO
+// is ready every LED_DEPTH samples at the AFE rate, so it is read AFE_DECIMATION times
+// and every read is decimated into AFE_DECIMATED
+float* AFE_read(HR_Decimator *decimator) {
+#if AFE_DECIMATION > 1
+	int samples = 0;
+	for (int read = 0; read < AFE_DECIMATION; read++) {
+		if (read > 0) {
+			while (HAL_GPIO_ReadPin(AFE_ADC_RDY_GPIO_Port, AFE_ADC_RDY_Pin)
+					!= GPIO_PIN_SET)
+				;
+		}
+		AFE_FIFO_READ(LED_DEPTH * HR_AFE_STRIDE);
+		samples += HR_decimator_process(decimator, AFE_FLOAT, LED_DEPTH,
+				AFE_DECIMATED + samples * HR_AFE_STRIDE);
+	}
+	return AFE_DECIMATED;
+#else
+	(void) decimator;
+	AFE_FIFO_READ(LED_DEPTH * HR_AFE_STRIDE);
+	return AFE_FLOAT;
+#endif
+}
+
 float getAverageFloat(float *array, uint16_t size) {
 	float sum = 0.0;
 	for (uint16_t i = 0; i < size; i++) {
@@ -0,0 +1,153 @@
+/**
+ * @file profiler.c
+ * @brief Cycle counts of the main loop stages with the DWT cycle counter
+ */
+
+#include <profiler.h>
+
+#ifdef PROF_ENABLE
+
+#if PROF_BINS % 2
+#error "PROF_BINS must be even, the report packs two bins per word"
+#endif
+
+/**
+ * @brief Accumulators of the stages since the last report.
+ */
+PROF_Accumulator PROF_accumulators[PROF_STAGES];
+
+/**
+ * @brief Cycles of two back to back reads of CYCCNT, taken off every run.
+ */
+static uint32_t PROF_overhead;
+
+/**
+ * @brief Calls of PROF_report since the last report.
+ */
+static uint32_t PROF_calls;
+
+/**
+ * @brief Number of the next report, a gap means lost reports.
+ */
+static uint32_t PROF_sequence;
+
+/**
+ * @brief Starts the cycle counter and clears the accumulators.
+ *
+ * CYCCNT wraps after 2^32 cycles (67 s at 64 MHz), a stage must be shorter.
+ */
+void PROF_init() {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	uint32_t start = DWT->CYCCNT;
+	PROF_overhead = DWT->CYCCNT - start;
+	PROF_calls = 0;
+	PROF_sequence = 0;
+	PROF_reset();
+}
+
+/**
+ * @brief Adds a run of a stage to its accumulator.
+ *
+ * @param stage Stage of the run.
+ * @param cycles CYCCNT at the end of the run minus CYCCNT at its start.
+ */
+void PROF_add(PROF_Stage stage, uint32_t cycles) {
+	PROF_Accumulator *accumulator = &PROF_accumulators[stage];
+	cycles = cycles > PROF_overhead ? cycles - PROF_overhead : 0;
+	accumulator->count++;
+	accumulator->sum += cycles;
+	if (cycles < accumulator->min) {
+		accumulator->min = cycles;
+	}
+	if (cycles > accumulator->max) {
+		accumulator->max = cycles;
+	}
+	int bin = 0;
+	if (cycles > 0) {
+		bin = 31 - (int) __CLZ(cycles) - PROF_BIN_FIRST + 1;
+		if (bin < 0) {
+			bin = 0;
+		} else if (bin > PROF_BINS - 1) {
+			bin = PROF_BINS - 1;
+		}
+	}
+	if (accumulator->bins[bin] < UINT16_MAX) {
+		accumulator->bins[bin]++;
+	}
+}
+
+/**
+ * @brief Clears the accumulators.
+ */
+void PROF_reset() {
+	for (int stage = 0; stage < PROF_STAGES; stage++) {
+		PROF_Accumulator *accumulator = &PROF_accumulators[stage];
+		accumulator->count = 0;
+		accumulator->min = UINT32_MAX;
+		accumulator->max = 0;
+		accumulator->sum = 0;
+		for (int bin = 0; bin < PROF_BINS; bin++) {
+			accumulator->bins[bin] = 0;
+		}
+	}
+}
+
+/**
+ * @brief Writes a word to the ITM port of the reports.
+ *
+ * @param word Word to write.
+ * @param checksum Sum of the words of the report, updated.
+ */
+static void PROF_send(uint32_t word, uint32_t *checksum) {
+	while (ITM->PORT[PROF_ITM_PORT].u32 == 0) {
+		__NOP();
+	}
+	ITM->PORT[PROF_ITM_PORT].u32 = word;
+	*checksum += word;
+}
+
+/**
+ * @brief Counts a call and sends a report every PROF_PERIOD calls.
+ *
+ * A report is a sequence of little endian 32-bit words:
+ * PROF_MAGIC; PROF_VERSION | PROF_STAGES << 8 | PROF_BINS << 16 |
+ * PROF_BIN_FIRST << 24; SystemCoreClock; sequence number; then per stage
+ * count, min, max, the low and high word of sum and the bins, two per word
+ * with the lower bin in the low half; last the sum of all the words before.
+ * Nothing is sent when the debugger has not enabled the ITM port, the
+ * accumulators start again in either case.
+ */
+void PROF_report() {
+	if (++PROF_calls < PROF_PERIOD) {
+		return;
+	}
+	PROF_calls = 0;
+	if ((ITM->TCR & ITM_TCR_ITMENA_Msk) != 0
+			&& (ITM->TER & (1UL << PROF_ITM_PORT)) != 0) {
+		uint32_t checksum = 0;
+		PROF_send(PROF_MAGIC, &checksum);
+		PROF_send(PROF_VERSION | PROF_STAGES << 8 | PROF_BINS << 16
+				| PROF_BIN_FIRST << 24, &checksum);
+		PROF_send(SystemCoreClock, &checksum);
+		PROF_send(PROF_sequence, &checksum);
+		for (int stage = 0; stage < PROF_STAGES; stage++) {
+			PROF_Accumulator *accumulator = &PROF_accumulators[stage];
+			PROF_send(accumulator->count, &checksum);
+			PROF_send(accumulator->min, &checksum);
+			PROF_send(accumulator->max, &checksum);
+			PROF_send((uint32_t) accumulator->sum, &checksum);
+			PROF_send((uint32_t) (accumulator->sum >> 32), &checksum);
+			for (int bin = 0; bin < PROF_BINS; bin += 2) {
+				PROF_send(accumulator->bins[bin]
+						| (uint32_t) accumulator->bins[bin + 1] << 16, &checksum);
+			}
+		}
+		PROF_send(checksum, &checksum);
+	}
+	PROF_sequence++;
+	PROF_reset();
+}
+
+#endif
@@ -0,0 +1,128 @@
+/**
+ * @file trace.c
+ * @brief Probes of the intermediate signals of the heart monitor
+ *
+ * The ring has one producer, the probe points, and one consumer, the drain of
+ * the main loop. Each side owns its index and publishes it with release
+ * order after the words it covers, so neither side takes a lock or masks
+ * interrupts. A record is a header word (TRACE_SYNC, probe, format and count
+ * from the low byte up), a sequence number and the samples. A record that
+ * does not fit is dropped whole and leaves a gap in the sequence numbers.
+ */
+
+#include <trace.h>
+#include <string.h>
+
+#ifdef TRACE_ENABLE
+
+#if TRACE_RING_WORDS & (TRACE_RING_WORDS - 1)
+#error "TRACE_RING_WORDS must be a power of 2"
+#endif
+
+/**
+ * @brief Non-zero while the records are drained, probes do not write otherwise.
+ */
+volatile uint32_t TRACE_active;
+
+static uint32_t TRACE_ring[TRACE_RING_WORDS];
+
+/**
+ * @brief Words written since the start, owned by the producer.
+ */
+static uint32_t TRACE_head;
+
+/**
+ * @brief Words read since the start, owned by the consumer.
+ */
+static uint32_t TRACE_tail;
+
+/**
+ * @brief Sequence number of the next record, dropped or not.
+ */
+static uint32_t TRACE_sequence;
+
+/**
+ * @brief Number of dropped records.
+ */
+static uint32_t TRACE_drops;
+
+/**
+ * @brief Copies words into the ring from a free-running index, wrapping around its end.
+ */
+static void TRACE_copyIn(uint32_t index, const void *source, uint32_t count) {
+	uint32_t offset = index & (TRACE_RING_WORDS - 1);
+	uint32_t first = TRACE_RING_WORDS - offset;
+	if (first > count) {
+		first = count;
+	}
+	memcpy(TRACE_ring + offset, source, first * sizeof(uint32_t));
+	memcpy(TRACE_ring, (const uint32_t*) source + first,
+			(count - first) * sizeof(uint32_t));
+}
+
+/**
+ * @brief Writes samples of a probe point to the ring.
+ *
+ * Blocks of more than TRACE_RECORD_SAMPLES samples are split into records.
+ * Called through TRACE_PROBE and TRACE_PROBE_Q.
+ *
+ * @param probe   Probe point of the samples.
+ * @param format  Format of the samples.
+ * @param samples Pointer to the samples, 32 bits each.
+ * @param size    Number of samples.
+ */
+void TRACE_write(TRACE_Probe probe, TRACE_Format format, const void *samples,
+		int size) {
+	const uint32_t *words = (const uint32_t*) samples;
+	for (int start = 0; start < size; start += TRACE_RECORD_SAMPLES) {
+		uint32_t count = size - start;
+		if (count > TRACE_RECORD_SAMPLES) {
+			count = TRACE_RECORD_SAMPLES;
+		}
+		uint32_t head = TRACE_head;
+		uint32_t tail = __atomic_load_n(&TRACE_tail, __ATOMIC_ACQUIRE);
+		uint32_t header[2] = { TRACE_SYNC | (uint32_t) probe << 8
+				| (uint32_t) format << 16 | count << 24, TRACE_sequence++ };
+		if (TRACE_RING_WORDS - (head - tail) < count + 2) {
+			TRACE_drops++;
+			continue;
+		}
+		TRACE_copyIn(head, header, 2);
+		TRACE_copyIn(head + 2, words + start, count);
+		__atomic_store_n(&TRACE_head, head + 2 + count, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ * @brief Takes words of the records from the ring, oldest first.
+ *
+ * @param words    Destination of the words.
+ * @param capacity Most words to take.
+ * @return Number of words taken, 0 if the ring is empty.
+ */
+int TRACE_read(uint32_t *words, int capacity) {
+	uint32_t tail = TRACE_tail;
+	uint32_t head = __atomic_load_n(&TRACE_head, __ATOMIC_ACQUIRE);
+	uint32_t count = head - tail;
+	if (count > (uint32_t) capacity) {
+		count = capacity;
+	}
+	uint32_t offset = tail & (TRACE_RING_WORDS - 1);
+	uint32_t first = TRACE_RING_WORDS - offset;
+	if (first > count) {
+		first = count;
+	}
+	memcpy(words, TRACE_ring + offset, first * sizeof(uint32_t));
+	memcpy(words + first, TRACE_ring, (count - first) * sizeof(uint32_t));
+	__atomic_store_n(&TRACE_tail, tail + count, __ATOMIC_RELEASE);
+	return count;
+}
+
+/**
+ * @brief Number of records dropped because the ring was full.
+ */
+uint32_t TRACE_dropped() {
+	return TRACE_drops;
+}
+
+#endif
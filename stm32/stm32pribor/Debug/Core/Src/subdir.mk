@@ -11,10 +11,15 @@ C_SRCS += \
 ../Core/Src/dma.c \
 ../Core/Src/gpio.c \
 ../Core/Src/heartmonitor.c \
+../Core/Src/heartmonitor_bpf.c \
+../Core/Src/heartmonitor_decimator.c \
+../Core/Src/heartmonitor_fixed.c \
+../Core/Src/heartmonitor_tables.c \
 ../Core/Src/i2c.c \
 ../Core/Src/ledhelper.c \
 ../Core/Src/lis2dtw12_reg.c \
 ../Core/Src/main.c \
+../Core/Src/profiler.c \
 ../Core/Src/spi.c \
 ../Core/Src/ssd1306.c \
 ../Core/Src/ssd1306_fonts.c \
@@ -25,6 +30,7 @@ C_SRCS += \
 ../Core/Src/sysmem.c \
 ../Core/Src/system_stm32f1xx.c \
 ../Core/Src/tim.c \
+../Core/Src/trace.c \
 ../Core/Src/usart.c 
 
 OBJS += \
@@ -34,10 +40,15 @@ OBJS += \
 ./Core/Src/dma.o \
 ./Core/Src/gpio.o \
 ./Core/Src/heartmonitor.o \
+./Core/Src/heartmonitor_bpf.o \
+./Core/Src/heartmonitor_decimator.o \
+./Core/Src/heartmonitor_fixed.o \
+./Core/Src/heartmonitor_tables.o \
 ./Core/Src/i2c.o \
 ./Core/Src/ledhelper.o \
 ./Core/Src/lis2dtw12_reg.o \
 ./Core/Src/main.o \
+./Core/Src/profiler.o \
 ./Core/Src/spi.o \
 ./Core/Src/ssd1306.o \
 ./Core/Src/ssd1306_fonts.o \
@@ -48,6 +59,7 @@ OBJS += \
 ./Core/Src/sysmem.o \
 ./Core/Src/system_stm32f1xx.o \
 ./Core/Src/tim.o \
+./Core/Src/trace.o \
 ./Core/Src/usart.o 
 
 C_DEPS += \
@@ -57,10 +69,15 @@ C_DEPS += \
 ./Core/Src/dma.d \
 ./Core/Src/gpio.d \
 ./Core/Src/heartmonitor.d \
+./Core/Src/heartmonitor_bpf.d \
+./Core/Src/heartmonitor_decimator.d \
+./Core/Src/heartmonitor_fixed.d \
+./Core/Src/heartmonitor_tables.d \
 ./Core/Src/i2c.d \
 ./Core/Src/ledhelper.d \
 ./Core/Src/lis2dtw12_reg.d \
 ./Core/Src/main.d \
+./Core/Src/profiler.d \
 ./Core/Src/spi.d \
 ./Core/Src/ssd1306.d \
 ./Core/Src/ssd1306_fonts.d \
@@ -71,6 +88,7 @@ C_DEPS += \
 ./Core/Src/sysmem.d \
 ./Core/Src/system_stm32f1xx.d \
 ./Core/Src/tim.d \
+./Core/Src/trace.d \
 ./Core/Src/usart.d 
 
 
@@ -81,7 +99,7 @@ Core/Src/%.o Core/Src/%.su: ../Core/Src/%.c Core/Src/subdir.mk
 clean: clean-Core-2f-Src
 
 clean-Core-2f-Src:
-	-$(RM) ./Core/Src/adc.d ./Core/Src/adc.o ./Core/Src/adc.su ./Core/Src/afe.d ./Core/Src/afe.o ./Core/Src/afe.su ./Core/Src/bee.d ./Core/Src/bee.o ./Core/Src/bee.su ./Core/Src/dma.d ./Core/Src/dma.o ./Core/Src/dma.su ./Core/Src/gpio.d ./Core/Src/gpio.o ./Core/Src/gpio.su ./Core/Src/heartmonitor.d ./Core/Src/heartmonitor.o ./Core/Src/heartmonitor.su ./Core/Src/i2c.d ./Core/Src/i2c.o ./Core/Src/i2c.su ./Core/Src/ledhelper.d ./Core/Src/ledhelper.o ./Core/Src/ledhelper.su ./Core/Src/lis2dtw12_reg.d ./Core/Src/lis2dtw12_reg.o ./Core/Src/lis2dtw12_reg.su ./Core/Src/main.d ./Core/Src/main.o ./Core/Src/main.su ./Core/Src/spi.d ./Core/Src/spi.o ./Core/Src/spi.su ./Core/Src/ssd1306.d ./Core/Src/ssd1306.o ./Core/Src/ssd1306.su ./Core/Src/ssd1306_fonts.d ./Core/Src/ssd1306_fonts.o ./Core/Src/ssd1306_fonts.su ./Core/Src/ssd1306_tests.d ./Core/Src/ssd1306_tests.o ./Core/Src/ssd1306_tests.su ./Core/Src/stm32f1xx_hal_msp.d ./Core/Src/stm32f1xx_hal_msp.o ./Core/Src/stm32f1xx_hal_msp.su ./Core/Src/stm32f1xx_it.d ./Core/Src/stm32f1xx_it.o ./Core/Src/stm32f1xx_it.su ./Core/Src/syscalls.d ./Core/Src/syscalls.o ./Core/Src/syscalls.su ./Core/Src/sysmem.d ./Core/Src/sysmem.o ./Core/Src/sysmem.su ./Core/Src/system_stm32f1xx.d ./Core/Src/system_stm32f1xx.o ./Core/Src/system_stm32f1xx.su ./Core/Src/tim.d ./Core/Src/tim.o ./Core/Src/tim.su ./Core/Src/usart.d ./Core/Src/usart.o ./Core/Src/usart.su
+	-$(RM) ./Core/Src/adc.d ./Core/Src/adc.o ./Core/Src/adc.su ./Core/Src/afe.d ./Core/Src/afe.o ./Core/Src/afe.su ./Core/Src/bee.d ./Core/Src/bee.o ./Core/Src/bee.su ./Core/Src/dma.d ./Core/Src/dma.o ./Core/Src/dma.su ./Core/Src/gpio.d ./Core/Src/gpio.o ./Core/Src/gpio.su ./Core/Src/heartmonitor.d ./Core/Src/heartmonitor.o ./Core/Src/heartmonitor.su ./Core/Src/heartmonitor_bpf.d ./Core/Src/heartmonitor_bpf.o ./Core/Src/heartmonitor_bpf.su ./Core/Src/heartmonitor_decimator.d ./Core/Src/heartmonitor_decimator.o ./Core/Src/heartmonitor_decimator.su ./Core/Src/heartmonitor_fixed.d ./Core/Src/heartmonitor_fixed.o ./Core/Src/heartmonitor_fixed.su ./Core/Src/heartmonitor_tables.d ./Core/Src/heartmonitor_tables.o ./Core/Src/heartmonitor_tables.su ./Core/Src/i2c.d ./Core/Src/i2c.o ./Core/Src/i2c.su ./Core/Src/ledhelper.d ./Core/Src/ledhelper.o ./Core/Src/ledhelper.su ./Core/Src/lis2dtw12_reg.d ./Core/Src/lis2dtw12_reg.o ./Core/Src/lis2dtw12_reg.su ./Core/Src/main.d ./Core/Src/main.o ./Core/Src/main.su ./Core/Src/profiler.d ./Core/Src/profiler.o ./Core/Src/profiler.su ./Core/Src/spi.d ./Core/Src/spi.o ./Core/Src/spi.su ./Core/Src/ssd1306.d ./Core/Src/ssd1306.o ./Core/Src/ssd1306.su ./Core/Src/ssd1306_fonts.d ./Core/Src/ssd1306_fonts.o ./Core/Src/ssd1306_fonts.su ./Core/Src/ssd1306_tests.d ./Core/Src/ssd1306_tests.o ./Core/Src/ssd1306_tests.su ./Core/Src/stm32f1xx_hal_msp.d ./Core/Src/stm32f1xx_hal_msp.o ./Core/Src/stm32f1xx_hal_msp.su ./Core/Src/stm32f1xx_it.d ./Core/Src/stm32f1xx_it.o ./Core/Src/stm32f1xx_it.su ./Core/Src/syscalls.d ./Core/Src/syscalls.o ./Core/Src/syscalls.su ./Core/Src/sysmem.d ./Core/Src/sysmem.o ./Core/Src/sysmem.su ./Core/Src/system_stm32f1xx.d ./Core/Src/system_stm32f1xx.o ./Core/Src/system_stm32f1xx.su ./Core/Src/tim.d ./Core/Src/tim.o ./Core/Src/tim.su ./Core/Src/trace.d ./Core/Src/trace.o ./Core/Src/trace.su ./Core/Src/usart.d ./Core/Src/usart.o ./Core/Src/usart.su
 
 .PHONY: clean-Core-2f-Src
 
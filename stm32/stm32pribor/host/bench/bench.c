@@ -0,0 +1,293 @@
+/**
+ * @file bench.c
+ * @brief Host timing of the main loop stages of HR_HeartMonitor
+ *
+ * Runs the heart monitor of main.c with its infrared channel on a synthetic
+ * signal, one second of samples per iteration as the main loop does, and
+ * prints the mean wall-clock time of every stage per iteration. The stages are
+ * those of PROF_Stage that run on the host; the cycles on the device come from
+ * the profiler (Core/Inc/profiler.h).
+ *
+ * With --record the signal is the PLETH channel of a BIDMC recording instead,
+ * decimated to 25 Hz and laid on the three channels with the perfusion of
+ * PPG_fifo. --output writes the heart rate and SpO2 that main.c displays for
+ * every second, and --compare reads such a file of the other arithmetic and
+ * prints the largest differences of both. It fails when they exceed
+ * BENCH_HR_TOLERANCE or BENCH_SPO2_TOLERANCE, or when one variant has a heart
+ * rate in a second where the other has none, so the fixed-point pipeline is
+ * checked against the float one on recorded data:
+ *
+ *     pribor_bench_float [--seconds N] [--record BIDMC_PREFIX]
+ *             [--output FILE] [--compare FILE]
+ *     pribor_bench_float --record ../../bench/BIDMC/bidmc_01 --output float.txt
+ *     pribor_bench_fixed --record ../../bench/BIDMC/bidmc_01 --compare float.txt
+ */
+
+#include <heartmonitor.h>
+#include <ppg.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_FREQ 25
+#define BENCH_SIZE 100
+#define BENCH_RATE_LOW 50
+#define BENCH_RATE_HIGH 150
+#define BENCH_RECORD_FREQ 125 // sampling frequency of the BIDMC recordings
+#define BENCH_RECORD_SAMPLES 100000
+#define BENCH_RECORD_SECONDS (BENCH_RECORD_SAMPLES / BENCH_RECORD_FREQ)
+#define BENCH_HR_TOLERANCE 1.0 // bpm
+#define BENCH_SPO2_TOLERANCE 0.5 // %
+
+typedef enum {
+	BENCH_PREPROCESS = 0,
+	BENCH_PEAKS,
+	BENCH_RATIO,
+	BENCH_QUALITY,
+	BENCH_TRACK,
+	BENCH_STAGES
+} BENCH_Stage;
+
+static const char *BENCH_names[BENCH_STAGES] = { "preprocess", "peaks",
+		"ratio", "quality", "track" };
+
+static float BENCH_record[BENCH_RECORD_SAMPLES / (BENCH_RECORD_FREQ / BENCH_FREQ)];
+static float BENCH_rates[BENCH_RECORD_SECONDS];
+static float BENCH_spo2[BENCH_RECORD_SECONDS];
+
+static double BENCH_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/**
+ * @brief Reads the PLETH column of a BIDMC *_Signals.csv file, decimated to BENCH_FREQ.
+ *
+ * @return Number of samples at BENCH_FREQ, 0 if the file has no PLETH column.
+ */
+static int BENCH_readRecord(const char *prefix) {
+	char filename[512];
+	snprintf(filename, sizeof(filename), "%s_Signals.csv", prefix);
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) {
+		perror(filename);
+		return 0;
+	}
+	char line[512];
+	int pleth_column = -1;
+	if (fgets(line, sizeof(line), file) != NULL) {
+		int column = 0;
+		for (char *name = strtok(line, ",\r\n"); name != NULL;
+				name = strtok(NULL, ",\r\n"), column++) {
+			while (*name == ' ') {
+				name++;
+			}
+			if (strcmp(name, "PLETH") == 0) {
+				pleth_column = column;
+			}
+		}
+	}
+	int count = 0;
+	for (int raw = 0; pleth_column >= 0 && raw < BENCH_RECORD_SAMPLES
+			&& fgets(line, sizeof(line), file) != NULL; raw++) {
+		if (raw % (BENCH_RECORD_FREQ / BENCH_FREQ) != 0) {
+			continue;
+		}
+		char *field = line;
+		for (int column = 0; column < pleth_column && field != NULL; column++) {
+			field = strchr(field, ',');
+			if (field != NULL) {
+				field++;
+			}
+		}
+		BENCH_record[count++] = field != NULL ? atof(field) : 0.0;
+	}
+	fclose(file);
+	return count;
+}
+
+/**
+ * @brief Lays a second of the recording on the channels of the AFE FIFO.
+ *
+ * The PLETH range is the pulse of PPG_fifo, so the channels have its DC and
+ * perfusion.
+ */
+static void BENCH_recordFifo(float *fifo, int second, float min, float max) {
+	for (int i = 0; i < BENCH_FREQ; i++) {
+		float pulse = (BENCH_record[second * BENCH_FREQ + i] - min)
+				/ (max - min);
+		float *sample = fifo + i * HR_AFE_STRIDE;
+		sample[HR_AFE_RED] = 0.50f + 0.005f * pulse;
+		sample[HR_AFE_IR] = 0.55f + 0.010f * pulse;
+		sample[HR_AFE_GREEN] = 0.60f + 0.020f * pulse;
+		sample[HR_AFE_STRIDE - 1] = 0.0f;
+	}
+}
+
+/**
+ * @brief Compares the heart rates and SpO2 of every second with those of a file of --output.
+ *
+ * @return 0 if they are within BENCH_HR_TOLERANCE and BENCH_SPO2_TOLERANCE, 1 otherwise.
+ */
+static int BENCH_compare(const char *filename, int seconds) {
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) {
+		perror(filename);
+		return 1;
+	}
+	float rate_error = 0.0f, spo2_error = 0.0f;
+	int compared = 0, mismatched = 0;
+	int second;
+	float rate, spo2;
+	while (fscanf(file, "%d %f %f", &second, &rate, &spo2) == 3) {
+		if (second < 0 || second >= seconds) {
+			continue;
+		}
+		if (isnan(rate) != isnan(BENCH_rates[second])) {
+			mismatched++;
+			continue;
+		}
+		if (!isnan(rate)) {
+			compared++;
+			float error = fabsf(rate - BENCH_rates[second]);
+			rate_error = error > rate_error ? error : rate_error;
+			error = fabsf(spo2 - BENCH_spo2[second]);
+			spo2_error = error > spo2_error ? error : spo2_error;
+		}
+	}
+	fclose(file);
+	printf("against %s: %d s compared, max |dHR| %.3f bpm, max |dSpO2| %.3f %%,"
+			" %d s with a heart rate in one only\n", filename, compared,
+			rate_error, spo2_error, mismatched);
+	return compared == 0 || mismatched > 0 || rate_error > BENCH_HR_TOLERANCE
+			|| spo2_error > BENCH_SPO2_TOLERANCE;
+}
+
+int main(int argc, char **argv) {
+	int seconds = 3600;
+	const char *record = NULL;
+	const char *output = NULL;
+	const char *compare = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			seconds = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			record = argv[++i];
+		} else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		} else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+			compare = argv[++i];
+		} else {
+			printf("usage: %s [--seconds N] [--record BIDMC_PREFIX]"
+					" [--output FILE] [--compare FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+	float min = 0.0f, max = 0.0f;
+	if (record != NULL) {
+		int samples = BENCH_readRecord(record);
+		if (samples == 0) {
+			printf("%s: no PLETH signal\n", record);
+			return 1;
+		}
+		min = max = BENCH_record[0];
+		for (int i = 1; i < samples; i++) {
+			min = BENCH_record[i] < min ? BENCH_record[i] : min;
+			max = BENCH_record[i] > max ? BENCH_record[i] : max;
+		}
+		seconds = samples / BENCH_FREQ;
+	} else if (output != NULL || compare != NULL) {
+		printf("--output and --compare need --record\n");
+		return 1;
+	}
+	HR_HeartMonitor *heartMonitor = HR_heartMonitor_new(BENCH_FREQ,
+			BENCH_SIZE, 0.35, 4, 0.8, 8.5, 2, 5, 7, BENCH_RATE_LOW,
+			BENCH_RATE_HIGH, HR_ENGINE_PEAKS);
+	if (heartMonitor == NULL) {
+		return 1;
+	}
+	heartMonitor->fusion = HR_fusion_new(BENCH_FREQ, BENCH_SIZE, 0.35, 4, 0.8,
+			8.5, 2, BENCH_RATE_HIGH);
+	if (heartMonitor->fusion == NULL) {
+		return 1;
+	}
+
+	PPG_Signal ppg;
+	PPG_init(&ppg, BENCH_FREQ, 72, 15, 0.005f, 1);
+	float fifo[BENCH_FREQ * HR_AFE_STRIDE];
+	double total[BENCH_STAGES] = { 0 };
+	float checksum = 0.0f;
+	int tracked = 0;
+	for (int second = 0; second < seconds; second++) {
+		HR_Result result;
+		HR_Quality quality;
+		double time[BENCH_STAGES + 1];
+		if (record != NULL) {
+			BENCH_recordFifo(fifo, second, min, max);
+		} else {
+			PPG_fifo(&ppg, fifo, BENCH_FREQ);
+		}
+		time[0] = BENCH_now();
+		HR_heartMonitor_addInterleaved(heartMonitor, fifo, NULL, BENCH_FREQ);
+		time[1] = BENCH_now();
+		HR_heartMonitor_peaksFromChannels(heartMonitor);
+		time[2] = BENCH_now();
+		HR_heartMonitor_heartRateAndRatio(heartMonitor, &result);
+		time[3] = BENCH_now();
+		HR_heartMonitor_quality(heartMonitor, &result, &quality);
+		time[4] = BENCH_now();
+		float rate = HR_heartMonitor_track(heartMonitor, &result);
+		time[5] = BENCH_now();
+		for (int stage = 0; stage < BENCH_STAGES; stage++) {
+			total[stage] += time[stage + 1] - time[stage];
+		}
+		if (rate == rate) {
+			checksum += rate;
+			tracked++;
+		}
+		if (record != NULL) {
+			// the display values of main.c
+			BENCH_rates[second] = rate;
+			BENCH_spo2[second] = 110.0f - 25.0f * result.ratio;
+			if (BENCH_spo2[second] >= 100.0f) {
+				BENCH_spo2[second] = 99.9f;
+			}
+		}
+	}
+
+#ifdef HR_FIXED_POINT
+	printf("HR_FIXED_POINT, %d s of samples at %d Hz\n", seconds, BENCH_FREQ);
+#else
+	printf("float, %d s of samples at %d Hz\n", seconds, BENCH_FREQ);
+#endif
+	printf("%-12s %12s %12s\n", "stage", "ns/second", "ns/sample");
+	double loop = 0.0;
+	for (int stage = 0; stage < BENCH_STAGES; stage++) {
+		double mean = seconds > 0 ? total[stage] / seconds : 0.0;
+		loop += mean;
+		printf("%-12s %12.0f %12.1f\n", BENCH_names[stage], mean,
+				mean / BENCH_FREQ);
+	}
+	printf("%-12s %12.0f %12.1f\n", "loop", loop, loop / BENCH_FREQ);
+	printf("mean tracked rate %.2f over %d s\n",
+			tracked > 0 ? checksum / tracked : 0.0f, tracked);
+	HR_fusion_free(heartMonitor->fusion);
+	HR_heartMonitor_free(heartMonitor);
+
+	if (output != NULL) {
+		FILE *file = fopen(output, "w");
+		if (file == NULL) {
+			perror(output);
+			return 1;
+		}
+		for (int second = 0; second < seconds; second++) {
+			fprintf(file, "%d %.4f %.4f\n", second, BENCH_rates[second],
+					BENCH_spo2[second]);
+		}
+		fclose(file);
+	}
+	return compare != NULL ? BENCH_compare(compare, seconds) : 0;
+}
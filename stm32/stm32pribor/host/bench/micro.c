@@ -0,0 +1,763 @@
+/**
+ * @file micro.c
+ * @brief Host microbenchmarks of the HR_HeartMonitor kernels
+ *
+ * Times the kernels of heartmonitor.c one by one over windows of HR_MON_SIZE
+ * samples, blocks of AFE samples and band-pass orders, and prints for every
+ * case the time per call and per sample, the throughput and the malloc calls
+ * per block. A block is the samples of one call: a FIFO read for the filters,
+ * a window for the peak detection and the estimators, none for BPF_new.
+ * BPF_reference is the band-pass filter of 4th order sections BPF_process
+ * replaced (host/bpf_reference.c), timed next to it as its baseline.
+ *
+ * The Cortex-M3 has no FPU, every float operation is a call of a helper of
+ * libgcc (__aeabi_fadd, __aeabi_fmul, ...). When the host allows ptrace, one
+ * call of every case is run again in a traced child one instruction at a
+ * time, each SSE instruction is counted as the helpers it becomes on the
+ * device and the other instructions as one cycle each. The estimate is per
+ * sample, per call for BPF_new. The helper cycles of BENCH_helpers are typical
+ * figures of libgcc on the Cortex-M3, so the estimate is rough and meant to
+ * compare kernels and runs; the helper counts are in the JSON output to be
+ * weighted otherwise. The cycles on the device come from the profiler
+ * (Core/Inc/profiler.h).
+ *
+ *     pribor_micro_float [--windows 100,250,500,1000] [--blocks 1,8,25,100]
+ *             [--orders 2,4,6,8] [--min-time S] [--no-cycles] [--json FILE]
+ *
+ * Orders without a table in BPF_tables are skipped unless HR_BPF_RUNTIME_DESIGN
+ * is defined.
+ */
+
+#include <bpf_reference.h>
+#include <heartmonitor.h>
+#include <ppg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__) && defined(__x86_64__)
+#define BENCH_PTRACE
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#define BENCH_FREQ 25
+#define BENCH_THRESHOLD 0.35f
+#define BENCH_LOW 0.8f
+#define BENCH_HIGH 8.5f
+#define BENCH_SSF_SIZE 2
+#define BENCH_MA_SIZE 5
+#define BENCH_MA_REDIR_SIZE 7
+#define BENCH_RATE_LOW 50
+#define BENCH_RATE_HIGH 150
+#define BENCH_SIGNAL (BENCH_FREQ * 60)
+#define BENCH_LIST 16
+
+/**
+ * @brief Soft-float helpers of the Cortex-M3, sub and min/max included in add and compare.
+ */
+typedef enum {
+	BENCH_FADD = 0,
+	BENCH_FMUL,
+	BENCH_FDIV,
+	BENCH_FCMP,
+	BENCH_FSQRT,
+	BENCH_I2F,
+	BENCH_F2I,
+	BENCH_F2D,
+	BENCH_D2F,
+	BENCH_DADD,
+	BENCH_DMUL,
+	BENCH_DDIV,
+	BENCH_DCMP,
+	BENCH_DSQRT,
+	BENCH_I2D,
+	BENCH_D2I,
+	BENCH_HELPERS
+} BENCH_Helper;
+
+typedef struct {
+	const char *name; /**< Name of the helper in libgcc or libm */
+	int cycles; /**< Typical cycles of a call on the Cortex-M3 */
+} BENCH_HelperCost;
+
+static const BENCH_HelperCost BENCH_helpers[BENCH_HELPERS] = {
+	{ "__aeabi_fadd", 55 }, { "__aeabi_fmul", 50 }, { "__aeabi_fdiv", 120 },
+	{ "__aeabi_fcmp", 30 }, { "sqrtf", 450 }, { "__aeabi_i2f", 35 },
+	{ "__aeabi_f2iz", 25 }, { "__aeabi_f2d", 25 }, { "__aeabi_d2f", 40 },
+	{ "__aeabi_dadd", 80 }, { "__aeabi_dmul", 100 }, { "__aeabi_ddiv", 350 },
+	{ "__aeabi_dcmp", 40 }, { "sqrt", 900 }, { "__aeabi_i2d", 35 },
+	{ "__aeabi_d2iz", 35 } };
+
+typedef struct BENCH_Case BENCH_Case;
+
+/**
+ * @brief One benchmark case, a kernel with its parameters and state.
+ */
+struct BENCH_Case {
+	const char *kernel; /**< Name of the kernel */
+	int window; /**< Window in samples, 0 when not a parameter */
+	int block; /**< Block in samples, 0 when not a parameter */
+	int order; /**< Band-pass order, 0 when not a parameter */
+	int samples; /**< Samples of one call, 0 for constructors */
+	const float *source; /**< Signal the calls go through */
+	void (*run)(BENCH_Case *bench, float *array); /**< One call of the kernel */
+	BPF_filter *bpf;
+	BPFREF_filter *reference;
+	MA_filter *ma;
+	SSF *ssf;
+	HR_HeartMonitor *heartMonitor;
+	int *signals;
+};
+
+typedef struct {
+	long calls; /**< Timed calls */
+	double ns; /**< Time of the timed calls */
+	long mallocs; /**< malloc calls of the timed calls */
+	int traced; /**< Whether the counts below are known */
+	long helpers[BENCH_HELPERS]; /**< Soft-float helper calls of one call */
+	long instructions; /**< Other instructions of one call */
+} BENCH_Result;
+
+static float BENCH_raw[BENCH_SIGNAL]; /**< Green channel as the AFE gives it */
+static float BENCH_filtered[BENCH_SIGNAL]; /**< Green channel after BPF, SSF and MA */
+static float BENCH_work[BENCH_SIGNAL];
+static long BENCH_mallocs;
+static volatile float BENCH_sink;
+
+void* __real_malloc(size_t size);
+
+/**
+ * @brief Counts the malloc calls of the kernels, linked with -Wl,--wrap=malloc.
+ */
+void* __wrap_malloc(size_t size) {
+	BENCH_mallocs++;
+	return __real_malloc(size);
+}
+
+static double BENCH_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static void BENCH_noop(BENCH_Case *bench, float *array) {
+	(void) bench;
+	(void) array;
+}
+
+static void BENCH_bpfNew(BENCH_Case *bench, float *array) {
+	(void) array;
+	BPF_free(BPF_new(bench->order, BENCH_FREQ, BENCH_LOW, BENCH_HIGH));
+}
+
+static void BENCH_bpfProcess(BENCH_Case *bench, float *array) {
+	BPF_process(bench->bpf, array, bench->block);
+}
+
+static void BENCH_bpfReference(BENCH_Case *bench, float *array) {
+	BPFREF_process(bench->reference, array, bench->block);
+}
+
+static void BENCH_maProcess(BENCH_Case *bench, float *array) {
+	MA_process(bench->ma, array, bench->block);
+}
+
+static void BENCH_ssfProcess(BENCH_Case *bench, float *array) {
+	SSF_process(bench->ssf, array, bench->block);
+}
+
+static void BENCH_peaksDetect(BENCH_Case *bench, float *array) {
+	peaks_detect(array, bench->signals, bench->window, BENCH_THRESHOLD);
+	peaks_normalize(array, bench->signals, bench->window);
+}
+
+static void BENCH_peaksIndexing(BENCH_Case *bench, float *array) {
+	(void) array;
+	int size;
+	free(peaks_indexingSize(bench->signals, bench->window, &size));
+	BENCH_sink = size;
+}
+
+static void BENCH_heartRate(BENCH_Case *bench, float *array) {
+	(void) array;
+	BENCH_sink = HR_heartMonitor_heartRateFromPeaks(bench->heartMonitor);
+}
+
+static void BENCH_ratio(BENCH_Case *bench, float *array) {
+	(void) array;
+	BENCH_sink = HR_heartMonitor_ratioFromPeaks(bench->heartMonitor);
+}
+
+/**
+ * @brief Times the calls of a case for at least a given time.
+ *
+ * The calls go through the signal block after block in place. The signal is
+ * copied back between the passes, outside the timed part.
+ *
+ * @param bench    Pointer to the case.
+ * @param min_time Minimum time of the timed calls in seconds.
+ * @param result   Pointer to the result to fill.
+ */
+static void BENCH_measure(BENCH_Case *bench, double min_time,
+		BENCH_Result *result) {
+	int step = bench->samples > 0 ? bench->samples : 1;
+	int calls = BENCH_SIGNAL / step;
+	memset(result, 0, sizeof(BENCH_Result));
+	for (int pass = -1; result->ns < min_time * 1e9; pass++) {
+		memcpy(BENCH_work, bench->source, sizeof(BENCH_work));
+		long mallocs = BENCH_mallocs;
+		double start = BENCH_now();
+		for (int i = 0; i < calls; i++) {
+			bench->run(bench, BENCH_work + i * step);
+		}
+		double time = BENCH_now() - start;
+		// The first pass warms up the caches and the state of the filters
+		if (pass >= 0) {
+			result->ns += time;
+			result->mallocs += BENCH_mallocs - mallocs;
+			result->calls += calls;
+		}
+	}
+}
+
+#ifdef BENCH_PTRACE
+/**
+ * @brief Counts a scalar or packed SSE/AVX floating point instruction.
+ *
+ * @param code    Bytes of the instruction, at least 16.
+ * @param helpers Counts of the helpers to update.
+ *
+ * @return 1 if the instruction is a floating point operation, 0 otherwise.
+ */
+static int BENCH_decode(const unsigned char *code, long *helpers) {
+	int i = 0;
+	int prefix = 0;
+	int map = 1;
+	int lanes = 1;
+	int wide = 0;
+	while (i < 4
+			&& (code[i] == 0x66 || code[i] == 0xF2 || code[i] == 0xF3
+					|| code[i] == 0xF0 || code[i] == 0x67 || code[i] == 0x2E
+					|| code[i] == 0x3E || code[i] == 0x26 || code[i] == 0x36
+					|| code[i] == 0x64 || code[i] == 0x65)) {
+		if (code[i] == 0x66 || code[i] == 0xF2 || code[i] == 0xF3) {
+			prefix = code[i];
+		}
+		i++;
+	}
+	static const int vex_prefixes[4] = { 0, 0x66, 0xF3, 0xF2 };
+	if (code[i] == 0xC5) {
+		prefix = vex_prefixes[code[i + 1] & 3];
+		lanes = code[i + 1] & 4 ? 2 : 1;
+		i += 2;
+	} else if (code[i] == 0xC4) {
+		map = code[i + 1] & 0x1F;
+		prefix = vex_prefixes[code[i + 2] & 3];
+		lanes = code[i + 2] & 4 ? 2 : 1;
+		wide = code[i + 2] >> 7;
+		i += 3;
+	} else {
+		if ((code[i] & 0xF0) == 0x40) {
+			i++;
+		}
+		if (code[i] != 0x0F) {
+			return 0;
+		}
+		i++;
+		if (code[i] == 0x38 || code[i] == 0x3A) {
+			map = code[i] == 0x38 ? 2 : 3;
+			i++;
+		}
+	}
+	int opcode = code[i];
+
+	// Fused multiply-add of FMA3, a multiplication and an addition
+	if (map == 2 && prefix == 0x66 && opcode >= 0x96 && opcode <= 0xBF
+			&& (opcode & 0x0F) >= 6) {
+		int scalar = (opcode & 1) && (opcode & 0x0F) >= 9;
+		int vector = scalar ? 1 : (wide ? 2 : 4) * lanes;
+		helpers[wide ? BENCH_DMUL : BENCH_FMUL] += vector;
+		helpers[wide ? BENCH_DADD : BENCH_FADD] += vector;
+		return 1;
+	}
+	// roundss and roundsd, a conversion to integer
+	if (map == 3 && prefix == 0x66 && (opcode == 0x0A || opcode == 0x0B)) {
+		helpers[opcode == 0x0A ? BENCH_F2I : BENCH_D2I]++;
+		return 1;
+	}
+	if (map != 1) {
+		return 0;
+	}
+
+	int single = prefix == 0xF3 || prefix == 0;
+	int vector = prefix == 0 ? 4 * lanes : prefix == 0x66 ? 2 * lanes : 1;
+	int helper;
+	switch (opcode) {
+	case 0x58:
+	case 0x5C:
+		helper = single ? BENCH_FADD : BENCH_DADD;
+		break;
+	case 0x59:
+		helper = single ? BENCH_FMUL : BENCH_DMUL;
+		break;
+	case 0x5E:
+		helper = single ? BENCH_FDIV : BENCH_DDIV;
+		break;
+	case 0x51:
+		helper = single ? BENCH_FSQRT : BENCH_DSQRT;
+		break;
+	case 0x5D:
+	case 0x5F:
+	case 0xC2:
+		helper = single ? BENCH_FCMP : BENCH_DCMP;
+		break;
+	case 0x2E:
+	case 0x2F:
+		if (prefix == 0xF3 || prefix == 0xF2) {
+			return 0;
+		}
+		helper = prefix == 0 ? BENCH_FCMP : BENCH_DCMP;
+		vector = 1;
+		break;
+	case 0x2A:
+		if (prefix != 0xF3 && prefix != 0xF2) {
+			return 0;
+		}
+		helper = single ? BENCH_I2F : BENCH_I2D;
+		break;
+	case 0x2C:
+	case 0x2D:
+		if (prefix != 0xF3 && prefix != 0xF2) {
+			return 0;
+		}
+		helper = single ? BENCH_F2I : BENCH_D2I;
+		break;
+	case 0x5A:
+		// cvtss2sd and cvtps2pd widen, cvtsd2ss and cvtpd2ps narrow
+		helper = single ? BENCH_F2D : BENCH_D2F;
+		vector = prefix == 0 || prefix == 0x66 ? 2 * lanes : 1;
+		break;
+	case 0x5B:
+		// cvtdq2ps, cvttps2dq and cvtps2dq
+		helper = prefix == 0 ? BENCH_I2F : BENCH_F2I;
+		vector = 4 * lanes;
+		break;
+	default:
+		return 0;
+	}
+	helpers[helper] += vector;
+	return 1;
+}
+
+/**
+ * @brief Counts the instructions of one call of a case in a traced child.
+ *
+ * The child stops itself, runs the call and exits, the counts include its stop
+ * and exit which BENCH_trace subtracts.
+ *
+ * @return 0 on success, -1 when the host does not allow tracing.
+ */
+static int BENCH_steps(BENCH_Case *bench, long *helpers, long *instructions) {
+	memcpy(BENCH_work, bench->source, sizeof(BENCH_work));
+	memset(helpers, 0, BENCH_HELPERS * sizeof(long));
+	*instructions = 0;
+	fflush(stdout);
+	pid_t child = fork();
+	if (child < 0) {
+		return -1;
+	}
+	if (child == 0) {
+		if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0) {
+			_exit(2);
+		}
+		raise(SIGSTOP);
+		bench->run(bench, BENCH_work);
+		_exit(0);
+	}
+	int status;
+	if (waitpid(child, &status, 0) != child || !WIFSTOPPED(status)) {
+		return -1;
+	}
+	for (;;) {
+		struct user_regs_struct regs;
+		long code[2];
+		if (ptrace(PTRACE_GETREGS, child, NULL, &regs) != 0) {
+			break;
+		}
+		code[0] = ptrace(PTRACE_PEEKTEXT, child, (void*) regs.rip, NULL);
+		code[1] = ptrace(PTRACE_PEEKTEXT, child, (void*) (regs.rip + 8), NULL);
+		if (!BENCH_decode((const unsigned char*) code, helpers)) {
+			(*instructions)++;
+		}
+		if (ptrace(PTRACE_SINGLESTEP, child, NULL, NULL) != 0
+				|| waitpid(child, &status, 0) != child) {
+			break;
+		}
+		if (WIFEXITED(status)) {
+			return WEXITSTATUS(status) == 0 ? 0 : -1;
+		}
+		if (WIFSIGNALED(status)
+				|| (WIFSTOPPED(status) && WSTOPSIG(status) != SIGTRAP)) {
+			break;
+		}
+	}
+	kill(child, SIGKILL);
+	waitpid(child, &status, 0);
+	return -1;
+}
+#endif
+
+/**
+ * @brief Counts the soft-float helpers and other instructions of one call of a case.
+ *
+ * @return 1 if the result has the counts, 0 when not available on this host.
+ */
+static int BENCH_trace(BENCH_Case *bench, BENCH_Result *result) {
+#ifdef BENCH_PTRACE
+	BENCH_Case noop = *bench;
+	long helpers[BENCH_HELPERS];
+	long instructions;
+	noop.run = BENCH_noop;
+	if (BENCH_steps(&noop, helpers, &instructions) != 0
+			|| BENCH_steps(bench, result->helpers, &result->instructions) != 0) {
+		return 0;
+	}
+	for (int helper = 0; helper < BENCH_HELPERS; helper++) {
+		result->helpers[helper] -= helpers[helper];
+		if (result->helpers[helper] < 0) {
+			result->helpers[helper] = 0;
+		}
+	}
+	result->instructions -= instructions;
+	if (result->instructions < 0) {
+		result->instructions = 0;
+	}
+	return 1;
+#else
+	(void) bench;
+	(void) result;
+	return 0;
+#endif
+}
+
+/**
+ * @brief Estimated Cortex-M3 cycles of one call from the counts of BENCH_trace.
+ */
+static double BENCH_cycles(const BENCH_Result *result) {
+	double cycles = result->instructions;
+	for (int helper = 0; helper < BENCH_HELPERS; helper++) {
+		cycles += (double) result->helpers[helper] * BENCH_helpers[helper].cycles;
+	}
+	return cycles;
+}
+
+/**
+ * @brief Creates a heart monitor of main.c with a full window of peaks.
+ */
+static HR_HeartMonitor* BENCH_monitor(int window) {
+	HR_HeartMonitor *heartMonitor = HR_heartMonitor_new(BENCH_FREQ, window,
+			BENCH_THRESHOLD, 4, BENCH_LOW, BENCH_HIGH, BENCH_SSF_SIZE,
+			BENCH_MA_SIZE, BENCH_MA_REDIR_SIZE, BENCH_RATE_LOW, BENCH_RATE_HIGH,
+			HR_ENGINE_PEAKS);
+	if (heartMonitor == NULL) {
+		return NULL;
+	}
+	PPG_Signal ppg;
+	PPG_init(&ppg, BENCH_FREQ, 72, 15, 0.005f, 1);
+	float fifo[BENCH_FREQ * HR_AFE_STRIDE];
+	for (int second = 0; second < window / BENCH_FREQ + 10; second++) {
+		PPG_fifo(&ppg, fifo, BENCH_FREQ);
+		HR_heartMonitor_addInterleaved(heartMonitor, fifo, NULL, BENCH_FREQ);
+		HR_heartMonitor_peaksFromChannels(heartMonitor);
+	}
+	return heartMonitor;
+}
+
+/**
+ * @brief Parses a comma separated list of positive integers.
+ *
+ * @return Number of values or -1 if the list is not valid.
+ */
+static int BENCH_list(const char *text, int *values) {
+	int size = 0;
+	while (*text != '\0') {
+		char *end;
+		long value = strtol(text, &end, 10);
+		if (end == text || value <= 0 || size == BENCH_LIST
+				|| (*end != ',' && *end != '\0')) {
+			return -1;
+		}
+		values[size++] = value;
+		text = *end == ',' ? end + 1 : end;
+	}
+	return size > 0 ? size : -1;
+}
+
+static void BENCH_jsonInt(FILE *json, const char *key, int value) {
+	if (value > 0) {
+		fprintf(json, "\"%s\": %d, ", key, value);
+	} else {
+		fprintf(json, "\"%s\": null, ", key);
+	}
+}
+
+/**
+ * @brief Prints a case to stdout and to the JSON output.
+ */
+static void BENCH_report(const BENCH_Case *bench, const BENCH_Result *result,
+		FILE *json, int first) {
+	double per_call = result->ns / result->calls;
+	double mallocs = (double) result->mallocs / result->calls;
+	char window[16] = "-", block[16] = "-", order[16] = "-";
+	char per_sample[16] = "-", throughput[16] = "-", cycles[16] = "-";
+	if (bench->window > 0) {
+		snprintf(window, sizeof(window), "%d", bench->window);
+	}
+	if (bench->block > 0) {
+		snprintf(block, sizeof(block), "%d", bench->block);
+	}
+	if (bench->order > 0) {
+		snprintf(order, sizeof(order), "%d", bench->order);
+	}
+	if (bench->samples > 0) {
+		snprintf(per_sample, sizeof(per_sample), "%.2f",
+				per_call / bench->samples);
+		snprintf(throughput, sizeof(throughput), "%.2f",
+				bench->samples / per_call * 1e3);
+	}
+	if (result->traced) {
+		double per = bench->samples > 0 ? bench->samples : 1;
+		snprintf(cycles, sizeof(cycles), "%.0f", BENCH_cycles(result) / per);
+	}
+	printf("%-20s %6s %6s %5s %12.1f %10s %10s %8.2f %10s\n", bench->kernel,
+			window, block, order, per_call, per_sample, throughput, mallocs,
+			cycles);
+	if (json == NULL) {
+		return;
+	}
+
+	fprintf(json, "%s\n    { \"kernel\": \"%s\", ", first ? "" : ",",
+			bench->kernel);
+	BENCH_jsonInt(json, "window", bench->window);
+	BENCH_jsonInt(json, "block", bench->block);
+	BENCH_jsonInt(json, "order", bench->order);
+	fprintf(json, "\"calls\": %ld, \"ns_per_call\": %.2f, ", result->calls,
+			per_call);
+	if (bench->samples > 0) {
+		fprintf(json, "\"ns_per_sample\": %.3f, \"samples_per_s\": %.0f, ",
+				per_call / bench->samples, bench->samples / per_call * 1e9);
+	} else {
+		fprintf(json, "\"ns_per_sample\": null, \"samples_per_s\": null, ");
+	}
+	fprintf(json, "\"mallocs_per_block\": %.3f, ", mallocs);
+	if (!result->traced) {
+		fprintf(json, "\"helpers\": null, \"instructions\": null, "
+				"\"m3_cycles_per_call\": null, \"m3_cycles_per_sample\": null }");
+		return;
+	}
+	fprintf(json, "\"helpers\": { ");
+	for (int helper = 0; helper < BENCH_HELPERS; helper++) {
+		fprintf(json, "%s\"%s\": %ld", helper > 0 ? ", " : "",
+				BENCH_helpers[helper].name, result->helpers[helper]);
+	}
+	fprintf(json, " }, \"instructions\": %ld, \"m3_cycles_per_call\": %.0f, ",
+			result->instructions, BENCH_cycles(result));
+	if (bench->samples > 0) {
+		fprintf(json, "\"m3_cycles_per_sample\": %.1f }",
+				BENCH_cycles(result) / bench->samples);
+	} else {
+		fprintf(json, "\"m3_cycles_per_sample\": null }");
+	}
+}
+
+/**
+ * @brief Measures, traces and reports a case.
+ */
+static void BENCH_run(BENCH_Case *bench, double min_time, int cycles,
+		FILE *json, int *first) {
+	BENCH_Result result;
+	BENCH_measure(bench, min_time, &result);
+	result.traced = cycles && BENCH_trace(bench, &result);
+	BENCH_report(bench, &result, json, *first);
+	*first = 0;
+}
+
+static int BENCH_usage(const char *name) {
+	printf("usage: %s [--windows N,...] [--blocks N,...] [--orders N,...]"
+			" [--min-time S] [--no-cycles] [--json FILE]\n", name);
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	int windows[BENCH_LIST] = { 100, 250, 500, 1000 };
+	int blocks[BENCH_LIST] = { 1, 8, 25, 100 };
+	int orders[BENCH_LIST] = { 2, 4, 6, 8 };
+	int windows_size = 4, blocks_size = 4, orders_size = 4;
+	double min_time = 0.1;
+	int cycles = 1;
+	const char *json_name = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+			windows_size = BENCH_list(argv[++i], windows);
+		} else if (strcmp(argv[i], "--blocks") == 0 && i + 1 < argc) {
+			blocks_size = BENCH_list(argv[++i], blocks);
+		} else if (strcmp(argv[i], "--orders") == 0 && i + 1 < argc) {
+			orders_size = BENCH_list(argv[++i], orders);
+		} else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+			min_time = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--no-cycles") == 0) {
+			cycles = 0;
+		} else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_name = argv[++i];
+		} else {
+			return BENCH_usage(argv[0]);
+		}
+	}
+	if (windows_size < 0 || blocks_size < 0 || orders_size < 0) {
+		return BENCH_usage(argv[0]);
+	}
+	for (int i = 0; i < windows_size; i++) {
+		if (windows[i] > BENCH_SIGNAL) {
+			printf("windows up to %d samples\n", BENCH_SIGNAL);
+			return 1;
+		}
+	}
+	for (int i = 0; i < blocks_size; i++) {
+		if (blocks[i] > BENCH_SIGNAL) {
+			printf("blocks up to %d samples\n", BENCH_SIGNAL);
+			return 1;
+		}
+	}
+
+	// The green channel of main.c before and after its filters
+	PPG_Signal ppg;
+	PPG_init(&ppg, BENCH_FREQ, 72, 15, 0.005f, 1);
+	static float fifo[BENCH_SIGNAL * HR_AFE_STRIDE];
+	PPG_fifo(&ppg, fifo, BENCH_SIGNAL);
+	for (int i = 0; i < BENCH_SIGNAL; i++) {
+		BENCH_raw[i] = BENCH_filtered[i] = fifo[i * HR_AFE_STRIDE + HR_AFE_GREEN];
+	}
+	BPF_filter *bpf = BPF_new(4, BENCH_FREQ, BENCH_LOW, BENCH_HIGH);
+	SSF *ssf = SSF_new(BENCH_SSF_SIZE);
+	MA_filter *ma = MA_new(BENCH_MA_SIZE);
+	if (bpf == NULL || ssf == NULL || ma == NULL) {
+		return 1;
+	}
+	BPF_process(bpf, BENCH_filtered, BENCH_SIGNAL);
+	SSF_process(ssf, BENCH_filtered, BENCH_SIGNAL);
+	MA_process(ma, BENCH_filtered, BENCH_SIGNAL);
+	BPF_free(bpf);
+
+	FILE *json = NULL;
+	if (json_name != NULL) {
+		json = fopen(json_name, "w");
+		if (json == NULL) {
+			perror(json_name);
+			return 1;
+		}
+#ifdef HR_FIXED_POINT
+		fprintf(json, "{\n  \"variant\": \"fixed\",\n");
+#else
+		fprintf(json, "{\n  \"variant\": \"float\",\n");
+#endif
+		fprintf(json, "  \"freq\": %d,\n  \"min_time\": %g,\n"
+				"  \"m3_helper_cycles\": { ", BENCH_FREQ, min_time);
+		for (int helper = 0; helper < BENCH_HELPERS; helper++) {
+			fprintf(json, "%s\"%s\": %d", helper > 0 ? ", " : "",
+					BENCH_helpers[helper].name, BENCH_helpers[helper].cycles);
+		}
+		fprintf(json, " },\n  \"results\": [");
+	}
+
+#ifdef HR_FIXED_POINT
+	printf("HR_FIXED_POINT, %d Hz, at least %g s per case\n", BENCH_FREQ,
+			min_time);
+#else
+	printf("float, %d Hz, at least %g s per case\n", BENCH_FREQ, min_time);
+#endif
+	printf("%-20s %6s %6s %5s %12s %10s %10s %8s %10s\n", "kernel", "window",
+			"block", "order", "ns/call", "ns/sample", "Msample/s", "mallocs",
+			"M3 cycles");
+	int first = 1;
+	for (int i = 0; i < orders_size; i++) {
+		BENCH_Case bench = { .kernel = "BPF_new", .order = orders[i],
+				.source = BENCH_raw, .run = BENCH_bpfNew };
+		bench.bpf = BPF_new(orders[i], BENCH_FREQ, BENCH_LOW, BENCH_HIGH);
+		if (bench.bpf == NULL) {
+			printf("%-20s %6s %6s %5d skipped, no table\n", "BPF_new", "-", "-",
+					orders[i]);
+			continue;
+		}
+		BENCH_run(&bench, min_time, cycles, json, &first);
+		bench.kernel = "BPF_process";
+		bench.run = BENCH_bpfProcess;
+		for (int j = 0; j < blocks_size; j++) {
+			bench.block = bench.samples = blocks[j];
+			BENCH_run(&bench, min_time, cycles, json, &first);
+		}
+		BPF_free(bench.bpf);
+		bench.reference = BPFREF_new(orders[i], BENCH_FREQ, BENCH_LOW,
+				BENCH_HIGH);
+		if (bench.reference == NULL) {
+			return 1;
+		}
+		bench.kernel = "BPF_reference";
+		bench.run = BENCH_bpfReference;
+		for (int j = 0; j < blocks_size; j++) {
+			bench.block = bench.samples = blocks[j];
+			BENCH_run(&bench, min_time, cycles, json, &first);
+		}
+		BPFREF_free(bench.reference);
+	}
+	for (int j = 0; j < blocks_size; j++) {
+		BENCH_Case bench = { .kernel = "MA_process", .block = blocks[j],
+				.samples = blocks[j], .source = BENCH_raw, .run =
+						BENCH_maProcess, .ma = ma };
+		BENCH_run(&bench, min_time, cycles, json, &first);
+	}
+	for (int j = 0; j < blocks_size; j++) {
+		BENCH_Case bench = { .kernel = "SSF_process", .block = blocks[j],
+				.samples = blocks[j], .source = BENCH_raw, .run =
+						BENCH_ssfProcess, .ssf = ssf };
+		BENCH_run(&bench, min_time, cycles, json, &first);
+	}
+	for (int i = 0; i < windows_size; i++) {
+		int signals[BENCH_SIGNAL];
+		BENCH_Case bench = { .kernel = "peaks_detect+normalize", .window =
+				windows[i], .samples = windows[i], .source = BENCH_filtered,
+				.run = BENCH_peaksDetect, .signals = signals };
+		BENCH_run(&bench, min_time, cycles, json, &first);
+
+		// The signals of the last window of the filtered signal
+		memcpy(BENCH_work, BENCH_filtered, sizeof(BENCH_work));
+		BENCH_peaksDetect(&bench,
+				BENCH_work + (BENCH_SIGNAL / windows[i] - 1) * windows[i]);
+		bench.kernel = "peaks_indexingSize";
+		bench.run = BENCH_peaksIndexing;
+		BENCH_run(&bench, min_time, cycles, json, &first);
+
+		bench.heartMonitor = BENCH_monitor(windows[i]);
+		if (bench.heartMonitor == NULL) {
+			return 1;
+		}
+		bench.kernel = "heartRateFromPeaks";
+		bench.run = BENCH_heartRate;
+		BENCH_run(&bench, min_time, cycles, json, &first);
+		bench.kernel = "ratioFromPeaks";
+		bench.run = BENCH_ratio;
+		BENCH_run(&bench, min_time, cycles, json, &first);
+		HR_heartMonitor_free(bench.heartMonitor);
+	}
+	if (json != NULL) {
+		fprintf(json, "\n  ]\n}\n");
+		fclose(json);
+	}
+	SSF_free(ssf);
+	MA_free(ma);
+	return 0;
+}
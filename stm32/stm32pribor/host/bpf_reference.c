@@ -0,0 +1,91 @@
+/**
+ * @file bpf_reference.c
+ * @brief Band-pass filter the biquad cascade of BPF_filter replaced, for the host tests and benchmarks
+ */
+
+#include "bpf_reference.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define BPFREF_PI 3.14159265358979
+
+/**
+ * @brief Creates the former band-pass filter, designed as BPF_new did.
+ *
+ * @param order The order of the bandpass filter.
+ * @param freq  The sampling frequency.
+ * @param low   The lower cutoff frequency.
+ * @param high  The higher cutoff frequency.
+ *
+ * @return Pointer to the newly created BPFREF_filter or NULL, freed by BPFREF_free.
+ */
+BPFREF_filter* BPFREF_new(int order, float freq, float low, float high) {
+	int n = order / 2;
+	BPFREF_filter *filter = (BPFREF_filter*) malloc(
+			sizeof(BPFREF_filter) + 10 * n * sizeof(float));
+	if (filter == NULL) {
+		return NULL;
+	}
+	float *arrays = (float*) (filter + 1);
+	filter->n = n;
+	filter->A = arrays;
+	filter->d1 = arrays + n;
+	filter->d2 = arrays + 2 * n;
+	filter->d3 = arrays + 3 * n;
+	filter->d4 = arrays + 4 * n;
+	filter->w0 = arrays + 5 * n;
+	filter->w1 = arrays + 6 * n;
+	filter->w2 = arrays + 7 * n;
+	filter->w3 = arrays + 8 * n;
+	filter->w4 = arrays + 9 * n;
+	for (int i = 5 * n; i < 10 * n; i++) {
+		arrays[i] = 0.0f;
+	}
+
+	float a = cosf(BPFREF_PI * (high + low) / freq)
+			/ cosf(BPFREF_PI * (high - low) / freq);
+	float b = tanf(BPFREF_PI * (high - low) / freq);
+	for (int i = 0; i < n; ++i) {
+		float r = sinf(BPFREF_PI * (2.0 * i + 1.0) / (4.0 * n));
+		float s = b * b + 2.0 * b * r + 1.0;
+		filter->A[i] = b * b / s;
+		filter->d1[i] = 4.0 * a * (1.0 + b * r) / s;
+		filter->d2[i] = 2.0 * (b * b - 2.0 * a * a - 1.0) / s;
+		filter->d3[i] = 4.0 * a * (1.0 - b * r) / s;
+		filter->d4[i] = -(b * b - 2.0 * b * r + 1.0) / s;
+	}
+	return filter;
+}
+
+/**
+ * @brief Frees a BPFREF_filter.
+ *
+ * @param filter Pointer to the BPFREF_filter created by BPFREF_new.
+ */
+void BPFREF_free(BPFREF_filter *filter) {
+	free(filter);
+}
+
+/**
+ * @brief Filters an array in place, sample by sample through every section.
+ *
+ * @param filter     Pointer to the BPFREF_filter.
+ * @param array      Pointer to the array to be filtered.
+ * @param array_size The size of the array.
+ */
+void BPFREF_process(BPFREF_filter *filter, float *array, int array_size) {
+	for (int i = 0; i < array_size; i++) {
+		for (int j = 0; j < filter->n; ++j) {
+			filter->w0[j] = filter->d1[j] * filter->w1[j]
+					+ filter->d2[j] * filter->w2[j]
+					+ filter->d3[j] * filter->w3[j]
+					+ filter->d4[j] * filter->w4[j] + array[i];
+			array[i] = filter->A[j]
+					* (filter->w0[j] - 2.0 * filter->w2[j] + filter->w4[j]);
+			filter->w4[j] = filter->w3[j];
+			filter->w3[j] = filter->w2[j];
+			filter->w2[j] = filter->w1[j];
+			filter->w1[j] = filter->w0[j];
+		}
+	}
+}
@@ -0,0 +1,35 @@
+/**
+ * @file bpf_reference.h
+ * @brief Band-pass filter the biquad cascade of BPF_filter replaced, for the host tests and benchmarks
+ */
+
+#ifndef HOST_BPF_REFERENCE_H_
+#define HOST_BPF_REFERENCE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Structure representing the former Butterworth band-pass filter.
+ *
+ * The same design as BPF_filter, kept as order / 2 sections of 4th order
+ * in direct form II with the coefficients and the state in parallel arrays,
+ * as BPF_filter did before it became a cascade of biquads. It is the
+ * reference of the frequency response test and the baseline of the
+ * microbenchmark of BPF_process.
+ */
+typedef struct {
+	int n; /**< Number of 4th order sections */
+	float *A, *d1, *d2, *d3, *d4, *w0, *w1, *w2, *w3, *w4; /**< Pointers to coefficients and state */
+} BPFREF_filter;
+
+BPFREF_filter* BPFREF_new(int order, float freq, float low, float high);
+void BPFREF_free(BPFREF_filter *filter);
+void BPFREF_process(BPFREF_filter *filter, float *array, int array_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_BPF_REFERENCE_H_ */
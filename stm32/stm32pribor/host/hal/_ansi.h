@@ -0,0 +1,17 @@
+/**
+ * @file _ansi.h
+ * @brief Host stand-in for the newlib header included by ssd1306.h
+ */
+
+#ifndef HOST_ANSI_H_
+#define HOST_ANSI_H_
+
+#ifdef __cplusplus
+#define _BEGIN_STD_C extern "C" {
+#define _END_STD_C }
+#else
+#define _BEGIN_STD_C
+#define _END_STD_C
+#endif
+
+#endif /* HOST_ANSI_H_ */
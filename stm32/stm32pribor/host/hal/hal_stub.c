@@ -0,0 +1,182 @@
+/**
+ * @file hal_stub.c
+ * @brief Host stand-in of the HAL functions used by the host build
+ *
+ * Transfers complete at once: a UART transmission is logged and its complete
+ * callback runs before HAL_UART_Transmit_IT returns, followed by the reply
+ * queued with HAL_stub_reply, byte by byte as the receive interrupts would
+ * deliver it. I2C memory writes to the SSD1306 are logged as commands
+ * (memory address 0x00) or display data (0x40).
+ */
+
+#include "hal_stub.h"
+#include <string.h>
+
+GPIO_TypeDef HAL_GPIOA, HAL_GPIOB, HAL_GPIOC, HAL_GPIOD;
+
+static USART_TypeDef HAL_USART1 = { 1 };
+
+UART_HandleTypeDef huart1 = { &HAL_USART1, NULL, 0, 0 };
+I2C_HandleTypeDef hi2c1 = { HAL_I2C_STATE_READY };
+
+/**
+ * @brief Bytes transmitted on the UARTs.
+ */
+HAL_StubLog HAL_stub_uart;
+
+/**
+ * @brief Bytes written to I2C memory address 0x00, the SSD1306 commands.
+ */
+HAL_StubLog HAL_stub_i2cCommands;
+
+/**
+ * @brief Bytes written to I2C memory address 0x40, the SSD1306 display data.
+ */
+HAL_StubLog HAL_stub_i2cData;
+
+/**
+ * @brief Reply delivered after the next transmission.
+ */
+static uint8_t HAL_stub_replyData[HAL_STUB_LOG];
+static int HAL_stub_replySize;
+
+static uint32_t HAL_stub_tick;
+
+/**
+ * @brief Appends bytes to a log.
+ */
+static void HAL_stub_log(HAL_StubLog *log, const uint8_t *bytes, int size) {
+	for (int i = 0; i < size; i++) {
+		if (log->size + i < HAL_STUB_LOG) {
+			log->data[log->size + i] = bytes[i];
+		}
+	}
+	log->size += size;
+	log->writes++;
+}
+
+/**
+ * @brief Clears the logs, the queued reply and the pending receive of huart1.
+ */
+void HAL_stub_reset(void) {
+	memset(&HAL_stub_uart, 0, sizeof(HAL_stub_uart));
+	memset(&HAL_stub_i2cCommands, 0, sizeof(HAL_stub_i2cCommands));
+	memset(&HAL_stub_i2cData, 0, sizeof(HAL_stub_i2cData));
+	HAL_stub_replySize = 0;
+	huart1.pRxBuffPtr = NULL;
+	huart1.RxXferCount = 0;
+}
+
+/**
+ * @brief Queues the bytes a module answers with to the next transmission.
+ *
+ * @param bytes Bytes of the reply.
+ * @param size  Number of bytes, at most HAL_STUB_LOG.
+ */
+void HAL_stub_reply(const uint8_t *bytes, int size) {
+	if (size > HAL_STUB_LOG) {
+		size = HAL_STUB_LOG;
+	}
+	memcpy(HAL_stub_replyData, bytes, size);
+	HAL_stub_replySize = size;
+}
+
+/**
+ * @brief Delivers bytes to the pending receive of a UART.
+ *
+ * Every completed receive calls HAL_UART_RxCpltCallback, which may start the
+ * next one. Delivery stops when no receive is pending.
+ *
+ * @param huart Pointer to the UART handle.
+ * @param bytes Bytes received.
+ * @param size  Number of bytes.
+ * @return Number of bytes delivered.
+ */
+int HAL_stub_receive(UART_HandleTypeDef *huart, const uint8_t *bytes,
+		int size) {
+	int i;
+	for (i = 0; i < size && huart->pRxBuffPtr != NULL; i++) {
+		*huart->pRxBuffPtr++ = bytes[i];
+		if (--huart->RxXferCount == 0) {
+			huart->pRxBuffPtr = NULL;
+			HAL_UART_RxCpltCallback(huart);
+		}
+	}
+	return i;
+}
+
+uint32_t HAL_GetTick(void) {
+	return HAL_stub_tick;
+}
+
+void HAL_Delay(uint32_t Delay) {
+	HAL_stub_tick += Delay;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin,
+		GPIO_PinState PinState) {
+	if (PinState == GPIO_PIN_SET) {
+		GPIOx->ODR |= GPIO_Pin;
+	} else {
+		GPIOx->ODR &= ~(uint32_t) GPIO_Pin;
+	}
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+	return (GPIOx->ODR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart,
+		uint8_t *pData, uint16_t Size) {
+	HAL_stub_log(&HAL_stub_uart, pData, Size);
+	HAL_UART_TxCpltCallback(huart);
+	int size = HAL_stub_replySize;
+	HAL_stub_replySize = 0;
+	HAL_stub_receive(huart, HAL_stub_replyData, size);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart,
+		uint8_t *pData, uint16_t Size) {
+	if (huart->pRxBuffPtr != NULL) {
+		return HAL_BUSY;
+	}
+	huart->pRxBuffPtr = pData;
+	huart->RxXferSize = Size;
+	huart->RxXferCount = Size;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive_IT(UART_HandleTypeDef *huart) {
+	huart->pRxBuffPtr = NULL;
+	huart->RxXferCount = 0;
+	return HAL_OK;
+}
+
+void HAL_UART_AbortReceiveCpltCallback(UART_HandleTypeDef *huart) {
+	(void) huart;
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c) {
+	return hi2c->State;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c,
+		uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+		uint8_t *pData, uint16_t Size) {
+	(void) hi2c;
+	(void) DevAddress;
+	(void) MemAddSize;
+	HAL_stub_log(MemAddress == 0x40 ? &HAL_stub_i2cData : &HAL_stub_i2cCommands,
+			pData, Size);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData,
+		uint16_t Size, uint32_t Timeout) {
+	(void) hspi;
+	(void) pData;
+	(void) Size;
+	(void) Timeout;
+	return HAL_OK;
+}
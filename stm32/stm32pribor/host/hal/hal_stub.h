@@ -0,0 +1,42 @@
+/**
+ * @file hal_stub.h
+ * @brief Logs of the host stand-in of the HAL, see hal_stub.c
+ */
+
+#ifndef HOST_HAL_STUB_H_
+#define HOST_HAL_STUB_H_
+
+#include "stm32f1xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Bytes kept by a log, later ones are counted but not kept.
+ */
+#define HAL_STUB_LOG 4096
+
+/**
+ * @brief Structure representing the bytes sent to a peripheral.
+ */
+typedef struct {
+	uint8_t data[HAL_STUB_LOG]; /**< Bytes sent, oldest first */
+	int size; /**< Number of bytes sent, may exceed HAL_STUB_LOG */
+	int writes; /**< Number of calls that sent them */
+} HAL_StubLog;
+
+extern HAL_StubLog HAL_stub_uart;
+extern HAL_StubLog HAL_stub_i2cCommands;
+extern HAL_StubLog HAL_stub_i2cData;
+
+void HAL_stub_reset(void);
+void HAL_stub_reply(const uint8_t *bytes, int size);
+int HAL_stub_receive(UART_HandleTypeDef *huart, const uint8_t *bytes,
+		int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_HAL_STUB_H_ */
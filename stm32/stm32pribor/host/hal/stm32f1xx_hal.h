@@ -0,0 +1,114 @@
+/**
+ * @file stm32f1xx_hal.h
+ * @brief Host stand-in for the STM32F1 HAL
+ *
+ * Only the types, constants and functions used by the modules of the host
+ * build (bee.c, ledhelper.c, ssd1306.c, main.h and usart.h), with the same
+ * names as the HAL. The functions are in hal_stub.c, which logs what the
+ * modules send instead of driving a peripheral.
+ */
+
+#ifndef HOST_STM32F1XX_HAL_H_
+#define HOST_STM32F1XX_HAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	HAL_OK = 0x00U, HAL_ERROR = 0x01U, HAL_BUSY = 0x02U, HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum {
+	RESET = 0U, SET = !RESET
+} FlagStatus, ITStatus;
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+typedef enum {
+	GPIO_PIN_RESET = 0U, GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct {
+	uint32_t ODR; /**< Output data register */
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef HAL_GPIOA, HAL_GPIOB, HAL_GPIOC, HAL_GPIOD;
+
+#define GPIOA (&HAL_GPIOA)
+#define GPIOB (&HAL_GPIOB)
+#define GPIOC (&HAL_GPIOC)
+#define GPIOD (&HAL_GPIOD)
+
+#define GPIO_PIN_0 ((uint16_t) 0x0001)
+#define GPIO_PIN_1 ((uint16_t) 0x0002)
+#define GPIO_PIN_2 ((uint16_t) 0x0004)
+#define GPIO_PIN_3 ((uint16_t) 0x0008)
+#define GPIO_PIN_4 ((uint16_t) 0x0010)
+#define GPIO_PIN_5 ((uint16_t) 0x0020)
+#define GPIO_PIN_6 ((uint16_t) 0x0040)
+#define GPIO_PIN_7 ((uint16_t) 0x0080)
+#define GPIO_PIN_8 ((uint16_t) 0x0100)
+#define GPIO_PIN_9 ((uint16_t) 0x0200)
+#define GPIO_PIN_10 ((uint16_t) 0x0400)
+#define GPIO_PIN_11 ((uint16_t) 0x0800)
+#define GPIO_PIN_12 ((uint16_t) 0x1000)
+#define GPIO_PIN_13 ((uint16_t) 0x2000)
+#define GPIO_PIN_14 ((uint16_t) 0x4000)
+#define GPIO_PIN_15 ((uint16_t) 0x8000)
+
+typedef struct {
+	uint32_t number; /**< Number of the peripheral, 1 for USART1 */
+} USART_TypeDef;
+
+typedef struct {
+	USART_TypeDef *Instance; /**< Peripheral of the handle */
+	uint8_t *pRxBuffPtr; /**< Destination of the pending receive or NULL */
+	uint16_t RxXferSize; /**< Bytes of the pending receive */
+	uint16_t RxXferCount; /**< Bytes of the pending receive still to come */
+} UART_HandleTypeDef;
+
+typedef enum {
+	HAL_I2C_STATE_RESET = 0x00U, HAL_I2C_STATE_READY = 0x20U
+} HAL_I2C_StateTypeDef;
+
+typedef struct {
+	HAL_I2C_StateTypeDef State; /**< State of the peripheral */
+} I2C_HandleTypeDef;
+
+typedef struct {
+	uint32_t number; /**< Number of the peripheral */
+} SPI_HandleTypeDef;
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin,
+		GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart,
+		uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart,
+		uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_AbortReceive_IT(UART_HandleTypeDef *huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_AbortReceiveCpltCallback(UART_HandleTypeDef *huart);
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c,
+		uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+		uint8_t *pData, uint16_t Size);
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData,
+		uint16_t Size, uint32_t Timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_STM32F1XX_HAL_H_ */
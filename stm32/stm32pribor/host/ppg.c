@@ -0,0 +1,76 @@
+/**
+ * @file ppg.c
+ * @brief Synthetic AFE samples for the host tests and benchmarks
+ */
+
+#include "ppg.h"
+#include <heartmonitor.h>
+#include <math.h>
+
+#define PPG_PI 3.14159265f
+
+/**
+ * @brief Initializes a synthetic signal.
+ *
+ * @param ppg       Pointer to the PPG_Signal structure.
+ * @param freq      Sampling frequency in Hz.
+ * @param rate      Mean heart rate in beats/min.
+ * @param breathing Respiration rate in breaths/min.
+ * @param noise     Peak amplitude of the noise of the green channel.
+ * @param seed      Seed of the noise, the same seed gives the same samples.
+ */
+void PPG_init(PPG_Signal *ppg, float freq, float rate, float breathing,
+		float noise, unsigned int seed) {
+	ppg->freq = freq;
+	ppg->rate = rate;
+	ppg->breathing = breathing;
+	ppg->noise = noise;
+	ppg->phase = 0.0f;
+	ppg->count = 0;
+	ppg->seed = seed;
+}
+
+/**
+ * @brief Uniform noise from -1 to 1 of a linear congruential generator.
+ *
+ * @param seed Pointer to the state of the generator, updated.
+ */
+float PPG_noise(unsigned int *seed) {
+	*seed = *seed * 1103515245u + 12345u;
+	return (float) (*seed >> 8 & 0xFFFF) / 32768.0f - 1.0f;
+}
+
+/**
+ * @brief Pulse of one beat at a position within it, peak about 1.
+ */
+static float PPG_pulse(float phase) {
+	float systolic = (phase - 0.2f) / 0.08f;
+	float dicrotic = (phase - 0.45f) / 0.12f;
+	return expf(-systolic * systolic) + 0.15f * expf(-dicrotic * dicrotic);
+}
+
+/**
+ * @brief Generates interleaved AFE samples as HR_heartMonitor_addInterleaved takes them.
+ *
+ * @param ppg     Pointer to the PPG_Signal structure.
+ * @param fifo    Pointer to samples * HR_AFE_STRIDE values.
+ * @param samples Number of samples.
+ */
+void PPG_fifo(PPG_Signal *ppg, float *fifo, int samples) {
+	for (int i = 0; i < samples; i++) {
+		float time = ppg->count / ppg->freq;
+		float breath = sinf(2.0f * PPG_PI * ppg->breathing / 60.0f * time);
+		float pulse = PPG_pulse(ppg->phase) * (1.0f + 0.2f * breath);
+		float *sample = fifo + i * HR_AFE_STRIDE;
+		sample[HR_AFE_RED] = 0.50f + 0.005f * pulse + 0.002f * breath;
+		sample[HR_AFE_IR] = 0.55f + 0.010f * pulse + 0.002f * breath;
+		sample[HR_AFE_GREEN] = 0.60f + 0.020f * pulse + 0.004f * breath
+				+ ppg->noise * PPG_noise(&ppg->seed);
+		sample[HR_AFE_STRIDE - 1] = 0.0f;
+		ppg->phase += ppg->rate * (1.0f + 0.05f * breath) / 60.0f / ppg->freq;
+		if (ppg->phase >= 1.0f) {
+			ppg->phase -= 1.0f;
+		}
+		ppg->count++;
+	}
+}
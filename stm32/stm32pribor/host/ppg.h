@@ -0,0 +1,39 @@
+/**
+ * @file ppg.h
+ * @brief Synthetic AFE samples for the host tests and benchmarks
+ */
+
+#ifndef HOST_PPG_H_
+#define HOST_PPG_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Structure representing a synthetic finger under the AFE.
+ *
+ * Every beat is a systolic and a dicrotic wave. Breathing modulates the
+ * pulse amplitude, the baseline and the beat interval, as in a resting
+ * subject, so every stage of HR_HeartMonitor has something to measure.
+ */
+typedef struct {
+	float freq; /**< Sampling frequency in Hz */
+	float rate; /**< Mean heart rate in beats/min */
+	float breathing; /**< Respiration rate in breaths/min */
+	float noise; /**< Peak amplitude of the uniform noise added to the green channel */
+	float phase; /**< Position within the current beat, 0 to 1 */
+	unsigned long count; /**< Number of samples generated */
+	unsigned int seed; /**< State of the noise generator */
+} PPG_Signal;
+
+void PPG_init(PPG_Signal *ppg, float freq, float rate, float breathing,
+		float noise, unsigned int seed);
+void PPG_fifo(PPG_Signal *ppg, float *fifo, int samples);
+float PPG_noise(unsigned int *seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_PPG_H_ */
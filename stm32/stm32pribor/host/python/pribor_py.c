@@ -0,0 +1,116 @@
+/**
+ * @file pribor_py.c
+ * @brief Flat C interface of HR_HeartMonitor for the ctypes binding of bench/pribor.py
+ *
+ * Built by CMakeLists.txt into the shared library libpribor_py.so together with
+ * the DSP sources of Core/Src, with HR_BPF_RUNTIME_DESIGN so that any sampling
+ * frequency of a dataset gets its band-pass filter. The arrays are those of the
+ * NumPy arrays of the caller, float32 and contiguous, nothing is copied but one
+ * block at a time into the filtered output, which the monitor filters in place.
+ */
+
+#include <heartmonitor.h>
+#include <string.h>
+
+/**
+ * @brief Creates a heart monitor, with a HR_Fusion of the infrared channel if asked.
+ *
+ * The parameters are those of HR_heartMonitor_new.
+ *
+ * @param fusion Whether the peaks of the infrared channel are detected too.
+ *
+ * @return Pointer to the heart monitor or NULL, freed by HRPY_free.
+ */
+HR_HeartMonitor* HRPY_new(float freq, int size, float threshold, int bpf_order,
+		float bpf_low, float bpf_high, int ssf_size, int ma_green_size,
+		int ma_redIr_size, float rate_low, float rate_high, int engine,
+		int fusion) {
+	HR_HeartMonitor *heartMonitor = HR_heartMonitor_new(freq, size, threshold,
+			bpf_order, bpf_low, bpf_high, ssf_size, ma_green_size, ma_redIr_size,
+			rate_low, rate_high, (HR_Engine) engine);
+	if (heartMonitor == NULL || !fusion) {
+		return heartMonitor;
+	}
+	heartMonitor->fusion = HR_fusion_new(freq, size, threshold, bpf_order,
+			bpf_low, bpf_high, ssf_size, rate_high);
+	if (heartMonitor->fusion == NULL) {
+		HR_heartMonitor_free(heartMonitor);
+		return NULL;
+	}
+	return heartMonitor;
+}
+
+/**
+ * @brief Frees a heart monitor of HRPY_new with its HR_Fusion.
+ */
+void HRPY_free(HR_HeartMonitor *heartMonitor) {
+	if (heartMonitor == NULL) {
+		return;
+	}
+	if (heartMonitor->fusion != NULL) {
+		HR_fusion_free(heartMonitor->fusion);
+	}
+	HR_heartMonitor_free(heartMonitor);
+}
+
+/**
+ * @brief Runs a recording through a heart monitor block by block as the main loop does.
+ *
+ * Every block goes through HR_heartMonitor_addGreen and HR_heartMonitor_addRedIr,
+ * HR_heartMonitor_peaksFromChannels, HR_heartMonitor_heartRateAndRatio,
+ * HR_heartMonitor_quality and HR_heartMonitor_track, and one value per block is
+ * written to every output. A last partial block is processed too.
+ *
+ * @param heartMonitor Pointer to the heart monitor of HRPY_new.
+ * @param green        Pointer to the green channel, 'samples' values.
+ * @param red          Pointer to the red channel or NULL without red and infrared channels.
+ * @param ir           Pointer to the infrared channel or NULL.
+ * @param samples      Number of samples of every channel.
+ * @param block        Number of samples per block, the samples of one main loop.
+ * @param filtered     Pointer to 'samples' values, the green channel after the preprocessing.
+ * @param rate         Pointer to the heart rate of every block or NULL.
+ * @param ratio        Pointer to the red/infrared ratio of every block or NULL.
+ * @param quality      Pointer to the signal quality index of every block or NULL.
+ * @param tracked      Pointer to the tracked heart rate of every block or NULL.
+ *
+ * @return Number of blocks or -1 if the arguments are not valid.
+ */
+int HRPY_process(HR_HeartMonitor *heartMonitor, const float *green,
+		const float *red, const float *ir, int samples, int block,
+		float *filtered, float *rate, float *ratio, float *quality,
+		float *tracked) {
+	if (heartMonitor == NULL || green == NULL || filtered == NULL || block <= 0
+			|| samples < 0 || (red == NULL) != (ir == NULL)) {
+		return -1;
+	}
+	int blocks = 0;
+	for (int start = 0; start < samples; start += block, blocks++) {
+		int block_size = samples - start < block ? samples - start : block;
+		memcpy(filtered + start, green + start, block_size * sizeof(float));
+		HR_heartMonitor_addGreen(heartMonitor, filtered + start, block_size);
+		if (red != NULL) {
+			HR_heartMonitor_addRedIr(heartMonitor, (float*) red + start,
+					(float*) ir + start, block_size);
+		}
+		HR_heartMonitor_peaksFromChannels(heartMonitor);
+
+		HR_Result result;
+		HR_Quality signal;
+		HR_heartMonitor_heartRateAndRatio(heartMonitor, &result);
+		HR_heartMonitor_quality(heartMonitor, &result, &signal);
+		float track = HR_heartMonitor_track(heartMonitor, &result);
+		if (rate != NULL) {
+			rate[blocks] = result.rate;
+		}
+		if (ratio != NULL) {
+			ratio[blocks] = result.ratio;
+		}
+		if (quality != NULL) {
+			quality[blocks] = signal.index;
+		}
+		if (tracked != NULL) {
+			tracked[blocks] = track;
+		}
+	}
+	return blocks;
+}
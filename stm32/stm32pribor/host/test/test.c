@@ -0,0 +1,74 @@
+/**
+ * @file test.c
+ * @brief Runner of the host tests
+ *
+ *     pribor_test_float [suite]
+ */
+
+#include "test.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+	const char *name;
+	void (*run)(void);
+} TEST_Suite;
+
+static const TEST_Suite TEST_suites[] = {
+	{ "filters", TEST_filters },
+	{ "fixed", TEST_fixed },
+	{ "monitor", TEST_monitor },
+	{ "engines", TEST_engines },
+	{ "decimator", TEST_decimator },
+	{ "fusion", TEST_fusion },
+	{ "detectors", TEST_detectors },
+	{ "quality", TEST_quality },
+	{ "trace", TEST_trace },
+	{ "bee", TEST_bee },
+	{ "ledhelper", TEST_ledhelper },
+	{ "pipeline", TEST_pipeline },
+};
+
+static int TEST_checks;
+static int TEST_failures;
+
+void TEST_check(int passed, const char *condition, const char *file,
+		int line) {
+	TEST_checks++;
+	if (!passed) {
+		TEST_failures++;
+		printf("%s:%d: check failed: %s\n", file, line, condition);
+	}
+}
+
+void TEST_checkNear(double actual, double expected, double tolerance,
+		const char *expression, const char *file, int line) {
+	TEST_checks++;
+	if (!(fabs(actual - expected) <= tolerance)) {
+		TEST_failures++;
+		printf("%s:%d: check failed: %s is %.9g, expected %.9g +- %.3g\n",
+				file, line, expression, actual, expected, tolerance);
+	}
+}
+
+int main(int argc, char **argv) {
+	int count = sizeof(TEST_suites) / sizeof(TEST_suites[0]);
+	int found = 0;
+	for (int i = 0; i < count; i++) {
+		if (argc > 1 && strcmp(argv[1], TEST_suites[i].name) != 0) {
+			continue;
+		}
+		found = 1;
+		int failures = TEST_failures;
+		TEST_suites[i].run();
+		printf("%-10s %s\n", TEST_suites[i].name,
+				TEST_failures == failures ? "ok" : "FAILED");
+	}
+	if (!found) {
+		printf("unknown suite %s\n", argv[1]);
+		return 2;
+	}
+	printf("%d checks, %d failed\n", TEST_checks, TEST_failures);
+	return TEST_failures != 0;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file test.h
+ * @brief Checks and suites of the host tests
+ *
+ * A suite is a function that runs checks, pribor_test_<variant> <suite> runs
+ * one of them and without an argument all. A failed check is printed and the
+ * run exits with status 1 after the suite.
+ */
+
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHECK(condition) \
+	TEST_check((condition) != 0, #condition, __FILE__, __LINE__)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+	TEST_checkNear((actual), (expected), (tolerance), #actual, __FILE__, \
+			__LINE__)
+
+void TEST_check(int passed, const char *condition, const char *file,
+		int line);
+void TEST_checkNear(double actual, double expected, double tolerance,
+		const char *expression, const char *file, int line);
+
+void TEST_filters(void);
+void TEST_fixed(void);
+void TEST_monitor(void);
+void TEST_engines(void);
+void TEST_decimator(void);
+void TEST_fusion(void);
+void TEST_detectors(void);
+void TEST_quality(void);
+void TEST_trace(void);
+void TEST_bee(void);
+void TEST_ledhelper(void);
+void TEST_pipeline(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_TEST_H_ */
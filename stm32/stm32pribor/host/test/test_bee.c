@@ -0,0 +1,98 @@
+/**
+ * @file test_bee.c
+ * @brief Host tests of the binary SWARM API framing of bee.c
+ */
+
+#include "test.h"
+#include <bee.h>
+#include <hal_stub.h>
+#include <usart.h>
+#include <string.h>
+
+/**
+ * @brief CRC-16/ARC, written out independently of crc.h.
+ */
+static uint16_t TEST_crc(const uint8_t *bytes, int size) {
+	uint16_t crc = 0;
+	for (int i = 0; i < size; i++) {
+		crc ^= bytes[i];
+		for (int bit = 0; bit < 8; bit++) {
+			crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+		}
+	}
+	return crc;
+}
+
+/**
+ * @brief Frames a message as the module does: SYNC, the message, the CRC, then escaping.
+ *
+ * @param message Length byte and the bytes it counts.
+ * @param frame   Destination of the frame.
+ * @return Number of bytes of the frame.
+ */
+static int TEST_frame(const uint8_t *message, uint8_t *frame) {
+	uint8_t raw[BEE_SIZE];
+	int size = message[0] + 1;
+	raw[0] = BEE_SYNC;
+	memcpy(raw + 1, message, size);
+	uint16_t crc = TEST_crc(raw, size + 1);
+	raw[size + 1] = crc & 0xFF;
+	raw[size + 2] = crc >> 8;
+	int length = 0;
+	frame[length++] = BEE_SYNC;
+	for (int i = 1; i < size + 3; i++) {
+		if (raw[i] == BEE_SYNC) {
+			frame[length++] = 0x1B;
+			frame[length++] = 0x53;
+		} else if (raw[i] == 0x1B) {
+			frame[length++] = 0x1B;
+			frame[length++] = 0x45;
+		} else {
+			frame[length++] = raw[i];
+		}
+	}
+	return length;
+}
+
+void TEST_bee(void) {
+	uint8_t frame[BEE_SIZE];
+	BEE_init(&huart1);
+
+	// Commands are framed with SYNC and CRC and escaped
+	HAL_stub_reset();
+	CHECK(BEE_b_sbiv(0x7F1B) == 0);
+	uint8_t sbiv[] = { 0x04, 0x55, 0x31, 0x7F, 0x1B };
+	int size = TEST_frame(sbiv, frame);
+	CHECK(HAL_stub_uart.size == size);
+	CHECK(HAL_stub_uart.writes == 1);
+	CHECK(memcmp(HAL_stub_uart.data, frame, size) == 0);
+
+	// The received frame is unescaped and its CRC checked
+	uint8_t id[6] = { 0x01, 0x7F, 0x03, 0x04, 0x05, 0x06 };
+	uint8_t gnid[] = { 0x07, 0x54, 0x01, 0x7F, 0x03, 0x04, 0x05, 0x06 };
+	uint8_t result[6] = { 0 };
+	HAL_stub_reset();
+	HAL_stub_reply(frame, TEST_frame(gnid, frame));
+	CHECK(BEE_b_gnid_ret(result) == 0);
+	CHECK(memcmp(result, id, 6) == 0);
+	CHECK(HAL_stub_uart.data[0] == BEE_SYNC && HAL_stub_uart.data[2] == 0x54);
+
+	// A corrupted reply fails the CRC
+	HAL_stub_reset();
+	size = TEST_frame(gnid, frame);
+	frame[4] ^= 0x01;
+	HAL_stub_reply(frame, size);
+	CHECK(BEE_b_gnid_ret(result) == -2);
+
+	// An error reply gives the negative error code
+	uint8_t error[] = { 0x02, 0x60, 0x03 };
+	HAL_stub_reset();
+	HAL_stub_reply(frame, TEST_frame(error, frame));
+	CHECK(BEE_b_gnid_ret(result) == -3);
+
+	// Commands that do not fit the buffers are refused
+	uint8_t payload[BEE_SIZE] = { 0 };
+	HAL_stub_reset();
+	CHECK(BEE_b_fnin(payload, BEE_SIZE - 6) != 0);
+	CHECK(HAL_stub_uart.writes == 0);
+}
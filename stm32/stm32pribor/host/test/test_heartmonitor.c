@@ -0,0 +1,688 @@
+/**
+ * @file test_heartmonitor.c
+ * @brief Host tests of the filters and stages of heartmonitor.c
+ */
+
+#include "test.h"
+#include <heartmonitor.h>
+#include <bpf_reference.h>
+#include <ppg.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FREQ 25
+#define TEST_SIZE 100
+#define TEST_SECONDS 60
+#define TEST_RATE_LOW 50
+#define TEST_RATE_HIGH 150
+
+/**
+ * @brief Settings of the heart monitor of main.c.
+ */
+static HR_HeartMonitor* TEST_monitorNew(HR_Engine engine) {
+	return HR_heartMonitor_new(TEST_FREQ, TEST_SIZE, 0.35, 4, 0.8, 8.5, 2, 5,
+			7, TEST_RATE_LOW, TEST_RATE_HIGH, engine);
+}
+
+/**
+ * @brief Measurements of a session, after the first 15 s of settling.
+ */
+typedef struct {
+	int windows; /**< Windows measured */
+	int rate_ok; /**< Windows whose heart rate is within 8 beats/min, two samples of the beat interval */
+	float rate_error; /**< Mean absolute error of the heart rate of the windows */
+	float track; /**< Tracked heart rate of the last window */
+	float ratio; /**< Mean red/infrared ratio of the windows that have one */
+	float quality; /**< Mean signal quality index of the windows */
+} TEST_Session;
+
+/**
+ * @brief Runs a heart monitor on a synthetic signal one second at a time, as main.c does.
+ */
+static void TEST_run(HR_HeartMonitor *heartMonitor, PPG_Signal *ppg,
+		int seconds, TEST_Session *session) {
+	float fifo[TEST_FREQ * HR_AFE_STRIDE];
+	int ratios = 0;
+	memset(session, 0, sizeof(TEST_Session));
+	for (int second = 0; second < seconds; second++) {
+		PPG_fifo(ppg, fifo, TEST_FREQ);
+		HR_heartMonitor_addInterleaved(heartMonitor, fifo, NULL, TEST_FREQ);
+		if (second < 4) {
+			continue;
+		}
+		HR_Result result;
+		HR_Quality quality;
+		HR_heartMonitor_peaksFromChannels(heartMonitor);
+		HR_heartMonitor_heartRateAndRatio(heartMonitor, &result);
+		HR_heartMonitor_quality(heartMonitor, &result, &quality);
+		session->track = HR_heartMonitor_track(heartMonitor, &result);
+		if (second < 15) {
+			continue;
+		}
+		float error = isnan(result.rate) ? 100.0f : fabsf(result.rate - ppg->rate);
+		session->windows++;
+		session->rate_ok += error <= 8.0f;
+		session->rate_error += error;
+		if (!isnan(result.ratio)) {
+			session->ratio += result.ratio;
+			ratios++;
+		}
+		session->quality += quality.index;
+	}
+	if (session->windows > 0) {
+		session->rate_error /= session->windows;
+		session->quality /= session->windows;
+	}
+	session->ratio = ratios > 0 ? session->ratio / ratios : NAN;
+}
+
+/**
+ * @brief Band-pass gain at a frequency after the filter settled, from the RMS of a sine.
+ *
+ * The gain is that of bpf or, when it is NULL, of the reference filter. The RMS is taken
+ * over 20 s, whole periods of the multiples of 0.05 Hz.
+ */
+static float TEST_bpfGain(BPF_filter *bpf, BPFREF_filter *reference,
+		float frequency) {
+	float block[TEST_FREQ];
+	float square = 0.0f;
+	int count = 0;
+	for (int second = 0; second < 40; second++) {
+		for (int i = 0; i < TEST_FREQ; i++) {
+			block[i] = sinf(2.0f * 3.14159265f * frequency
+					* (second * TEST_FREQ + i) / TEST_FREQ);
+		}
+		if (bpf != NULL) {
+			BPF_process(bpf, block, TEST_FREQ);
+		} else {
+			BPFREF_process(reference, block, TEST_FREQ);
+		}
+		for (int i = 0; second >= 20 && i < TEST_FREQ; i++) {
+			square += block[i] * block[i];
+			count++;
+		}
+	}
+	return sqrtf(2.0f * square / count);
+}
+
+void TEST_filters(void) {
+	// The ring keeps the last samples contiguous in their order
+	HR_Ring *ring = HR_ring_new(8);
+	for (int i = 0; i < 21; i++) {
+		HR_ring_push(ring, (float) i);
+	}
+	float *window = HR_ring_window(ring);
+	for (int i = 0; i < 8; i++) {
+		CHECK(window[i] == (float) (13 + i));
+	}
+	HR_ring_free(ring);
+
+	// MA and SSF against their definitions
+	float input[300], ma[300], ssf[300];
+	unsigned int seed = 1;
+	for (int i = 0; i < 300; i++) {
+		input[i] = PPG_noise(&seed);
+	}
+	memcpy(ma, input, sizeof(input));
+	memcpy(ssf, input, sizeof(input));
+	MA_filter *ma_filter = MA_new(7);
+	SSF *ssf_filter = SSF_new(4);
+	for (int i = 0; i < 300; i += 32) {
+		int size = 300 - i < 32 ? 300 - i : 32;
+		MA_process(ma_filter, ma + i, size);
+		SSF_process(ssf_filter, ssf + i, size);
+	}
+	for (int i = 0; i < 300; i++) {
+		float sum = 0.0f, slope = 0.0f;
+		for (int j = i - 6; j <= i; j++) {
+			sum += j >= 0 ? input[j] : 0.0f;
+		}
+		for (int j = i - 2; j <= i; j++) {
+			float delta = j >= 0 ? input[j] - (j > 0 ? input[j - 1] : 0.0f) : 0.0f;
+			slope += delta > 0.0f ? delta : 0.0f;
+		}
+		CHECK_NEAR(ma[i], sum / 7, 1e-5);
+		CHECK_NEAR(ssf[i], slope, 1e-5);
+	}
+	MA_free(ma_filter);
+	SSF_free(ssf_filter);
+
+	// NLMS learns a motion artefact within its taps and leaves the pulse
+	float axes[HR_MOTION_AXES][TEST_FREQ];
+	float *reference[HR_MOTION_AXES] = { axes[0], axes[1], axes[2] };
+	float history[HR_MOTION_AXES][3] = { { 0.0f } };
+	float block[TEST_FREQ], pulse[TEST_FREQ];
+	float residual = 0.0f, artefact = 0.0f;
+	NLMS_filter *nlms = NLMS_new(HR_NLMS_TAPS, HR_NLMS_MU, HR_NLMS_EPSILON);
+	for (int second = 0; second < 300; second++) {
+		for (int i = 0; i < TEST_FREQ; i++) {
+			for (int axis = 0; axis < HR_MOTION_AXES; axis++) {
+				history[axis][2] = history[axis][1];
+				history[axis][1] = history[axis][0];
+				history[axis][0] = axes[axis][i] = PPG_noise(&seed);
+			}
+			float motion = 0.5f * history[0][0] - 0.3f * history[1][1]
+					+ 0.2f * history[2][2];
+			pulse[i] = 0.1f * sinf(0.5f * (second * TEST_FREQ + i));
+			block[i] = pulse[i] + motion;
+			if (second >= 290) {
+				artefact += motion * motion;
+			}
+		}
+		NLMS_process(nlms, block, reference, TEST_FREQ);
+		for (int i = 0; second >= 290 && i < TEST_FREQ; i++) {
+			residual += (block[i] - pulse[i]) * (block[i] - pulse[i]);
+		}
+	}
+	CHECK(residual < 0.01f * artefact);
+	NLMS_free(nlms);
+
+	// Only the generated tables give a filter, which passes the band
+	CHECK(BPF_findTable(4, 25, 0.8, 8.5) != NULL);
+	CHECK(BPF_findTable(4, 25, 0.7, 8.5) == NULL);
+#ifndef HR_BPF_RUNTIME_DESIGN
+	CHECK(BPF_new(4, 25, 0.7, 8.5) == NULL);
+#endif
+	BPF_filter *bpf = BPF_new(4, 25, 0.8, 8.5);
+	CHECK(bpf != NULL);
+	if (bpf != NULL) {
+		CHECK_NEAR(TEST_bpfGain(bpf, NULL, 2.5), 1.0, 0.05);
+		CHECK(TEST_bpfGain(bpf, NULL, 0.1) < 0.05);
+		BPF_free(bpf);
+	}
+
+	// From 0.1 to 12 Hz, -76 dB to 0 dB, the biquad cascade has the response
+	// of the 4th order sections it replaced within 0.01 dB, -3 dB at the
+	// cutoff frequencies
+	for (int step = 1; step <= 120; step++) {
+		float frequency = 0.1f * step;
+		bpf = BPF_new(4, 25, 0.8, 8.5);
+		BPFREF_filter *reference = BPFREF_new(4, 25, 0.8, 8.5);
+		float gain = 20.0f * log10f(TEST_bpfGain(bpf, NULL, frequency));
+		CHECK_NEAR(gain,
+				20.0f * log10f(TEST_bpfGain(NULL, reference, frequency)),
+				0.01);
+		if (step == 8 || step == 85) {
+			CHECK_NEAR(gain, -3.01, 0.01);
+		}
+		BPF_free(bpf);
+		BPFREF_free(reference);
+	}
+
+	// The footprint of a heart monitor is exact, with run time design it also
+	// holds the coefficients a table would have
+	size_t footprint = HR_HEARTMONITOR_FOOTPRINT(TEST_SIZE, 4, 2, 7,
+			HR_ENGINE_PEAKS);
+	void *memory = malloc(footprint);
+	HR_Arena arena;
+	HR_arena_init(&arena, memory, footprint);
+	CHECK(HR_heartMonitor_arenaNew(&arena, TEST_FREQ, TEST_SIZE, 0.35, 4, 0.8,
+			8.5, 2, 5, 7, TEST_RATE_LOW, TEST_RATE_HIGH, HR_ENGINE_PEAKS) != NULL);
+#ifdef HR_BPF_RUNTIME_DESIGN
+	CHECK(arena.used <= footprint);
+#else
+	CHECK(arena.used == footprint);
+	HR_arena_init(&arena, memory, footprint - 1);
+	CHECK(HR_heartMonitor_arenaNew(&arena, TEST_FREQ, TEST_SIZE, 0.35, 4, 0.8,
+			8.5, 2, 5, 7, TEST_RATE_LOW, TEST_RATE_HIGH, HR_ENGINE_PEAKS) == NULL);
+#endif
+	free(memory);
+}
+
+void TEST_fixed(void) {
+	// The Q8.23 band-pass follows the float one
+	float input[500], reference[500];
+	int32_t fixed[500];
+	unsigned int seed = 2;
+	for (int i = 0; i < 500; i++) {
+		input[i] = sinf(0.5f * i) + 0.3f * PPG_noise(&seed);
+	}
+	memcpy(reference, input, sizeof(input));
+	HRQ_fromFloatArray(input, fixed, 500);
+	BPF_filter *bpf = BPF_new(4, 25, 0.8, 8.5);
+	HRQ_BPF_filter *bpf_q = HRQ_BPF_new(4, 25, 0.8, 8.5);
+	CHECK(bpf != NULL && bpf_q != NULL);
+	if (bpf == NULL || bpf_q == NULL) {
+		return;
+	}
+	BPF_process(bpf, reference, 500);
+	HRQ_BPF_process(bpf_q, fixed, 500);
+	float error = 0.0f;
+	for (int i = 0; i < 500; i++) {
+		error = fmaxf(error, fabsf(HRQ_toFloat(fixed[i]) - reference[i]));
+	}
+	CHECK(error < 1e-4f);
+	BPF_free(bpf);
+	HRQ_BPF_free(bpf_q);
+
+	// SSF and MA follow the float ones on the band-passed signal
+	memcpy(input, reference, sizeof(input));
+	HRQ_fromFloatArray(input, fixed, 500);
+	SSF *ssf = SSF_new(4);
+	HRQ_SSF *ssf_q = HRQ_SSF_new(4);
+	MA_filter *ma = MA_new(7);
+	HRQ_MA_filter *ma_q = HRQ_MA_new(7);
+	SSF_process(ssf, reference, 500);
+	HRQ_SSF_process(ssf_q, fixed, 500);
+	error = 0.0f;
+	for (int i = 0; i < 500; i++) {
+		error = fmaxf(error, fabsf(HRQ_toFloat(fixed[i]) - reference[i]));
+	}
+	CHECK(error < 1e-5f);
+	MA_process(ma, reference, 500);
+	HRQ_MA_process(ma_q, fixed, 500);
+	error = 0.0f;
+	for (int i = 0; i < 500; i++) {
+		error = fmaxf(error, fabsf(HRQ_toFloat(fixed[i]) - reference[i]));
+	}
+	CHECK(error < 1e-5f);
+	SSF_free(ssf);
+	HRQ_SSF_free(ssf_q);
+	MA_free(ma);
+	HRQ_MA_free(ma_q);
+
+	// So does the whole green pipeline, one second at a time
+	HR_GreenPreprocess *green = HR_greenPreprocess_new(25, 4, 0.8, 8.5, 2);
+	HRQ_GreenPreprocess *green_q = HRQ_greenPreprocess_new(25, 4, 0.8, 8.5, 2);
+	CHECK(green != NULL && green_q != NULL);
+	if (green != NULL && green_q != NULL) {
+		float peak = 0.0f;
+		error = 0.0f;
+		for (int i = 0; i < 500; i++) {
+			reference[i] = sinf(0.5f * i) + 0.3f * PPG_noise(&seed);
+		}
+		HRQ_fromFloatArray(reference, fixed, 500);
+		for (int i = 0; i < 500; i += TEST_FREQ) {
+			HR_greenPreprocess_process(green, reference + i, TEST_FREQ);
+			HRQ_greenPreprocess_process(green_q, fixed + i, TEST_FREQ);
+		}
+		for (int i = 0; i < 500; i++) {
+			peak = fmaxf(peak, reference[i]);
+			error = fmaxf(error, fabsf(HRQ_toFloat(fixed[i]) - reference[i]));
+		}
+		CHECK(error < 1e-4f * peak);
+	}
+	HR_greenPreprocess_free(green);
+	HRQ_greenPreprocess_free(green_q);
+
+	// The Q8.23 red/infrared ratio is that of the float windows, (AC/DC) of
+	// red over (AC/DC) of infrared with the minima as DC
+	float red[TEST_SIZE], ir[TEST_SIZE];
+	int32_t red_q[TEST_SIZE], ir_q[TEST_SIZE];
+	int peaks[] = { 5, 25, 45, 65, 85 };
+	for (int i = 0; i < TEST_SIZE; i++) {
+		float pulse = cosf(2.0f * 3.14159265f * (i - 5) / 20.0f);
+		red[i] = 0.50f + 0.005f * pulse;
+		ir[i] = 0.55f + 0.010f * pulse;
+	}
+	HRQ_fromFloatArray(red, red_q, TEST_SIZE);
+	HRQ_fromFloatArray(ir, ir_q, TEST_SIZE);
+	HR_HeartMonitor *heartMonitor = TEST_monitorNew(HR_ENGINE_PEAKS);
+#ifdef HR_FIXED_POINT
+	HRQ_ring_pushFloatArray(heartMonitor->red, red, TEST_SIZE);
+	HRQ_ring_pushFloatArray(heartMonitor->ir, ir, TEST_SIZE);
+#else
+	HR_ring_pushArray(heartMonitor->red, red, TEST_SIZE);
+	HR_ring_pushArray(heartMonitor->ir, ir, TEST_SIZE);
+#endif
+	float perfusion;
+	float ratio = HR_heartMonitor_ratioFromIndexedPeaks(heartMonitor, peaks, 5);
+	CHECK_NEAR(ratio, (0.010 / 0.495) / (0.020 / 0.540), 1e-3);
+	CHECK_NEAR(HRQ_ratioFromIndexedPeaks(red_q, ir_q, peaks, 5, &perfusion),
+			ratio, 1e-4);
+	CHECK_NEAR(perfusion, 100.0 * 0.020 / 0.540, 1e-3);
+	CHECK(isnan(HRQ_ratioFromIndexedPeaks(red_q, ir_q, peaks, 2, NULL)));
+	HR_heartMonitor_free(heartMonitor);
+
+	// Q8.23 conversions round to the nearest step
+	CHECK(HRQ_fromFloat(1.0f) == 1 << HRQ_FRAC);
+	CHECK(HRQ_fromFloat(-0.5f) == -(1 << (HRQ_FRAC - 1)));
+	CHECK_NEAR(HRQ_toFloat(HRQ_fromFloat(3.14159f)), 3.14159, 1.0 / (1 << HRQ_FRAC));
+}
+
+void TEST_monitor(void) {
+	HR_HeartMonitor *heartMonitor = TEST_monitorNew(HR_ENGINE_PEAKS);
+	CHECK(heartMonitor != NULL);
+	if (heartMonitor == NULL) {
+		return;
+	}
+	PPG_Signal ppg;
+	PPG_init(&ppg, TEST_FREQ, 72, 15, 0.0f, 3);
+	TEST_Session session;
+	TEST_run(heartMonitor, &ppg, TEST_SECONDS, &session);
+	CHECK(session.rate_ok >= session.windows * 9 / 10);
+	CHECK(session.rate_error < 3.0f);
+	CHECK_NEAR(session.track, 72, 3);
+	// (AC/DC) of red over (AC/DC) of infrared of ppg.c
+	CHECK_NEAR(session.ratio, (0.005 / 0.50) / (0.010 / 0.55), 0.1);
+	CHECK(session.quality >= HR_SQI_ACCEPT);
+
+	// Breathing modulates the beat intervals by 5 %
+	float rmssd = HR_variability_rmssd(heartMonitor->variability);
+	float sdnn = HR_variability_sdnn(heartMonitor->variability);
+	CHECK(rmssd > 5.0f && rmssd < 100.0f);
+	CHECK(sdnn > 5.0f && sdnn < 100.0f);
+	CHECK_NEAR(HR_respiration_rate(heartMonitor->respiration), 15, 3);
+	HR_heartMonitor_free(heartMonitor);
+
+	// Without breathing the features only vary with the sampling grid, which gives no rate,
+	// also at 55 and 80 bpm, where whole samples modulated them by 5 % to 8 %
+	float rates[] = { 55, 72, 80, 90 };
+	float fifo[TEST_FREQ * HR_AFE_STRIDE];
+	for (int i = 0; i < 4; i++) {
+		heartMonitor = TEST_monitorNew(HR_ENGINE_PEAKS);
+		PPG_init(&ppg, TEST_FREQ, rates[i], 0, 0.0f, 3);
+		int readings = 0;
+		for (int second = 0; second < 2 * TEST_SECONDS; second++) {
+			PPG_fifo(&ppg, fifo, TEST_FREQ);
+			HR_heartMonitor_addInterleaved(heartMonitor, fifo, NULL, TEST_FREQ);
+			readings += !isnan(HR_respiration_rate(heartMonitor->respiration));
+		}
+		CHECK(readings == 0);
+		HR_heartMonitor_free(heartMonitor);
+	}
+}
+
+void TEST_engines(void) {
+	HR_Engine engines[] = { HR_ENGINE_SPECTRUM, HR_ENGINE_AUTOCORRELATION };
+	for (int i = 0; i < 2; i++) {
+		HR_HeartMonitor *heartMonitor = TEST_monitorNew(engines[i]);
+		CHECK(heartMonitor != NULL);
+		if (heartMonitor == NULL) {
+			continue;
+		}
+		PPG_Signal ppg;
+		PPG_init(&ppg, TEST_FREQ, 90, 15, 0.0f, 4);
+		TEST_Session session;
+		TEST_run(heartMonitor, &ppg, 40, &session);
+		CHECK(session.rate_ok >= session.windows * 9 / 10);
+		CHECK_NEAR(session.track, 90, 5);
+		HR_heartMonitor_free(heartMonitor);
+	}
+}
+
+void TEST_decimator(void) {
+	CHECK(HR_decimator_new(3, 25, 8.5, 0) == NULL);
+	HR_Decimator *separate = HR_decimator_new(4, 25, 8.5, 0);
+	HR_Decimator *inPlace = HR_decimator_new(4, 25, 8.5, 0);
+	CHECK(separate != NULL && inPlace != NULL);
+	if (separate == NULL || inPlace == NULL) {
+		return;
+	}
+	float fifo[100 * HR_AFE_STRIDE], output[25 * HR_AFE_STRIDE];
+	PPG_Signal ppg;
+	PPG_init(&ppg, 100, 72, 15, 0.001f, 5);
+	int equal = 1;
+	for (int second = 0; second < 5; second++) {
+		PPG_fifo(&ppg, fifo, 100);
+		CHECK(HR_decimator_process(separate, fifo, 100, output) == 25);
+		CHECK(HR_decimator_process(inPlace, fifo, 100, fifo) == 25);
+		equal &= memcmp(fifo, output, sizeof(output)) == 0;
+	}
+	CHECK(equal);
+
+	// Unity gain at DC, blocks need not be multiples of the factor
+	HR_decimator_reset(separate);
+	for (int i = 0; i < 100 * HR_AFE_STRIDE; i++) {
+		fifo[i] = 1.0f;
+	}
+	int written = 0;
+	for (int block = 0; block < 9; block++) {
+		written += HR_decimator_process(separate, fifo, 33, output);
+	}
+	// the first input sample completes an output sample
+	CHECK(written == (9 * 33 + 3) / 4);
+	CHECK_NEAR(output[0 * HR_AFE_STRIDE + HR_AFE_GREEN], 1.0, 1e-3);
+	HR_decimator_free(separate);
+	HR_decimator_free(inPlace);
+}
+
+void TEST_fusion(void) {
+	// A noisy green channel, the infrared one is clean
+	HR_HeartMonitor *green = TEST_monitorNew(HR_ENGINE_PEAKS);
+	HR_HeartMonitor *fused = TEST_monitorNew(HR_ENGINE_PEAKS);
+	CHECK(green != NULL && fused != NULL);
+	if (green == NULL || fused == NULL) {
+		return;
+	}
+	fused->fusion = HR_fusion_new(TEST_FREQ, TEST_SIZE, 0.35, 4, 0.8, 8.5, 2,
+			TEST_RATE_HIGH);
+	CHECK(fused->fusion != NULL);
+	PPG_Signal ppg;
+	TEST_Session session_green, session_fused;
+	PPG_init(&ppg, TEST_FREQ, 72, 15, 0.03f, 6);
+	TEST_run(green, &ppg, TEST_SECONDS, &session_green);
+	PPG_init(&ppg, TEST_FREQ, 72, 15, 0.03f, 6);
+	TEST_run(fused, &ppg, TEST_SECONDS, &session_fused);
+	CHECK(session_fused.rate_error < session_green.rate_error / 2);
+	CHECK(session_fused.rate_ok >= session_fused.windows * 9 / 10);
+	HR_fusion_free(fused->fusion);
+	HR_heartMonitor_free(green);
+	HR_heartMonitor_free(fused);
+}
+
+/**
+ * @brief Number of windows of a signal where PD_peaks differs from peaks_detect + peaks_normalize.
+ */
+static int TEST_peaksMismatches(float *signal, int samples) {
+	PD_detector *detector = PD_new(TEST_SIZE, 0.35);
+	HR_Ring *ring = HR_ring_new(TEST_SIZE);
+	int signals[TEST_SIZE], expected[TEST_SIZE];
+	int mismatches = 0;
+	for (int i = 0; i < samples; i++) {
+		PD_push(detector, signal[i]);
+		HR_ring_push(ring, signal[i]);
+		if (i + 1 < TEST_SIZE) {
+			continue;
+		}
+		float *window = HR_ring_window(ring);
+		PD_peaks(detector, window, signals);
+		peaks_detect(window, expected, TEST_SIZE, 0.35);
+		peaks_normalize(window, expected, TEST_SIZE);
+		mismatches += memcmp(signals, expected, sizeof(signals)) != 0;
+	}
+	PD_free(detector);
+	HR_ring_free(ring);
+	return mismatches;
+}
+
+/**
+ * @brief Adds a triangular bump of three samples to a signal.
+ */
+static void TEST_bump(float *signal, int samples, int center, float height) {
+	for (int i = center - 1; i <= center + 1; i++) {
+		if (i >= 0 && i < samples) {
+			signal[i] += i == center ? height : 0.5f * height;
+		}
+	}
+}
+
+void TEST_detectors(void) {
+	// The streaming peak detector gives the peaks of the window scan on
+	// random samples, on plateaus and on ramps cut anywhere by the window
+	float signal[600];
+	unsigned int seed = 7;
+	for (int i = 0; i < 600; i++) {
+		signal[i] = PPG_noise(&seed);
+	}
+	CHECK(TEST_peaksMismatches(signal, 600) == 0);
+	for (int i = 0; i < 600; i++) {
+		signal[i] = (float) (int) (3.0f * PPG_noise(&seed));
+	}
+	CHECK(TEST_peaksMismatches(signal, 600) == 0);
+	for (int i = 0; i < 600; i++) {
+		int phase = i % (23 + i / 150);
+		signal[i] = (float) (phase < 15 ? phase : 15);
+	}
+	CHECK(TEST_peaksMismatches(signal, 600) == 0);
+
+	// A higher maximum within the refractory period moves the beat to it and
+	// a lower one is ignored: each 20 samples a bump of 0.9, its beat of 1.0
+	// 4 samples later and a dicrotic bump of 0.6 5 samples after the beat
+	ATD_detector *detector = ATD_new(TEST_SIZE, TEST_FREQ, 0.35,
+			TEST_RATE_HIGH);
+	CHECK(detector != NULL);
+	if (detector == NULL) {
+		return;
+	}
+	memset(signal, 0, sizeof(signal));
+	for (int beat = 10; beat < 600; beat += 20) {
+		TEST_bump(signal, 600, beat - 4, 0.9f);
+		TEST_bump(signal, 600, beat, 1.0f);
+		TEST_bump(signal, 600, beat + 5, 0.6f);
+	}
+	int signals[TEST_SIZE];
+	int moved = 1, finals = 0, ordered = 1, refractory = 1;
+	unsigned int previous = 0;
+	for (int i = 0; i < 600; i++) {
+		ATD_push(detector, signal[i]);
+		unsigned int index;
+		float offset;
+		// a final beat is out of its refractory period and never moves again
+		while (ATD_next(detector, &index, &offset)) {
+			moved &= index % 20 == 10;
+			ordered &= finals == 0 || index > previous;
+			refractory &= detector->count - index > detector->refractory;
+			previous = index;
+			finals++;
+		}
+	}
+	CHECK(moved && ordered && refractory);
+	CHECK(finals == 29);
+	ATD_peaks(detector, signals);
+	for (int i = 0; i < TEST_SIZE; i++) {
+		CHECK(signals[i] == ((600 - TEST_SIZE + i) % 20 == 10));
+	}
+	ATD_free(detector);
+
+	// Searchback: a beat below the threshold is taken once no beat came for
+	// HR_ATD_SEARCHBACK average intervals
+	detector = ATD_new(TEST_SIZE, TEST_FREQ, 0.9, TEST_RATE_HIGH);
+	memset(signal, 0, sizeof(signal));
+	for (int beat = 10; beat < 400; beat += 15) {
+		TEST_bump(signal, 600, beat, beat == 310 ? 0.4f : 1.0f);
+	}
+	ATD_process(detector, signal, 318);
+	ATD_peaks(detector, signals);
+	CHECK(signals[310 - (318 - TEST_SIZE)] == 0);
+	ATD_process(detector, signal + 318, 27);
+	ATD_peaks(detector, signals);
+	CHECK(signals[310 - (345 - TEST_SIZE)] == 1);
+	CHECK(signals[325 - (345 - TEST_SIZE)] == 1);
+	CHECK(signals[340 - (345 - TEST_SIZE)] == 1);
+	ATD_free(detector);
+}
+
+void TEST_quality(void) {
+	// The tracker follows measurements near the track, ignores outliers and
+	// restarts at the HR_TRACKER_OUTLIERS-th outlier in a row
+	HR_Tracker *tracker = HR_tracker_new(HR_PEAKS_CAPACITY(TEST_SIZE),
+			TEST_FREQ, TEST_RATE_LOW, TEST_RATE_HIGH);
+	CHECK(isnan(HR_tracker_update(tracker, NAN, 4.0)));
+	CHECK(HR_tracker_update(tracker, 72, 4.0) == 72);
+	float rate = HR_tracker_update(tracker, 76, 4.0);
+	CHECK(rate > 72 && rate < 76);
+	CHECK(HR_tracker_update(tracker, NAN, 4.0) == rate);
+	for (int i = 1; i < HR_TRACKER_OUTLIERS; i++) {
+		CHECK(HR_tracker_update(tracker, 150, 4.0) == rate);
+	}
+	CHECK(HR_tracker_update(tracker, 150, 4.0) == 150);
+
+	// Intervals of missed or double-detected beats and implausible ones are
+	// dropped, the measurement is the mean of the rest at 20 samples
+	int regular[] = { 0, 20, 40, 60, 80, 100 };
+	int gated[] = { 0, 20, 40, 60, 70, 80, 100, 400 };
+	float variance_regular, variance_gated;
+	CHECK_NEAR(HR_tracker_measurePeaks(tracker, regular, 6, 0,
+			&variance_regular), 60.0 * TEST_FREQ / 20, 1e-3);
+	CHECK_NEAR(HR_tracker_measurePeaks(tracker, gated, 8, 0, &variance_gated),
+			60.0 * TEST_FREQ / 20, 1e-3);
+	CHECK(tracker->count == 4);
+	CHECK(variance_gated > variance_regular);
+	CHECK(isnan(HR_tracker_measurePeaks(tracker, gated + 6, 2, 0,
+			&variance_gated)));
+
+	// Only the intervals ending at or after start are measured
+	float variance_new;
+	CHECK(isnan(HR_tracker_measurePeaks(tracker, regular, 6, 101,
+			&variance_new)));
+	CHECK_NEAR(HR_tracker_measurePeaks(tracker, regular, 6, 90, &variance_new),
+			60.0 * TEST_FREQ / 20, 1e-3);
+	CHECK(variance_new > variance_regular);
+
+	// Windows of a stationary beat that move by one second overlap by three
+	// quarters. Every interval reaches the filter once, so its variance stays
+	// above 2.3 bpm^2, the steady state with two new intervals of one-sample
+	// resolution every second. Feeding every window collapses it to 0.74.
+	HR_tracker_reset(tracker);
+	for (int second = 0; second < 60; second++) {
+		int end = TEST_SIZE + second * TEST_FREQ;
+		int peaks[TEST_SIZE / 20 + 1];
+		int peaks_size = 0;
+		for (int beat = (end - TEST_SIZE + 19) / 20 * 20; beat < end; beat += 20) {
+			peaks[peaks_size++] = beat - (end - TEST_SIZE);
+		}
+		HR_tracker_updatePeaks(tracker, peaks, peaks_size,
+				TEST_SIZE - TEST_FREQ);
+	}
+	CHECK(tracker->variance > 2.0);
+	HR_tracker_free(tracker);
+
+	// Quality of a window of identical beats 20 samples apart, limited by the
+	// perfusion and the motion
+	HR_HeartMonitor *heartMonitor = TEST_monitorNew(HR_ENGINE_PEAKS);
+	CHECK(heartMonitor != NULL);
+	if (heartMonitor == NULL) {
+		return;
+	}
+	float window[TEST_SIZE];
+	for (int i = 0; i < TEST_SIZE; i++) {
+		float pulse = 0.5f + 0.5f * cosf(2.0f * 3.14159265f * (i - 5) / 20.0f);
+		window[i] = pulse * pulse * pulse;
+	}
+	HR_ring_pushArray(heartMonitor->green, window, TEST_SIZE);
+	int peaks[] = { 5, 25, 45, 65, 85 };
+	memcpy(heartMonitor->indexed, peaks, sizeof(peaks));
+	heartMonitor->indexed_size = 5;
+	heartMonitor->motion = 0.0f;
+	HR_Result result = { .perfusion = 1.0f };
+	HR_Quality quality;
+	HR_heartMonitor_quality(heartMonitor, &result, &quality);
+	CHECK_NEAR(quality.interval_cv, 0.0, 1e-6);
+	CHECK_NEAR(quality.correlation, 1.0, 1e-4);
+	CHECK_NEAR(quality.index, 1.0, 1e-4);
+	result.perfusion = 0.25f;
+	HR_heartMonitor_quality(heartMonitor, &result, &quality);
+	CHECK_NEAR(quality.index, 0.25 / HR_SQI_PERFUSION, 1e-4);
+	result.perfusion = NAN;
+	HR_heartMonitor_quality(heartMonitor, &result, &quality);
+	CHECK(quality.index == 0);
+	result.perfusion = 1.0f;
+	heartMonitor->motion = 0.75 * HR_SQI_MOTION;
+	HR_heartMonitor_quality(heartMonitor, &result, &quality);
+	CHECK_NEAR(quality.index, 0.25, 1e-4);
+	heartMonitor->motion = 0.0f;
+
+	// Uneven intervals of 18 and 22 samples, a coefficient of variation of 0.1
+	int uneven[] = { 5, 23, 45, 63, 85 };
+	memcpy(heartMonitor->indexed, uneven, sizeof(uneven));
+	HR_heartMonitor_quality(heartMonitor, &result, &quality);
+	CHECK_NEAR(quality.interval_cv, 0.1, 1e-6);
+	CHECK(quality.index <= 1.0 - 0.1 / HR_SQI_INTERVAL_CV + 1e-6);
+
+	// Beats that do not look alike, or too few of them, are unusable
+	unsigned int seed = 8;
+	for (int i = 0; i < TEST_SIZE; i++) {
+		window[i] = PPG_noise(&seed);
+	}
+	HR_ring_pushArray(heartMonitor->green, window, TEST_SIZE);
+	memcpy(heartMonitor->indexed, peaks, sizeof(peaks));
+	HR_heartMonitor_quality(heartMonitor, &result, &quality);
+	CHECK(quality.index < HR_SQI_ACCEPT);
+	heartMonitor->indexed_size = 2;
+	HR_heartMonitor_quality(heartMonitor, &result, &quality);
+	CHECK(isnan(quality.interval_cv));
+	CHECK(quality.index == 0);
+	HR_heartMonitor_free(heartMonitor);
+}
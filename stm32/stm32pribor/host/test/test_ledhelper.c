@@ -0,0 +1,51 @@
+/**
+ * @file test_ledhelper.c
+ * @brief Host tests of the screens of ledhelper.c sent to the SSD1306
+ */
+
+#include "test.h"
+#include <ledhelper.h>
+#include <ssd1306.h>
+#include <hal_stub.h>
+#include <string.h>
+
+/**
+ * @brief Whether the last screen sent equals a frame.
+ */
+static int TEST_sameScreen(const uint8_t *frame) {
+	return memcmp(HAL_stub_i2cData.data, frame, SSD1306_BUFFER_SIZE) == 0;
+}
+
+void TEST_ledhelper(void) {
+	static uint8_t frame[SSD1306_BUFFER_SIZE];
+
+	// The screen is cleared when initialized
+	HAL_stub_reset();
+	LED_init();
+	CHECK(HAL_stub_i2cCommands.size > 20);
+	CHECK(HAL_stub_i2cData.size == SSD1306_BUFFER_SIZE);
+	memset(frame, 0, sizeof(frame));
+	CHECK(TEST_sameScreen(frame));
+
+	// A screen is one write per page
+	HAL_stub_reset();
+	LED_update(36, 72, 98, 40, 15);
+	CHECK(HAL_stub_i2cData.size == SSD1306_BUFFER_SIZE);
+	CHECK(HAL_stub_i2cData.writes == SSD1306_HEIGHT / 8);
+	CHECK(!TEST_sameScreen(frame));
+	memcpy(frame, HAL_stub_i2cData.data, sizeof(frame));
+
+	// The same readings give the same screen, another reading another one
+	HAL_stub_reset();
+	LED_update(36, 72, 98, 40, 15);
+	CHECK(TEST_sameScreen(frame));
+	HAL_stub_reset();
+	LED_update(36, 73, 98, 40, 15);
+	CHECK(HAL_stub_i2cData.size == SSD1306_BUFFER_SIZE);
+	CHECK(!TEST_sameScreen(frame));
+
+	HAL_stub_reset();
+	LED_pribor();
+	CHECK(HAL_stub_i2cData.size == SSD1306_BUFFER_SIZE);
+	CHECK(!TEST_sameScreen(frame));
+}
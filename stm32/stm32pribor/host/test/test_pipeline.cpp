@@ -0,0 +1,47 @@
+/**
+ * @file test_pipeline.cpp
+ * @brief Host tests of heartmonitor_pipeline.hpp against the C filters
+ */
+
+#include "test.h"
+#include <heartmonitor_pipeline.hpp>
+#include <ppg.h>
+#include <cstring>
+
+void TEST_pipeline(void) {
+	const BPF_table *table = BPF_findTable(4, 25, 0.8, 8.5);
+	CHECK(table != nullptr);
+	if (table == nullptr) {
+		return;
+	}
+	hr::Pipeline<hr::Bandpass<4>, hr::SlopeSum<2>, hr::MovingAvg<5>> pipeline {
+			hr::Bandpass<4>(table), hr::SlopeSum<2>(), hr::MovingAvg<5>() };
+	CHECK(pipeline.stage<0>().valid());
+	BPF_filter *bpf = BPF_new(4, 25, 0.8, 8.5);
+	SSF *ssf = SSF_new(2);
+	MA_filter *ma = MA_new(5);
+
+	// Bit-exact with BPF_process, SSF_process and MA_process
+	PPG_Signal ppg;
+	PPG_init(&ppg, 25, 72, 15, 0.01f, 7);
+	float fifo[25 * HR_AFE_STRIDE], reference[25], samples[25];
+	int equal = 1;
+	for (int second = 0; second < 30; second++) {
+		PPG_fifo(&ppg, fifo, 25);
+		for (int i = 0; i < 25; i++) {
+			reference[i] = samples[i] = fifo[i * HR_AFE_STRIDE + HR_AFE_GREEN];
+		}
+		BPF_process(bpf, reference, 25);
+		SSF_process(ssf, reference, 25);
+		MA_process(ma, reference, 25);
+		pipeline.process(samples, 25);
+		equal &= std::memcmp(reference, samples, sizeof(samples)) == 0;
+	}
+	CHECK(equal);
+	BPF_free(bpf);
+	SSF_free(ssf);
+	MA_free(ma);
+
+	// A table of another order leaves the band-pass invalid
+	CHECK(!hr::Bandpass<2>(table).valid());
+}
@@ -0,0 +1,84 @@
+/**
+ * @file test_trace.c
+ * @brief Host tests of the trace ring of trace.c
+ */
+
+#include "test.h"
+#include <trace.h>
+#include <string.h>
+
+/**
+ * @brief Empties the ring.
+ */
+static void TEST_traceDrain(void) {
+	uint32_t words[64];
+	while (TRACE_read(words, 64) > 0) {
+	}
+}
+
+void TEST_trace(void) {
+#ifdef TRACE_ENABLE
+	uint32_t words[TRACE_RING_WORDS];
+	float samples[300];
+	for (int i = 0; i < 300; i++) {
+		samples[i] = i * 0.5f;
+	}
+	TEST_traceDrain();
+	uint32_t drops = TRACE_dropped();
+
+	// Nothing is written while the drain is off
+	TRACE_active = 0;
+	TRACE_PROBE(TRACE_GREEN_BPF, samples, 10);
+	CHECK(TRACE_read(words, TRACE_RING_WORDS) == 0);
+
+	// A record is the header, the sequence number and the samples
+	TRACE_active = 1;
+	TRACE_PROBE(TRACE_GREEN_BPF, samples, 10);
+	CHECK(TRACE_read(words, TRACE_RING_WORDS) == 12);
+	CHECK(words[0] == (TRACE_SYNC | TRACE_GREEN_BPF << 8 | TRACE_FLOAT << 16
+			| 10u << 24));
+	CHECK(memcmp(words + 2, samples, 10 * sizeof(float)) == 0);
+	uint32_t sequence = words[1];
+
+	// Reads may split records, the words come out in order
+	TRACE_PROBE_Q(TRACE_GREEN_PULSE, samples, 20);
+	CHECK(TRACE_read(words, 5) == 5);
+	CHECK(TRACE_read(words + 5, TRACE_RING_WORDS) == 17);
+	CHECK(words[0] >> 16 == (TRACE_Q23 | 20u << 8));
+	CHECK(words[1] == sequence + 1);
+	CHECK(memcmp(words + 2, samples, 20 * sizeof(float)) == 0);
+
+	// Long blocks are split into records, which wrap around the ring;
+	// the records after a full ring are dropped
+	TRACE_write(TRACE_GREEN_RAW, TRACE_FLOAT, samples, 300);
+	CHECK(TRACE_dropped() - drops == 1);
+	int read = TRACE_read(words, TRACE_RING_WORDS);
+	CHECK(read == 2 * (TRACE_RECORD_SAMPLES + 2));
+	for (int record = 0; record < 2; record++) {
+		uint32_t *header = words + record * (TRACE_RECORD_SAMPLES + 2);
+		CHECK(header[0] >> 24 == TRACE_RECORD_SAMPLES);
+		CHECK(header[1] == sequence + 2 + record);
+		CHECK(memcmp(header + 2, samples + record * TRACE_RECORD_SAMPLES,
+				TRACE_RECORD_SAMPLES * sizeof(float)) == 0);
+	}
+
+	// A record that does not fit is dropped whole and leaves a gap
+	TEST_traceDrain();
+	drops = TRACE_dropped();
+	int written = 0;
+	while (TRACE_dropped() == drops) {
+		TRACE_PROBE(TRACE_GREEN_NLMS, samples, 25);
+		written++;
+	}
+	CHECK(written == TRACE_RING_WORDS / 27 + 1);
+	TRACE_PROBE(TRACE_GREEN_NLMS, samples, 25);
+	read = TRACE_read(words, TRACE_RING_WORDS);
+	CHECK(read == (written - 1) * 27);
+	CHECK(words[(written - 2) * 27 + 1] - words[1] == (uint32_t) written - 2);
+	uint32_t last = words[(written - 2) * 27 + 1];
+	TRACE_PROBE(TRACE_GREEN_NLMS, samples, 25);
+	CHECK(TRACE_read(words, TRACE_RING_WORDS) == 27);
+	CHECK(words[1] - last == 3);
+	TRACE_active = 0;
+#endif
+}
@@ -0,0 +1,375 @@
+/**
+ * @file beats.c
+ * @brief Beat-level comparison of the peak detectors on a BIDMC recording.
+ *
+ * Host program: the PLETH channel is decimated to 25 Hz by HR_Decimator, preprocessed by
+ * HR_GreenPreprocess as in the firmware and fed to PD_detector (relative
+ * threshold of the window maximum) and ATD_detector (adaptive threshold).
+ * The reference beats are the R waves of ECG lead II. A beat matches an R wave
+ * when it is within 250 ms of the R wave plus the median pulse delay. The
+ * sensitivity and the positive predictive value of each detector are printed.
+ *
+ *     gcc -O2 -ICore/Inc tools/beats.c Core/Src/heartmonitor.c \
+ *         Core/Src/heartmonitor_fixed.c Core/Src/heartmonitor_bpf.c \
+ *         Core/Src/heartmonitor_decimator.c Core/Src/heartmonitor_tables.c \
+ *         Core/Src/trace.c -lm -o beats
+ *     ./beats ../../bench/BIDMC/bidmc_01_Signals.csv [SPIKE_PERIOD]
+ *
+ * With SPIKE_PERIOD (seconds) a motion spike of three pulse amplitudes and
+ * 0.2 s is added to the PLETH channel every SPIKE_PERIOD seconds.
+ *
+ * The final beats of ATD_detector also go through HR_Variability, and its
+ * RMSSD, SDNN and pNN50 are printed every minute next to the same measures of
+ * the R-R intervals. ATD_detector runs twice: on its own and with its beats
+ * timed on the 125 Hz PLETH by HR_decimator_refine, as HR_HeartMonitor does
+ * with a decimator.
+ */
+
+#include <heartmonitor.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RAW_FREQ 125
+#define DECIMATION 5
+#define FREQ 25
+#define BLOCK 25
+#define SIZE 100
+#define MAX_SAMPLES 100000
+#define TOLERANCE 0.25
+#define THRESHOLD 0.35 // HR_THRESHOLD of main.c
+#define RATE_LOW 50 // HR_limit_low of main.c
+#define RATE_HIGH 150 // HR_limit_high of main.c
+#define HISTORY (2 * RAW_FREQ) // high-rate samples kept for the beat timing
+
+static float pleth[MAX_SAMPLES];
+static float ecg[MAX_SAMPLES];
+static float energy[MAX_SAMPLES];
+static float reference[MAX_SAMPLES / 25];
+static float beats[MAX_SAMPLES / 5];
+static float rmssd[MAX_SAMPLES / (FREQ * 60) + 1];
+static float sdnn[MAX_SAMPLES / (FREQ * 60) + 1];
+static float pnn50[MAX_SAMPLES / (FREQ * 60) + 1];
+static float fifo[BLOCK * DECIMATION * HR_AFE_STRIDE];
+
+/**
+ * @brief Reads the PLETH and II columns of a BIDMC *_Signals.csv file.
+ */
+static int readSignals(const char *filename) {
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) {
+		return 0;
+	}
+	char line[512];
+	int pleth_column = -1;
+	int ecg_column = -1;
+	if (fgets(line, sizeof(line), file) != NULL) {
+		int column = 0;
+		for (char *name = strtok(line, ",\r\n"); name != NULL;
+				name = strtok(NULL, ",\r\n"), column++) {
+			while (*name == ' ') {
+				name++;
+			}
+			if (strcmp(name, "PLETH") == 0) {
+				pleth_column = column;
+			} else if (strcmp(name, "II") == 0) {
+				ecg_column = column;
+			}
+		}
+	}
+	int count = 0;
+	while (pleth_column >= 0 && ecg_column >= 0 && count < MAX_SAMPLES
+			&& fgets(line, sizeof(line), file) != NULL) {
+		char *field = line;
+		for (int column = 0; field != NULL; column++) {
+			if (column == pleth_column) {
+				pleth[count] = atof(field);
+			} else if (column == ecg_column) {
+				ecg[count] = atof(field);
+			}
+			field = strchr(field, ',');
+			if (field != NULL) {
+				field++;
+			}
+		}
+		count++;
+	}
+	fclose(file);
+	return count;
+}
+
+/**
+ * @brief Finds the R waves of the ECG, in samples at FREQ.
+ *
+ * Squared derivative integrated over 150 ms, local maxima above 30% of the
+ * maximum of the last 2 s and highest within 250 ms, then the ECG maximum
+ * within 150 ms of each of them.
+ */
+static int findRWaves(int samples) {
+	const int integration = RAW_FREQ * 150 / 1000;
+	const int history = 2 * RAW_FREQ;
+	const int refractory = RAW_FREQ / 4;
+	// centred window of squared derivatives
+	float sum = 0.0;
+	for (int i = 0; i < samples; i++) {
+		int in = i + integration / 2;
+		int out = in - integration;
+		if (in > 0 && in < samples - 1) {
+			float derivative = ecg[in + 1] - ecg[in - 1];
+			sum += derivative * derivative;
+		}
+		if (out > 0 && out < samples - 1) {
+			float derivative = ecg[out + 1] - ecg[out - 1];
+			sum -= derivative * derivative;
+		}
+		energy[i] = sum;
+	}
+
+	int count = 0;
+	int last = -refractory;
+	for (int i = 1; i < samples - 1; i++) {
+		if (energy[i] <= energy[i - 1] || energy[i] < energy[i + 1]
+				|| i - last < refractory) {
+			continue;
+		}
+		float max = 0.0;
+		float near = 0.0;
+		for (int j = i - history; j < i + RAW_FREQ / 2; j++) {
+			if (j >= 0 && j < samples && energy[j] > max) {
+				max = energy[j];
+			}
+			if (j >= 0 && j < samples && j - i < refractory
+					&& i - j < refractory && energy[j] > near) {
+				near = energy[j];
+			}
+		}
+		if (energy[i] < 0.3 * max || energy[i] < near) {
+			continue;
+		}
+		int r = i;
+		for (int j = i - integration; j <= i + integration; j++) {
+			if (j >= 0 && j < samples && ecg[j] > ecg[r]) {
+				r = j;
+			}
+		}
+		reference[count++] = (float) r / DECIMATION;
+		last = i;
+	}
+	return count;
+}
+
+/**
+ * @brief Runs the green channel preprocessing and one detector over the recording.
+ *
+ * After every block the beats of the window are read out and those in the
+ * block two blocks before the newest one are kept, so every sample is read out
+ * once and detectors that revise or search back have time to settle.
+ *
+ * @param detector 0 for PD_detector, 1 for ATD_detector, 2 for ATD_detector with
+ *                 the beats timed on the high-rate samples.
+ */
+static int detect(int detector, int samples, float spike_period) {
+	int use_atd = detector > 0;
+	HR_GreenPreprocess *greenPreprocess = HR_greenPreprocess_new(FREQ, 4, 0.8,
+			8.5, 2);
+	HR_Ring *ring = HR_ring_new(SIZE);
+	PD_detector *pd = PD_new(SIZE, THRESHOLD);
+	ATD_detector *atd = ATD_new(SIZE, FREQ, THRESHOLD, RATE_HIGH);
+	HR_Decimator *decimator = HR_decimator_new(DECIMATION, FREQ, 8.5, HISTORY);
+	static int signals[SIZE];
+	float min = pleth[0];
+	float max = pleth[0];
+	for (int i = 0; i < samples; i++) {
+		min = pleth[i] < min ? pleth[i] : min;
+		max = pleth[i] > max ? pleth[i] : max;
+	}
+
+	int count = 0;
+	int total = 0;
+	HR_Variability *variability = HR_variability_new(HR_HRV_SIZE, FREQ,
+			RATE_LOW, RATE_HIGH);
+	float block[BLOCK];
+	for (int start = 0; start + BLOCK <= samples / DECIMATION; start +=
+	BLOCK) {
+		for (int i = 0; i < BLOCK * DECIMATION; i++) {
+			int n = start * DECIMATION + i;
+			float value = pleth[n];
+			if (spike_period > 0) {
+				float t = fmodf((float) n / RAW_FREQ, spike_period);
+				if (t < 0.2) {
+					value += 3.0 * (max - min) * sinf(M_PI * t / 0.2);
+				}
+			}
+			fifo[i * HR_AFE_STRIDE + HR_AFE_GREEN] = value;
+		}
+		HR_decimator_process(decimator, fifo, BLOCK * DECIMATION, fifo);
+		for (int i = 0; i < BLOCK; i++) {
+			block[i] = fifo[i * HR_AFE_STRIDE + HR_AFE_GREEN];
+		}
+		HR_greenPreprocess_process(greenPreprocess, block, BLOCK);
+		HR_ring_pushArray(ring, block, BLOCK);
+		if (use_atd) {
+			ATD_process(atd, block, BLOCK);
+			ATD_peaks(atd, signals);
+			unsigned int index;
+			float offset;
+			while (ATD_next(atd, &index, &offset)) {
+				if (detector == 2) {
+					float ago = (float) (atd->count - 1 - index) - offset;
+					float rise = HR_decimator_refine(decimator, ago,
+							0.5 * atd->interval);
+					if (!isnan(rise)) {
+						offset += ago - rise;
+					}
+				}
+				HR_variability_beat(variability, index, offset);
+			}
+			if ((start + BLOCK) % (FREQ * 60) == 0) {
+				int minute = (start + BLOCK) / (FREQ * 60) - 1;
+				rmssd[minute] = HR_variability_rmssd(variability);
+				sdnn[minute] = HR_variability_sdnn(variability);
+				pnn50[minute] = HR_variability_pnn50(variability);
+			}
+		} else {
+			PD_process(pd, block, BLOCK);
+			PD_peaks(pd, HR_ring_window(ring), signals);
+		}
+		total += BLOCK;
+		if (total < SIZE) {
+			continue;
+		}
+		for (int i = SIZE - 3 * BLOCK; i < SIZE - 2 * BLOCK; i++) {
+			if (signals[i]) {
+				beats[count++] = total - SIZE + i;
+			}
+		}
+	}
+
+	HR_greenPreprocess_free(greenPreprocess);
+	HR_ring_free(ring);
+	PD_free(pd);
+	ATD_free(atd);
+	HR_decimator_free(decimator);
+	HR_variability_free(variability);
+	return count;
+}
+
+/**
+ * @brief Prints the HRV measures of the ATD beats and of the R-R intervals every minute.
+ *
+ * The R waves go through a HR_Variability of their own, so both sides use the
+ * same window and the same rejection of implausible intervals.
+ */
+static void compareVariability(int samples, int references_size) {
+	HR_Variability *variability = HR_variability_new(HR_HRV_SIZE, FREQ,
+			RATE_LOW, RATE_HIGH);
+	int minutes = samples / DECIMATION / (FREQ * 60);
+	int r = 0;
+	float error[3] = { 0.0, 0.0, 0.0 };
+	int compared = 0;
+	printf("minute  RMSSD ms (R-R)  SDNN ms (R-R)  pNN50 %% (R-R)\n");
+	for (int minute = 0; minute < minutes; minute++) {
+		float end = (minute + 1) * FREQ * 60;
+		while (r < references_size && reference[r] < end) {
+			unsigned int index = (unsigned int) (reference[r] + 0.5);
+			HR_variability_beat(variability, index, reference[r] - index);
+			r++;
+		}
+		float reference_rmssd = HR_variability_rmssd(variability);
+		float reference_sdnn = HR_variability_sdnn(variability);
+		float reference_pnn50 = HR_variability_pnn50(variability);
+		printf("%6d  %5.1f (%5.1f)   %5.1f (%5.1f)  %5.1f (%5.1f)\n", minute + 1,
+				rmssd[minute], reference_rmssd, sdnn[minute], reference_sdnn,
+				pnn50[minute], reference_pnn50);
+		if (minute > 0 && !isnan(rmssd[minute]) && !isnan(reference_rmssd)) {
+			error[0] += fabsf(rmssd[minute] - reference_rmssd);
+			error[1] += fabsf(sdnn[minute] - reference_sdnn);
+			error[2] += fabsf(pnn50[minute] - reference_pnn50);
+			compared++;
+		}
+	}
+	if (compared > 0) {
+		printf("mean absolute error from minute 2: RMSSD %.1f ms, SDNN %.1f ms, "
+				"pNN50 %.1f%%\n", error[0] / compared, error[1] / compared,
+				error[2] / compared);
+	}
+	HR_variability_free(variability);
+}
+
+static int compareFloat(const void *a, const void *b) {
+	float difference = *(const float*) a - *(const float*) b;
+	return (difference > 0) - (difference < 0);
+}
+
+/**
+ * @brief Matches the beats to the R waves and prints sensitivity and PPV.
+ */
+static void evaluate(const char *name, int beats_size, int references_size) {
+	// Pulse delay: median distance of the beats from the R wave before them
+	static float delays[MAX_SAMPLES / 5];
+	int delays_size = 0;
+	int r = 0;
+	for (int i = 0; i < beats_size; i++) {
+		while (r + 1 < references_size && reference[r + 1] <= beats[i]) {
+			r++;
+		}
+		if (reference[r] <= beats[i] && beats[i] - reference[r] < FREQ) {
+			delays[delays_size++] = beats[i] - reference[r];
+		}
+	}
+	qsort(delays, delays_size, sizeof(float), compareFloat);
+	float delay = delays_size > 0 ? delays[delays_size / 2] : 0.0;
+
+	// Greedy matching in time order, the window of every R wave is checked once
+	int matched = 0;
+	int b = 0;
+	float first = beats_size > 0 ? beats[0] : 0.0;
+	float last = beats_size > 0 ? beats[beats_size - 1] : 0.0;
+	int counted = 0;
+	for (int i = 0; i < references_size; i++) {
+		float expected = reference[i] + delay;
+		if (expected < first || expected > last) {
+			continue;
+		}
+		counted++;
+		while (b < beats_size && beats[b] < expected - TOLERANCE * FREQ) {
+			b++;
+		}
+		if (b < beats_size && beats[b] <= expected + TOLERANCE * FREQ) {
+			matched++;
+			b++;
+		}
+	}
+	int detected = 0;
+	for (int i = 0; i < beats_size; i++) {
+		detected += beats[i] >= first && beats[i] <= last;
+	}
+	printf("%s: %d R waves, %d beats, delay %.2f s, "
+			"sensitivity %.1f%%, PPV %.1f%%\n", name, counted, detected,
+			delay / FREQ, 100.0 * matched / counted, 100.0 * matched / detected);
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s SIGNALS_CSV [SPIKE_PERIOD]\n", argv[0]);
+		return 1;
+	}
+	int samples = readSignals(argv[1]);
+	if (samples == 0) {
+		fprintf(stderr, "%s: no PLETH and II columns\n", argv[1]);
+		return 1;
+	}
+	float spike_period = argc > 2 ? atof(argv[2]) : 0.0;
+	int references_size = findRWaves(samples);
+
+	int beats_size = detect(0, samples, spike_period);
+	evaluate("PD ", beats_size, references_size);
+	beats_size = detect(1, samples, spike_period);
+	evaluate("ATD", beats_size, references_size);
+	compareVariability(samples, references_size);
+	printf("beats timed at %d Hz:\n", RAW_FREQ);
+	detect(2, samples, spike_period);
+	compareVariability(samples, references_size);
+	return 0;
+}
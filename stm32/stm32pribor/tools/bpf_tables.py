@@ -0,0 +1,121 @@
+"""Generates Core/Src/heartmonitor_bpf.c with the band-pass filter tables.
+
+The firmware binds BPF_filter and HRQ_BPF_filter to these tables instead of
+designing the filter with cosf, sinf and tanf at boot. Run it again after
+changing HR_BPF_ORDER, HR_BPF_LOW, HR_BPF_HIGH or SAMPLING_RATE in main.c:
+
+    python tools/bpf_tables.py 4 25 0.8 8.5 [ORDER FREQ LOW HIGH ...]
+"""
+import cmath
+import math
+import os
+import sys
+
+COEF_FRAC = 28  # HRQ_COEF_FRAC
+OUTPUT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Core', 'Src', 'heartmonitor_bpf.c')
+
+
+def sections(order, freq, low, high):
+    """4th order sections (A, d1, d2, d3, d4) of the Butterworth band-pass, as in HRQ_BPF_arenaNew."""
+    a = math.cos(math.pi * (high + low) / freq) / math.cos(math.pi * (high - low) / freq)
+    b = math.tan(math.pi * (high - low) / freq)
+    n = order // 2
+    result = []
+    for i in range(n):
+        r = math.sin(math.pi * (2.0 * i + 1.0) / (4.0 * n))
+        s = b * b + 2.0 * b * r + 1.0
+        result.append((b * b / s,
+                       4.0 * a * (1.0 + b * r) / s,
+                       2.0 * (b * b - 2.0 * a * a - 1.0) / s,
+                       4.0 * a * (1.0 - b * r) / s,
+                       -(b * b - 2.0 * b * r + 1.0) / s))
+    return result
+
+
+def biquads(order, freq, low, high):
+    """Second-order sections (b0, b1, b2, a1, a2) of the same filter, as in BPF_arenaNew."""
+    a = math.cos(math.pi * (high + low) / freq) / math.cos(math.pi * (high - low) / freq)
+    b = math.tan(math.pi * (high - low) / freq)
+    n = order // 2
+    result = []
+    for i in range(n):
+        r = math.sin(math.pi * (2.0 * i + 1.0) / (4.0 * n))
+        c = math.cos(math.pi * (2.0 * i + 1.0) / (4.0 * n))
+        g = b / math.sqrt(b * b + 2.0 * b * r + 1.0)
+        s = complex(-r, c)
+        p = (1.0 + b * s) / (1.0 - b * s)
+        q = a * (1.0 + p)
+        v = cmath.sqrt(q * q - 4.0 * p)
+        for z in ((q - v) / 2.0, (q + v) / 2.0):
+            result.append((g, 0.0, -g, -2.0 * z.real, abs(z) ** 2))
+    return result
+
+
+def fixed(value):
+    value = int(round(value * (1 << COEF_FRAC)))
+    if not -(1 << 31) <= value < (1 << 31):
+        raise ValueError('coefficient out of the Q3.28 range')
+    return value
+
+
+def literal(value):
+    text = '%.9g' % value
+    if '.' not in text and 'e' not in text:
+        text += '.0'
+    return text + 'f'
+
+
+def name(order, freq, low, high):
+    return ('BPF_table_%d_%g_%g_%g' % (order, freq, low, high)).replace('.', 'p')
+
+
+def generate(configs):
+    lines = ['/**',
+             ' * @file heartmonitor_bpf.c',
+             ' * @brief Band-pass filter tables generated by tools/bpf_tables.py, do not edit',
+             ' *',
+             ' * python tools/bpf_tables.py %s' % ' '.join('%d %g %g %g' % c for c in configs),
+             ' */',
+             '',
+             '#include <heartmonitor.h>',
+             '']
+    for order, freq, low, high in configs:
+        prefix = name(order, freq, low, high)
+        lines.append('static const BPF_coefficients %s_sections[%d] = {' % (prefix, order))
+        for biquad in biquads(order, freq, low, high):
+            lines.append('\t{ %s },' % ', '.join(literal(x) for x in biquad))
+        lines.append('};')
+        lines.append('')
+        columns = list(zip(*sections(order, freq, low, high)))
+        for column, values in zip(('A', 'd1', 'd2', 'd3', 'd4'), columns):
+            lines.append('static const int32_t %s_%s[%d] = { %s };'
+                         % (prefix, column, order // 2, ', '.join(str(fixed(x)) for x in values)))
+        lines.append('')
+    lines.append('const BPF_table BPF_tables[] = {')
+    for order, freq, low, high in configs:
+        prefix = name(order, freq, low, high)
+        lines.append('\t{ %d, %s, %s, %s, %s_sections,' % (order, literal(freq), literal(low), literal(high), prefix))
+        lines.append('\t\t\t%s_A, %s_d1, %s_d2, %s_d3, %s_d4 },' % ((prefix,) * 5))
+    lines.append('};')
+    lines.append('')
+    lines.append('const int BPF_tables_size = sizeof(BPF_tables) / sizeof(BPF_tables[0]);')
+    return '\n'.join(lines) + '\n'
+
+
+def main(args):
+    if not args or len(args) % 4:
+        print(__doc__)
+        return 1
+    configs = []
+    for i in range(0, len(args), 4):
+        order = int(args[i])
+        if order < 2 or order % 2:
+            raise ValueError('order must be even')
+        configs.append((order, float(args[i + 1]), float(args[i + 2]), float(args[i + 3])))
+    with open(OUTPUT, 'w', newline='\n') as f:
+        f.write(generate(configs))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,172 @@
+/**
+ * @file decimation.c
+ * @brief Aliasing rejection and cost of the HR_Decimator tables.
+ *
+ * Host program: for every entry of HR_decimatorTables, tones of unit amplitude
+ * are fed as the red, infrared and green channel of the AFE FIFO at the rate of
+ * the AFE, factor times the output rate. The gain of the output is measured
+ * over the pass band up to the pass edge and over the band whose aliases fall
+ * below the pass edge, from freq - pass to the Nyquist frequency of the AFE.
+ * Taking every factor-th sample, as without the decimator, passes that band at
+ * 0 dB. The multiply-adds per input sample and the host time per input sample
+ * are printed, and the output in place is checked against a separate buffer.
+ *
+ *     gcc -O2 -ICore/Inc tools/decimation.c Core/Src/heartmonitor.c \
+ *         Core/Src/heartmonitor_fixed.c Core/Src/heartmonitor_bpf.c \
+ *         Core/Src/heartmonitor_decimator.c Core/Src/heartmonitor_tables.c \
+ *         Core/Src/trace.c -lm -o decimation
+ *     ./decimation
+ *
+ * The exit status is 1 if a table rejects the aliases by less than REJECTION dB.
+ */
+
+#include <heartmonitor.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SECONDS 20
+#define SETTLE 2 // seconds of output left out of the gain
+#define STEP (2.0 / (SECONDS - SETTLE)) // Hz, whole periods of every tone and alias
+#define REJECTION 55.0 // dB
+#define MAX_FACTOR 8
+#define BLOCK 25 // output samples per call, one second as in main.c
+
+static float input[BLOCK * MAX_FACTOR * HR_AFE_STRIDE];
+static float output[BLOCK * HR_AFE_STRIDE];
+
+/**
+ * @brief Gain in dB of the decimator for a tone at the given input frequency.
+ *
+ * The frequency is a multiple of STEP, so the mean square is taken over
+ * whole periods of the output, which is the tone or its alias.
+ */
+static float gain(const HR_DecimatorTable *table, float frequency) {
+	HR_Decimator *decimator = HR_decimator_new(table->factor, table->freq,
+			table->pass, 0);
+	int inputs = BLOCK * table->factor;
+	float rate = table->factor * table->freq;
+	double square = 0.0;
+	int count = 0;
+	for (int second = 0; second < SECONDS; second++) {
+		for (int i = 0; i < inputs; i++) {
+			double t = (double) (second * inputs + i) / rate;
+			float value = sin(2.0 * M_PI * frequency * t);
+			for (int channel = 0; channel < HR_AFE_STRIDE; channel++) {
+				input[i * HR_AFE_STRIDE + channel] = value;
+			}
+		}
+		int written = HR_decimator_process(decimator, input, inputs, output);
+		if (second < SETTLE) {
+			continue;
+		}
+		for (int i = 0; i < written; i++) {
+			float value = output[i * HR_AFE_STRIDE + HR_AFE_GREEN];
+			square += value * value;
+			count++;
+		}
+	}
+	HR_decimator_free(decimator);
+	// A sine of unit amplitude has a mean square of 1/2
+	return 10.0 * log10(2.0 * square / count + 1e-30);
+}
+
+/**
+ * @brief Host time of the decimator in ns per input sample.
+ */
+static float timing(const HR_DecimatorTable *table) {
+	HR_Decimator *decimator = HR_decimator_new(table->factor, table->freq,
+			table->pass, 0);
+	int inputs = BLOCK * table->factor;
+	for (int i = 0; i < inputs * HR_AFE_STRIDE; i++) {
+		input[i] = (float) rand() / RAND_MAX;
+	}
+	const int repeats = 20000;
+	clock_t start = clock();
+	for (int r = 0; r < repeats; r++) {
+		HR_decimator_process(decimator, input, inputs, output);
+	}
+	clock_t end = clock();
+	HR_decimator_free(decimator);
+	return 1e9 * (end - start) / CLOCKS_PER_SEC / ((double) repeats * inputs);
+}
+
+/**
+ * @brief Checks that decimating in place gives the same output as a separate buffer.
+ */
+static int inPlace(const HR_DecimatorTable *table) {
+	HR_Decimator *separate = HR_decimator_new(table->factor, table->freq,
+			table->pass, 0);
+	HR_Decimator *same = HR_decimator_new(table->factor, table->freq,
+			table->pass, 0);
+	static float fifo[BLOCK * MAX_FACTOR * HR_AFE_STRIDE];
+	int inputs = BLOCK * table->factor;
+	int equal = 1;
+	for (int second = 0; second < 3 && equal; second++) {
+		for (int i = 0; i < inputs * HR_AFE_STRIDE; i++) {
+			input[i] = (float) rand() / RAND_MAX;
+		}
+		memcpy(fifo, input, inputs * HR_AFE_STRIDE * sizeof(float));
+		int written = HR_decimator_process(separate, input, inputs, output);
+		equal = written == BLOCK
+				&& HR_decimator_process(same, fifo, inputs, fifo) == written
+				&& memcmp(fifo, output, written * HR_AFE_STRIDE * sizeof(float))
+						== 0;
+	}
+	HR_decimator_free(separate);
+	HR_decimator_free(same);
+	return equal;
+}
+
+int main(void) {
+	int failed = 0;
+	for (int t = 0; t < HR_decimatorTables_size; t++) {
+		const HR_DecimatorTable *table = &HR_decimatorTables[t];
+		if (table->factor > MAX_FACTOR) {
+			continue;
+		}
+		float rate = table->factor * table->freq;
+		float pass_min = INFINITY;
+		float pass_max = -INFINITY;
+		for (int k = 1; k * STEP <= table->pass; k++) {
+			float g = gain(table, k * STEP);
+			pass_min = fminf(pass_min, g);
+			pass_max = fmaxf(pass_max, g);
+		}
+		float alias_max = -INFINITY;
+		float alias_frequency = 0.0;
+		for (int k = ceilf((table->freq - table->pass) / STEP); k * STEP
+				< 0.5 * rate; k++) {
+			float f = k * STEP;
+			if (fabsf(remainderf(f, table->freq)) < 0.5 * STEP) {
+				continue; // aliased to 0 Hz, the output depends on the phase
+			}
+			float g = gain(table, f);
+			if (g > alias_max) {
+				alias_max = g;
+				alias_frequency = f;
+			}
+		}
+		int equal = inPlace(table);
+		printf("%g Hz to %g Hz (factor %d, %d coefficients per phase, "
+				"delay %d samples)\n", rate, table->freq, table->factor,
+				table->length, table->delay);
+		printf("  pass band up to %g Hz: %+.2f to %+.2f dB\n", table->pass,
+				pass_min, pass_max);
+		printf("  aliases from %g to %g Hz: %.1f dB at most (%.2f Hz), "
+				"every factor-th sample: 0 dB\n", table->freq - table->pass,
+				0.5 * rate, alias_max, alias_frequency);
+		printf("  %d multiply-adds per input sample, %.1f ns per input sample "
+				"on this host\n", HR_DECIMATOR_CHANNELS * table->length,
+				timing(table));
+		printf("  in place: %s\n", equal ? "same output" : "DIFFERENT OUTPUT");
+		if (-alias_max < REJECTION || !equal) {
+			failed = 1;
+		}
+	}
+	printf("arena bytes: %d, with 2 s of green at 100 Hz: %d\n",
+			(int) HR_DECIMATOR_FOOTPRINT(0), (int) HR_DECIMATOR_FOOTPRINT(200));
+	return failed;
+}
@@ -0,0 +1,123 @@
+"""Generates Core/Src/heartmonitor_decimator.c with the decimation filter tables.
+
+HR_Decimator is bound to these tables instead of designing its low-pass filter
+at boot. Run it again after changing AFE_DECIMATION, SAMPLING_RATE or
+HR_BPF_HIGH in main.c:
+
+    python tools/decimator_tables.py 4 25 8.5 [FACTOR FREQ PASS ...]
+
+FREQ is the output sampling frequency, the AFE runs at FACTOR * FREQ. The
+filter is a Kaiser windowed sinc with ATTENUATION dB in the stop band, which
+starts at FREQ - PASS, so nothing from the stop band aliases below PASS.
+"""
+import math
+import os
+import sys
+
+ATTENUATION = 60.0  # dB
+MAX_LENGTH = 16  # HR_DECIMATOR_LENGTH
+OUTPUT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Core', 'Src', 'heartmonitor_decimator.c')
+
+
+def bessel_i0(x):
+    total = term = 1.0
+    k = 1
+    while term > 1e-12 * total:
+        term *= (x / (2.0 * k)) ** 2
+        total += term
+        k += 1
+    return total
+
+
+def design(factor, freq, passband):
+    """Taps of the low-pass filter at factor * freq, normalized to a gain of 1 at DC."""
+    rate = factor * freq
+    stop = freq - passband
+    if stop <= passband:
+        raise ValueError('pass band must be below a half of the output frequency')
+    beta = 0.1102 * (ATTENUATION - 8.7)
+    width = 2.0 * math.pi * (stop - passband) / rate
+    taps = int(math.ceil((ATTENUATION - 8.0) / (2.285 * width))) + 1
+    taps += 1 - taps % 2  # odd, delay of a whole number of samples
+    cutoff = 0.5 * (passband + stop) / rate
+    middle = (taps - 1) / 2.0
+    result = []
+    for n in range(taps):
+        t = n - middle
+        ideal = 2.0 * cutoff if t == 0 else math.sin(2.0 * math.pi * cutoff * t) / (math.pi * t)
+        window = bessel_i0(beta * math.sqrt(1.0 - (t / middle) ** 2)) / bessel_i0(beta)
+        result.append(ideal * window)
+    total = sum(result)
+    # The sinc is 0 at every factor-th tap off the middle, drop the rounding noise
+    return [x / total if abs(x) > 1e-12 else 0.0 for x in result]
+
+
+def phases(factor, taps):
+    """Coefficients h[phase + j * factor], phase by phase, padded with zeros to whole phases."""
+    length = -(-len(taps) // factor)
+    if length > MAX_LENGTH:
+        raise ValueError('more than HR_DECIMATOR_LENGTH coefficients per phase')
+    padded = taps + [0.0] * (length * factor - len(taps))
+    return length, [[padded[phase + j * factor] for j in range(length)] for phase in range(factor)]
+
+
+def literal(value):
+    text = '%.9g' % value
+    if '.' not in text and 'e' not in text:
+        text += '.0'
+    return text + 'f'
+
+
+def name(factor, freq, passband):
+    return ('HR_decimatorTable_%d_%g_%g' % (factor, freq, passband)).replace('.', 'p')
+
+
+def generate(configs):
+    lines = ['/**',
+             ' * @file heartmonitor_decimator.c',
+             ' * @brief Decimation filter tables generated by tools/decimator_tables.py, do not edit',
+             ' *',
+             ' * python tools/decimator_tables.py %s' % ' '.join('%d %g %g' % c for c in configs),
+             ' */',
+             '',
+             '#include <heartmonitor.h>',
+             '']
+    entries = []
+    for factor, freq, passband in configs:
+        taps = design(factor, freq, passband)
+        length, table = phases(factor, taps)
+        prefix = name(factor, freq, passband)
+        lines.append('// %d taps, delay of %d samples at %g Hz' % (len(taps), (len(taps) - 1) // 2, factor * freq))
+        lines.append('static const float %s_coefficients[%d] = {' % (prefix, factor * length))
+        for row in table:
+            lines.append('\t%s,' % ', '.join(literal(x) for x in row))
+        lines.append('};')
+        lines.append('')
+        entries.append('\t{ %d, %s, %s, %d, %d, %s_coefficients },'
+                       % (factor, literal(freq), literal(passband), length, (len(taps) - 1) // 2, prefix))
+    lines.append('const HR_DecimatorTable HR_decimatorTables[] = {')
+    lines.extend(entries)
+    lines.append('};')
+    lines.append('')
+    lines.append('const int HR_decimatorTables_size = sizeof(HR_decimatorTables)')
+    lines.append('\t\t/ sizeof(HR_decimatorTables[0]);')
+    return '\n'.join(lines) + '\n'
+
+
+def main(args):
+    if not args or len(args) % 3:
+        print(__doc__)
+        return 1
+    configs = []
+    for i in range(0, len(args), 3):
+        factor = int(args[i])
+        if factor < 2:
+            raise ValueError('factor must be at least 2')
+        configs.append((factor, float(args[i + 1]), float(args[i + 2])))
+    with open(OUTPUT, 'w', newline='\n') as f:
+        f.write(generate(configs))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,265 @@
+/**
+ * @file fusion.c
+ * @brief Valid-window rate of HR_HeartMonitor with and without the infrared channel.
+ *
+ * Host program: the PLETH channel of a BIDMC recording is decimated to 25 Hz
+ * and fed as the infrared channel of the AFE FIFO, one second per call of
+ * HR_heartMonitor_addInterleaved as in main.c. The recording has no second
+ * PPG, so the green channel is the same PLETH made worse per scenario: its
+ * pulse is scaled by a gain and white noise is added, over the whole recording
+ * or every other SEGMENT seconds. The last scenario makes the infrared channel
+ * worse instead. Every scenario runs a monitor on the green channel alone
+ * (HR_heartMonitor_peaksFromGreen) and one with a HR_Fusion
+ * (HR_heartMonitor_peaksFromChannels).
+ *
+ * A window is valid as in the session of main.c: the result is valid, the
+ * tracked heart rate is within HR_limit_low and HR_limit_high and the signal
+ * quality index reaches HR_SQI_ACCEPT. The valid windows and the mean absolute
+ * error of their tracked heart rate against the HR numeric of the bedside
+ * monitor are printed.
+ *
+ *     gcc -O2 -ICore/Inc tools/fusion.c Core/Src/heartmonitor.c \
+ *         Core/Src/heartmonitor_fixed.c Core/Src/heartmonitor_bpf.c \
+ *         Core/Src/heartmonitor_decimator.c Core/Src/heartmonitor_tables.c \
+ *         Core/Src/trace.c -lm -o fusion
+ *     ./fusion ../../bench/BIDMC/bidmc_01
+ *
+ * The prefix is completed with _Signals.csv and _Numerics.csv.
+ */
+
+#include <heartmonitor.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RAW_FREQ 125
+#define DECIMATION 5
+#define FREQ 25
+#define BLOCK 25
+#define SIZE 100
+#define MAX_SAMPLES 100000
+#define MAX_SECONDS (MAX_SAMPLES / RAW_FREQ)
+#define WARMUP 8 // seconds before the windows are counted
+#define SEGMENT 20 // seconds of good and bad green channel in turn
+#define RATE_LOW 50 // HR_limit_low of main.c
+#define RATE_HIGH 150 // HR_limit_high of main.c
+
+static float pleth[MAX_SAMPLES];
+static float numerics[MAX_SECONDS];
+
+/**
+ * @brief Reads the PLETH column of a BIDMC *_Signals.csv file.
+ */
+static int readSignals(const char *filename) {
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) {
+		return 0;
+	}
+	char line[512];
+	int pleth_column = -1;
+	if (fgets(line, sizeof(line), file) != NULL) {
+		int column = 0;
+		for (char *name = strtok(line, ",\r\n"); name != NULL;
+				name = strtok(NULL, ",\r\n"), column++) {
+			while (*name == ' ') {
+				name++;
+			}
+			if (strcmp(name, "PLETH") == 0) {
+				pleth_column = column;
+			}
+		}
+	}
+	int count = 0;
+	while (pleth_column >= 0 && count < MAX_SAMPLES
+			&& fgets(line, sizeof(line), file) != NULL) {
+		char *field = line;
+		for (int column = 0; column < pleth_column && field != NULL; column++) {
+			field = strchr(field, ',');
+			if (field != NULL) {
+				field++;
+			}
+		}
+		pleth[count++] = field != NULL ? atof(field) : 0.0;
+	}
+	fclose(file);
+	return count;
+}
+
+/**
+ * @brief Reads the HR column of a BIDMC *_Numerics.csv file, one value per second.
+ */
+static int readNumerics(const char *filename) {
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) {
+		return 0;
+	}
+	char line[256];
+	int hr_column = -1;
+	if (fgets(line, sizeof(line), file) != NULL) {
+		int column = 0;
+		for (char *name = strtok(line, ",\r\n"); name != NULL;
+				name = strtok(NULL, ",\r\n"), column++) {
+			while (*name == ' ') {
+				name++;
+			}
+			if (strcmp(name, "HR") == 0) {
+				hr_column = column;
+			}
+		}
+	}
+	int count = 0;
+	while (hr_column >= 0 && count < MAX_SECONDS
+			&& fgets(line, sizeof(line), file) != NULL) {
+		char *field = line;
+		for (int column = 0; column < hr_column && field != NULL; column++) {
+			field = strchr(field, ',');
+			if (field != NULL) {
+				field++;
+			}
+		}
+		numerics[count++] = field != NULL && *field != '\0' && *field != '\n' ?
+				atof(field) : nanf("");
+	}
+	fclose(file);
+	return count;
+}
+
+/**
+ * @brief Gaussian noise of unit variance (Box-Muller), repeatable with srand.
+ */
+static float gaussian(void) {
+	float u = ((float) rand() + 1.0) / ((float) RAND_MAX + 2.0);
+	float v = (float) rand() / RAND_MAX;
+	return sqrtf(-2.0 * logf(u)) * cosf(2.0 * M_PI * v);
+}
+
+typedef struct {
+	const char *name;
+	float gain; /**< Gain of the pulse of the worse channel */
+	float noise; /**< Standard deviation of the noise of the worse channel */
+	int segments; /**< Non-zero if the green channel is bad every other SEGMENT seconds only */
+	int infrared; /**< Non-zero if the infrared channel is made worse instead */
+} Scenario;
+
+typedef struct {
+	int windows; /**< Number of windows with a reference */
+	int valid; /**< Number of valid windows */
+	float error; /**< Sum of the absolute errors of the valid windows */
+	int ir; /**< Number of windows on the infrared peaks */
+	int blend; /**< Number of windows blending both channels */
+} Score;
+
+/**
+ * @brief Runs one monitor over the recording, with the infrared channel if fused.
+ */
+static void run(const Scenario *scenario, int samples, int numerics_size,
+		int fused, Score *score) {
+	HR_HeartMonitor *heartMonitor = HR_heartMonitor_new(FREQ, SIZE, 0.35, 4,
+			0.8, 8.5, 2, 5, 7, RATE_LOW, RATE_HIGH, HR_ENGINE_PEAKS);
+	HR_Fusion *fusion = NULL;
+	if (fused) {
+		fusion = HR_fusion_new(FREQ, SIZE, 0.35, 4, 0.8, 8.5, 2, RATE_HIGH);
+		heartMonitor->fusion = fusion;
+	}
+	memset(score, 0, sizeof(Score));
+	srand(1);
+	float mean = 0.0;
+	for (int i = 0; i < samples; i++) {
+		mean += pleth[i];
+	}
+	mean /= samples;
+	float fifo[BLOCK * HR_AFE_STRIDE];
+	HR_Result result;
+	HR_Quality quality;
+	int seconds = samples / DECIMATION / BLOCK;
+	for (int second = 0; second < seconds; second++) {
+		int bad = !scenario->segments || (second / SEGMENT) % 2;
+		for (int i = 0; i < BLOCK; i++) {
+			float value = pleth[(second * BLOCK + i) * DECIMATION];
+			float worse = value;
+			if (bad) {
+				worse = mean + scenario->gain * (value - mean)
+						+ scenario->noise * gaussian();
+			}
+			fifo[i * HR_AFE_STRIDE + HR_AFE_RED] = value;
+			fifo[i * HR_AFE_STRIDE + HR_AFE_IR] =
+					scenario->infrared ? worse : value;
+			fifo[i * HR_AFE_STRIDE + HR_AFE_GREEN] =
+					scenario->infrared ? value : worse;
+			fifo[i * HR_AFE_STRIDE + 3] = 0.0;
+		}
+		HR_heartMonitor_addInterleaved(heartMonitor, fifo, NULL, BLOCK);
+		if (fused) {
+			HR_heartMonitor_peaksFromChannels(heartMonitor);
+		} else {
+			HR_heartMonitor_peaksFromGreen(heartMonitor);
+		}
+		HR_heartMonitor_heartRateAndRatio(heartMonitor, &result);
+		HR_heartMonitor_quality(heartMonitor, &result, &quality);
+		float rate = HR_heartMonitor_track(heartMonitor, &result);
+
+		float reference =
+				second + 1 < numerics_size ? numerics[second + 1] : nanf("");
+		if (second + 1 < WARMUP || isnan(reference)) {
+			continue;
+		}
+		score->windows++;
+		if (fused) {
+			score->ir += fusion->channel == HR_FUSION_IR;
+			score->blend += fusion->blend;
+		}
+		if (result.valid && rate > RATE_LOW && rate < RATE_HIGH
+				&& quality.index >= HR_SQI_ACCEPT) {
+			score->valid++;
+			score->error += fabsf(rate - reference);
+		}
+	}
+	HR_heartMonitor_free(heartMonitor);
+	if (fusion != NULL) {
+		HR_fusion_free(fusion);
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s BIDMC_PREFIX\n", argv[0]);
+		return 1;
+	}
+	char filename[512];
+	snprintf(filename, sizeof(filename), "%s_Signals.csv", argv[1]);
+	int samples = readSignals(filename);
+	snprintf(filename, sizeof(filename), "%s_Numerics.csv", argv[1]);
+	int numerics_size = readNumerics(filename);
+	if (samples == 0 || numerics_size == 0) {
+		fprintf(stderr, "%s: no PLETH signal or HR numeric\n", argv[1]);
+		return 1;
+	}
+
+	static const Scenario scenarios[] = {
+			{ "same as infrared", 1.0, 0.0, 0, 0 },
+			{ "weak", 0.3, 0.02, 0, 0 },
+			{ "noisy", 1.0, 0.06, 0, 0 },
+			{ "lost every other 20 s", 0.3, 0.06, 1, 0 },
+			{ "good, infrared noisy", 1.0, 0.06, 0, 1 },
+	};
+	printf("%-28s %-26s %s\n", "green channel", "green alone",
+			"green and infrared");
+	for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+		Score green;
+		Score fused;
+		run(&scenarios[s], samples, numerics_size, 0, &green);
+		run(&scenarios[s], samples, numerics_size, 1, &fused);
+		printf("%-28s %5.1f%% valid, MAE %4.1f   %5.1f%% valid, MAE %4.1f"
+				" (infrared %4.1f%%, blended %4.1f%%)\n", scenarios[s].name,
+				100.0 * green.valid / green.windows,
+				green.valid > 0 ? green.error / green.valid : nanf(""),
+				100.0 * fused.valid / fused.windows,
+				fused.valid > 0 ? fused.error / fused.valid : nanf(""),
+				100.0 * fused.ir / fused.windows,
+				100.0 * fused.blend / fused.windows);
+	}
+	printf("infrared channel: %d bytes\n",
+			(int) HR_FUSION_FOOTPRINT(SIZE, 4, 2));
+	return 0;
+}
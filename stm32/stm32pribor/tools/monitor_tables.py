@@ -0,0 +1,112 @@
+"""Generates Core/Src/heartmonitor_tables.c with the tables of the heart monitor window.
+
+HR_Spectrum is bound to these tables instead of computing its Hann window and
+Goertzel coefficients with cosf at boot, ATD_detector takes its threshold decay
+per sample from them instead of expf. Run it again after changing HR_MON_SIZE or
+SAMPLING_RATE in main.c, or HR_SPECTRUM_LOW, HR_SPECTRUM_STEP, HR_SPECTRUM_BINS
+or HR_ATD_DECAY in heartmonitor.h:
+
+    python tools/monitor_tables.py 100 25 [SIZE FREQ ...]
+"""
+import math
+import os
+import sys
+
+SPECTRUM_LOW = 0.8  # HR_SPECTRUM_LOW
+SPECTRUM_STEP = 0.125  # HR_SPECTRUM_STEP
+SPECTRUM_BINS = 23  # HR_SPECTRUM_BINS
+ATD_DECAY = 0.8  # HR_ATD_DECAY
+OUTPUT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Core', 'Src', 'heartmonitor_tables.c')
+
+
+def hann(size):
+    """Hann window of size samples, as in HR_spectrum_arenaNew."""
+    return [0.5 - 0.5 * math.cos(2.0 * math.pi * i / size) for i in range(size)]
+
+
+def goertzel(freq, low, step, bins):
+    """Goertzel coefficients 2 cos(2 pi f / freq) of the bins."""
+    return [2.0 * math.cos(2.0 * math.pi * (low + k * step) / freq) for k in range(bins)]
+
+
+def decay(freq):
+    """Factor of the ATD_detector threshold per sample, time constant ATD_DECAY seconds."""
+    return math.exp(-1.0 / (ATD_DECAY * freq))
+
+
+def literal(value):
+    text = '%.9g' % value
+    if '.' not in text and 'e' not in text:
+        text += '.0'
+    return text + 'f'
+
+
+def name(size, freq):
+    return ('HR_spectrumTable_%d_%g' % (size, freq)).replace('.', 'p')
+
+
+def rows(values, width=8):
+    return ['\t%s,' % ', '.join(literal(x) for x in values[i:i + width]) for i in range(0, len(values), width)]
+
+
+def generate(configs):
+    lines = ['/**',
+             ' * @file heartmonitor_tables.c',
+             ' * @brief Heart monitor tables generated by tools/monitor_tables.py, do not edit',
+             ' *',
+             ' * python tools/monitor_tables.py %s' % ' '.join('%d %g' % c for c in configs),
+             ' */',
+             '',
+             '#include <heartmonitor.h>',
+             '']
+    entries = []
+    for size, freq in configs:
+        prefix = name(size, freq)
+        window = hann(size)
+        coefficients = goertzel(freq, SPECTRUM_LOW, SPECTRUM_STEP, SPECTRUM_BINS)
+        lines.append('static const float %s_window[%d] = {' % (prefix, size))
+        lines.extend(rows(window))
+        lines.append('};')
+        lines.append('')
+        lines.append('// %g Hz to %g Hz' % (SPECTRUM_LOW, SPECTRUM_LOW + (SPECTRUM_BINS - 1) * SPECTRUM_STEP))
+        lines.append('static const float %s_coefficients[%d] = {' % (prefix, SPECTRUM_BINS))
+        lines.extend(rows(coefficients))
+        lines.append('};')
+        lines.append('')
+        entries.append('\t{ %d, %s, %s, %s, %d, %s_window, %s_coefficients },'
+                       % (size, literal(freq), literal(SPECTRUM_LOW), literal(SPECTRUM_STEP), SPECTRUM_BINS,
+                          prefix, prefix))
+    lines.append('const HR_SpectrumTable HR_spectrumTables[] = {')
+    lines.extend(entries)
+    lines.append('};')
+    lines.append('')
+    lines.append('const int HR_spectrumTables_size = sizeof(HR_spectrumTables)')
+    lines.append('\t\t/ sizeof(HR_spectrumTables[0]);')
+    lines.append('')
+    lines.append('// threshold decay of %g s' % ATD_DECAY)
+    lines.append('const ATD_table ATD_tables[] = {')
+    for freq in sorted(set(freq for _, freq in configs)):
+        lines.append('\t{ %s, %s },' % (literal(freq), literal(decay(freq))))
+    lines.append('};')
+    lines.append('')
+    lines.append('const int ATD_tables_size = sizeof(ATD_tables) / sizeof(ATD_tables[0]);')
+    return '\n'.join(lines) + '\n'
+
+
+def main(args):
+    if not args or len(args) % 2:
+        print(__doc__)
+        return 1
+    configs = []
+    for i in range(0, len(args), 2):
+        size = int(args[i])
+        if size < 1:
+            raise ValueError('size must be positive')
+        configs.append((size, float(args[i + 1])))
+    with open(OUTPUT, 'w', newline='\n') as f:
+        f.write(generate(configs))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
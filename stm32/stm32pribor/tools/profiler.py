@@ -0,0 +1,180 @@
+"""Prints the cycle counts of the main loop stages reported by Core/Src/profiler.c.
+
+Build the firmware with PROF_ENABLE in Core/Inc/profiler.h, enable ITM
+stimulus ports 0 and 1 in the SWV settings of the debugger and save the SWO
+output to a file, for example with OpenOCD:
+
+    tpiu config internal swo.bin uart off 64000000 2000000
+    itm ports on
+
+then:
+
+    python tools/profiler.py swo.bin [--each] [--port-data]
+
+The file is the raw ITM stream of the SWO pin. With --port-data it is the data
+of stimulus port PROF_ITM_PORT alone, as some SWV viewers save it. The reports
+of the file are added up into one table; with --each every report is printed.
+The stage names come from the PROF_Stage enum of Core/Inc/profiler.h.
+"""
+import os
+import re
+import struct
+import sys
+
+PROF_MAGIC = 0x464F5250
+PROF_VERSION = 1
+PROF_ITM_PORT = 1
+HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Core', 'Inc', 'profiler.h')
+
+
+def stage_names():
+    """Names of the PROF_Stage enum without the PROF_ prefix, in order."""
+    try:
+        with open(HEADER) as f:
+            text = f.read()
+    except OSError:
+        return []
+    body = re.search(r'typedef enum \{(.*?)\} PROF_Stage;', text, re.S)
+    if body is None:
+        return []
+    names = re.findall(r'^\s*PROF_(\w+)', body.group(1), re.M)
+    return [name for name in names if name != 'STAGES']
+
+
+def port_data(stream, port):
+    """Payload bytes of the software source packets of one ITM stimulus port."""
+    data = bytearray()
+    zeros = 0
+    i = 0
+    while i < len(stream):
+        header = stream[i]
+        i += 1
+        if header == 0:
+            zeros += 1
+            continue
+        if header == 0x80 and zeros >= 5:
+            zeros = 0  # end of a synchronization packet
+            continue
+        zeros = 0
+        if header & 0x03:
+            size = (1, 2, 4)[(header & 0x03) - 1]
+            if not header & 0x04 and header >> 3 == port:
+                data += stream[i:i + size]
+            i += size
+        elif header & 0x80:
+            # timestamp or extension packet, continued while bit 7 is set
+            while i < len(stream) and stream[i] & 0x80:
+                i += 1
+            i += 1
+    return bytes(data)
+
+
+def reports(data):
+    """Decoded reports with a valid checksum, see PROF_report."""
+    result = []
+    start = 0
+    magic = struct.pack('<I', PROF_MAGIC)
+    while True:
+        start = data.find(magic, start)
+        if start < 0 or start + 16 > len(data):
+            return result
+        layout, clock, sequence = struct.unpack_from('<3I', data, start + 4)
+        version = layout & 0xFF
+        stages = layout >> 8 & 0xFF
+        bins = layout >> 16 & 0xFF
+        first = layout >> 24 & 0xFF
+        words = 4 + stages * (5 + bins // 2) + 1
+        if version != PROF_VERSION or bins % 2 or start + 4 * words > len(data):
+            start += 1
+            continue
+        values = struct.unpack_from('<%dI' % words, data, start)
+        if sum(values[:-1]) & 0xFFFFFFFF != values[-1]:
+            start += 1
+            continue
+        report = {'clock': clock, 'sequence': sequence, 'first': first, 'stages': []}
+        offset = 4
+        for _ in range(stages):
+            count, low, high, sum_low, sum_high = values[offset:offset + 5]
+            packed = values[offset + 5:offset + 5 + bins // 2]
+            histogram = []
+            for word in packed:
+                histogram += [word & 0xFFFF, word >> 16]
+            report['stages'].append({'count': count, 'min': low, 'max': high,
+                                     'sum': sum_low | sum_high << 32, 'bins': histogram})
+            offset += 5 + bins // 2
+        result.append(report)
+        start += 4 * words
+
+
+def merge(reports_list):
+    """One report with the runs of all the reports."""
+    total = {'clock': reports_list[-1]['clock'], 'sequence': reports_list[-1]['sequence'],
+             'first': reports_list[-1]['first'], 'stages': []}
+    for stages in zip(*(report['stages'] for report in reports_list)):
+        total['stages'].append({
+            'count': sum(s['count'] for s in stages),
+            'min': min((s['min'] for s in stages if s['count']), default=0),
+            'max': max(s['max'] for s in stages),
+            'sum': sum(s['sum'] for s in stages),
+            'bins': [sum(b) for b in zip(*(s['bins'] for s in stages))],
+        })
+    return total
+
+
+def histogram(bins, first):
+    """Non-empty log2 bins as upper edge:runs."""
+    cells = []
+    for k, runs in enumerate(bins):
+        if not runs:
+            continue
+        if k == len(bins) - 1:
+            cells.append('>2^%d:%d' % (first + k - 1, runs))
+        else:
+            cells.append('<2^%d:%d' % (first + k, runs))
+    return ' '.join(cells)
+
+
+def print_report(report, names):
+    us = 1e6 / report['clock'] if report['clock'] else 0.0
+    loop = report['stages'][0]['sum'] if report['stages'] else 0
+    print('%-12s %7s %10s %10s %10s %10s %6s  %s' % ('stage', 'runs', 'min', 'mean', 'max',
+                                                      'mean us', 'loop%', 'cycles histogram'))
+    for index, stage in enumerate(report['stages']):
+        name = names[index] if index < len(names) else 'stage %d' % index
+        if not stage['count']:
+            print('%-12s %7d %10s %10s %10s %10s %6s' % (name, 0, '-', '-', '-', '-', '-'))
+            continue
+        mean = stage['sum'] / stage['count']
+        share = 100.0 * stage['sum'] / loop if loop else 0.0
+        print('%-12s %7d %10d %10.0f %10d %10.1f %6.2f  %s' % (
+            name, stage['count'], stage['min'], mean, stage['max'], mean * us, share,
+            histogram(stage['bins'], report['first'])))
+
+
+def main(args):
+    paths = [arg for arg in args if not arg.startswith('--')]
+    if len(paths) != 1:
+        print(__doc__)
+        return 1
+    with open(paths[0], 'rb') as f:
+        stream = f.read()
+    data = stream if '--port-data' in args else port_data(stream, PROF_ITM_PORT)
+    decoded = reports(data)
+    if not decoded:
+        print('%s: no profiler report' % paths[0])
+        return 1
+    names = stage_names()
+    lost = sum(max(0, b['sequence'] - a['sequence'] - 1) for a, b in zip(decoded, decoded[1:]))
+    if '--each' in args:
+        for report in decoded:
+            print('report %d at %d Hz' % (report['sequence'], report['clock']))
+            print_report(report, names)
+            print()
+    else:
+        print('%d reports (%d lost) at %d Hz' % (len(decoded), lost, decoded[-1]['clock']))
+        print_report(merge(decoded), names)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,263 @@
+/**
+ * @file respiration.c
+ * @brief Respiration rate of HR_HeartMonitor against the breath annotations of BIDMC.
+ *
+ * Host program: the PLETH channel is decimated to 25 Hz and fed as the red,
+ * infrared and green channel of the AFE FIFO to HR_heartMonitor_addInterleaved,
+ * one second per call as in main.c. After every call the respiration rate of
+ * every feature and the fused rate are compared with the rate of the manual
+ * breath annotations over the last REFERENCE_WINDOW seconds (mean time of the
+ * two annotators) and with the RESP numeric of the bedside monitor.
+ *
+ *     gcc -O2 -ICore/Inc tools/respiration.c Core/Src/heartmonitor.c \
+ *         Core/Src/heartmonitor_fixed.c Core/Src/heartmonitor_bpf.c \
+ *         Core/Src/heartmonitor_decimator.c Core/Src/heartmonitor_tables.c \
+ *         Core/Src/trace.c -lm -o respiration
+ *     ./respiration ../../bench/BIDMC/bidmc_01 [-v]
+ *
+ * The prefix is completed with _Signals.csv, _Breaths.csv and _Numerics.csv.
+ * With -v the rates of every second are printed.
+ */
+
+#include <heartmonitor.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RAW_FREQ 125
+#define DECIMATION 5
+#define FREQ 25
+#define BLOCK 25
+#define SIZE 100
+#define RATE_LOW 50 // HR_limit_low of main.c
+#define RATE_HIGH 150 // HR_limit_high of main.c
+#define MAX_SAMPLES 100000
+#define MAX_SECONDS (MAX_SAMPLES / RAW_FREQ)
+#define REFERENCE_WINDOW 32.0
+#define WARMUP 30 // seconds before the rates are compared
+
+static float pleth[MAX_SAMPLES];
+static float breaths[MAX_SAMPLES / RAW_FREQ];
+static float numerics[MAX_SECONDS];
+
+/**
+ * @brief Reads the PLETH column of a BIDMC *_Signals.csv file.
+ */
+static int readSignals(const char *filename) {
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) {
+		return 0;
+	}
+	char line[512];
+	int pleth_column = -1;
+	if (fgets(line, sizeof(line), file) != NULL) {
+		int column = 0;
+		for (char *name = strtok(line, ",\r\n"); name != NULL;
+				name = strtok(NULL, ",\r\n"), column++) {
+			while (*name == ' ') {
+				name++;
+			}
+			if (strcmp(name, "PLETH") == 0) {
+				pleth_column = column;
+			}
+		}
+	}
+	int count = 0;
+	while (pleth_column >= 0 && count < MAX_SAMPLES
+			&& fgets(line, sizeof(line), file) != NULL) {
+		char *field = line;
+		for (int column = 0; column < pleth_column && field != NULL; column++) {
+			field = strchr(field, ',');
+			if (field != NULL) {
+				field++;
+			}
+		}
+		pleth[count++] = field != NULL ? atof(field) : 0.0;
+	}
+	fclose(file);
+	return count;
+}
+
+/**
+ * @brief Reads the breath annotations of a BIDMC *_Breaths.csv file as times in s.
+ */
+static int readBreaths(const char *filename) {
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) {
+		return 0;
+	}
+	char line[256];
+	int count = 0;
+	if (fgets(line, sizeof(line), file) != NULL) {
+		int first, second;
+		while (count < MAX_SAMPLES / RAW_FREQ
+				&& fgets(line, sizeof(line), file) != NULL) {
+			if (sscanf(line, "%d,%d", &first, &second) == 2) {
+				breaths[count++] = 0.5 * (first + second) / RAW_FREQ;
+			} else if (sscanf(line, "%d", &first) == 1) {
+				breaths[count++] = (float) first / RAW_FREQ;
+			}
+		}
+	}
+	fclose(file);
+	return count;
+}
+
+/**
+ * @brief Reads the RESP column of a BIDMC *_Numerics.csv file, one value per second.
+ */
+static int readNumerics(const char *filename) {
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) {
+		return 0;
+	}
+	char line[256];
+	int resp_column = -1;
+	if (fgets(line, sizeof(line), file) != NULL) {
+		int column = 0;
+		for (char *name = strtok(line, ",\r\n"); name != NULL;
+				name = strtok(NULL, ",\r\n"), column++) {
+			while (*name == ' ') {
+				name++;
+			}
+			if (strcmp(name, "RESP") == 0) {
+				resp_column = column;
+			}
+		}
+	}
+	int count = 0;
+	while (resp_column >= 0 && count < MAX_SECONDS
+			&& fgets(line, sizeof(line), file) != NULL) {
+		char *field = line;
+		for (int column = 0; column < resp_column && field != NULL; column++) {
+			field = strchr(field, ',');
+			if (field != NULL) {
+				field++;
+			}
+		}
+		numerics[count++] = field != NULL && *field != '\0' && *field != '\n' ?
+				atof(field) : nanf("");
+	}
+	fclose(file);
+	return count;
+}
+
+/**
+ * @brief Rate of the breath annotations in the window ending at the given time.
+ */
+static float referenceRate(int breaths_size, float time) {
+	int first = -1;
+	int last = -1;
+	for (int i = 0; i < breaths_size; i++) {
+		if (breaths[i] > time - REFERENCE_WINDOW && breaths[i] <= time) {
+			if (first < 0) {
+				first = i;
+			}
+			last = i;
+		}
+	}
+	if (first < 0 || last - first < 2) {
+		return nanf("");
+	}
+	return 60.0 * (last - first) / (breaths[last] - breaths[first]);
+}
+
+typedef struct {
+	float error; /**< Sum of the absolute errors */
+	int compared; /**< Number of seconds with both rates */
+	int seconds; /**< Number of seconds with a reference */
+} Score;
+
+static void score(Score *score, float rate, float reference) {
+	if (isnan(reference)) {
+		return;
+	}
+	score->seconds++;
+	if (!isnan(rate)) {
+		score->error += fabsf(rate - reference);
+		score->compared++;
+	}
+}
+
+static void printScore(const char *name, Score *score) {
+	printf("%-9s MAE %5.2f breaths/min, rate given %5.1f%% of the time\n", name,
+			score->compared > 0 ? score->error / score->compared : nanf(""),
+			score->seconds > 0 ? 100.0 * score->compared / score->seconds : 0.0);
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s BIDMC_PREFIX [-v]\n", argv[0]);
+		return 1;
+	}
+	int verbose = argc > 2 && strcmp(argv[2], "-v") == 0;
+	char filename[512];
+	snprintf(filename, sizeof(filename), "%s_Signals.csv", argv[1]);
+	int samples = readSignals(filename);
+	snprintf(filename, sizeof(filename), "%s_Breaths.csv", argv[1]);
+	int breaths_size = readBreaths(filename);
+	snprintf(filename, sizeof(filename), "%s_Numerics.csv", argv[1]);
+	int numerics_size = readNumerics(filename);
+	if (samples == 0 || breaths_size == 0) {
+		fprintf(stderr, "%s: no PLETH signal or breath annotations\n", argv[1]);
+		return 1;
+	}
+
+	HR_HeartMonitor *heartMonitor = HR_heartMonitor_new(FREQ, SIZE, 0.35, 4,
+			0.8, 8.5, 2, 5, 7, RATE_LOW, RATE_HIGH, HR_ENGINE_PEAKS);
+	if (heartMonitor == NULL) {
+		fprintf(stderr, "no memory or band-pass filter table\n");
+		return 1;
+	}
+	static const char *names[HR_RESP_FEATURES] = { "amplitude", "baseline",
+			"interval" };
+	Score features[HR_RESP_FEATURES] = { 0 };
+	Score fused = { 0 };
+	Score monitor = { 0 };
+	float fifo[BLOCK * HR_AFE_STRIDE];
+	int seconds = samples / DECIMATION / BLOCK;
+	for (int second = 0; second < seconds; second++) {
+		for (int i = 0; i < BLOCK; i++) {
+			float value = pleth[(second * BLOCK + i) * DECIMATION];
+			fifo[i * HR_AFE_STRIDE + HR_AFE_RED] = value;
+			fifo[i * HR_AFE_STRIDE + HR_AFE_IR] = value;
+			fifo[i * HR_AFE_STRIDE + HR_AFE_GREEN] = value;
+			fifo[i * HR_AFE_STRIDE + 3] = 0.0;
+		}
+		HR_heartMonitor_addInterleaved(heartMonitor, fifo, NULL, BLOCK);
+
+		float time = second + 1;
+		float reference = referenceRate(breaths_size, time);
+		float rate = HR_respiration_rate(heartMonitor->respiration);
+		float resp = second + 1 < numerics_size ? numerics[second + 1] : nanf("");
+		if (verbose) {
+			printf("%4d s  reference %5.1f  monitor %5.1f  fused %5.1f  (", second + 1,
+					reference, resp, rate);
+			for (int feature = 0; feature < HR_RESP_FEATURES; feature++) {
+				printf(" %5.1f", HR_respiration_featureRate(
+						heartMonitor->respiration, feature));
+			}
+			printf(" )\n");
+		}
+		if (time < WARMUP) {
+			continue;
+		}
+		for (int feature = 0; feature < HR_RESP_FEATURES; feature++) {
+			score(&features[feature], HR_respiration_featureRate(
+					heartMonitor->respiration, feature), reference);
+		}
+		score(&fused, rate, reference);
+		score(&monitor, resp, reference);
+	}
+
+	for (int feature = 0; feature < HR_RESP_FEATURES; feature++) {
+		printScore(names[feature], &features[feature]);
+	}
+	printScore("fused", &fused);
+	printScore("RESP", &monitor);
+	printf("respiration stage: %d bytes\n",
+			(int) HR_RESPIRATION_FOOTPRINT(HR_RESP_BREATHS));
+	HR_heartMonitor_free(heartMonitor);
+	return 0;
+}
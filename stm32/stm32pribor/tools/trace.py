@@ -0,0 +1,107 @@
+"""Extracts the signals of the trace probes (Core/Inc/trace.h) from an SWO capture.
+
+Enable ITM stimulus port TRACE_ITM_PORT (2) in the SWV settings of the
+debugger, which also makes the firmware write the probes, and save the SWO
+output to a file, for example with OpenOCD:
+
+    tpiu config internal swo.bin uart off 64000000 2000000
+    itm ports on
+
+then:
+
+    python tools/trace.py swo.bin [--out DIR] [--port-data]
+
+The file is the raw ITM stream of the SWO pin. With --port-data it is the data
+of stimulus port TRACE_ITM_PORT alone. A table of the records per probe is
+printed; with --out every probe is written to DIR/<probe>.csv, one sample per
+line in order. The probe names come from the TRACE_Probe enum of trace.h.
+"""
+import math
+import os
+import re
+import struct
+import sys
+
+from profiler import port_data
+
+TRACE_SYNC = 0xA5
+TRACE_ITM_PORT = 2
+HRQ_FRAC = 23
+HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Core', 'Inc', 'trace.h')
+
+
+def probe_names():
+    """Names of the TRACE_Probe enum without the TRACE_ prefix, in order."""
+    try:
+        with open(HEADER) as f:
+            text = f.read()
+    except OSError:
+        return []
+    body = re.search(r'typedef enum \{(.*?)\} TRACE_Probe;', text, re.S)
+    if body is None:
+        return []
+    names = re.findall(r'^\s*TRACE_(\w+)', body.group(1), re.M)
+    return [name.lower() for name in names if name != 'PROBE_COUNT']
+
+
+def records(data, probes):
+    """(sequence, probe, samples) of the records, see TRACE_write."""
+    result = []
+    i = 0
+    while i + 8 <= len(data):
+        header, sequence = struct.unpack_from('<2I', data, i)
+        probe = header >> 8 & 0xFF
+        fmt = header >> 16 & 0xFF
+        count = header >> 24
+        if (header & 0xFF != TRACE_SYNC or probe >= probes or fmt > 1 or count == 0
+                or i + 8 + 4 * count > len(data)):
+            i += 1
+            continue
+        if fmt == 0:
+            samples = struct.unpack_from('<%df' % count, data, i + 8)
+        else:
+            samples = [x / float(1 << HRQ_FRAC) for x in struct.unpack_from('<%di' % count, data, i + 8)]
+        result.append((sequence, probe, samples))
+        i += 8 + 4 * count
+    return result
+
+
+def main(args):
+    paths = [arg for arg in args if not arg.startswith('--')]
+    out = None
+    if '--out' in args:
+        index = args.index('--out')
+        out = args[index + 1] if index + 1 < len(args) else None
+        paths = [path for path in paths if path != out]
+    if len(paths) != 1 or ('--out' in args and out is None):
+        print(__doc__)
+        return 1
+    with open(paths[0], 'rb') as f:
+        stream = f.read()
+    data = stream if '--port-data' in args else port_data(stream, TRACE_ITM_PORT)
+    names = probe_names()
+    decoded = records(data, len(names) or 256)
+    if not decoded:
+        print('%s: no trace record' % paths[0])
+        return 1
+    lost = sum(max(0, ((b[0] - a[0]) & 0xFFFFFFFF) - 1) for a, b in zip(decoded, decoded[1:]))
+    signals = {}
+    for _, probe, samples in decoded:
+        signals.setdefault(probe, []).extend(samples)
+    print('%d records (%d lost)' % (len(decoded), lost))
+    print('%-14s %8s %8s %12s %12s %12s' % ('probe', 'records', 'samples', 'min', 'max', 'rms'))
+    for probe in sorted(signals):
+        name = names[probe] if probe < len(names) else 'probe_%d' % probe
+        values = signals[probe]
+        rms = math.sqrt(sum(x * x for x in values) / len(values))
+        print('%-14s %8d %8d %12.6g %12.6g %12.6g' % (
+            name, sum(1 for r in decoded if r[1] == probe), len(values), min(values), max(values), rms))
+        if out is not None:
+            os.makedirs(out, exist_ok=True)
+            with open(os.path.join(out, name + '.csv'), 'w') as f:
+                f.writelines('%.9g\n' % x for x in values)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))